@@ -1,13 +1,545 @@
+#include "Core/CPU/CodeBuffer.h"
 #include "Core/CPU/CPUCore.h"
+#include "Core/CPU/Flags.h"
 #include "Core/CPU/IR.h"
 #include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/Passes/RegisterAllocation.h"
+#include "Core/CPU/AArch64Backend/Assembler.h"
 #include "AArch64.h"
 #include "LogManager.h"
-#include <map>
+#include <algorithm>
+#include <unordered_map>
 
 namespace Emu {
+using namespace AArch64Asm;
 
-void* AArch64::CompileCode(Emu::IR::IntrusiveIRList const *ir) {
-  return nullptr;
+// Host registers handed to the register allocator
+// Caller saved first, guest state gets pinned to the callee saved ones at the top
+constexpr std::array<Reg, 22> HostRegisters = {
+  X0, X1, X2, X3, X4, X5, X6, X7, X8,
+  X11, X12, X13, X14, X15,
+  X19, X20, X21, X22, X23, X24, X25, X26,
+};
+constexpr uint64_t HOST_CALLER_SAVED_MASK = (1ULL << 14) - 1;
+
+// Registers the allocator never sees
+// X18 is the platform register and is left alone
+constexpr Reg STATE_REG = X28;  ///< X86State*
+constexpr Reg MEMBASE_REG = X27; ///< Guest memory base
+constexpr Reg DST_SCRATCH = X9;
+constexpr Reg ADDR_SCRATCH = X10;
+constexpr Reg SRC_SCRATCH0 = X16;
+constexpr Reg SRC_SCRATCH1 = X17;
+
+// Caller saved registers the allocator hands out, in pairs for blocks that call helpers outside of call ops
+constexpr std::array<std::pair<Reg, Reg>, 7> CallerSavedRegisters = {{
+  {X0, X1}, {X2, X3}, {X4, X5}, {X6, X7}, {X8, X11}, {X12, X13}, {X14, X15},
+}};
+
+// Callee saved pairs, X29/X30 first
+constexpr std::array<std::pair<Reg, Reg>, 6> SavedRegisters = {{
+  {X29, X30}, {X19, X20}, {X21, X22}, {X23, X24}, {X25, X26}, {X27, X28},
+}};
+
+// Frame layout after the prologue, relative to SP
+constexpr uint32_t SYSCALL_ARGS_OFFSET = 0;
+constexpr uint32_t SPILL_OFFSET = SYSCALL_ARGS_OFFSET + IR::IROp_Syscall::MAX_ARGS * 8;
+
+// Most guest state the allocator keeps in host registers while a block runs
+constexpr uint32_t NUM_PINNED_REGISTERS = 6;
+
+constexpr size_t CODE_BUFFER_SIZE = 128 * 1024 * 1024;
+
+static uint64_t SyscallThunk(SyscallHandler *Handler, SyscallHandler::SyscallArguments *Args) {
+  return Handler->HandleSyscall(Args);
+}
+
+static uint64_t FallbackThunk(CPUCore *CPU, X86State *State, uint64_t RIP) {
+  return CPU->FallbackInstruction(State, RIP);
+}
+
+static void SignalThunk(CPUCore *CPU, X86State *State, uint64_t Signal) {
+  CPU->RaiseSignal(State, Signal);
+}
+
+// There's no 128/64 divide, the high half is below the divisor so the quotient fits
+static uint64_t LongDivideThunk(uint64_t Low, uint64_t High, uint64_t Divisor) {
+  return ((static_cast<unsigned __int128>(High) << 64) | Low) / Divisor;
+}
+
+static uint64_t LongRemainderThunk(uint64_t Low, uint64_t High, uint64_t Divisor) {
+  return ((static_cast<unsigned __int128>(High) << 64) | Low) % Divisor;
+}
+
+static bool GetComparisonCC(IR::IROp_Select::ComparisonOp Comparison, Cond *CC) {
+  switch (Comparison) {
+  case IR::IROp_Select::COMP_EQ: *CC = CC_EQ; break;
+  case IR::IROp_Select::COMP_NEQ: *CC = CC_NE; break;
+  case IR::IROp_Select::COMP_SLT: *CC = CC_LT; break;
+  case IR::IROp_Select::COMP_SLE: *CC = CC_LE; break;
+  case IR::IROp_Select::COMP_SGT: *CC = CC_GT; break;
+  case IR::IROp_Select::COMP_SGE: *CC = CC_GE; break;
+  case IR::IROp_Select::COMP_ULT: *CC = CC_CC; break;
+  case IR::IROp_Select::COMP_ULE: *CC = CC_LS; break;
+  case IR::IROp_Select::COMP_UGT: *CC = CC_HI; break;
+  case IR::IROp_Select::COMP_UGE: *CC = CC_CS; break;
+  default: return false;
+  }
+  return true;
+}
+
+class AArch64 final : public CPUBackend {
+public:
+  explicit AArch64(CPUCore *CPU);
+  std::string GetName() override { return "AArch64"; }
+  void* CompileCode(Emu::IR::IntrusiveIRList const *ir) override;
+  void FreeCode(void *Block) override { Code.Free(Block); }
+
+private:
+  CPUCore *cpu;
+  IR::RegisterFile RegisterFile;
+  CodeBuffer Code{CODE_BUFFER_SIZE};
 };
+
+namespace {
+class BlockEmitter final {
+public:
+  BlockEmitter(CPUCore *CPU, IR::RegisterFile const &Registers, IR::IntrusiveIRList const *ir)
+    : cpu {CPU}
+    , RegisterFile {Registers}
+    , IR {ir}
+    , RA {IR::AllocateRegisters(ir, Registers)} {
+  }
+
+  bool Emit();
+  Assembler const &GetAssembler() const { return Asm; }
+
+private:
+  CPUCore *cpu;
+  IR::RegisterFile const &RegisterFile;
+  IR::IntrusiveIRList const *IR;
+  IR::RegisterAllocationData RA;
+  Assembler Asm;
+  std::unordered_map<IR::AlignmentType, Assembler::Label> Labels;
+  uint32_t FrameSize;
+
+  Assembler::Label GetLabel(IR::AlignmentType Offset) {
+    auto it = Labels.find(Offset);
+    if (it == Labels.end())
+      it = Labels.emplace(Offset, Asm.NewLabel()).first;
+    return it->second;
+  }
+
+  // Falls back to an index register when the offset doesn't fit in the immediate
+  void LoadOffset(uint8_t Size, Reg Dst, Reg Base, uint32_t Offset) {
+    if (Assembler::IsLoadStoreImmEncodable(Size, Offset)) {
+      Asm.Load(Size, Dst, Base, Offset);
+    }
+    else {
+      Asm.MovImm(ADDR_SCRATCH, Offset);
+      Asm.LoadIndexed(Size, Dst, Base, ADDR_SCRATCH);
+    }
+  }
+
+  void StoreOffset(uint8_t Size, Reg Src, Reg Base, uint32_t Offset) {
+    if (Assembler::IsLoadStoreImmEncodable(Size, Offset)) {
+      Asm.Store(Size, Src, Base, Offset);
+    }
+    else {
+      Asm.MovImm(ADDR_SCRATCH, Offset);
+      Asm.StoreIndexed(Size, Src, Base, ADDR_SCRATCH);
+    }
+  }
+
+  // Add and sub immediates are only 12 bits
+  void AdjustSP(bool Sub, uint32_t Size) {
+    while (Size) {
+      uint32_t Chunk = std::min<uint32_t>(Size, 4080);
+      if (Sub)
+        Asm.SubImm(SP, SP, Chunk);
+      else
+        Asm.AddImm(SP, SP, Chunk);
+      Size -= Chunk;
+    }
+  }
+
+  uint32_t SpillOffset(uint32_t Slot) const { return SPILL_OFFSET + Slot * 8; }
+
+  Reg GetSrc(IR::AlignmentType Value, Reg Scratch) {
+    auto &Assignment = RA.Get(Value);
+    if (!Assignment.IsSpilled())
+      return HostRegisters[Assignment.Register];
+    LoadOffset(8, Scratch, SP, SpillOffset(Assignment.SpillSlot));
+    return Scratch;
+  }
+
+  Reg GetDst(IR::AlignmentType Value) {
+    auto &Assignment = RA.Get(Value);
+    return Assignment.IsSpilled() ? DST_SCRATCH : HostRegisters[Assignment.Register];
+  }
+
+  void StoreDst(IR::AlignmentType Value, Reg R) {
+    auto &Assignment = RA.Get(Value);
+    if (Assignment.IsSpilled())
+      StoreOffset(8, R, SP, SpillOffset(Assignment.SpillSlot));
+  }
+
+  void WritebackPinned() {
+    for (auto &Pin : RA.Pinned)
+      StoreOffset(8, HostRegisters[Pin.Register], STATE_REG, Pin.ContextOffset);
+  }
+
+  void ReloadPinned() {
+    for (auto &Pin : RA.Pinned)
+      LoadOffset(8, HostRegisters[Pin.Register], STATE_REG, Pin.ContextOffset);
+  }
+
+  // Partial accesses to pinned state go through X86State
+  template<typename F>
+  void ForEachOverlappingPin(uint32_t Offset, uint8_t Size, F Func) {
+    for (auto &Pin : RA.Pinned) {
+      if (Offset < Pin.ContextOffset + 8 && Pin.ContextOffset < Offset + Size)
+        Func(Pin);
+    }
+  }
+
+  void CallHelper(void *Func) {
+    Asm.MovImm(SRC_SCRATCH0, reinterpret_cast<uint64_t>(Func));
+    Asm.Blr(SRC_SCRATCH0);
+  }
+
+  void EmitPrologue();
+  void EmitEpilogue();
+  bool EmitOp(IR::AlignmentType Offset, IR::IROp_Header const *op);
+};
+
+void BlockEmitter::EmitPrologue() {
+  for (auto &Pair : SavedRegisters)
+    Asm.Stp(Pair.first, Pair.second);
+
+  // SP has to stay 16 byte aligned
+  FrameSize = (SPILL_OFFSET + RA.SpillSlots * 8 + 15) & ~15U;
+  AdjustSP(true, FrameSize);
+
+  // Code caches are per thread, so the thread's state can be baked in
+  Asm.MovImm(STATE_REG, reinterpret_cast<uint64_t>(&cpu->GetTLSThread()->CPUState));
+  Asm.MovImm(MEMBASE_REG, cpu->MemoryMapper->GetBaseOffset<uint64_t>(0));
+  ReloadPinned();
+}
+
+void BlockEmitter::EmitEpilogue() {
+  WritebackPinned();
+  AdjustSP(false, FrameSize);
+  for (auto it = SavedRegisters.rbegin(); it != SavedRegisters.rend(); ++it)
+    Asm.Ldp(it->first, it->second);
+  Asm.Ret();
+}
+
+bool BlockEmitter::EmitOp(IR::AlignmentType Offset, IR::IROp_Header const *op) {
+  switch (op->Op) {
+  case IR::OP_BEGINBLOCK:
+  case IR::OP_RIP_MARKER:
+  break;
+  case IR::OP_ENDBLOCK: {
+    auto EndOp = op->C<IR::IROp_EndBlock>();
+    if (EndOp->RIPIncrement) {
+      LoadOffset(8, DST_SCRATCH, STATE_REG, offsetof(X86State, rip));
+      if (EndOp->RIPIncrement < 4096) {
+        Asm.AddImm(DST_SCRATCH, DST_SCRATCH, EndOp->RIPIncrement);
+      }
+      else {
+        Asm.MovImm(SRC_SCRATCH0, EndOp->RIPIncrement);
+        Asm.Add(DST_SCRATCH, DST_SCRATCH, SRC_SCRATCH0);
+      }
+      StoreOffset(8, DST_SCRATCH, STATE_REG, offsetof(X86State, rip));
+    }
+    EmitEpilogue();
+  break;
+  }
+  case IR::OP_JUMP_TGT:
+    Asm.Bind(GetLabel(Offset));
+  break;
+  case IR::OP_JUMP:
+    Asm.B(GetLabel(op->C<IR::IROp_Jump>()->Target));
+  break;
+  case IR::OP_COND_JUMP: {
+    auto JumpOp = op->C<IR::IROp_CondJump>();
+    Cond CC;
+    if (!GetComparisonCC(JumpOp->Cond, &CC)) {
+      LogMan::Msg::E("Unknown jump comparison: %d", JumpOp->Cond);
+      return false;
+    }
+
+    Asm.Cmp(GetSrc(JumpOp->Args[0], SRC_SCRATCH0), GetSrc(JumpOp->Args[1], SRC_SCRATCH1));
+    Asm.BCond(CC, GetLabel(JumpOp->Target));
+  break;
+  }
+  case IR::OP_CONSTANT: {
+    Reg Dst = GetDst(Offset);
+    Asm.MovImm(Dst, op->C<IR::IROp_Constant>()->Constant);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LOADCONTEXT: {
+    auto LoadOp = op->C<IR::IROp_LoadContext>();
+    Reg Dst = GetDst(Offset);
+    uint32_t Pin = IR::FindPinnedRegister(RA, LoadOp->Offset, LoadOp->Size);
+    if (Pin != IR::RegisterAssignment::INVALID) {
+      Asm.Mov(Dst, HostRegisters[Pin]);
+    }
+    else {
+      ForEachOverlappingPin(LoadOp->Offset, LoadOp->Size, [this](IR::PinnedRegister const &Pin) {
+        StoreOffset(8, HostRegisters[Pin.Register], STATE_REG, Pin.ContextOffset);
+      });
+      LoadOffset(LoadOp->Size, Dst, STATE_REG, LoadOp->Offset);
+    }
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_STORECONTEXT: {
+    auto StoreOp = op->C<IR::IROp_StoreContext>();
+    Reg Src = GetSrc(StoreOp->Arg, SRC_SCRATCH0);
+    uint32_t Pin = IR::FindPinnedRegister(RA, StoreOp->Offset, StoreOp->Size);
+    if (Pin != IR::RegisterAssignment::INVALID) {
+      Asm.Mov(HostRegisters[Pin], Src);
+    }
+    else {
+      ForEachOverlappingPin(StoreOp->Offset, StoreOp->Size, [this](IR::PinnedRegister const &Pin) {
+        StoreOffset(8, HostRegisters[Pin.Register], STATE_REG, Pin.ContextOffset);
+      });
+      StoreOffset(StoreOp->Size, Src, STATE_REG, StoreOp->Offset);
+      ForEachOverlappingPin(StoreOp->Offset, StoreOp->Size, [this](IR::PinnedRegister const &Pin) {
+        LoadOffset(8, HostRegisters[Pin.Register], STATE_REG, Pin.ContextOffset);
+      });
+    }
+  break;
+  }
+  case IR::OP_ADD:
+  case IR::OP_SUB:
+  case IR::OP_OR:
+  case IR::OP_XOR:
+  case IR::OP_AND:
+  case IR::OP_NAND:
+  case IR::OP_SHL:
+  case IR::OP_SHR:
+  case IR::OP_ASHR:
+  case IR::OP_BITEXTRACT:
+  case IR::OP_MUL:
+  case IR::OP_UMULH:
+  case IR::OP_SMULH:
+  case IR::OP_UDIV:
+  case IR::OP_SDIV:
+  case IR::OP_UREM:
+  case IR::OP_SREM: {
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    Reg Src1 = GetSrc(BiOp->Args[0], SRC_SCRATCH0);
+    Reg Src2 = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    switch (op->Op) {
+    case IR::OP_ADD: Asm.Add(Dst, Src1, Src2); break;
+    case IR::OP_SUB: Asm.Sub(Dst, Src1, Src2); break;
+    case IR::OP_OR:  Asm.Orr(Dst, Src1, Src2); break;
+    case IR::OP_XOR: Asm.Eor(Dst, Src1, Src2); break;
+    case IR::OP_AND: Asm.And(Dst, Src1, Src2); break;
+    case IR::OP_NAND: Asm.Bic(Dst, Src1, Src2); break;
+    case IR::OP_SHL: Asm.Lslv(Dst, Src1, Src2); break;
+    case IR::OP_SHR: Asm.Lsrv(Dst, Src1, Src2); break;
+    case IR::OP_ASHR: Asm.Asrv(Dst, Src1, Src2); break;
+    case IR::OP_MUL: Asm.Mul(Dst, Src1, Src2); break;
+    case IR::OP_UMULH: Asm.Umulh(Dst, Src1, Src2); break;
+    case IR::OP_SMULH: Asm.Smulh(Dst, Src1, Src2); break;
+    case IR::OP_UDIV: Asm.Udiv(Dst, Src1, Src2); break;
+    case IR::OP_SDIV: Asm.Sdiv(Dst, Src1, Src2); break;
+    // No remainder instruction, take the quotient back off
+    case IR::OP_UREM:
+      Asm.Udiv(Dst, Src1, Src2);
+      Asm.Msub(Dst, Dst, Src2, Src1);
+    break;
+    case IR::OP_SREM:
+      Asm.Sdiv(Dst, Src1, Src2);
+      Asm.Msub(Dst, Dst, Src2, Src1);
+    break;
+    default:
+      Asm.Lsrv(Dst, Src1, Src2);
+      Asm.AndOne(Dst, Dst);
+    break;
+    }
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LUDIV:
+  case IR::OP_LUREM: {
+    // Not a call op, so every caller saved register gets preserved here instead of the allocator working around each divide
+    // Sources have to be read before the pushes move SP away from the spill slots
+    auto TriOp = op->C<IR::IROp_TriOp>();
+    std::array<Reg, 3> Args = {SRC_SCRATCH0, SRC_SCRATCH1, ADDR_SCRATCH};
+    for (size_t i = 0; i < Args.size(); ++i) {
+      Reg Src = GetSrc(TriOp->Args[i], Args[i]);
+      if (Src != Args[i])
+        Asm.Mov(Args[i], Src);
+    }
+
+    for (auto &Pair : CallerSavedRegisters)
+      Asm.Stp(Pair.first, Pair.second);
+    Asm.Mov(X0, Args[0]);
+    Asm.Mov(X1, Args[1]);
+    Asm.Mov(X2, Args[2]);
+    CallHelper(reinterpret_cast<void*>(op->Op == IR::OP_LUDIV ? LongDivideThunk : LongRemainderThunk));
+    Asm.Mov(DST_SCRATCH, X0);
+    for (auto it = CallerSavedRegisters.rbegin(); it != CallerSavedRegisters.rend(); ++it)
+      Asm.Ldp(it->first, it->second);
+
+    Reg Dst = GetDst(Offset);
+    if (Dst != DST_SCRATCH)
+      Asm.Mov(Dst, DST_SCRATCH);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_SELECT: {
+    auto SelectOp = op->C<IR::IROp_Select>();
+    Cond CC;
+    if (!GetComparisonCC(SelectOp->Op, &CC)) {
+      LogMan::Msg::E("Unknown select comparison: %d", SelectOp->Op);
+      return false;
+    }
+
+    Asm.Cmp(GetSrc(SelectOp->Args[0], SRC_SCRATCH0), GetSrc(SelectOp->Args[1], SRC_SCRATCH1));
+    // Reloading spilled values doesn't touch the flags
+    Reg True = GetSrc(SelectOp->Args[2], SRC_SCRATCH0);
+    Reg False = GetSrc(SelectOp->Args[3], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    Asm.Csel(CC, Dst, True, False);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_TRUNC_32:
+  case IR::OP_TRUNC_16: {
+    Reg Src = GetSrc(op->C<IR::IROp_MonoOp>()->Arg, SRC_SCRATCH0);
+    Reg Dst = GetDst(Offset);
+    if (op->Op == IR::OP_TRUNC_32)
+      Asm.Mov32(Dst, Src);
+    else
+      Asm.Uxth(Dst, Src);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LOAD_MEM: {
+    auto LoadMemOp = op->C<IR::IROp_LoadMem>();
+    Reg Addr = GetSrc(LoadMemOp->Arg[0], SRC_SCRATCH0);
+    if (LoadMemOp->Arg[1] != ~0U) {
+      Asm.Add(ADDR_SCRATCH, Addr, GetSrc(LoadMemOp->Arg[1], SRC_SCRATCH1));
+      Addr = ADDR_SCRATCH;
+    }
+    Reg Dst = GetDst(Offset);
+    if (LoadMemOp->SignExtend)
+      Asm.LoadSignedIndexed(LoadMemOp->Size, Dst, MEMBASE_REG, Addr);
+    else
+      Asm.LoadIndexed(LoadMemOp->Size, Dst, MEMBASE_REG, Addr);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_STORE_MEM: {
+    auto StoreMemOp = op->C<IR::IROp_StoreMem>();
+    Reg Addr = GetSrc(StoreMemOp->Arg[1], SRC_SCRATCH0);
+    if (StoreMemOp->Arg[2] != ~0U) {
+      Asm.Add(ADDR_SCRATCH, Addr, GetSrc(StoreMemOp->Arg[2], SRC_SCRATCH1));
+      Addr = ADDR_SCRATCH;
+    }
+    Asm.StoreIndexed(StoreMemOp->Size, GetSrc(StoreMemOp->Arg[0], SRC_SCRATCH1), MEMBASE_REG, Addr);
+  break;
+  }
+  case IR::OP_SYSCALL: {
+    auto SyscallOp = op->C<IR::IROp_Syscall>();
+    for (size_t i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i) {
+      StoreOffset(8, GetSrc(SyscallOp->Arguments[i], SRC_SCRATCH0), SP, SYSCALL_ARGS_OFFSET + i * 8);
+    }
+    WritebackPinned();
+    Asm.MovImm(X0, reinterpret_cast<uint64_t>(&cpu->syscallhandler));
+    Asm.AddImm(X1, SP, SYSCALL_ARGS_OFFSET);
+    CallHelper(reinterpret_cast<void*>(SyscallThunk));
+    ReloadPinned();
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, X0);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_FALLBACK: {
+    WritebackPinned();
+    Asm.MovImm(X0, reinterpret_cast<uint64_t>(cpu));
+    Asm.Mov(X1, STATE_REG);
+    Asm.MovImm(X2, op->C<IR::IROp_Fallback>()->RIP);
+    CallHelper(reinterpret_cast<void*>(FallbackThunk));
+    ReloadPinned();
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, X0);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_RAISE_SIGNAL:
+    WritebackPinned();
+    Asm.MovImm(X0, reinterpret_cast<uint64_t>(cpu));
+    Asm.Mov(X1, STATE_REG);
+    Asm.MovImm(X2, op->C<IR::IROp_RaiseSignal>()->Signal);
+    CallHelper(reinterpret_cast<void*>(SignalThunk));
+    ReloadPinned();
+  break;
+  case IR::OP_GET_FLAG: {
+    WritebackPinned();
+    Asm.Mov(X0, STATE_REG);
+    Asm.MovImm(X1, op->C<IR::IROp_GetFlag>()->Bit);
+    CallHelper(reinterpret_cast<void*>(Flags::GetFlag));
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, X0);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_MATERIALIZE_FLAGS:
+    WritebackPinned();
+    Asm.Mov(X0, STATE_REG);
+    CallHelper(reinterpret_cast<void*>(Flags::Materialize));
+    ReloadPinned();
+  break;
+  default:
+    // Function level ops never come out of the op dispatcher
+    LogMan::Msg::E("Unknown IR Op: %d(%s)", op->Op, IR::GetName(op->Op).data());
+    return false;
+  }
+
+  return true;
+}
+
+bool BlockEmitter::Emit() {
+  EmitPrologue();
+
+  size_t Size = IR->GetOffset();
+  for (size_t i = 0; i != Size; i += IR::GetSize(IR->GetOp(i)->Op)) {
+    if (!EmitOp(i, IR->GetOp(i)))
+      return false;
+  }
+  return true;
+}
+}
+
+AArch64::AArch64(CPUCore *CPU)
+  : cpu {CPU} {
+  RegisterFile.NumRegisters = HostRegisters.size();
+  RegisterFile.CallerSavedMask = HOST_CALLER_SAVED_MASK;
+  RegisterFile.MaxPinned = NUM_PINNED_REGISTERS;
+}
+
+void* AArch64::CompileCode(Emu::IR::IntrusiveIRList const *ir) {
+  BlockEmitter Emitter(cpu, RegisterFile, ir);
+  if (!Emitter.Emit())
+    return nullptr;
+
+  auto &Asm = Emitter.GetAssembler();
+  return Code.Copy(Asm.GetData(), Asm.GetSize());
+}
+
+CPUBackend *CreateAArch64Backend(Emu::CPUCore *CPU) {
+  return new AArch64(CPU);
+}
 }
@@ -0,0 +1,218 @@
+#pragma once
+#include "LogManager.h"
+#include <cstdint>
+#include <vector>
+
+namespace Emu::AArch64Asm {
+
+// 64bit general purpose registers, 31 is XZR or SP depending on the instruction
+enum Reg : uint8_t {
+  X0 = 0, X1, X2, X3, X4, X5, X6, X7,
+  X8, X9, X10, X11, X12, X13, X14, X15,
+  X16, X17, X18, X19, X20, X21, X22, X23,
+  X24, X25, X26, X27, X28, X29, X30,
+  SP = 31,
+  XZR = 31,
+};
+
+enum Cond : uint8_t {
+  CC_EQ = 0, CC_NE, CC_CS, CC_CC, CC_MI, CC_PL, CC_VS, CC_VC,
+  CC_HI, CC_LS, CC_GE, CC_LT, CC_GT, CC_LE, CC_AL,
+};
+
+/**
+ * @brief Minimal AArch64 encoder for the instructions the JIT needs
+ *
+ * All code it emits is position independent, so a finished buffer can be copied anywhere
+ */
+class Assembler final {
+public:
+  using Label = uint32_t;
+
+  size_t GetSize() const { return Code.size() * sizeof(uint32_t); }
+  uint8_t const *GetData() const { return reinterpret_cast<uint8_t const*>(Code.data()); }
+
+  Label NewLabel() {
+    Labels.emplace_back();
+    return Labels.size() - 1;
+  }
+
+  void Bind(Label L) {
+    auto &Data = Labels[L];
+    LogMan::Throw::A(Data.Position == -1, "Label bound twice");
+    Data.Position = Code.size();
+    for (auto Fixup : Data.Fixups) {
+      PatchBranch(Fixup, Data.Position);
+    }
+    Data.Fixups.clear();
+  }
+
+  // Moves
+  void Mov(Reg Dst, Reg Src) { Emit(0xAA0003E0 | (Src << 16) | Dst); }
+  void Mov32(Reg Dst, Reg Src) { Emit(0x2A0003E0 | (Src << 16) | Dst); }
+  void Uxth(Reg Dst, Reg Src) { Emit(0x53003C00 | (Src << 5) | Dst); }
+
+  void MovImm(Reg Dst, uint64_t Imm) {
+    uint32_t Zeroes = 0;
+    uint32_t Ones = 0;
+    for (int i = 0; i < 4; ++i) {
+      uint16_t Part = Imm >> (i * 16);
+      Zeroes += Part == 0;
+      Ones += Part == 0xFFFF;
+    }
+
+    // MOVN sets everything we don't touch to ones
+    bool Inverted = Ones > Zeroes;
+    uint16_t Skip = Inverted ? 0xFFFF : 0;
+    bool First = true;
+    for (int i = 0; i < 4; ++i) {
+      uint16_t Part = Imm >> (i * 16);
+      if (Part == Skip)
+        continue;
+      if (First) {
+        uint16_t Value = Inverted ? ~Part : Part;
+        Emit((Inverted ? 0x92800000 : 0xD2800000) | (i << 21) | (Value << 5) | Dst); // MOVN/MOVZ
+        First = false;
+      }
+      else {
+        Emit(0xF2800000 | (i << 21) | (Part << 5) | Dst); // MOVK
+      }
+    }
+
+    if (First) {
+      // Every halfword matched, all zeroes or all ones
+      Emit((Inverted ? 0x92800000 : 0xD2800000) | Dst);
+    }
+  }
+
+  // Loads smaller than 8 bytes zero extend
+  // Unsigned scaled immediate offset, the offset must be a multiple of the size
+  void Load(uint8_t Size, Reg Dst, Reg Base, uint32_t Offset) { EmitLoadStoreImm(LoadOpcode(Size), Size, Dst, Base, Offset); }
+  void Store(uint8_t Size, Reg Src, Reg Base, uint32_t Offset) { EmitLoadStoreImm(StoreOpcode(Size), Size, Src, Base, Offset); }
+
+  // [Base + Index]
+  void LoadIndexed(uint8_t Size, Reg Dst, Reg Base, Reg Index) { EmitLoadStoreReg(LoadOpcode(Size), Dst, Base, Index); }
+  void LoadSignedIndexed(uint8_t Size, Reg Dst, Reg Base, Reg Index) { EmitLoadStoreReg(LoadSignedOpcode(Size), Dst, Base, Index); }
+  void StoreIndexed(uint8_t Size, Reg Src, Reg Base, Reg Index) { EmitLoadStoreReg(StoreOpcode(Size), Src, Base, Index); }
+
+  static bool IsLoadStoreImmEncodable(uint8_t Size, uint32_t Offset) {
+    return (Offset % Size) == 0 && (Offset / Size) < 4096;
+  }
+
+  void Stp(Reg Src1, Reg Src2) { Emit(0xA9800000 | ((-2 & 0x7F) << 15) | (Src2 << 10) | (SP << 5) | Src1); } ///< stp Src1, Src2, [sp, #-16]!
+  void Ldp(Reg Dst1, Reg Dst2) { Emit(0xA8C00000 | (2 << 15) | (Dst2 << 10) | (SP << 5) | Dst1); } ///< ldp Dst1, Dst2, [sp], #16
+
+  // ALU, shifted register forms with no shift
+  void Add(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x8B000000, Dst, Src1, Src2); }
+  void Sub(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0xCB000000, Dst, Src1, Src2); }
+  void And(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x8A000000, Dst, Src1, Src2); }
+  void Orr(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0xAA000000, Dst, Src1, Src2); }
+  void Eor(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0xCA000000, Dst, Src1, Src2); }
+  void Bic(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x8A200000, Dst, Src1, Src2); } ///< Src1 & ~Src2
+  void Lslv(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9AC02000, Dst, Src1, Src2); }
+  void Lsrv(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9AC02400, Dst, Src1, Src2); }
+  void Asrv(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9AC02800, Dst, Src1, Src2); }
+  void Mul(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9B007C00, Dst, Src1, Src2); } ///< madd Dst, Src1, Src2, xzr
+  void Umulh(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9BC07C00, Dst, Src1, Src2); }
+  void Smulh(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9B407C00, Dst, Src1, Src2); }
+  void Udiv(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9AC00800, Dst, Src1, Src2); }
+  void Sdiv(Reg Dst, Reg Src1, Reg Src2) { EmitRRR(0x9AC00C00, Dst, Src1, Src2); }
+  void Msub(Reg Dst, Reg Src1, Reg Src2, Reg Src3) { EmitRRR(0x9B008000 | (Src3 << 10), Dst, Src1, Src2); } ///< Src3 - Src1 * Src2
+  void Cmp(Reg Src1, Reg Src2) { EmitRRR(0xEB000000, XZR, Src1, Src2); }
+  void Csel(Cond CC, Reg Dst, Reg True, Reg False) { Emit(0x9A800000 | (False << 16) | (CC << 12) | (True << 5) | Dst); }
+  void AndOne(Reg Dst, Reg Src) { Emit(0x92400000 | (Src << 5) | Dst); } ///< and Dst, Src, #1
+
+  // Immediate forms, Reg 31 is SP here
+  void AddImm(Reg Dst, Reg Src, uint32_t Imm) { EmitAddSubImm(0x91000000, Dst, Src, Imm); }
+  void SubImm(Reg Dst, Reg Src, uint32_t Imm) { EmitAddSubImm(0xD1000000, Dst, Src, Imm); }
+
+  // Control flow
+  void Blr(Reg Target) { Emit(0xD63F0000 | (Target << 5)); }
+  void Ret() { Emit(0xD65F03C0); }
+
+  void B(Label L) { EmitBranch(0x14000000, L); }
+  void BCond(Cond CC, Label L) { EmitBranch(0x54000000 | CC, L); }
+  void Cbnz(Reg Src, Label L) { EmitBranch(0xB5000000 | Src, L); }
+
+private:
+  struct LabelData {
+    int64_t Position{-1};
+    std::vector<size_t> Fixups;
+  };
+
+  std::vector<uint32_t> Code;
+  std::vector<LabelData> Labels;
+
+  void Emit(uint32_t Inst) { Code.emplace_back(Inst); }
+
+  void EmitRRR(uint32_t Opcode, Reg Dst, Reg Src1, Reg Src2) {
+    Emit(Opcode | (Src2 << 16) | (Src1 << 5) | Dst);
+  }
+
+  void EmitAddSubImm(uint32_t Opcode, Reg Dst, Reg Src, uint32_t Imm) {
+    LogMan::Throw::A(Imm < 4096, "Immediate out of range");
+    Emit(Opcode | (Imm << 10) | (Src << 5) | Dst);
+  }
+
+  static uint32_t LoadOpcode(uint8_t Size) {
+    switch (Size) {
+    case 8: return 0xF9400000;
+    case 4: return 0xB9400000;
+    case 2: return 0x79400000;
+    case 1: return 0x39400000;
+    default: LogMan::Msg::A("Unhandled load size: %d", Size); return 0;
+    }
+  }
+
+  // LDRSB, LDRSH and LDRSW in to a 64bit register
+  static uint32_t LoadSignedOpcode(uint8_t Size) {
+    switch (Size) {
+    case 8: return 0xF9400000;
+    case 4: return 0xB9800000;
+    case 2: return 0x79800000;
+    case 1: return 0x39800000;
+    default: LogMan::Msg::A("Unhandled load size: %d", Size); return 0;
+    }
+  }
+
+  static uint32_t StoreOpcode(uint8_t Size) {
+    switch (Size) {
+    case 8: return 0xF9000000;
+    case 4: return 0xB9000000;
+    case 2: return 0x79000000;
+    case 1: return 0x39000000;
+    default: LogMan::Msg::A("Unhandled store size: %d", Size); return 0;
+    }
+  }
+
+  void EmitLoadStoreImm(uint32_t Opcode, uint8_t Size, Reg Rt, Reg Base, uint32_t Offset) {
+    LogMan::Throw::A(IsLoadStoreImmEncodable(Size, Offset), "Load/store offset out of range");
+    Emit(Opcode | ((Offset / Size) << 10) | (Base << 5) | Rt);
+  }
+
+  void EmitLoadStoreReg(uint32_t Opcode, Reg Rt, Reg Base, Reg Index) {
+    // Switch the unsigned offset form over to the register offset form, option LSL with no shift
+    Emit((Opcode & ~0x01000000U) | 0x00206800 | (Index << 16) | (Base << 5) | Rt);
+  }
+
+  void PatchBranch(size_t Fixup, size_t Target) {
+    int64_t Rel = static_cast<int64_t>(Target) - static_cast<int64_t>(Fixup);
+    uint32_t &Inst = Code[Fixup];
+    if ((Inst & 0xFC000000) == 0x14000000)
+      Inst |= Rel & 0x03FFFFFF; // B imm26
+    else
+      Inst |= (Rel & 0x7FFFF) << 5; // B.cond and CBNZ imm19
+  }
+
+  void EmitBranch(uint32_t Opcode, Label L) {
+    auto &Data = Labels[L];
+    size_t Fixup = Code.size();
+    Emit(Opcode);
+    if (Data.Position != -1)
+      PatchBranch(Fixup, Data.Position);
+    else
+      Data.Fixups.emplace_back(Fixup);
+  }
+};
+
+}
@@ -1,11 +1,23 @@
 #pragma once
+#include "Core/CPU/CPUBackend.h"
 #include "LogManager.h"
 #include <map>
 
 namespace Emu {
+/**
+ * @brief A compiled block and how to run it
+ *
+ * Blocks from the baseline and the hot backend sit in the same cache
+ */
+struct CachedBlock {
+  void *Code;
+  CPUBackend::BlockRunner Runner; ///< nullptr when Code gets called as `void(CPUCore*)`
+  uint32_t Runs; ///< Only counted while the block can still move up to the hot backend
+};
+
 class BlockCache {
 public:
-  using BlockCacheType = std::map<uint64_t, void*>;
+  using BlockCacheType = std::map<uint64_t, CachedBlock>;
   using BlockCacheIter = BlockCacheType::iterator const;
 
   BlockCacheIter FindBlock(uint64_t Address) {
@@ -14,8 +26,8 @@ public:
 
   BlockCacheIter End() { return Blocks.end(); }
 
-  BlockCacheIter AddBlockMapping(uint64_t Address, void *Ptr) {
-    auto ret = Blocks.insert(std::make_pair(Address, Ptr));
+  BlockCacheIter AddBlockMapping(uint64_t Address, void *Ptr, CPUBackend::BlockRunner Runner) {
+    auto ret = Blocks.insert(std::make_pair(Address, CachedBlock{Ptr, Runner, 0}));
     LogMan::Throw::A(ret.second, "Couldn't insert block");
     return ret.first;
   }
@@ -3,10 +3,31 @@
 #include <string>
 
 namespace Emu {
+class CPUCore;
+
 class CPUBackend {
 public:
+  /**
+   * @brief Runs a block handle that CompileCode returned
+   */
+  using BlockRunner = void (*)(CPUCore *CPU, void *Block);
+
   virtual ~CPUBackend() = default;
   virtual std::string GetName() = 0;
   virtual void* CompileCode(Emu::IR::IntrusiveIRList const *ir) = 0;
+
+  /**
+   * @brief How blocks from this backend get run
+   *
+   * nullptr means CompileCode returns host code that is called as `void(CPUCore*)`
+   */
+  virtual BlockRunner GetBlockRunner() { return nullptr; }
+
+  /**
+   * @brief Releases a block once nothing can run it again
+   *
+   * JIT backends hand the space back to their CodeBuffer for later blocks
+   */
+  virtual void FreeCode(void *) {}
 };
 }
@@ -1,12 +1,17 @@
 #include "CPUCore.h"
 #include "ELFLoader.h"
+#include "Flags.h"
 #include "IR.h"
 #include "LogManager.h"
 #include "OpcodeDispatch.h"
+#include "Passes/Passes.h"
 #include "X86Tables.h"
 #include "AArch64Backend/AArch64.h"
 #include "InterpreterBackend/Interpreter.h"
 #include "LLVMBackend/LLVM.h"
+#include "X86_64Backend/X86_64.h"
+#include <csignal>
+#include <cstdlib>
 #include <cstring>
 #include <string>
 #include <sys/stat.h>
@@ -117,26 +122,96 @@ void CPUCore::MapRegionOnAll(uint64_t Offset, uint64_t Size) {
 CPUCore::CPUCore(Memmap *Mapper)
   : MemoryMapper{Mapper}
   , syscallhandler {this} {
-  X86Tables::InitializeInfoTables();
-  IR::InstallOpcodeHandlers();
+  OptimizationPasses.BlockManager.AddPass(IR::CreateValueNumberingPass());
+  OptimizationPasses.BlockManager.AddPass(IR::CreateKnownBitsPass());
+  OptimizationPasses.BlockManager.AddPass(IR::CreateDeadCodeEliminationPass());
 }
 
-void CPUCore::Init(std::string const &File) {
-  // XXX: Allow runtime selection between cores
-#if 1
-  Backend.reset(CreateLLVMBackend(this));
-#elif 0
-  Backend.reset(new AArch64());
+namespace {
+// The native backend runs everything first, LLVM takes the blocks that keep running
+#if defined(__x86_64__) && ENABLE_LLVM
+constexpr char const *DEFAULT_BACKENDS = "x86_64+llvm";
+#elif defined(__x86_64__)
+constexpr char const *DEFAULT_BACKENDS = "x86_64";
+#elif defined(__aarch64__) && ENABLE_LLVM
+constexpr char const *DEFAULT_BACKENDS = "aarch64+llvm";
+#elif defined(__aarch64__)
+constexpr char const *DEFAULT_BACKENDS = "aarch64";
+#elif ENABLE_LLVM
+constexpr char const *DEFAULT_BACKENDS = "llvm";
 #else
-  Backend.reset(new Interpreter());
+constexpr char const *DEFAULT_BACKENDS = "interpreter";
 #endif
-  InitThread(File);
 
+constexpr uint32_t DEFAULT_HOT_THRESHOLD = 1000;
+
+uint32_t GetHotThreshold() {
+  char const *Threshold = getenv("X86EMU_HOT_THRESHOLD");
+  if (!Threshold)
+    return DEFAULT_HOT_THRESHOLD;
+
+  char *End;
+  unsigned long Value = strtoul(Threshold, &End, 10);
+  if (*Threshold == '\0' || *End != '\0' || Value == 0 || Value > UINT32_MAX) {
+    LogMan::Msg::E("Couldn't parse X86EMU_HOT_THRESHOLD: %s", Threshold);
+    return DEFAULT_HOT_THRESHOLD;
+  }
+  return Value;
+}
+
+CPUBackend *CreateBackend(std::string_view Name, CPUCore *CPU, bool Hot, uint32_t HotThreshold) {
+  if (Name == "interpreter")
+    return CreateInterpreterBackend(CPU);
+  // Native backends only emit code for the host they were built for
+#if defined(__x86_64__)
+  if (Name == "x86_64")
+    return CreateX86_64Backend(CPU);
+#elif defined(__aarch64__)
+  if (Name == "aarch64")
+    return CreateAArch64Backend(CPU);
+#endif
+#if ENABLE_LLVM
+  if (Name == "llvm") {
+    // Blocks only reach the hot backend after they've proven themselves, so they skip the fast pipeline
+    LLVMBackendOptions Options;
+    Options.HotThreshold = HotThreshold;
+    if (Hot)
+      Options.Pipeline = LLVMPipeline::Aggressive;
+    return CreateLLVMBackend(CPU, Options);
+  }
+#endif
+  return nullptr;
+}
+}
+
+bool CPUCore::CreateBackends(std::string_view Names) {
+  size_t Split = Names.find('+');
+  HotThreshold = GetHotThreshold();
+  Backend.reset(CreateBackend(Names.substr(0, Split), this, false, HotThreshold));
+  HotBackend.reset();
+  if (Split != std::string_view::npos)
+    HotBackend.reset(CreateBackend(Names.substr(Split + 1), this, true, HotThreshold));
+  return Backend && (Split == std::string_view::npos || HotBackend);
+}
+
+void CPUCore::Init(std::string const &File) {
+  char const *Names = getenv("X86EMU_BACKEND");
+  if (!Names || !CreateBackends(Names)) {
+    if (Names)
+      LogMan::Msg::E("Couldn't create X86EMU_BACKEND: %s, using %s", Names, DEFAULT_BACKENDS);
+    LogMan::Throw::A(CreateBackends(DEFAULT_BACKENDS), "Couldn't create the default backends");
+  }
+  InitThread(File);
 }
 
 void CPUCore::RunLoop() {
   for (auto &Thread : Threads)
     Thread->ExecutionThread.join();
+
+  if (ExitSignal) {
+    signal(ExitSignal, SIG_DFL);
+    raise(ExitSignal);
+  }
 }
 
 thread_local CPUCore::ThreadState* TLSThread;
@@ -144,6 +219,10 @@ CPUCore::ThreadState *CPUCore::GetTLSThread() {
   return TLSThread;
 }
 
+void CPUCore::SetTLSThread(ThreadState *Thread) {
+  TLSThread = Thread;
+}
+
 void CPUCore::InitThread(std::string const &File) {
   ThreadState *threadstate{nullptr};
 
@@ -255,6 +334,8 @@ CPUCore::ThreadState *CPUCore::NewThread(X86State *NewState, uint64_t parent_tid
   // Initialize default CPU state
   // Since we are a new thread copy the data from the parent
   memcpy(&threadstate->CPUState, NewState, sizeof(X86State));
+  // Unicorn only knows about RFLAGS
+  Flags::Materialize(&threadstate->CPUState);
 
   threadstate->threadmanager.parent_tid = parent_tid;
   threadstate->threadmanager.child_tid = child_tid;
@@ -408,15 +489,35 @@ void CPUCore::ExecutionThread(ThreadState *Thread) {
 
     if (it != Thread->blockcache.End()) {
       // Holy crap, the block actually compiled? Run it!
-      using BlockFn = void (*)(CPUCore *cpu);
-      BlockFn Ptr;
-      Ptr = (BlockFn)it->second;
-      Ptr(this);
+      auto &Block = it->second;
+      if (Block.Runner) {
+        Block.Runner(this, Block.Code);
+      }
+      else {
+        using BlockFn = void (*)(CPUCore *cpu);
+        BlockFn Ptr;
+        Ptr = (BlockFn)Block.Code;
+        Ptr(this);
+      }
+
+      if (HotBackend && Block.Runs < HotThreshold && ++Block.Runs == HotThreshold)
+        PromoteBlock(Thread, it);
     }
     else {
  //     printf("%ld fallback to unicorn\n", Thread->threadmanager.GetTID());
       FallbackToUnicorn(Thread);
     }
+    if (Thread->FaultError) {
+      printf("%ld Guest fault at RIP 0x%zx: %s\n", TID, Thread->FaultRIP, uc_strerror(Thread->FaultError));
+      break;
+    }
+    if (Thread->PendingSignal) {
+      // rt_sigaction doesn't hand handlers to the guest, so this is always the default action of ending the process
+      printf("%ld Guest signal %d at RIP 0x%zx\n", TID, Thread->PendingSignal, Thread->CPUState.rip);
+      ExitSignal = Thread->PendingSignal;
+      StopRunning = true;
+      break;
+    }
     if (Thread->CPUState.rip == 0) {
       printf("%ld Hit zero\n", Thread->threadmanager.GetTID());
       if (Thread->threadmanager.GetTID() == 1) {
@@ -457,29 +558,30 @@ std::pair<BlockCache::BlockCacheIter, bool> CPUCore::CompileBlock(ThreadState *T
     Thread->OpDispatcher.BeginBlock();
     while (!Done) {
       bool HadDispatchError = false;
-      auto Info = X86Tables::GetInstInfo(&Code[TotalInstructionsLength]);
-      if (!Info.first) {
+      X86Tables::DecodedInst DecodedInfo;
+      if (!X86Tables::DecodeInstruction(&Code[TotalInstructionsLength], &DecodedInfo)) {
         printf("Unknown instruction encoding! 0x%zx\n", GuestRIP + TotalInstructionsLength);
         StopRunning = true;
         Thread->OpDispatcher.ResetWorkingList();
         return std::make_pair(Thread->blockcache.End(), false);
       }
 
-      LastInstSize = Info.second.Size;
+      auto Info = DecodedInfo.TableInfo;
+      LastInstSize = DecodedInfo.Size;
       Thread->JITRIP = GuestRIP + TotalInstructionsLength;
-      if (Info.second.Flags & X86Tables::DECODE_FLAG_LOCK) {
+      if (DecodedInfo.Flags & X86Tables::DECODE_FLAG_LOCK) {
         HadDispatchError = true;
       }
-      else if (Info.first->OpcodeDispatcher) {
+      else if (Info->OpcodeDispatcher) {
         Thread->OpDispatcher.AddRIPMarker(GuestRIP + TotalInstructionsLength);
-        auto Fn = Info.first->OpcodeDispatcher;
-        std::invoke(Fn, Thread->OpDispatcher, Info, &Code[TotalInstructionsLength]);
+        auto Fn = Info->OpcodeDispatcher;
+        std::invoke(Fn, Thread->OpDispatcher, &DecodedInfo);
         if (Thread->OpDispatcher.HadDecodeFailure()) {
 //          printf("Decode failure at 0x%zx\n", GuestRIP + TotalInstructionsLength);
           HadDispatchError = true;
         }
         else {
-          TotalInstructionsLength += Info.second.Size;
+          TotalInstructionsLength += DecodedInfo.Size;
           TotalInstructions++;
         }
       }
@@ -487,6 +589,19 @@ std::pair<BlockCache::BlockCacheIter, bool> CPUCore::CompileBlock(ThreadState *T
         HadDispatchError = true;
       }
 
+      // A REP string op only runs one iteration per Unicorn step
+      bool Repeats = (Info->Flags & X86Tables::FLAGS_STRING_OP) && (DecodedInfo.Flags & (X86Tables::DECODE_FLAG_REP | X86Tables::DECODE_FLAG_REPNE));
+      if (HadDispatchError && !Repeats && !(Info->Flags & (X86Tables::FLAGS_BLOCK_END | X86Tables::FLAGS_SETS_RIP))) {
+        // Nothing after this instruction depends on how it ran, so let Unicorn step it inside of the block
+        uint64_t InstRIP = GuestRIP + TotalInstructionsLength;
+        if (!Thread->OpDispatcher.HadDecodeFailure())
+          Thread->OpDispatcher.AddRIPMarker(InstRIP);
+        Thread->OpDispatcher.Fallback(InstRIP, DecodedInfo.Size);
+        TotalInstructionsLength += DecodedInfo.Size;
+        TotalInstructions++;
+        HadDispatchError = false;
+      }
+
       if (HadDispatchError) {
         if (TotalInstructions == 0) {
           // Couldn't handle any instruction in op dispatcher
@@ -498,10 +613,11 @@ std::pair<BlockCache::BlockCacheIter, bool> CPUCore::CompileBlock(ThreadState *T
           Done = true;
         }
       }
-      if (Info.first->Flags & X86Tables::FLAGS_BLOCK_END) {
+      if (Info->Flags & X86Tables::FLAGS_BLOCK_END) {
         Done = true;
       }
-      if (!HadDispatchError && (Info.first->Flags & X86Tables::FLAGS_SETS_RIP)) {
+      // Jcc only sets RIP on its taken path, the block carries on after it
+      if (!HadDispatchError && (Info->Flags & X86Tables::FLAGS_BLOCK_END) && (Info->Flags & X86Tables::FLAGS_SETS_RIP)) {
         Done = true;
         HitRIPSetter = true;
       }
@@ -515,16 +631,16 @@ std::pair<BlockCache::BlockCacheIter, bool> CPUCore::CompileBlock(ThreadState *T
 
     auto IR = Thread->irlists.emplace(std::make_pair(GuestRIP, Thread->OpDispatcher.GetWorkingIR()));
     Thread->OpDispatcher.ResetWorkingList();
+    IRList = &IR.first->second;
 
     // XXX: Analysis
-    AnalysisPasses.FunctionManager.Run();
-    AnalysisPasses.BlockManager.Run();
+    AnalysisPasses.FunctionManager.Run(IRList);
+    AnalysisPasses.BlockManager.Run(IRList);
 
-    // XXX: Optimization
-    OptimizationPasses.FunctionManager.Run();
-    OptimizationPasses.BlockManager.Run();
+    // Optimization
+    OptimizationPasses.FunctionManager.Run(IRList);
+    OptimizationPasses.BlockManager.Run(IRList);
     // XXX: Code Emission
-    IRList = &IR.first->second;
   }
   else {
     IRList = &IR->second;
@@ -541,12 +657,40 @@ std::pair<BlockCache::BlockCacheIter, bool> CPUCore::CompileBlock(ThreadState *T
 
   CodePtr = Backend->CompileCode(IRList);
 	if (CodePtr)
-		return std::make_pair(Thread->blockcache.AddBlockMapping(GuestRIP, CodePtr), true);
+		return std::make_pair(Thread->blockcache.AddBlockMapping(GuestRIP, CodePtr, Backend->GetBlockRunner()), true);
 	else
 		return std::make_pair(Thread->blockcache.End(), false);
 }
 
-void CPUCore::FallbackToUnicorn(ThreadState *Thread) {
+void CPUCore::PromoteBlock(ThreadState *Thread, BlockCache::BlockCacheIter Block) {
+  // The IR is still around from the first compile
+  void *Code = HotBackend->CompileCode(GetIRList(Thread, Block->first));
+  if (!Code)
+    return;
+
+  Backend->FreeCode(Block->second.Code);
+  Block->second.Code = Code;
+  Block->second.Runner = HotBackend->GetBlockRunner();
+}
+
+uint64_t CPUCore::FallbackInstruction(X86State *State, uint64_t RIP) {
+  ThreadState *Thread = GetTLSThread();
+  LogMan::Throw::A(State == &Thread->CPUState, "Fallback can only step the current thread's state");
+
+  uint64_t BlockRIP = State->rip;
+  State->rip = RIP;
+  uint64_t StoppedRIP = FallbackToUnicorn(Thread) ? State->rip : RIP;
+  State->rip = BlockRIP;
+  return StoppedRIP;
+}
+
+void CPUCore::RaiseSignal(X86State *State, int Signal) {
+  ThreadState *Thread = GetTLSThread();
+  LogMan::Throw::A(State == &Thread->CPUState, "Signals can only be raised on the current thread");
+  Thread->PendingSignal = Signal;
+}
+
+bool CPUCore::FallbackToUnicorn(ThreadState *Thread) {
   std::array<int, 34> GPRs = {
     UC_X86_REG_RIP,
     UC_X86_REG_RAX,
@@ -645,14 +789,19 @@ void CPUCore::FallbackToUnicorn(ThreadState *Thread) {
     }
   };
 
+  // Unicorn needs the real RFLAGS and will hand back real RFLAGS
+  Flags::Materialize(&Thread->CPUState);
   SetUnicornRegisters();
   uc_err err = uc_emu_start(Thread->uc, Thread->CPUState.rip, 0, 0, 1);
   if (err) {
     printf("Failed on uc_emu_start() with error returned %u: %s\n", err,
            uc_strerror(err));
+    Thread->FaultError = err;
+    Thread->FaultRIP = Thread->CPUState.rip;
     StopRunning = true;
   }
 
   LoadUnicornRegisters();
+  return !err;
 }
 }
@@ -9,6 +9,7 @@
 #include <atomic>
 #include <memory>
 #include <mutex>
+#include <string_view>
 #include <thread>
 #include <unicorn/unicorn.h>
 
@@ -34,6 +35,11 @@ friend SyscallHandler;
     std::mutex StartRunningMutex;
     std::atomic<bool> ShouldStart;
     std::atomic<bool> StopRunning;
+    // The last instruction Unicorn failed to step, nothing can hand the exception to the guest yet so the thread stops on it
+    uc_err FaultError{UC_ERR_OK};
+    uint64_t FaultRIP{0};
+    // Signal a block raised with RIP left on the faulting instruction, guest handlers can't be installed yet so the thread stops on it
+    int PendingSignal{0};
   };
 
   std::atomic<bool> PauseThreads{false};
@@ -47,6 +53,13 @@ friend SyscallHandler;
 
   static ThreadState *GetTLSThread();
 
+  /**
+   * @brief Makes Thread the guest thread of the calling host thread
+   *
+   * ExecutionThread does this itself, tools that compile and run blocks on their own thread need it first
+   */
+  static void SetTLSThread(ThreadState *Thread);
+
   Emu::IR::IntrusiveIRList const* GetIRList(ThreadState *Thread, uint64_t Address) {
     return &Thread->irlists.at(Address);
   }
@@ -55,7 +68,24 @@ friend SyscallHandler;
   void *MapRegion(ThreadState *Thread, uint64_t Offset, uint64_t Size);
   void MapRegionOnAll(uint64_t Offset, uint64_t Size);
 
-  void FallbackToUnicorn(ThreadState *Thread);
+  // Single steps the thread through Unicorn, false if Unicorn failed to run the instruction
+  bool FallbackToUnicorn(ThreadState *Thread);
+
+  /**
+   * @brief Single steps the instruction at RIP through Unicorn from inside of a block
+   *
+   * Leaves the state's RIP at the start of the block like every other op in it
+   *
+   * @return The RIP Unicorn stopped at, RIP itself if Unicorn failed
+   */
+  uint64_t FallbackInstruction(X86State *State, uint64_t RIP);
+
+  /**
+   * @brief Leaves Signal pending on the current guest thread from inside of a block
+   *
+   * The block leaves straight after, so the thread sees it before running anything else
+   */
+  void RaiseSignal(X86State *State, int Signal);
 
   ThreadState *NewThread(X86State *NewState, uint64_t parent_tid, uint64_t child_tid);
 
@@ -67,8 +97,22 @@ private:
   void SetGS(ThreadState *Thread);
   void SetFS(ThreadState *Thread);
 
+  /**
+   * @brief Creates the backends X86EMU_BACKEND names as "<backend>[+<hot backend>]"
+   *
+   * The hot backend recompiles blocks once they have run X86EMU_HOT_THRESHOLD times
+   *
+   * @return false if a backend doesn't exist or can't run on this host
+   */
+  bool CreateBackends(std::string_view Names);
+
   std::pair<BlockCache::BlockCacheIter, bool> CompileBlock(ThreadState *Thread);
+
+  // Replaces a hot block with the hot backend's code for it, it stays as it was if that backend can't compile it
+  void PromoteBlock(ThreadState *Thread, BlockCache::BlockCacheIter Block);
   std::atomic<bool> StopRunning {false};
+  // Signal that took the guest down, RunLoop raises it again so the process ends the way it would have natively
+  std::atomic<int> ExitSignal {0};
   uint32_t MaxBlockInstructions = 1;
 
   struct PassManagers {
@@ -78,5 +122,7 @@ private:
   PassManagers AnalysisPasses;
   PassManagers OptimizationPasses;
   std::unique_ptr<CPUBackend> Backend;
+  std::unique_ptr<CPUBackend> HotBackend;
+  uint32_t HotThreshold;
 };
 }
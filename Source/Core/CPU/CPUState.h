@@ -27,5 +27,13 @@ struct X86State {
   uint64_t gs;
   uint64_t fs;
   uint64_t rflags;
+
+  // Deferred flag state, see Flags.h
+  // The arithmetic flags in rflags are only valid while flags_op is DEFERRED_NONE
+  uint64_t flags_op;
+  uint64_t flags_size;
+  uint64_t flags_src1;
+  uint64_t flags_src2;
+  uint64_t flags_res;
 };
 }
@@ -0,0 +1,144 @@
+#include "Core/CPU/CodeBuffer.h"
+#include "LogManager.h"
+#include <cstring>
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Emu {
+constexpr size_t HUGE_PAGE_SIZE = 2 * 1024 * 1024;
+
+static size_t AlignUp(size_t Value, size_t Alignment) {
+  return (Value + Alignment - 1) & ~(Alignment - 1);
+}
+
+CodeBuffer::CodeBuffer(size_t Size, bool HugePages)
+  : BufferSize {AlignUp(Size, HUGE_PAGE_SIZE)} {
+  auto MapViews = [this]() {
+    WritableBase = reinterpret_cast<uint8_t*>(mmap(nullptr, BufferSize, PROT_READ | PROT_WRITE, MAP_SHARED, FD, 0));
+    ExecutableBase = reinterpret_cast<uint8_t*>(mmap(nullptr, BufferSize, PROT_READ | PROT_EXEC, MAP_SHARED, FD, 0));
+    if (WritableBase != MAP_FAILED && ExecutableBase != MAP_FAILED)
+      return true;
+
+    if (WritableBase != MAP_FAILED)
+      munmap(WritableBase, BufferSize);
+    if (ExecutableBase != MAP_FAILED)
+      munmap(ExecutableBase, BufferSize);
+    close(FD);
+    FD = -1;
+    return false;
+  };
+
+  // hugetlbfs only works if the admin reserved pages for it, fall back to asking for transparent huge pages
+  bool Mapped = false;
+  if (HugePages) {
+    FD = memfd_create("X86Emu-Code", MFD_CLOEXEC | MFD_HUGETLB);
+    Mapped = FD != -1 && ftruncate(FD, BufferSize) == 0 && MapViews();
+  }
+
+  if (!Mapped) {
+    FD = memfd_create("X86Emu-Code", MFD_CLOEXEC);
+    LogMan::Throw::A(FD != -1, "Couldn't create code buffer memfd");
+    LogMan::Throw::A(ftruncate(FD, BufferSize) == 0, "Couldn't size code buffer");
+    LogMan::Throw::A(MapViews(), "Couldn't map code buffer");
+
+    if (HugePages) {
+      madvise(WritableBase, BufferSize, MADV_HUGEPAGE);
+      madvise(ExecutableBase, BufferSize, MADV_HUGEPAGE);
+    }
+  }
+}
+
+CodeBuffer::~CodeBuffer() {
+  munmap(WritableBase, BufferSize);
+  munmap(ExecutableBase, BufferSize);
+  close(FD);
+}
+
+void *CodeBuffer::AllocateLocked(size_t Size, size_t Alignment) {
+  // First fit out of the freed code before growing in to untouched pages
+  for (auto it = FreeRanges.begin(); it != FreeRanges.end(); ++it) {
+    size_t RangeStart = it->first;
+    size_t RangeEnd = it->first + it->second;
+    size_t Offset = AlignUp(RangeStart, Alignment);
+    if (Offset + Size > RangeEnd)
+      continue;
+
+    // Leading alignment padding stays a hole so it can merge back when its neighbours get freed
+    FreeRanges.erase(it);
+    if (Offset != RangeStart)
+      FreeRanges[RangeStart] = Offset - RangeStart;
+    if (Offset + Size != RangeEnd)
+      FreeRanges[Offset + Size] = RangeEnd - (Offset + Size);
+
+    Allocations[Offset] = Size;
+    return &ExecutableBase[Offset];
+  }
+
+  size_t Offset = AlignUp(CurrentOffset, Alignment);
+  if (Offset + Size > BufferSize) {
+    LogMan::Msg::E("Out of code buffer space");
+    return nullptr;
+  }
+
+  // The padding becomes a hole, so freeing this block can still move the bump pointer back past it
+  if (Offset != CurrentOffset)
+    FreeRanges[CurrentOffset] = Offset - CurrentOffset;
+  CurrentOffset = Offset + Size;
+  Allocations[Offset] = Size;
+  return &ExecutableBase[Offset];
+}
+
+void *CodeBuffer::Allocate(size_t Size, size_t Alignment) {
+  std::lock_guard<std::mutex> lk(BufferLock);
+  return AllocateLocked(Size, Alignment);
+}
+
+void *CodeBuffer::Copy(void const *Code, size_t Size) {
+  std::lock_guard<std::mutex> lk(BufferLock);
+  // Keep blocks 16 byte aligned
+  void *Ptr = AllocateLocked(Size, 16);
+  if (!Ptr)
+    return nullptr;
+
+  memcpy(GetWritable(Ptr), Code, Size);
+  FlushCache(Ptr, Size);
+  return Ptr;
+}
+
+void CodeBuffer::Free(void *Code) {
+  std::lock_guard<std::mutex> lk(BufferLock);
+  size_t Offset = reinterpret_cast<uint8_t*>(Code) - ExecutableBase;
+  auto Allocation = Allocations.find(Offset);
+  LogMan::Throw::A(Allocation != Allocations.end(), "Freeing code the buffer didn't hand out");
+
+  size_t Start = Offset;
+  size_t End = Offset + Allocation->second;
+  Allocations.erase(Allocation);
+
+  // Merge with the holes on either side
+  auto Next = FreeRanges.lower_bound(Start);
+  if (Next != FreeRanges.end() && Next->first == End) {
+    End += Next->second;
+    Next = FreeRanges.erase(Next);
+  }
+  if (Next != FreeRanges.begin()) {
+    auto Prev = std::prev(Next);
+    if (Prev->first + Prev->second == Start) {
+      Start = Prev->first;
+      FreeRanges.erase(Prev);
+    }
+  }
+
+  // A hole at the end just moves the bump pointer back
+  if (End == CurrentOffset)
+    CurrentOffset = Start;
+  else
+    FreeRanges[Start] = End - Start;
+}
+
+void CodeBuffer::FlushCache(void *Code, size_t Size) {
+  // No-op on x86, AArch64 needs the instruction cache to see the new code
+  char *Begin = reinterpret_cast<char*>(Code);
+  __builtin___clear_cache(Begin, Begin + Size);
+}
+}
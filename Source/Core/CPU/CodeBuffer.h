@@ -0,0 +1,75 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+
+namespace Emu {
+/**
+ * @brief Executable memory that every JIT backend puts its blocks in
+ *
+ * One memfd mapped twice: code is written through a read/write view and run from a read/exec view,
+ * no address is ever writable and executable at the same time.
+ * Shared between threads, freed code goes on a free list for the next block
+ */
+class CodeBuffer final {
+public:
+  /**
+   * @param Size Bytes reserved up front, pages only get backed once code is written to them
+   * @param HugePages Back the buffer with 2MB pages to take pressure off of the iTLB
+   */
+  explicit CodeBuffer(size_t Size, bool HugePages = true);
+  ~CodeBuffer();
+
+  /**
+   * @brief Copies position independent code in to the buffer
+   *
+   * @return Pointer to the executable copy or nullptr if the buffer is full
+   */
+  void *Copy(void const *Code, size_t Size);
+
+  /**
+   * @brief Reserves space for code that gets written in place with GetWritable
+   *
+   * @return Executable address of the space or nullptr if the buffer is full
+   */
+  void *Allocate(size_t Size, size_t Alignment = 16);
+
+  /**
+   * @brief Gives code from Copy or Allocate back to the buffer
+   *
+   * Nothing can be running the code any more
+   */
+  void Free(void *Code);
+
+  /**
+   * @brief The read/write view of an executable address in the buffer
+   */
+  uint8_t *GetWritable(void const *Code) const {
+    return WritableBase + (reinterpret_cast<uint8_t const*>(Code) - ExecutableBase);
+  }
+
+  bool Contains(void const *Code) const {
+    return Code >= ExecutableBase && Code < ExecutableBase + BufferSize;
+  }
+
+  /**
+   * @brief Makes code written through the read/write view visible to instruction fetch
+   */
+  void FlushCache(void *Code, size_t Size);
+
+private:
+  void *AllocateLocked(size_t Size, size_t Alignment);
+
+  std::mutex BufferLock;
+  int FD{-1};
+  uint8_t *WritableBase;
+  uint8_t *ExecutableBase;
+  size_t BufferSize;
+  size_t CurrentOffset{};
+
+  // Offset -> Size, live allocations and the holes left behind by freed ones
+  std::map<size_t, size_t> Allocations;
+  std::map<size_t, size_t> FreeRanges;
+};
+}
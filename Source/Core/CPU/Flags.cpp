@@ -0,0 +1,145 @@
+#include "Core/CPU/Flags.h"
+#include "LogManager.h"
+
+namespace Emu::Flags {
+
+static uint64_t GetSizeMask(uint64_t Size) {
+  return Size == 8 ? ~0ULL : ((1ULL << (Size * 8)) - 1);
+}
+
+uint64_t GetFlag(X86State const *State, uint32_t Bit) {
+  if (State->flags_op == DEFERRED_NONE) {
+    return (State->rflags >> Bit) & 1;
+  }
+
+  uint64_t Mask = GetSizeMask(State->flags_size);
+  uint32_t MSB = State->flags_size * 8 - 1;
+  uint64_t Src1 = State->flags_src1 & Mask;
+  uint64_t Src2 = State->flags_src2 & Mask;
+  uint64_t Res = State->flags_res & Mask;
+
+  switch (Bit) {
+  case FLAG_ZF_LOC:
+    return Res == 0;
+  case FLAG_SF_LOC:
+    return (Res >> MSB) & 1;
+  case FLAG_PF_LOC:
+    return !(__builtin_popcountll(Res & 0xFF) & 1);
+  default:
+  break;
+  }
+
+  switch (State->flags_op) {
+  case DEFERRED_ADD:
+    switch (Bit) {
+    case FLAG_CF_LOC: return Res < Src1;
+    case FLAG_AF_LOC: return ((Src1 ^ Src2 ^ Res) >> 4) & 1;
+    case FLAG_OF_LOC: return (((Src1 ^ Res) & (Src2 ^ Res)) >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_SUB:
+    switch (Bit) {
+    case FLAG_CF_LOC: return Src1 < Src2;
+    case FLAG_AF_LOC: return ((Src1 ^ Src2 ^ Res) >> 4) & 1;
+    case FLAG_OF_LOC: return (((Src1 ^ Src2) & (Src1 ^ Res)) >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_LOGIC:
+    // CF and OF are cleared, AF is undefined
+    return 0;
+  case DEFERRED_ADC:
+    // The carry in doesn't change how the top bit carries out
+    switch (Bit) {
+    case FLAG_CF_LOC: return (((Src1 & Src2) | ((Src1 | Src2) & ~Res)) >> MSB) & 1;
+    case FLAG_AF_LOC: return ((Src1 ^ Src2 ^ Res) >> 4) & 1;
+    case FLAG_OF_LOC: return (((Src1 ^ Res) & (Src2 ^ Res)) >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_SBB:
+    switch (Bit) {
+    case FLAG_CF_LOC: return (((~Src1 & Src2) | (~(Src1 ^ Src2) & Res)) >> MSB) & 1;
+    case FLAG_AF_LOC: return ((Src1 ^ Src2 ^ Res) >> 4) & 1;
+    case FLAG_OF_LOC: return (((Src1 ^ Src2) & (Src1 ^ Res)) >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_INC:
+  case DEFERRED_DEC:
+    switch (Bit) {
+    case FLAG_CF_LOC: return Src2 & 1;
+    case FLAG_AF_LOC: return ((Src1 ^ Res) >> 4) & 1;
+    case FLAG_OF_LOC:
+      // Positive to negative for INC, negative to positive for DEC
+      if (State->flags_op == DEFERRED_INC)
+        return ((~Src1 & Res) >> MSB) & 1;
+      return ((Src1 & ~Res) >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_SHL:
+    // CF is the last bit shifted out, AF is undefined
+    switch (Bit) {
+    case FLAG_CF_LOC: return ((Src1 << (Src2 - 1)) >> MSB) & 1;
+    case FLAG_AF_LOC: return 0;
+    case FLAG_OF_LOC: return ((Res >> MSB) ^ ((Src1 << (Src2 - 1)) >> MSB)) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_SHR:
+    switch (Bit) {
+    case FLAG_CF_LOC: return (Src1 >> (Src2 - 1)) & 1;
+    case FLAG_AF_LOC: return 0;
+    case FLAG_OF_LOC: return (Src1 >> MSB) & 1;
+    default: break;
+    }
+  break;
+  case DEFERRED_SAR: {
+    // Shifting the sign extended source covers counts past the operand size
+    int64_t Signed = static_cast<int64_t>(Src1 << (63 - MSB)) >> (63 - MSB);
+    switch (Bit) {
+    case FLAG_CF_LOC: return (Signed >> (Src2 - 1)) & 1;
+    case FLAG_AF_LOC:
+    case FLAG_OF_LOC: return 0;
+    default: break;
+    }
+  break;
+  }
+  case DEFERRED_MUL:
+    // SF, ZF, AF and PF are undefined, they come from the low half like everything else
+    switch (Bit) {
+    case FLAG_CF_LOC:
+    case FLAG_OF_LOC: return Src1 & 1;
+    case FLAG_AF_LOC: return 0;
+    default: break;
+    }
+  break;
+  default:
+    LogMan::Msg::A("Unknown deferred flags op");
+  break;
+  }
+
+  // Not an arithmetic flag, RFLAGS still holds it
+  return (State->rflags >> Bit) & 1;
+}
+
+uint64_t CalculateRFLAGS(X86State const *State) {
+  if (State->flags_op == DEFERRED_NONE) {
+    return State->rflags;
+  }
+
+  uint64_t RFLAGS = State->rflags & ~ARITH_FLAGS_MASK;
+  for (uint32_t Bit : {FLAG_CF_LOC, FLAG_PF_LOC, FLAG_AF_LOC, FLAG_ZF_LOC, FLAG_SF_LOC, FLAG_OF_LOC}) {
+    RFLAGS |= GetFlag(State, Bit) << Bit;
+  }
+  return RFLAGS;
+}
+
+void Materialize(X86State *State) {
+  State->rflags = CalculateRFLAGS(State);
+  State->flags_op = DEFERRED_NONE;
+}
+
+}
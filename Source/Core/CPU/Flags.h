@@ -0,0 +1,59 @@
+#pragma once
+#include "Core/CPU/CPUState.h"
+#include <cstdint>
+
+namespace Emu::Flags {
+
+// Bit locations inside of RFLAGS
+constexpr uint32_t FLAG_CF_LOC = 0;
+constexpr uint32_t FLAG_PF_LOC = 2;
+constexpr uint32_t FLAG_AF_LOC = 4;
+constexpr uint32_t FLAG_ZF_LOC = 6;
+constexpr uint32_t FLAG_SF_LOC = 7;
+constexpr uint32_t FLAG_OF_LOC = 11;
+
+// The arithmetic flags that get calculated from the deferred state
+constexpr uint64_t ARITH_FLAGS_MASK =
+  (1ULL << FLAG_CF_LOC) |
+  (1ULL << FLAG_PF_LOC) |
+  (1ULL << FLAG_AF_LOC) |
+  (1ULL << FLAG_ZF_LOC) |
+  (1ULL << FLAG_SF_LOC) |
+  (1ULL << FLAG_OF_LOC);
+
+// The last flag producing operation stored in X86State::flags_op
+// Flags are only calculated from these once something needs to read them
+enum DeferredOp : uint64_t {
+  DEFERRED_NONE = 0, ///< RFLAGS holds the real flags
+  DEFERRED_ADD,      ///< res = src1 + src2
+  DEFERRED_SUB,      ///< res = src1 - src2
+  DEFERRED_LOGIC,    ///< res = src1 op src2, CF and OF cleared
+  DEFERRED_ADC,      ///< res = src1 + src2 + CF
+  DEFERRED_SBB,      ///< res = src1 - src2 - CF
+  DEFERRED_INC,      ///< res = src1 + 1, src2 is the CF that INC leaves alone
+  DEFERRED_DEC,      ///< res = src1 - 1, src2 is the CF that DEC leaves alone
+  DEFERRED_SHL,      ///< res = src1 << src2, src2 is the masked count and never 0
+  DEFERRED_SHR,      ///< res = src1 >> src2, src2 is the masked count and never 0
+  DEFERRED_SAR,      ///< res = src1 >> src2 arithmetic, src2 is the masked count and never 0
+  DEFERRED_MUL,      ///< res = low half of the product, src1 is the CF and OF that say the high half is needed
+};
+
+/**
+ * @brief Calculates a single flag bit, deferred or not
+ *
+ * @return 0 or 1
+ */
+uint64_t GetFlag(X86State const *State, uint32_t Bit);
+
+/**
+ * @brief Returns the full RFLAGS value with the deferred flags merged in
+ */
+uint64_t CalculateRFLAGS(X86State const *State);
+
+/**
+ * @brief Writes the deferred flags back in to RFLAGS
+ *
+ * Afterwards RFLAGS is the only source of truth
+ */
+void Materialize(X86State *State);
+}
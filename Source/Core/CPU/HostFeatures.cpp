@@ -0,0 +1,98 @@
+#include "Core/CPU/HostFeatures.h"
+#include "LogManager.h"
+#include <cstdlib>
+#include <mutex>
+
+#if defined(__x86_64__)
+#include <cpuid.h>
+#endif
+
+namespace Emu {
+namespace {
+std::once_flag DetectOnce;
+HostFeatures Features;
+
+struct FeatureName {
+  std::string_view Name;
+  bool HostFeatures::*Supported;
+};
+
+constexpr FeatureName FeatureNames[] = {
+  {"popcnt", &HostFeatures::SupportsPOPCNT},
+  {"lzcnt",  &HostFeatures::SupportsLZCNT},
+  {"bmi",    &HostFeatures::SupportsBMI1},
+  {"bmi2",   &HostFeatures::SupportsBMI2},
+  {"avx2",   &HostFeatures::SupportsAVX2},
+};
+
+void DetectOnceAndApplyEnvironment() {
+  std::call_once(DetectOnce, [] {
+    Features = DetectHostFeatures();
+    char const *List = getenv("X86EMU_HOST_FEATURES");
+    if (List && !ParseHostFeatures(List, &Features))
+      LogMan::Msg::E("Couldn't parse X86EMU_HOST_FEATURES: %s", List);
+  });
+}
+}
+
+HostFeatures DetectHostFeatures() {
+  HostFeatures Detected;
+#if defined(__x86_64__)
+  uint32_t EAX, EBX, ECX, EDX;
+  bool OSSavesYMM = false;
+  if (__get_cpuid(1, &EAX, &EBX, &ECX, &EDX)) {
+    Detected.SupportsPOPCNT = ECX & bit_POPCNT;
+    // AVX state has to be enabled by the OS before any AVX instruction can run
+    if (ECX & bit_OSXSAVE) {
+      uint32_t XCR0Lo, XCR0Hi;
+      __asm__ ("xgetbv" : "=a"(XCR0Lo), "=d"(XCR0Hi) : "c"(0));
+      OSSavesYMM = (XCR0Lo & 0b110) == 0b110;
+    }
+  }
+  if (__get_cpuid_count(7, 0, &EAX, &EBX, &ECX, &EDX)) {
+    Detected.SupportsBMI1 = EBX & bit_BMI;
+    Detected.SupportsBMI2 = EBX & bit_BMI2;
+    Detected.SupportsAVX2 = (EBX & bit_AVX2) && OSSavesYMM;
+  }
+  if (__get_cpuid(0x8000'0001, &EAX, &EBX, &ECX, &EDX)) {
+    Detected.SupportsLZCNT = ECX & bit_ABM;
+  }
+#endif
+  return Detected;
+}
+
+HostFeatures const &GetHostFeatures() {
+  DetectOnceAndApplyEnvironment();
+  return Features;
+}
+
+void SetHostFeatures(HostFeatures const &NewFeatures) {
+  DetectOnceAndApplyEnvironment();
+  Features = NewFeatures;
+}
+
+bool ParseHostFeatures(std::string_view List, HostFeatures *Features) {
+  while (!List.empty()) {
+    size_t End = List.find(',');
+    std::string_view Feature = List.substr(0, End);
+    List = End == std::string_view::npos ? std::string_view{} : List.substr(End + 1);
+
+    bool Enable = true;
+    if (!Feature.empty() && (Feature[0] == '+' || Feature[0] == '-')) {
+      Enable = Feature[0] == '+';
+      Feature.remove_prefix(1);
+    }
+
+    bool Found = false;
+    for (auto &Name : FeatureNames) {
+      if (Name.Name == Feature) {
+        Features->*Name.Supported = Enable;
+        Found = true;
+      }
+    }
+    if (!Found)
+      return false;
+  }
+  return true;
+}
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <string_view>
+
+namespace Emu {
+/**
+ * @brief Optional host instructions the JIT backends can generate code for
+ *
+ * Everything is false on hosts that aren't x86-64
+ */
+struct HostFeatures {
+  bool SupportsPOPCNT{};
+  bool SupportsLZCNT{};
+  bool SupportsBMI1{};
+  bool SupportsBMI2{};
+  bool SupportsAVX2{};
+};
+
+/**
+ * @brief Reads the features straight from CPUID
+ */
+HostFeatures DetectHostFeatures();
+
+/**
+ * @brief The features backends generate code for
+ *
+ * Detected on first use, then X86EMU_HOST_FEATURES (eg "-bmi2,-popcnt") is applied on top
+ */
+HostFeatures const &GetHostFeatures();
+
+/**
+ * @brief Overrides what backends created afterwards think the host supports
+ *
+ * Lets benchmarks pin generated code to one feature set
+ */
+void SetHostFeatures(HostFeatures const &Features);
+
+/**
+ * @brief Applies a comma separated list of +feature/-feature on top of Features
+ *
+ * Names match LLVM's: popcnt, lzcnt, bmi, bmi2 and avx2. A name without a sign enables it
+ *
+ * @return false if the list names a feature that doesn't exist
+ */
+bool ParseHostFeatures(std::string_view List, HostFeatures *Features);
+}
@@ -1,5 +1,6 @@
 #include "Core/CPU/IR.h"
 #include "Core/CPU/IntrusiveIRList.h"
+#include "LogManager.h"
 
 namespace Emu::IR {
 
@@ -24,6 +25,8 @@ constexpr std::array<std::string_view const, OP_LASTOP + 1> IRNames = {
   "Call", // sizeof(IROp_Call),
   "ExternCall", // sizeof(IROp_ExternCall),
 	"Syscall", // sizeof(IROp_Syscall),
+	"Fallback", // sizeof(IROp_Fallback),
+	"RaiseSignal", // sizeof(IROp_RaiseSignal),
   "Return", // sizeof(IROp_Return),
 
   // Instructions
@@ -33,15 +36,30 @@ constexpr std::array<std::string_view const, OP_LASTOP + 1> IRNames = {
   "Xor", // sizeof(IROp_Xor),
   "Shl", // sizeof(IROp_Shl),
   "Shr", // sizeof(IROp_Shr),
+  "Ashr", // sizeof(IROp_Ashr),
   "And", // sizeof(IROp_And),
   "Nand", // sizeof(IROp_Nand),
   "BitExtract", // sizeof(IROp_BitExtract),
+  "Mul", // sizeof(IROp_Mul),
+  "UMulH", // sizeof(IROp_UMulH),
+  "SMulH", // sizeof(IROp_SMulH),
+  "UDiv", // sizeof(IROp_UDiv),
+  "SDiv", // sizeof(IROp_SDiv),
+  "URem", // sizeof(IROp_URem),
+  "SRem", // sizeof(IROp_SRem),
+  "LUDiv", // sizeof(IROp_LUDiv),
+  "LURem", // sizeof(IROp_LURem),
   "Select", // sizeof(IROp_Select),
   "Trunc_32", // sizeof(IROp_Trunc_32),
   "Trunc_16", // sizeof(IROp_Trunc_16),
 
   // Memory
   "LoadMem", // sizeof(IROp_LoadMem),
+  "StoreMem", // sizeof(IROp_StoreMem),
+
+  // Flags
+  "GetFlag", // sizeof(IROp_GetFlag),
+  "MaterializeFlags", // sizeof(IROp_MaterializeFlags),
 
   // Misc
   "JmpTarget", // sizeof(IROp_JmpTarget),
@@ -55,6 +73,69 @@ std::string_view const& GetName(IROps Op) {
   return IRNames[Op];
 }
 
+std::pair<AlignmentType*, size_t> GetArgs(IROp_Header *Op) {
+  switch (Op->Op) {
+  case OP_STORECONTEXT: {
+    auto StoreOp = Op->CW<IROp_StoreContext>();
+    return {&StoreOp->Arg, 1};
+  }
+  case OP_COND_JUMP: {
+    auto CondJumpOp = Op->CW<IROp_CondJump>();
+    return {CondJumpOp->Args, 2};
+  }
+  case OP_SYSCALL: {
+    auto SyscallOp = Op->CW<IROp_Syscall>();
+    return {SyscallOp->Arguments, IROp_Syscall::MAX_ARGS};
+  }
+  case OP_RETURN:
+  case OP_TRUNC_32:
+  case OP_TRUNC_16: {
+    auto MonoOp = Op->CW<IROp_MonoOp>();
+    return {&MonoOp->Arg, 1};
+  }
+  case OP_ADD:
+  case OP_SUB:
+  case OP_OR:
+  case OP_XOR:
+  case OP_SHL:
+  case OP_SHR:
+  case OP_ASHR:
+  case OP_AND:
+  case OP_NAND:
+  case OP_BITEXTRACT:
+  case OP_MUL:
+  case OP_UMULH:
+  case OP_SMULH:
+  case OP_UDIV:
+  case OP_SDIV:
+  case OP_UREM:
+  case OP_SREM: {
+    auto BiOp = Op->CW<IROp_BiOp>();
+    return {BiOp->Args, 2};
+  }
+  case OP_LUDIV:
+  case OP_LUREM: {
+    auto TriOp = Op->CW<IROp_TriOp>();
+    return {TriOp->Args, 3};
+  }
+  case OP_SELECT: {
+    auto SelectOp = Op->CW<IROp_Select>();
+    return {SelectOp->Args, 4};
+  }
+  case OP_LOAD_MEM: {
+    auto LoadMemOp = Op->CW<IROp_LoadMem>();
+    return {LoadMemOp->Arg, LoadMemOp->Arg[1] != ~0U ? 2U : 1U};
+  }
+  case OP_STORE_MEM: {
+    auto StoreMemOp = Op->CW<IROp_StoreMem>();
+    return {StoreMemOp->Arg, StoreMemOp->Arg[2] != ~0U ? 3U : 2U};
+  }
+  default:
+    LogMan::Throw::A(GetSize(Op->Op) != -1ULL, "Unknown IR op");
+    return {nullptr, 0};
+  }
+}
+
 void DumpConstantOp(size_t Offset, IROp_Header const *op) {
   auto ConstantOp = op->C<IROp_Constant>();
   printf("%%%zd = %s 0x%zx\n", Offset, GetName(op->Op).data(), ConstantOp->Constant);
@@ -85,9 +166,24 @@ void DumpBinOp(size_t Offset, IROp_Header const *op) {
   printf("%%%zd = %s %%%d %%%d\n", Offset, GetName(op->Op).data(), BinOp->Args[0], BinOp->Args[1]);
 }
 
+void DumpTriOp(size_t Offset, IROp_Header const *op) {
+  auto TriOp = op->C<IROp_TriOp>();
+  printf("%%%zd = %s %%%d %%%d %%%d\n", Offset, GetName(op->Op).data(), TriOp->Args[0], TriOp->Args[1], TriOp->Args[2]);
+}
+
+constexpr std::array<char const*, 10> ComparisonNames = {
+  "EQ", "NEQ", "SLT", "SLE", "SGT", "SGE", "ULT", "ULE", "UGT", "UGE",
+};
+
+void DumpSelectOp(size_t Offset, IROp_Header const *op) {
+  auto SelectOp = op->C<IROp_Select>();
+  printf("%%%zd = %s %s %%%d %%%d ? %%%d : %%%d\n", Offset, GetName(op->Op).data(), ComparisonNames[SelectOp->Op],
+    SelectOp->Args[0], SelectOp->Args[1], SelectOp->Args[2], SelectOp->Args[3]);
+}
+
 void DumpLoadMemOp(size_t Offset, IROp_Header const *op) {
   auto LoadMemOp = op->C<IROp_LoadMem>();
-  printf("%%%zd = %s [%%%d", Offset, GetName(op->Op).data(), LoadMemOp->Arg[0]);
+  printf("%%%zd = %s%s %d [%%%d", Offset, GetName(op->Op).data(), LoadMemOp->SignExtend ? " SX" : "", LoadMemOp->Size, LoadMemOp->Arg[0]);
   if (LoadMemOp->Arg[1] != ~0) {
     printf(" + %%%d]\n", LoadMemOp->Arg[1]);
   }
@@ -96,9 +192,26 @@ void DumpLoadMemOp(size_t Offset, IROp_Header const *op) {
   }
 }
 
+void DumpStoreMemOp(size_t Offset, IROp_Header const *op) {
+  auto StoreMemOp = op->C<IROp_StoreMem>();
+  printf("%s %d [%%%d", GetName(op->Op).data(), StoreMemOp->Size, StoreMemOp->Arg[1]);
+  if (StoreMemOp->Arg[2] != ~0) {
+    printf(" + %%%d]", StoreMemOp->Arg[2]);
+  }
+  else {
+    printf("]");
+  }
+  printf(" %%%d\n", StoreMemOp->Arg[0]);
+}
+
+void DumpGetFlag(size_t Offset, IROp_Header const *op) {
+  auto GetFlag = op->C<IROp_GetFlag>();
+  printf("%%%zd = %s %d\n", Offset, GetName(op->Op).data(), GetFlag->Bit);
+}
+
 void DumpCondJump(size_t Offset, IROp_Header const *op) {
   auto CondJump = op->C<IROp_CondJump>();
-  printf("%s %%%d %%%d\n", GetName(op->Op).data(), CondJump->Cond, CondJump->Target);
+  printf("%s %s %%%d %%%d %%%d\n", GetName(op->Op).data(), ComparisonNames[CondJump->Cond], CondJump->Args[0], CondJump->Args[1], CondJump->Target);
 }
 
 void DumpJmpTarget(size_t Offset, IROp_Header const *op) {
@@ -114,6 +227,16 @@ void DumpSyscall(size_t Offset, IROp_Header const *op) {
   printf("\n");
 }
 
+void DumpFallback(size_t Offset, IROp_Header const *op) {
+  auto Fallback = op->C<IROp_Fallback>();
+  printf("%%%zd = %s 0x%zx\n", Offset, GetName(op->Op).data(), Fallback->RIP);
+}
+
+void DumpRaiseSignal(size_t Offset, IROp_Header const *op) {
+  auto RaiseSignal = op->C<IROp_RaiseSignal>();
+  printf("%s %d\n", GetName(op->Op).data(), RaiseSignal->Signal);
+}
+
 void DumpRIPMarker(size_t Offset, IROp_Header const *op) {
   auto RIPMarker = op->C<IROp_RIPMarker>();
   printf("%s 0x%zx\n", GetName(op->Op).data(), RIPMarker->RIP);
@@ -145,6 +268,8 @@ constexpr std::array<OpDumpVisitor, OP_LASTOP + 1> IRDump = {
   DumpInvalid, // sizeof(IROp_Call),
   DumpInvalid, // sizeof(IROp_ExternCall),
 	DumpSyscall, // sizeof(IROp_Syscall),
+	DumpFallback, // sizeof(IROp_Fallback),
+	DumpRaiseSignal, // sizeof(IROp_RaiseSignal),
   DumpInvalid, // sizeof(IROp_Return),
 
   // Instructions
@@ -154,15 +279,30 @@ constexpr std::array<OpDumpVisitor, OP_LASTOP + 1> IRDump = {
   DumpBinOp, // sizeof(IROp_Xor),
   DumpBinOp, // sizeof(IROp_Shl),
   DumpBinOp, // sizeof(IROp_Shr),
+  DumpBinOp, // sizeof(IROp_Ashr),
   DumpBinOp, // sizeof(IROp_And),
   DumpBinOp, // sizeof(IROp_Nand),
   DumpBinOp, // sizeof(IROp_BitExtract),
-  DumpBinOp, // sizeof(IROp_Select),
+  DumpBinOp, // sizeof(IROp_Mul),
+  DumpBinOp, // sizeof(IROp_UMulH),
+  DumpBinOp, // sizeof(IROp_SMulH),
+  DumpBinOp, // sizeof(IROp_UDiv),
+  DumpBinOp, // sizeof(IROp_SDiv),
+  DumpBinOp, // sizeof(IROp_URem),
+  DumpBinOp, // sizeof(IROp_SRem),
+  DumpTriOp, // sizeof(IROp_LUDiv),
+  DumpTriOp, // sizeof(IROp_LURem),
+  DumpSelectOp, // sizeof(IROp_Select),
   DumpBinOp, // sizeof(IROp_Trunc_32),
   DumpBinOp, // sizeof(IROp_Trunc_16),
 
   // Memory
   DumpLoadMemOp, // sizeof(IROp_LoadMem),
+  DumpStoreMemOp, // sizeof(IROp_StoreMem),
+
+  // Flags
+  DumpGetFlag, // sizeof(IROp_GetFlag),
+  DumpBeginBlockOp, // sizeof(IROp_MaterializeFlags),
 
   // Misc
   DumpJmpTarget, // sizeof(IROp_JmpTarget),
@@ -1,6 +1,8 @@
 #pragma once
 #include <array>
 #include <cstdint>
+#include <string_view>
+#include <utility>
 
 namespace Emu::IR {
 
@@ -27,6 +29,8 @@ enum IROps : unsigned {
   OP_CALL,
   OP_EXTERN_CALL,
   OP_SYSCALL,
+  OP_FALLBACK,
+  OP_RAISE_SIGNAL,
   OP_RETURN,
 
   // Instructions
@@ -36,15 +40,30 @@ enum IROps : unsigned {
   OP_XOR,
   OP_SHL,
   OP_SHR,
+  OP_ASHR,
   OP_AND,
   OP_NAND,
   OP_BITEXTRACT,
+  OP_MUL,
+  OP_UMULH,
+  OP_SMULH,
+  OP_UDIV,
+  OP_SDIV,
+  OP_UREM,
+  OP_SREM,
+  OP_LUDIV,
+  OP_LUREM,
   OP_SELECT,
   OP_TRUNC_32,
   OP_TRUNC_16,
 
   // Memory
   OP_LOAD_MEM,
+  OP_STORE_MEM,
+
+  // Flags
+  OP_GET_FLAG,
+  OP_MATERIALIZE_FLAGS,
 
   // Misc
   OP_JUMP_TGT,
@@ -54,11 +73,14 @@ enum IROps : unsigned {
 };
 
 struct IROp_Header {
-  void* Data[0];
+  // Byte typed so that the ops can be reached through it without an unaligned pointer in to the packed header
+  uint8_t Data[0];
   IROps Op : 8;
 
   template<typename T>
   T const* C() const { return reinterpret_cast<T const*>(Data); }
+  template<typename T>
+  T* CW() { return reinterpret_cast<T*>(Data); }
 } __attribute__((packed));
 
 enum TYPE_FLAGS {
@@ -148,34 +170,77 @@ using IROp_Or   = IROp_BiOp;
 using IROp_Xor  = IROp_BiOp;
 using IROp_Shl  = IROp_BiOp;
 using IROp_Shr  = IROp_BiOp;
+using IROp_Ashr = IROp_BiOp;
 using IROp_And  = IROp_BiOp;
 using IROp_Nand = IROp_BiOp;
 using IROp_BitExtract = IROp_BiOp;
+// Low and high 64bits of the 128bit product
+using IROp_Mul   = IROp_BiOp;
+using IROp_UMulH = IROp_BiOp;
+using IROp_SMulH = IROp_BiOp;
+// 64bit divides, a zero divisor or INT64_MIN / -1 is undefined so the frontend has to rule them out first
+using IROp_UDiv  = IROp_BiOp;
+using IROp_SDiv  = IROp_BiOp;
+using IROp_URem  = IROp_BiOp;
+using IROp_SRem  = IROp_BiOp;
+
+// TriOps
+// Args[1]:Args[0] divided by Args[2], Args[1] has to be below Args[2] so the quotient fits in 64bits
+using IROp_LUDiv = IROp_TriOp;
+using IROp_LURem = IROp_TriOp;
 
 struct IROp_Select {
   enum ComparisonOp {
     COMP_EQ,
     COMP_NEQ,
+    COMP_SLT,
+    COMP_SLE,
+    COMP_SGT,
+    COMP_SGE,
+    COMP_ULT,
+    COMP_ULE,
+    COMP_UGT,
+    COMP_UGE,
   };
+  // Args[0] Op Args[1] ? Args[2] : Args[3], signed comparisons treat the arguments as 64bit
   IROp_Header Header;
   ComparisonOp Op;
   AlignmentType Args[4];
 };
 
+// Guest memory accesses of 1, 2, 4 or 8 bytes at Arg[0] + Arg[1] from the memory base, Arg[1] is ~0 without an index
 struct IROp_LoadMem {
   IROp_Header Header;
   uint8_t Size;
+  bool SignExtend; ///< Sign extends to 64bit instead of zero extending
   AlignmentType Arg[2];
 };
 
+// Stores the bottom Size bytes of Arg[0] to Arg[1] + Arg[2], Arg[2] is ~0 without an index
+struct IROp_StoreMem {
+  IROp_Header Header;
+  uint8_t Size;
+  AlignmentType Arg[3];
+};
+
+struct IROp_GetFlag {
+  IROp_Header Header;
+  uint8_t Bit;
+};
+
+using IROp_MaterializeFlags = IROp_Empty;
+
 struct IROp_Jump {
   IROp_Header Header;
   AlignmentType Target;
 };
 
+// Compare and branch, jumps to Target if Args[0] Cond Args[1]
+// RIPTarget is the guest RIP that the exit path falling out of it leaves for, ~0 if it isn't a direct jump
 struct IROp_CondJump {
   IROp_Header Header;
-  AlignmentType Cond;
+  IROp_Select::ComparisonOp Cond;
+  AlignmentType Args[2];
   AlignmentType Target;
   uint64_t RIPTarget;
 };
@@ -197,6 +262,19 @@ struct IROp_Syscall {
   AlignmentType Arguments[MAX_ARGS];
 };
 
+// Runs a single guest instruction through Unicorn, the result is the RIP Unicorn stopped at
+// The block only carries on if that is the next instruction
+struct IROp_Fallback {
+  IROp_Header Header;
+  uint64_t RIP;
+};
+
+// Leaves the block with Signal pending on the guest thread, RIP has to already point at the faulting instruction
+struct IROp_RaiseSignal {
+  IROp_Header Header;
+  uint8_t Signal;
+};
+
 struct IROp_RIPMarker {
   IROp_Header Header;
   uint64_t RIP;
@@ -223,6 +301,8 @@ constexpr std::array<size_t, OP_LASTOP + 1> IRSizes = {
   sizeof(IROp_Call),
   sizeof(IROp_ExternCall),
 	sizeof(IROp_Syscall),
+	sizeof(IROp_Fallback),
+	sizeof(IROp_RaiseSignal),
 	sizeof(IROp_Return),
 
   // Instructions
@@ -232,15 +312,30 @@ constexpr std::array<size_t, OP_LASTOP + 1> IRSizes = {
   sizeof(IROp_Xor),
   sizeof(IROp_Shl),
   sizeof(IROp_Shr),
+  sizeof(IROp_Ashr),
   sizeof(IROp_And),
   sizeof(IROp_Nand),
   sizeof(IROp_BitExtract),
+  sizeof(IROp_Mul),
+  sizeof(IROp_UMulH),
+  sizeof(IROp_SMulH),
+  sizeof(IROp_UDiv),
+  sizeof(IROp_SDiv),
+  sizeof(IROp_URem),
+  sizeof(IROp_SRem),
+  sizeof(IROp_LUDiv),
+  sizeof(IROp_LURem),
   sizeof(IROp_Select),
   sizeof(IROp_Trunc_32),
   sizeof(IROp_Trunc_16),
 
   // Memory
   sizeof(IROp_LoadMem),
+  sizeof(IROp_StoreMem),
+
+  // Flags
+  sizeof(IROp_GetFlag),
+  sizeof(IROp_MaterializeFlags),
 
   // Misc
   sizeof(IROp_JmpTarget),
@@ -251,8 +346,98 @@ constexpr std::array<size_t, OP_LASTOP + 1> IRSizes = {
 // Try to make sure our array mape directly to the IROps enum
 static_assert(IRSizes[OP_LASTOP] == -1ULL);
 
+// Properties of each op that the IR passes care about
+enum IROpProperties : uint8_t {
+  PROP_NONE         = 0,
+  PROP_HAS_DEST     = (1 << 0), ///< Op defines an SSA value
+  PROP_SIDE_EFFECTS = (1 << 1), ///< Op can't be removed even if nothing uses its value
+  PROP_PURE         = (1 << 2), ///< Value only depends on the op's arguments and immediates
+  PROP_INVALID      = 0xFF,
+};
+
+constexpr std::array<uint8_t, OP_LASTOP + 1> IRProperties = {
+	PROP_HAS_DEST | PROP_PURE, // IROp_Constant
+	PROP_HAS_DEST, // IROp_LoadContext
+	PROP_SIDE_EFFECTS, // IROp_StoreContext
+
+  // Function management
+  PROP_SIDE_EFFECTS, // IROp_BeginFunction
+  PROP_SIDE_EFFECTS, // IROp_EndFunction
+  PROP_HAS_DEST, // IROp_GetArgument
+  PROP_HAS_DEST | PROP_SIDE_EFFECTS, // IROp_AllocateContext
+
+  // Block Management
+  PROP_SIDE_EFFECTS, // BeginBlock
+  PROP_SIDE_EFFECTS, // EndBlock
+
+  // Branching
+  PROP_SIDE_EFFECTS, // IROp_Jump
+  PROP_SIDE_EFFECTS, // IROp_CondJump
+  PROP_SIDE_EFFECTS, // IROp_Call
+  PROP_SIDE_EFFECTS, // IROp_ExternCall
+	PROP_HAS_DEST | PROP_SIDE_EFFECTS, // IROp_Syscall
+	PROP_HAS_DEST | PROP_SIDE_EFFECTS, // IROp_Fallback
+	PROP_SIDE_EFFECTS, // IROp_RaiseSignal
+	PROP_SIDE_EFFECTS, // IROp_Return
+
+  // Instructions
+  PROP_HAS_DEST | PROP_PURE, // IROp_Add
+  PROP_HAS_DEST | PROP_PURE, // IROp_Sub
+  PROP_HAS_DEST | PROP_PURE, // IROp_Or
+  PROP_HAS_DEST | PROP_PURE, // IROp_Xor
+  PROP_HAS_DEST | PROP_PURE, // IROp_Shl
+  PROP_HAS_DEST | PROP_PURE, // IROp_Shr
+  PROP_HAS_DEST | PROP_PURE, // IROp_Ashr
+  PROP_HAS_DEST | PROP_PURE, // IROp_And
+  PROP_HAS_DEST | PROP_PURE, // IROp_Nand
+  PROP_HAS_DEST | PROP_PURE, // IROp_BitExtract
+  PROP_HAS_DEST | PROP_PURE, // IROp_Mul
+  PROP_HAS_DEST | PROP_PURE, // IROp_UMulH
+  PROP_HAS_DEST | PROP_PURE, // IROp_SMulH
+  PROP_HAS_DEST | PROP_PURE, // IROp_UDiv
+  PROP_HAS_DEST | PROP_PURE, // IROp_SDiv
+  PROP_HAS_DEST | PROP_PURE, // IROp_URem
+  PROP_HAS_DEST | PROP_PURE, // IROp_SRem
+  PROP_HAS_DEST | PROP_PURE, // IROp_LUDiv
+  PROP_HAS_DEST | PROP_PURE, // IROp_LURem
+  PROP_HAS_DEST | PROP_PURE, // IROp_Select
+  PROP_HAS_DEST | PROP_PURE, // IROp_Trunc_32
+  PROP_HAS_DEST | PROP_PURE, // IROp_Trunc_16
+
+  // Memory
+  PROP_HAS_DEST, // IROp_LoadMem
+  PROP_SIDE_EFFECTS, // IROp_StoreMem
+
+  // Flags
+  PROP_HAS_DEST, // IROp_GetFlag
+  PROP_SIDE_EFFECTS, // IROp_MaterializeFlags
+
+  // Misc
+  PROP_SIDE_EFFECTS, // IROp_JmpTarget
+	PROP_SIDE_EFFECTS, // IROp_RIPMarker
+	PROP_INVALID,
+};
+
+static_assert(IRProperties[OP_LASTOP] == PROP_INVALID);
+
 std::string_view const& GetName(IROps Op);
 static size_t GetSize(IROps Op) { return IRSizes[Op]; }
+static bool HasDest(IROps Op) { return IRProperties[Op] & PROP_HAS_DEST; }
+static bool HasSideEffects(IROps Op) { return IRProperties[Op] & PROP_SIDE_EFFECTS; }
+static bool IsPure(IROps Op) { return IRProperties[Op] & PROP_PURE; }
+
+/**
+ * @brief Gets the SSA values an op consumes
+ *
+ * Branch targets aren't SSA values and aren't returned
+ * An unused LoadMem or StoreMem index isn't returned
+ *
+ * @return Pointer to the first argument and the number of arguments
+ */
+std::pair<AlignmentType*, size_t> GetArgs(IROp_Header *Op);
+static std::pair<AlignmentType const*, size_t> GetArgs(IROp_Header const *Op) {
+  return GetArgs(const_cast<IROp_Header*>(Op));
+}
 
 void Dump(IntrusiveIRList const* IR);
 }
@@ -1,189 +1,776 @@
 #include "Core/CPU/CPUCore.h"
+#include "Core/CPU/Flags.h"
 #include "Core/CPU/IR.h"
 #include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/Passes/RegisterAllocation.h"
 #include "Interpreter.h"
 #include "LogManager.h"
-#include <map>
+#include <alloca.h>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 
 namespace Emu {
+namespace {
+// Bytecode ops, IR ops get split on anything that would otherwise be checked at runtime
+enum BytecodeOp : uint32_t {
+  BC_CONSTANT,
+  BC_LOADCONTEXT_1,
+  BC_LOADCONTEXT_2,
+  BC_LOADCONTEXT_4,
+  BC_LOADCONTEXT_8,
+  BC_STORECONTEXT_1,
+  BC_STORECONTEXT_2,
+  BC_STORECONTEXT_4,
+  BC_STORECONTEXT_8,
+  BC_ADD,
+  BC_SUB,
+  BC_OR,
+  BC_XOR,
+  BC_SHL,
+  BC_SHR,
+  BC_ASHR,
+  BC_AND,
+  BC_NAND,
+  BC_BITEXTRACT,
+  BC_MUL,
+  BC_UMULH,
+  BC_SMULH,
+  BC_UDIV,
+  BC_SDIV,
+  BC_UREM,
+  BC_SREM,
+  BC_LUDIV,
+  BC_LUREM,
+  BC_SELECT_EQ,
+  BC_SELECT_NEQ,
+  BC_SELECT_SLT,
+  BC_SELECT_SLE,
+  BC_SELECT_SGT,
+  BC_SELECT_SGE,
+  BC_SELECT_ULT,
+  BC_SELECT_ULE,
+  BC_SELECT_UGT,
+  BC_SELECT_UGE,
+  BC_TRUNC_32,
+  BC_TRUNC_16,
+  BC_LOADMEM_1,
+  BC_LOADMEM_2,
+  BC_LOADMEM_4,
+  BC_LOADMEM_8,
+  BC_LOADMEM_INDEXED_1,
+  BC_LOADMEM_INDEXED_2,
+  BC_LOADMEM_INDEXED_4,
+  BC_LOADMEM_INDEXED_8,
+  BC_LOADMEM_SX_1,
+  BC_LOADMEM_SX_2,
+  BC_LOADMEM_SX_4,
+  BC_LOADMEM_SX_8,
+  BC_LOADMEM_SX_INDEXED_1,
+  BC_LOADMEM_SX_INDEXED_2,
+  BC_LOADMEM_SX_INDEXED_4,
+  BC_LOADMEM_SX_INDEXED_8,
+  BC_STOREMEM_1,
+  BC_STOREMEM_2,
+  BC_STOREMEM_4,
+  BC_STOREMEM_8,
+  BC_STOREMEM_INDEXED_1,
+  BC_STOREMEM_INDEXED_2,
+  BC_STOREMEM_INDEXED_4,
+  BC_STOREMEM_INDEXED_8,
+  BC_SYSCALL,
+  BC_FALLBACK,
+  BC_RAISE_SIGNAL,
+  BC_GET_FLAG,
+  BC_MATERIALIZE_FLAGS,
+  BC_JUMP,
+  BC_COND_JUMP_EQ,
+  BC_COND_JUMP_NEQ,
+  BC_COND_JUMP_SLT,
+  BC_COND_JUMP_SLE,
+  BC_COND_JUMP_SGT,
+  BC_COND_JUMP_SGE,
+  BC_COND_JUMP_ULT,
+  BC_COND_JUMP_ULE,
+  BC_COND_JUMP_UGT,
+  BC_COND_JUMP_UGE,
+  BC_ENDBLOCK,
+  BC_LASTOP,
+};
+
+/**
+ * @brief A single bytecode instruction
+ *
+ * Dest and Args are value slots, Imm holds whatever the op needs resolved ahead of time:
+ * Context offsets, constants, instruction indexes for jumps, the RIP increment
+ */
+struct Instruction {
+  void const *Handler;
+  uint32_t Dest;
+  uint32_t Args[2];
+  uint64_t Imm;
+};
+
+/**
+ * @brief An IR list lowered to bytecode
+ */
+struct LoweredBlock {
+  uint32_t NumSlots;
+  std::vector<Instruction> Code;
+  // Syscalls have more arguments than fit in an instruction, Imm indexes in to this
+  std::vector<uint32_t> ExtraArgs;
+};
+
+// Values get slots from the linear scan allocator so blocks touch as little stack as possible
+// Spilled values get slots past the register slots
+constexpr uint32_t NUM_REGISTER_SLOTS = 64;
 
-static void TestCompilation(CPUCore *cpu) {
-  auto threadstate = cpu->GetTLSThread();
-  auto IR = cpu->GetIRList(threadstate, threadstate->CPUState.rip);
-  auto Size = IR->GetOffset();
+/**
+ * @brief Runs a lowered block
+ *
+ * Labels only exist inside of this function, so calling it with a nullptr Block returns the handler table
+ * the lowering uses instead of running anything
+ */
+void const* const* Interpret(CPUCore *CPU, X86State *State, LoweredBlock const *Block) {
+  static void const* const Handlers[BC_LASTOP] = {
+    &&Op_Constant,
+    &&Op_LoadContext_1,
+    &&Op_LoadContext_2,
+    &&Op_LoadContext_4,
+    &&Op_LoadContext_8,
+    &&Op_StoreContext_1,
+    &&Op_StoreContext_2,
+    &&Op_StoreContext_4,
+    &&Op_StoreContext_8,
+    &&Op_Add,
+    &&Op_Sub,
+    &&Op_Or,
+    &&Op_Xor,
+    &&Op_Shl,
+    &&Op_Shr,
+    &&Op_Ashr,
+    &&Op_And,
+    &&Op_Nand,
+    &&Op_BitExtract,
+    &&Op_Mul,
+    &&Op_UMulH,
+    &&Op_SMulH,
+    &&Op_UDiv,
+    &&Op_SDiv,
+    &&Op_URem,
+    &&Op_SRem,
+    &&Op_LUDiv,
+    &&Op_LURem,
+    &&Op_Select_EQ,
+    &&Op_Select_NEQ,
+    &&Op_Select_SLT,
+    &&Op_Select_SLE,
+    &&Op_Select_SGT,
+    &&Op_Select_SGE,
+    &&Op_Select_ULT,
+    &&Op_Select_ULE,
+    &&Op_Select_UGT,
+    &&Op_Select_UGE,
+    &&Op_Trunc_32,
+    &&Op_Trunc_16,
+    &&Op_LoadMem_1,
+    &&Op_LoadMem_2,
+    &&Op_LoadMem_4,
+    &&Op_LoadMem_8,
+    &&Op_LoadMem_Indexed_1,
+    &&Op_LoadMem_Indexed_2,
+    &&Op_LoadMem_Indexed_4,
+    &&Op_LoadMem_Indexed_8,
+    &&Op_LoadMem_SX_1,
+    &&Op_LoadMem_SX_2,
+    &&Op_LoadMem_SX_4,
+    &&Op_LoadMem_SX_8,
+    &&Op_LoadMem_SX_Indexed_1,
+    &&Op_LoadMem_SX_Indexed_2,
+    &&Op_LoadMem_SX_Indexed_4,
+    &&Op_LoadMem_SX_Indexed_8,
+    &&Op_StoreMem_1,
+    &&Op_StoreMem_2,
+    &&Op_StoreMem_4,
+    &&Op_StoreMem_8,
+    &&Op_StoreMem_Indexed_1,
+    &&Op_StoreMem_Indexed_2,
+    &&Op_StoreMem_Indexed_4,
+    &&Op_StoreMem_Indexed_8,
+    &&Op_Syscall,
+    &&Op_Fallback,
+    &&Op_RaiseSignal,
+    &&Op_GetFlag,
+    &&Op_MaterializeFlags,
+    &&Op_Jump,
+    &&Op_CondJump_EQ,
+    &&Op_CondJump_NEQ,
+    &&Op_CondJump_SLT,
+    &&Op_CondJump_SLE,
+    &&Op_CondJump_SGT,
+    &&Op_CondJump_SGE,
+    &&Op_CondJump_ULT,
+    &&Op_CondJump_ULE,
+    &&Op_CondJump_UGT,
+    &&Op_CondJump_UGE,
+    &&Op_EndBlock,
+  };
 
-  size_t i = 0;
-  // XXX: Change this map over to a register bank that supports real RA
-  // Works now for testing
-  std::map<IR::AlignmentType, uint64_t> Values;
+  if (!Block)
+    return Handlers;
+
+  uint64_t *Slots = static_cast<uint64_t*>(alloca(Block->NumSlots * sizeof(uint64_t)));
+  uint8_t *Context = reinterpret_cast<uint8_t*>(State);
+  uint8_t *MemBase = CPU->MemoryMapper->GetBaseOffset<uint8_t*>(0);
+  Instruction const *Code = Block->Code.data();
+  Instruction const *IP = Code;
+
+#define DISPATCH() goto *IP->Handler
+#define NEXT() do { ++IP; DISPATCH(); } while (0)
+#define ARG(n) Slots[IP->Args[n]]
+#define CONTEXT(Type) *reinterpret_cast<Type*>(Context + IP->Imm)
+#define MEM(Type, Addr) *reinterpret_cast<Type*>(MemBase + (Addr))
+
+  DISPATCH();
+
+Op_Constant:
+  Slots[IP->Dest] = IP->Imm;
+  NEXT();
+Op_LoadContext_1:
+  Slots[IP->Dest] = CONTEXT(uint8_t);
+  NEXT();
+Op_LoadContext_2:
+  Slots[IP->Dest] = CONTEXT(uint16_t);
+  NEXT();
+Op_LoadContext_4:
+  Slots[IP->Dest] = CONTEXT(uint32_t);
+  NEXT();
+Op_LoadContext_8:
+  Slots[IP->Dest] = CONTEXT(uint64_t);
+  NEXT();
+Op_StoreContext_1:
+  CONTEXT(uint8_t) = ARG(0);
+  NEXT();
+Op_StoreContext_2:
+  CONTEXT(uint16_t) = ARG(0);
+  NEXT();
+Op_StoreContext_4:
+  CONTEXT(uint32_t) = ARG(0);
+  NEXT();
+Op_StoreContext_8:
+  CONTEXT(uint64_t) = ARG(0);
+  NEXT();
+Op_Add:
+  Slots[IP->Dest] = ARG(0) + ARG(1);
+  NEXT();
+Op_Sub:
+  Slots[IP->Dest] = ARG(0) - ARG(1);
+  NEXT();
+Op_Or:
+  Slots[IP->Dest] = ARG(0) | ARG(1);
+  NEXT();
+Op_Xor:
+  Slots[IP->Dest] = ARG(0) ^ ARG(1);
+  NEXT();
+// Shift counts wrap the same way they do in the native backends
+Op_Shl:
+  Slots[IP->Dest] = ARG(0) << (ARG(1) & 63);
+  NEXT();
+Op_Shr:
+  Slots[IP->Dest] = ARG(0) >> (ARG(1) & 63);
+  NEXT();
+Op_Ashr:
+  Slots[IP->Dest] = static_cast<int64_t>(ARG(0)) >> (ARG(1) & 63);
+  NEXT();
+Op_And:
+  Slots[IP->Dest] = ARG(0) & ARG(1);
+  NEXT();
+Op_Nand:
+  Slots[IP->Dest] = ARG(0) & ~ARG(1);
+  NEXT();
+Op_BitExtract:
+  Slots[IP->Dest] = (ARG(0) >> (ARG(1) & 63)) & 1;
+  NEXT();
+Op_Mul:
+  Slots[IP->Dest] = ARG(0) * ARG(1);
+  NEXT();
+Op_UMulH:
+  Slots[IP->Dest] = (static_cast<unsigned __int128>(ARG(0)) * ARG(1)) >> 64;
+  NEXT();
+Op_SMulH:
+  Slots[IP->Dest] = (static_cast<__int128>(static_cast<int64_t>(ARG(0))) * static_cast<int64_t>(ARG(1))) >> 64;
+  NEXT();
+Op_UDiv:
+  Slots[IP->Dest] = ARG(0) / ARG(1);
+  NEXT();
+Op_SDiv:
+  Slots[IP->Dest] = static_cast<int64_t>(ARG(0)) / static_cast<int64_t>(ARG(1));
+  NEXT();
+Op_URem:
+  Slots[IP->Dest] = ARG(0) % ARG(1);
+  NEXT();
+Op_SRem:
+  Slots[IP->Dest] = static_cast<int64_t>(ARG(0)) % static_cast<int64_t>(ARG(1));
+  NEXT();
+// The divisor's slot is in Imm
+Op_LUDiv:
+  Slots[IP->Dest] = ((static_cast<unsigned __int128>(ARG(1)) << 64) | ARG(0)) / Slots[IP->Imm];
+  NEXT();
+Op_LURem:
+  Slots[IP->Dest] = ((static_cast<unsigned __int128>(ARG(1)) << 64) | ARG(0)) % Slots[IP->Imm];
+  NEXT();
+// The true and false values are packed in to Imm
+Op_Select_EQ:
+  Slots[IP->Dest] = Slots[ARG(0) == ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_NEQ:
+  Slots[IP->Dest] = Slots[ARG(0) != ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_SLT:
+  Slots[IP->Dest] = Slots[int64_t(ARG(0)) < int64_t(ARG(1)) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_SLE:
+  Slots[IP->Dest] = Slots[int64_t(ARG(0)) <= int64_t(ARG(1)) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_SGT:
+  Slots[IP->Dest] = Slots[int64_t(ARG(0)) > int64_t(ARG(1)) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_SGE:
+  Slots[IP->Dest] = Slots[int64_t(ARG(0)) >= int64_t(ARG(1)) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_ULT:
+  Slots[IP->Dest] = Slots[ARG(0) < ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_ULE:
+  Slots[IP->Dest] = Slots[ARG(0) <= ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_UGT:
+  Slots[IP->Dest] = Slots[ARG(0) > ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Select_UGE:
+  Slots[IP->Dest] = Slots[ARG(0) >= ARG(1) ? uint32_t(IP->Imm) : uint32_t(IP->Imm >> 32)];
+  NEXT();
+Op_Trunc_32:
+  Slots[IP->Dest] = ARG(0) & 0xFFFFFFFFULL;
+  NEXT();
+Op_Trunc_16:
+  Slots[IP->Dest] = ARG(0) & 0x0000FFFFULL;
+  NEXT();
+Op_LoadMem_1:
+  Slots[IP->Dest] = MEM(uint8_t, ARG(0));
+  NEXT();
+Op_LoadMem_2:
+  Slots[IP->Dest] = MEM(uint16_t, ARG(0));
+  NEXT();
+Op_LoadMem_4:
+  Slots[IP->Dest] = MEM(uint32_t, ARG(0));
+  NEXT();
+Op_LoadMem_8:
+  Slots[IP->Dest] = MEM(uint64_t, ARG(0));
+  NEXT();
+Op_LoadMem_Indexed_1:
+  Slots[IP->Dest] = MEM(uint8_t, ARG(0) + ARG(1));
+  NEXT();
+Op_LoadMem_Indexed_2:
+  Slots[IP->Dest] = MEM(uint16_t, ARG(0) + ARG(1));
+  NEXT();
+Op_LoadMem_Indexed_4:
+  Slots[IP->Dest] = MEM(uint32_t, ARG(0) + ARG(1));
+  NEXT();
+Op_LoadMem_Indexed_8:
+  Slots[IP->Dest] = MEM(uint64_t, ARG(0) + ARG(1));
+  NEXT();
+Op_LoadMem_SX_1:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int8_t, ARG(0)));
+  NEXT();
+Op_LoadMem_SX_2:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int16_t, ARG(0)));
+  NEXT();
+Op_LoadMem_SX_4:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int32_t, ARG(0)));
+  NEXT();
+Op_LoadMem_SX_8:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int64_t, ARG(0)));
+  NEXT();
+Op_LoadMem_SX_Indexed_1:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int8_t, ARG(0) + ARG(1)));
+  NEXT();
+Op_LoadMem_SX_Indexed_2:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int16_t, ARG(0) + ARG(1)));
+  NEXT();
+Op_LoadMem_SX_Indexed_4:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int32_t, ARG(0) + ARG(1)));
+  NEXT();
+Op_LoadMem_SX_Indexed_8:
+  Slots[IP->Dest] = static_cast<int64_t>(MEM(int64_t, ARG(0) + ARG(1)));
+  NEXT();
+// Stores have no destination, the value is in the first argument and an index slot in Imm
+Op_StoreMem_1:
+  MEM(uint8_t, ARG(1)) = ARG(0);
+  NEXT();
+Op_StoreMem_2:
+  MEM(uint16_t, ARG(1)) = ARG(0);
+  NEXT();
+Op_StoreMem_4:
+  MEM(uint32_t, ARG(1)) = ARG(0);
+  NEXT();
+Op_StoreMem_8:
+  MEM(uint64_t, ARG(1)) = ARG(0);
+  NEXT();
+Op_StoreMem_Indexed_1:
+  MEM(uint8_t, ARG(1) + Slots[IP->Imm]) = ARG(0);
+  NEXT();
+Op_StoreMem_Indexed_2:
+  MEM(uint16_t, ARG(1) + Slots[IP->Imm]) = ARG(0);
+  NEXT();
+Op_StoreMem_Indexed_4:
+  MEM(uint32_t, ARG(1) + Slots[IP->Imm]) = ARG(0);
+  NEXT();
+Op_StoreMem_Indexed_8:
+  MEM(uint64_t, ARG(1) + Slots[IP->Imm]) = ARG(0);
+  NEXT();
+Op_Syscall: {
+  Emu::SyscallHandler::SyscallArguments Args;
+  uint32_t const *ArgSlots = &Block->ExtraArgs[IP->Imm];
+  for (size_t i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i)
+    Args.Argument[i] = Slots[ArgSlots[i]];
+
+  Slots[IP->Dest] = CPU->syscallhandler.HandleSyscall(&Args);
+  NEXT();
+}
+Op_Fallback:
+  Slots[IP->Dest] = CPU->FallbackInstruction(State, IP->Imm);
+  NEXT();
+Op_RaiseSignal:
+  CPU->RaiseSignal(State, IP->Imm);
+  NEXT();
+Op_GetFlag:
+  Slots[IP->Dest] = Flags::GetFlag(State, IP->Imm);
+  NEXT();
+Op_MaterializeFlags:
+  Flags::Materialize(State);
+  NEXT();
+Op_Jump:
+  IP = &Code[IP->Imm];
+  DISPATCH();
+Op_CondJump_EQ:
+  if (ARG(0) == ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_NEQ:
+  if (ARG(0) != ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_SLT:
+  if (int64_t(ARG(0)) < int64_t(ARG(1))) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_SLE:
+  if (int64_t(ARG(0)) <= int64_t(ARG(1))) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_SGT:
+  if (int64_t(ARG(0)) > int64_t(ARG(1))) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_SGE:
+  if (int64_t(ARG(0)) >= int64_t(ARG(1))) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_ULT:
+  if (ARG(0) < ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_ULE:
+  if (ARG(0) <= ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_UGT:
+  if (ARG(0) > ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_CondJump_UGE:
+  if (ARG(0) >= ARG(1)) {
+    IP = &Code[IP->Imm];
+    DISPATCH();
+  }
+  NEXT();
+Op_EndBlock:
+  State->rip += IP->Imm;
+  return nullptr;
 
-  bool End = false;
-  while (i != Size && !End) {
-    auto op = IR->GetOp(i);
-    size_t opSize = Emu::IR::GetSize(op->Op);
+#undef MEM
+#undef CONTEXT
+#undef ARG
+#undef NEXT
+#undef DISPATCH
+}
+
+/**
+ * @brief Bytecode op for a sized access
+ *
+ * @return BC_LASTOP for sizes the bytecode doesn't handle
+ */
+BytecodeOp SizedOp(BytecodeOp Base, uint8_t Size) {
+  switch (Size) {
+  case 1: return static_cast<BytecodeOp>(Base);
+  case 2: return static_cast<BytecodeOp>(Base + 1);
+  case 4: return static_cast<BytecodeOp>(Base + 2);
+  case 8: return static_cast<BytecodeOp>(Base + 3);
+  default: return BC_LASTOP;
+  }
+}
+
+class Interpreter final : public CPUBackend {
+public:
+  explicit Interpreter(CPUCore *CPU);
+  std::string GetName() override { return "Interpreter"; }
+  void* CompileCode(Emu::IR::IntrusiveIRList const *ir) override;
+  BlockRunner GetBlockRunner() override { return RunBlock; }
+
+private:
+  CPUCore *cpu;
+  IR::RegisterFile SlotFile;
+  void const* const* Handlers;
+
+  // Blocks are shared between threads and never freed, same as native code
+  std::mutex BlockLock;
+  std::vector<std::unique_ptr<LoweredBlock>> Blocks;
+
+  std::unique_ptr<LoweredBlock> Lower(IR::IntrusiveIRList const *ir);
+
+  static void RunBlock(CPUCore *CPU, void *Block) {
+    Interpret(CPU, &CPU->GetTLSThread()->CPUState, reinterpret_cast<LoweredBlock const*>(Block));
+  }
+};
+
+Interpreter::Interpreter(CPUCore *CPU)
+  : cpu {CPU}
+  , Handlers {Interpret(nullptr, nullptr, nullptr)} {
+  SlotFile.NumRegisters = NUM_REGISTER_SLOTS;
+  SlotFile.CallerSavedMask = 0;
+}
+
+std::unique_ptr<LoweredBlock> Interpreter::Lower(IR::IntrusiveIRList const *ir) {
+  auto RA = IR::AllocateRegisters(ir, SlotFile);
+  auto Block = std::make_unique<LoweredBlock>();
+
+  if (RA.SpillSlots)
+    Block->NumSlots = NUM_REGISTER_SLOTS + RA.SpillSlots;
+  else
+    Block->NumSlots = RA.UsedRegisters ? 64 - __builtin_clzll(RA.UsedRegisters) : 1;
+
+  auto Slot = [&RA](IR::AlignmentType Value) -> uint32_t {
+    auto &Assignment = RA.Get(Value);
+    return Assignment.IsSpilled() ? NUM_REGISTER_SLOTS + Assignment.SpillSlot : Assignment.Register;
+  };
+
+  auto Emit = [this, &Block](BytecodeOp Op, uint32_t Dest, uint32_t Arg0, uint32_t Arg1, uint64_t Imm) {
+    Block->Code.emplace_back(Instruction{Handlers[Op], Dest, {Arg0, Arg1}, Imm});
+  };
+
+  // Jump targets are resolved to instruction indexes once the whole block is lowered
+  std::unordered_map<IR::AlignmentType, uint32_t> TargetIndexes;
+  std::vector<std::pair<size_t, IR::AlignmentType>> Fixups;
+
+  size_t Size = ir->GetOffset();
+  for (size_t i = 0; i != Size; i += IR::GetSize(ir->GetOp(i)->Op)) {
+    auto op = ir->GetOp(i);
+    uint32_t Dest = IR::HasDest(op->Op) ? Slot(i) : 0;
 
     switch (op->Op) {
     case IR::OP_BEGINBLOCK:
+    case IR::OP_RIP_MARKER:
     break;
     case IR::OP_JUMP_TGT:
-      printf("Landed on jump target\n");
+      TargetIndexes[i] = Block->Code.size();
     break;
-    case IR::OP_ENDBLOCK: {
-      auto EndOp = op->C<IR::IROp_EndBlock>();
-      threadstate->CPUState.rip += EndOp->RIPIncrement;
-      // If we hit an end block that isn't at the end of the stream that means we need to early exit
-      // Just set ourselves to the end regardless
-      End = true;
+    case IR::OP_ENDBLOCK:
+      Emit(BC_ENDBLOCK, 0, 0, 0, op->C<IR::IROp_EndBlock>()->RIPIncrement);
+    break;
+    case IR::OP_JUMP:
+      Fixups.emplace_back(Block->Code.size(), op->C<IR::IROp_Jump>()->Target);
+      Emit(BC_JUMP, 0, 0, 0, 0);
     break;
-    }
     case IR::OP_COND_JUMP: {
       auto JumpOp = op->C<IR::IROp_CondJump>();
-      if (!!Values[JumpOp->Cond])
-        i = JumpOp->Target - opSize;
-    }
+      static_assert(BC_COND_JUMP_UGE - BC_COND_JUMP_EQ == IR::IROp_Select::COMP_UGE - IR::IROp_Select::COMP_EQ, "Bytecode jumps need to match the IR's order");
+      if (JumpOp->Cond > IR::IROp_Select::COMP_UGE) {
+        LogMan::Msg::E("Unknown jump comparison: %d", JumpOp->Cond);
+        return nullptr;
+      }
+      Fixups.emplace_back(Block->Code.size(), JumpOp->Target);
+      Emit(static_cast<BytecodeOp>(BC_COND_JUMP_EQ + JumpOp->Cond), 0, Slot(JumpOp->Args[0]), Slot(JumpOp->Args[1]), 0);
     break;
-    case IR::OP_CONSTANT: {
-      auto ConstantOp = op->C<IR::IROp_Constant>();
-      Values[i] = ConstantOp->Constant;
     }
+    case IR::OP_CONSTANT:
+      Emit(BC_CONSTANT, Dest, 0, 0, op->C<IR::IROp_Constant>()->Constant);
     break;
-    case IR::OP_SYSCALL: {
-      auto SyscallOp = op->C<IR::IROp_Syscall>();
-
-      Emu::SyscallHandler::SyscallArguments Args;
-      for (int i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i)
-        Args.Argument[i] = Values[SyscallOp->Arguments[i]];
-
-      uint64_t Res = cpu->syscallhandler.HandleSyscall(&Args);
-      Values[i] = Res;
-    break;
-    }
     case IR::OP_LOADCONTEXT: {
       auto LoadOp = op->C<IR::IROp_LoadContext>();
-      LogMan::Throw::A(LoadOp->Size == 8, "Can only handle 8 byte");
-
-      uintptr_t ContextPtr = reinterpret_cast<uintptr_t>(&threadstate->CPUState);
-      ContextPtr += LoadOp->Offset;
-
-      uint64_t *ContextData = reinterpret_cast<uint64_t*>(ContextPtr);
-      Values[i] = *ContextData;
+      BytecodeOp Op = SizedOp(BC_LOADCONTEXT_1, LoadOp->Size);
+      if (Op == BC_LASTOP) {
+        LogMan::Msg::E("Unknown LoadContext size: %d", LoadOp->Size);
+        return nullptr;
+      }
+      Emit(Op, Dest, 0, 0, LoadOp->Offset);
     break;
     }
     case IR::OP_STORECONTEXT: {
       auto StoreOp = op->C<IR::IROp_StoreContext>();
-      LogMan::Throw::A(StoreOp->Size == 8, "Can only handle 8 byte");
-
-      uintptr_t ContextPtr = reinterpret_cast<uintptr_t>(&threadstate->CPUState);
-      ContextPtr += StoreOp->Offset;
-
-      uint64_t *ContextData = reinterpret_cast<uint64_t*>(ContextPtr);
-      *ContextData = Values[StoreOp->Arg];
-    }
-    break;
-    case IR::OP_ADD: {
-      auto AddOp = op->C<IR::IROp_Add>();
-      Values[i] = Values[AddOp->Args[0]] + Values[AddOp->Args[1]];
-    }
-    break;
-    case IR::OP_SUB: {
-      auto SubOp = op->C<IR::IROp_Sub>();
-      Values[i] = Values[SubOp->Args[0]] - Values[SubOp->Args[1]];
-    }
+      BytecodeOp Op = SizedOp(BC_STORECONTEXT_1, StoreOp->Size);
+      if (Op == BC_LASTOP) {
+        LogMan::Msg::E("Unknown StoreContext size: %d", StoreOp->Size);
+        return nullptr;
+      }
+      Emit(Op, 0, Slot(StoreOp->Arg), 0, StoreOp->Offset);
     break;
-    case IR::OP_OR: {
-      auto OrOp = op->C<IR::IROp_Or>();
-      Values[i] = Values[OrOp->Args[0]] | Values[OrOp->Args[1]];
     }
+    case IR::OP_ADD:
+    case IR::OP_SUB:
+    case IR::OP_OR:
+    case IR::OP_XOR:
+    case IR::OP_SHL:
+    case IR::OP_SHR:
+    case IR::OP_ASHR:
+    case IR::OP_AND:
+    case IR::OP_NAND:
+    case IR::OP_BITEXTRACT:
+    case IR::OP_MUL:
+    case IR::OP_UMULH:
+    case IR::OP_SMULH:
+    case IR::OP_UDIV:
+    case IR::OP_SDIV:
+    case IR::OP_UREM:
+    case IR::OP_SREM: {
+      static_assert(BC_SREM - BC_ADD == IR::OP_SREM - IR::OP_ADD, "Bytecode ALU ops need to match the IR's order");
+      auto BiOp = op->C<IR::IROp_BiOp>();
+      auto Op = static_cast<BytecodeOp>(BC_ADD + (op->Op - IR::OP_ADD));
+      Emit(Op, Dest, Slot(BiOp->Args[0]), Slot(BiOp->Args[1]), 0);
     break;
-    case IR::OP_XOR: {
-      auto XorOp = op->C<IR::IROp_Xor>();
-      Values[i] = Values[XorOp->Args[0]] ^ Values[XorOp->Args[1]];
     }
+    case IR::OP_LUDIV:
+    case IR::OP_LUREM: {
+      auto TriOp = op->C<IR::IROp_TriOp>();
+      Emit(op->Op == IR::OP_LUDIV ? BC_LUDIV : BC_LUREM, Dest, Slot(TriOp->Args[0]), Slot(TriOp->Args[1]), Slot(TriOp->Args[2]));
     break;
-    case IR::OP_SHL: {
-      auto ShlOp = op->C<IR::IROp_Shl>();
-      Values[i] = Values[ShlOp->Args[0]] << Values[ShlOp->Args[1]];
     }
+    case IR::OP_SELECT: {
+      auto SelectOp = op->C<IR::IROp_Select>();
+      static_assert(BC_SELECT_UGE - BC_SELECT_EQ == IR::IROp_Select::COMP_UGE - IR::IROp_Select::COMP_EQ, "Bytecode selects need to match the IR's order");
+      if (SelectOp->Op > IR::IROp_Select::COMP_UGE) {
+        LogMan::Msg::E("Unknown select comparison: %d", SelectOp->Op);
+        return nullptr;
+      }
+      auto Op = static_cast<BytecodeOp>(BC_SELECT_EQ + SelectOp->Op);
+      uint64_t Values = Slot(SelectOp->Args[2]) | (static_cast<uint64_t>(Slot(SelectOp->Args[3])) << 32);
+      Emit(Op, Dest, Slot(SelectOp->Args[0]), Slot(SelectOp->Args[1]), Values);
     break;
-    case IR::OP_SHR: {
-      auto ShrOp = op->C<IR::IROp_Shr>();
-      Values[i] = Values[ShrOp->Args[0]] >> Values[ShrOp->Args[1]];
     }
+    case IR::OP_TRUNC_32:
+    case IR::OP_TRUNC_16:
+      Emit(op->Op == IR::OP_TRUNC_32 ? BC_TRUNC_32 : BC_TRUNC_16, Dest, Slot(op->C<IR::IROp_MonoOp>()->Arg), 0, 0);
     break;
-    case IR::OP_AND: {
-      auto AndOp = op->C<IR::IROp_And>();
-      Values[i] = Values[AndOp->Args[0]] & Values[AndOp->Args[1]];
-    }
+    case IR::OP_LOAD_MEM: {
+      auto LoadMemOp = op->C<IR::IROp_LoadMem>();
+      bool Indexed = LoadMemOp->Arg[1] != ~0U;
+      BytecodeOp Base;
+      if (LoadMemOp->SignExtend)
+        Base = Indexed ? BC_LOADMEM_SX_INDEXED_1 : BC_LOADMEM_SX_1;
+      else
+        Base = Indexed ? BC_LOADMEM_INDEXED_1 : BC_LOADMEM_1;
+      BytecodeOp Op = SizedOp(Base, LoadMemOp->Size);
+      if (Op == BC_LASTOP) {
+        LogMan::Msg::E("Unknown LoadMem size: %d", LoadMemOp->Size);
+        return nullptr;
+      }
+      Emit(Op, Dest, Slot(LoadMemOp->Arg[0]), Indexed ? Slot(LoadMemOp->Arg[1]) : 0, 0);
     break;
-    case IR::OP_NAND: {
-      auto NandOp = op->C<IR::IROp_Nand>();
-      Values[i] = Values[NandOp->Args[0]] & ~(Values[NandOp->Args[1]]);
     }
+    case IR::OP_STORE_MEM: {
+      auto StoreMemOp = op->C<IR::IROp_StoreMem>();
+      bool Indexed = StoreMemOp->Arg[2] != ~0U;
+      BytecodeOp Op = SizedOp(Indexed ? BC_STOREMEM_INDEXED_1 : BC_STOREMEM_1, StoreMemOp->Size);
+      if (Op == BC_LASTOP) {
+        LogMan::Msg::E("Unknown StoreMem size: %d", StoreMemOp->Size);
+        return nullptr;
+      }
+      Emit(Op, 0, Slot(StoreMemOp->Arg[0]), Slot(StoreMemOp->Arg[1]), Indexed ? Slot(StoreMemOp->Arg[2]) : 0);
     break;
-    case IR::OP_BITEXTRACT: {
-      auto BitExtractOp = op->C<IR::IROp_BitExtract>();
-      Values[i] = (Values[BitExtractOp->Args[0]] >> Values[BitExtractOp->Args[1]]) & 1;
     }
+    case IR::OP_SYSCALL: {
+      auto SyscallOp = op->C<IR::IROp_Syscall>();
+      uint64_t ArgsIndex = Block->ExtraArgs.size();
+      for (size_t j = 0; j < IR::IROp_Syscall::MAX_ARGS; ++j)
+        Block->ExtraArgs.emplace_back(Slot(SyscallOp->Arguments[j]));
+      Emit(BC_SYSCALL, Dest, 0, 0, ArgsIndex);
     break;
-    case IR::OP_SELECT: {
-      auto SelectOp = op->C<IR::IROp_Select>();
-      switch (SelectOp->Op) {
-      case IR::IROp_Select::COMP_EQ:
-        Values[i] = Values[SelectOp->Args[0]] == Values[SelectOp->Args[1]] ?
-          Values[SelectOp->Args[2]] : Values[SelectOp->Args[3]];
-        break;
-      case IR::IROp_Select::COMP_NEQ:
-        Values[i] = Values[SelectOp->Args[0]] != Values[SelectOp->Args[1]] ?
-          Values[SelectOp->Args[2]] : Values[SelectOp->Args[3]];
-        break;
-
-      };
     }
+    case IR::OP_FALLBACK:
+      Emit(BC_FALLBACK, Dest, 0, 0, op->C<IR::IROp_Fallback>()->RIP);
     break;
-
-    case IR::OP_TRUNC_32: {
-      auto Trunc_32Op = op->C<IR::IROp_Trunc_32>();
-      Values[i] = Values[Trunc_32Op->Arg] & 0xFFFFFFFFULL;
-    }
+    case IR::OP_RAISE_SIGNAL:
+      Emit(BC_RAISE_SIGNAL, 0, 0, 0, op->C<IR::IROp_RaiseSignal>()->Signal);
     break;
-    case IR::OP_TRUNC_16: {
-      auto Trunc_16Op = op->C<IR::IROp_Trunc_16>();
-      Values[i] = Values[Trunc_16Op->Arg] & 0x0000FFFFULL;
-    }
+    case IR::OP_GET_FLAG:
+      Emit(BC_GET_FLAG, Dest, 0, 0, op->C<IR::IROp_GetFlag>()->Bit);
     break;
-    case IR::OP_LOAD_MEM: {
-      auto LoadMemOp = op->C<IR::IROp_LoadMem>();
-      uint64_t Src = Values[LoadMemOp->Arg[0]];
-      if (LoadMemOp->Arg[1] != ~0)
-        Src += Values[LoadMemOp->Arg[1]];
-
-      void *ptr = cpu->MemoryMapper->GetPointer(Src);
-      switch (LoadMemOp->Size) {
-      case 4:
-        printf("32bit load from %zx(%d)\n", Src, *(uint32_t*)ptr);
-        Values[i] = *(uint32_t*)ptr;
-      break;
-      case 8:
-        Values[i] = *(uint64_t*)ptr;
-      break;
-      default:
-      printf("Unknown LoadSize: %d\n", LoadMemOp->Size);
-      std::abort();
-      break;
-      }
-    }
+    case IR::OP_MATERIALIZE_FLAGS:
+      Emit(BC_MATERIALIZE_FLAGS, 0, 0, 0, 0);
     break;
     default:
-      printf("Unknown IR Op: %d(%s)\n", op->Op, Emu::IR::GetName(op->Op).data());
-      std::abort();
-    break;
+      // Function level ops never come out of the op dispatcher
+      LogMan::Msg::E("Unknown IR Op: %d(%s)", op->Op, IR::GetName(op->Op).data());
+      return nullptr;
     }
+  }
+
+  LogMan::Throw::A(!Block->Code.empty() && Block->Code.back().Handler == Handlers[BC_ENDBLOCK], "Block doesn't end with EndBlock");
 
-    i += opSize;
+  for (auto &Fixup : Fixups) {
+    auto it = TargetIndexes.find(Fixup.second);
+    LogMan::Throw::A(it != TargetIndexes.end() && it->second < Block->Code.size(), "Jump to something that isn't a jump target");
+    Block->Code[Fixup.first].Imm = it->second;
   }
+
+  return Block;
 }
 
 void* Interpreter::CompileCode(Emu::IR::IntrusiveIRList const *ir) {
-  return (void*)TestCompilation;
-};
+  auto Block = Lower(ir);
+  if (!Block)
+    return nullptr;
+
+  std::lock_guard<std::mutex> lk(BlockLock);
+  Blocks.emplace_back(std::move(Block));
+  return Blocks.back().get();
+}
+}
+
+CPUBackend *CreateInterpreterBackend(Emu::CPUCore *CPU) {
+  return new Interpreter(CPU);
+}
+
+void ExecuteInterpreterBlock(Emu::CPUCore *CPU, X86State *State, void const *Block) {
+  Interpret(CPU, State, reinterpret_cast<LoweredBlock const*>(Block));
+}
 }
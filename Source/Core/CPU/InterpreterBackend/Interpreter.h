@@ -2,12 +2,15 @@
 #include "Core/CPU/CPUBackend.h"
 
 namespace Emu {
-class Interpreter final : public CPUBackend {
-public:
-  std::string GetName() override { return "Interpreter"; }
-  void* CompileCode(Emu::IR::IntrusiveIRList const *ir) override;
-private:
+class CPUCore;
+struct X86State;
 
+CPUBackend *CreateInterpreterBackend(Emu::CPUCore *CPU);
 
-};
+/**
+ * @brief Runs a block the interpreter's CompileCode returned
+ *
+ * The backend runs blocks against the current thread's state, this lets anything else pick the state
+ */
+void ExecuteInterpreterBlock(Emu::CPUCore *CPU, X86State *State, void const *Block);
 }
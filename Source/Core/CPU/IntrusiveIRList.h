@@ -41,6 +41,7 @@ public:
 
   IntrusiveIRList&
   operator=(IntrusiveIRList Other) {
+    CurrentOffset = Other.CurrentOffset;
     IRList.resize(Other.CurrentOffset);
     memcpy(&IRList.at(0), &Other.IRList.at(0), Other.CurrentOffset);
     return *this;
@@ -50,15 +51,31 @@ public:
 
   void Reset() { CurrentOffset = 0; }
 
+  /**
+   * @brief Drops every op at or after the offset
+   *
+   * Used by passes that compact the list in place
+   */
+  void Shrink(AlignmentType Offset) { CurrentOffset = Offset; }
+
   IROp_Header const* GetOp(size_t Offset) const {
     return reinterpret_cast<IROp_Header const*>(&IRList.at(Offset));
   }
 
+  IROp_Header *GetOp(size_t Offset) {
+    return reinterpret_cast<IROp_Header*>(&IRList.at(Offset));
+  }
+
   template<class T>
   T const* GetOpAs(size_t Offset) const {
     return reinterpret_cast<T const*>(&IRList.at(Offset));
   }
 
+  template<class T>
+  T *GetOpAs(size_t Offset) {
+    return reinterpret_cast<T*>(&IRList.at(Offset));
+  }
+
   void Dump() const { Emu::IR::Dump(this); }
 
 private:
@@ -1,57 +1,212 @@
+#include "Core/CPU/CodeBuffer.h"
 #include "Core/CPU/CPUCore.h"
+#include "Core/CPU/Flags.h"
+#include "Core/CPU/HostFeatures.h"
 #include "Core/CPU/IR.h"
 #include "Core/CPU/IntrusiveIRList.h"
 #include "LLVM.h"
 #include "LogManager.h"
+#include <atomic>
 #include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
 #include <llvm/InitializePasses.h>
 #include <llvm/LinkAllPasses.h>
 #include <llvm/PassRegistry.h>
-#include <llvm/ExecutionEngine/ExecutionEngine.h>
-#include <llvm/ExecutionEngine/GenericValue.h>
+#include <llvm/Analysis/ScopedNoAliasAA.h>
+#include <llvm/Analysis/TargetTransformInfo.h>
+#include <llvm/Analysis/TypeBasedAliasAnalysis.h>
+#include <llvm/ExecutionEngine/Orc/CompileUtils.h>
+#include <llvm/ExecutionEngine/Orc/JITTargetMachineBuilder.h>
+#include <llvm/ExecutionEngine/Orc/LLJIT.h>
+#include <llvm/ExecutionEngine/Orc/RTDyldObjectLinkingLayer.h>
+#include <llvm/ExecutionEngine/Orc/ThreadSafeModule.h>
+#include <llvm/ExecutionEngine/RTDyldMemoryManager.h>
 #include <llvm/IR/IRBuilder.h>
-#include <llvm/IR/IRPrintingPasses.h>
 #include <llvm/IR/LegacyPassManager.h>
 #include <llvm/IR/LLVMContext.h>
+#include <llvm/IR/MDBuilder.h>
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetSelect.h>
+#include <llvm/Target/TargetMachine.h>
 #include <llvm/Transforms/Scalar.h>
-#include <llvm/Transforms/IPO/PassManagerBuilder.h>
-#include <llvm-c/Core.h>
+#include <llvm/Transforms/Scalar/GVN.h>
 
 using namespace llvm;
 
 namespace Emu {
+constexpr size_t CODE_BUFFER_SIZE = 128 * 1024 * 1024;
+
+/**
+ * @brief Puts each object's code and read only data in the backend's CodeBuffer
+ *
+ * RuntimeDyld writes and relocates through the writable view while the code gets relocated against the executable view.
+ * Each object gets its own manager and its memory goes back to the CodeBuffer when the object is removed
+ */
+class CodeBufferMemoryManager final : public RuntimeDyld::MemoryManager {
+public:
+  explicit CodeBufferMemoryManager(CodeBuffer *Code) : Code {Code} {}
+  ~CodeBufferMemoryManager() override {
+    deregisterEHFrames();
+    for (auto &Section : Sections)
+      Code->Free(Section.Executable);
+  }
+
+  uint8_t *allocateCodeSection(uintptr_t Size, unsigned Alignment, unsigned, StringRef) override {
+    return AllocateSection(Size, Alignment);
+  }
+
+  uint8_t *allocateDataSection(uintptr_t Size, unsigned Alignment, unsigned, StringRef, bool IsReadOnly) override {
+    if (IsReadOnly)
+      return AllocateSection(Size, Alignment);
+
+    // Data the code writes can't live in the executable view
+    Alignment = std::max(Alignment, 16U);
+    auto &Data = WritableData.emplace_back(std::make_unique<uint8_t[]>(Size + Alignment));
+    return reinterpret_cast<uint8_t*>(alignAddr(Data.get(), Align(Alignment)));
+  }
+
+  void notifyObjectLoaded(RuntimeDyld &RTDyld, object::ObjectFile const &) override {
+    for (auto &Section : Sections)
+      RTDyld.mapSectionAddress(Code->GetWritable(Section.Executable), reinterpret_cast<uint64_t>(Section.Executable));
+  }
+
+  bool finalizeMemory(std::string *) override {
+    for (auto &Section : Sections)
+      Code->FlushCache(Section.Executable, Section.Size);
+    return false;
+  }
+
+  void registerEHFrames(uint8_t *, uint64_t LoadAddr, size_t Size) override {
+    // The unwinder reads the frames where they are loaded, their pc relative entries are wrong from the writable view
+    auto Frames = reinterpret_cast<uint8_t*>(LoadAddr);
+    RTDyldMemoryManager::registerEHFramesInProcess(Frames, Size);
+    EHFrames.emplace_back(Frames, Size);
+  }
+
+  void deregisterEHFrames() override {
+    for (auto [Frames, Size] : EHFrames)
+      RTDyldMemoryManager::deregisterEHFramesInProcess(Frames, Size);
+    EHFrames.clear();
+  }
+
+private:
+  uint8_t *AllocateSection(uintptr_t Size, unsigned Alignment) {
+    auto Executable = reinterpret_cast<uint8_t*>(Code->Allocate(Size, std::max(Alignment, 16U)));
+    if (!Executable)
+      return nullptr;
+    Sections.emplace_back(Section{Executable, Size});
+    return Code->GetWritable(Executable);
+  }
+
+  struct Section {
+    uint8_t *Executable;
+    size_t Size;
+  };
+  CodeBuffer *Code;
+  std::vector<Section> Sections;
+  std::vector<std::unique_ptr<uint8_t[]>> WritableData;
+  std::vector<std::pair<uint8_t*, size_t>> EHFrames;
+};
+
 class LLVM final : public CPUBackend {
 public:
-	LLVM(Emu::CPUCore* CPU);
+	LLVM(Emu::CPUCore* CPU, LLVMBackendOptions const &Options);
 	~LLVM();
   std::string GetName() override { return "LLVM"; }
   void* CompileCode(Emu::IR::IntrusiveIRList const *ir) override;
+  void FreeCode(void *Code) override;
+  BlockRunner GetBlockRunner() override { return RunBlock; }
+
+  /**
+   * @brief What CompileCode hands out
+   *
+   * Blocks don't know which thread runs them so every thread shares the one compiled for a RIP.
+   * Promoting a block swaps Code, the older tier stays alive until the block is freed since another thread can still be in it.
+   */
+  using BlockFn = void (*)(X86State *State, uint8_t *MemBase);
+  struct CompiledBlock {
+    LLVM *Backend;
+    std::atomic<BlockFn> Code;
+    std::atomic<uint32_t> Runs{};
+    uint64_t GuestRIP;
+    uint32_t Refs;
+    std::atomic<bool> Promoted;
+    // Kept for the recompile when tiering
+    std::unique_ptr<IR::IntrusiveIRList> IR;
+    std::vector<llvm::orc::ResourceTrackerSP> Trackers;
+  };
+
+  static void RunBlock(CPUCore *CPU, void *Block) {
+    ExecuteLLVMBlock(CPU, &CPU->GetTLSThread()->CPUState, Block);
+  }
+  void PromoteBlock(CompiledBlock *Block);
+
+  LLVMBackendOptions const Options;
 
 private:
-  void CreateGlobalVariables(llvm::ExecutionEngine *engine, llvm::Module *module);
+  void CreateGlobalTypes();
+  void DeclareHelpers(llvm::Module *module);
   llvm::Value *CreateContextGEP(uint64_t Offset);
+  void TagContextAccess(llvm::Instruction *Inst, uint64_t Offset);
+  void TagMemoryAccess(llvm::Instruction *Inst);
+  llvm::Type *GetMemoryType(uint8_t Size);
+  llvm::Value *CreateMemoryGEP(IR::AlignmentType Address, IR::AlignmentType Index, llvm::Type *AccessType);
+  llvm::Value *CreateCompare(IR::IROp_Select::ComparisonOp Comparison, llvm::Value *Src1, llvm::Value *Src2);
   void HandleIR(uint64_t Offset, IR::IROp_Header const* op);
   std::map<uint64_t, llvm::Value*> Values;
+
+  // Has to outlive the JIT, removing a block's objects frees their code
+  CodeBuffer Code{CODE_BUFFER_SIZE};
+  // One JIT for every block, each block gets its own module and resource tracker
+  std::unique_ptr<llvm::orc::LLJIT> JIT;
+  // Shared by the optimizer and code generation
+  std::unique_ptr<llvm::TargetMachine> TM;
+  llvm::orc::ThreadSafeContext TSContext;
   llvm::LLVMContext *con;
-  LLVMContextRef conref;
-	llvm::Module *mainmodule;
-  llvm::IRBuilder<> *builder;
-  std::vector<llvm::ExecutionEngine*> functions;
+  std::unique_ptr<llvm::IRBuilder<>> builder;
   Emu::CPUCore *cpu;
 
+  // The context and builder are shared, only one block compiles at a time
+  std::mutex CompileLock;
+
+  std::unordered_map<uint64_t, std::unique_ptr<CompiledBlock>> BlocksByRIP;
+
+  BlockFn Compile(Emu::IR::IntrusiveIRList const *ir, uint64_t GuestRIP, LLVMPipeline Pipeline, CompiledBlock *Block);
+  void Optimize(llvm::Module *module, LLVMPipeline Pipeline);
+
   struct GlobalState {
     // CPUState
-    llvm::Type *cpustatetype;
-    GlobalVariable *cpustatevar;
-    llvm::LoadInst *cpustate;
+    llvm::StructType *cpustatetype;
+    // Arguments of the block being compiled
+    llvm::Value *cpustate;
+    llvm::Value *membase;
+
+    // Helpers that blocks call, their addresses are defined once in the JITDylib
+    llvm::FunctionType *syscalltype;
+    llvm::FunctionType *getflagtype;
+    llvm::FunctionType *materializeflagstype;
+    llvm::FunctionType *fallbacktype;
+    llvm::FunctionType *raisesignaltype;
+    llvm::FunctionType *longdividetype;
     llvm::Function *syscallfunction;
-    llvm::Function *loadmem4function;
-    llvm::Function *loadmem8function;
+    llvm::Function *getflagfunction;
+    llvm::Function *materializeflagsfunction;
+    llvm::Function *fallbackfunction;
+    llvm::Function *raisesignalfunction;
+    llvm::Function *longdividefunction;
+    llvm::Function *longremainderfunction;
+
+    // Alias metadata, every X86State field and guest memory are disjoint from each other
+    llvm::MDNode *tbaaroot;
+    llvm::MDNode *memorytbaa;
+    std::unordered_map<uint64_t, llvm::MDNode*> contexttbaa;
+    llvm::MDNode *statescope;
+    llvm::MDNode *memoryscope;
   };
   GlobalState state;
   llvm::Function *func;
@@ -60,36 +215,97 @@ private:
   std::unordered_map<uint64_t, BasicBlock*> BlockJumpTargets;
 
   uint64_t CurrentRIP{0};
-  void FindJumpTargets(Emu::IR::IntrusiveIRList const *ir);
+  void FindJumpTargets(Emu::IR::IntrusiveIRList const *ir, uint64_t GuestRIP);
 };
 
-LLVM::LLVM(Emu::CPUCore *CPU)
-  : cpu {CPU} {
-	using namespace llvm;
-	InitializeNativeTarget();
-	InitializeNativeTargetAsmPrinter();
-	conref = LLVMContextCreate();
-  con = *llvm::unwrap(&conref);
-	mainmodule = new llvm::Module("Main Module", *con);
-  builder = new IRBuilder<>(*con);
+// The handler can write the thread's state (arch_prctl), blocks pass State so the optimizer knows the call may touch it
+static uint64_t SyscallThunk(SyscallHandler *Handler, SyscallHandler::SyscallArguments *Args, X86State *) {
+  return Handler->HandleSyscall(Args);
 }
 
-LLVM::~LLVM() {
-  delete builder;
-  for (auto module : functions)
-    delete module;
-	LLVMContextDispose(conref);
+static uint64_t FallbackThunk(CPUCore *CPU, X86State *State, uint64_t RIP) {
+  return CPU->FallbackInstruction(State, RIP);
+}
+
+static void RaiseSignalThunk(CPUCore *CPU, X86State *State, uint64_t Signal) {
+  CPU->RaiseSignal(State, Signal);
 }
 
-static uint64_t LoadMem4(CPUCore *cpu, uint64_t Offset) {
-  return *cpu->MemoryMapper->GetBaseOffset<uint32_t*>(Offset);
+// An i128 divide would call in to compiler-rt's full 128/128 divide, the high half is known to be below the divisor here
+static uint64_t LongDivideThunk(uint64_t Low, uint64_t High, uint64_t Divisor) {
+  return ((static_cast<unsigned __int128>(High) << 64) | Low) / Divisor;
 }
 
-static uint64_t LoadMem8(CPUCore *cpu, uint64_t Offset) {
-  return *cpu->MemoryMapper->GetBaseOffset<uint64_t*>(Offset);
+static uint64_t LongRemainderThunk(uint64_t Low, uint64_t High, uint64_t Divisor) {
+  return ((static_cast<unsigned __int128>(High) << 64) | Low) % Divisor;
 }
 
-void LLVM::CreateGlobalVariables(llvm::ExecutionEngine *engine, llvm::Module *module) {
+LLVM::LLVM(Emu::CPUCore *CPU, LLVMBackendOptions const &Options)
+  : Options {Options}
+  , TSContext {std::make_unique<llvm::LLVMContext>()}
+  , con {TSContext.getContext()}
+  , builder {std::make_unique<IRBuilder<>>(*con)}
+  , cpu {CPU} {
+	using namespace llvm;
+	InitializeNativeTarget();
+	InitializeNativeTargetAsmPrinter();
+
+  // detectHost asks LLVM for the host CPU and its features
+  auto JTMB = cantFail(orc::JITTargetMachineBuilder::detectHost());
+  if (!Options.CPU.empty()) {
+    // The named CPU implies its own features, the host's would leak in to benchmarks otherwise
+    JTMB.setCPU(Options.CPU);
+    JTMB.getFeatures() = SubtargetFeatures();
+  }
+#if defined(__x86_64__)
+  // The native backends and LLVM agree on what the host can do, including any overrides
+  auto &Features = GetHostFeatures();
+  for (auto [Name, Supported] : {
+      std::make_pair("popcnt", Features.SupportsPOPCNT),
+      std::make_pair("lzcnt", Features.SupportsLZCNT),
+      std::make_pair("bmi", Features.SupportsBMI1),
+      std::make_pair("bmi2", Features.SupportsBMI2),
+      std::make_pair("avx2", Features.SupportsAVX2)}) {
+    JTMB.getFeatures().AddFeature(Name, Supported);
+  }
+#endif
+  TM = cantFail(JTMB.createTargetMachine());
+
+  // Compile on the calling thread with our TargetMachine instead of LLJIT creating its own
+  // Its codegen level is set per block, so the lookup that compiles has to happen under the CompileLock
+  JIT = cantFail(orc::LLJITBuilder()
+    .setJITTargetMachineBuilder(std::move(JTMB))
+    .setObjectLinkingLayerCreator([this](orc::ExecutionSession &ES, Triple const &) -> Expected<std::unique_ptr<orc::ObjectLayer>> {
+      return std::make_unique<orc::RTDyldObjectLinkingLayer>(ES, [this]() {
+        return std::make_unique<CodeBufferMemoryManager>(&Code);
+      });
+    })
+    .setCompileFunctionCreator([this](orc::JITTargetMachineBuilder) -> Expected<std::unique_ptr<orc::IRCompileLayer::IRCompiler>> {
+      return std::make_unique<orc::SimpleCompiler>(*TM);
+    })
+    .create());
+
+  orc::MangleAndInterner Mangle(JIT->getExecutionSession(), JIT->getDataLayout());
+  cantFail(JIT->getMainJITDylib().define(orc::absoluteSymbols({
+    {Mangle("Syscall"), JITEvaluatedSymbol::fromPointer(SyscallThunk, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("GetFlag"), JITEvaluatedSymbol::fromPointer(Flags::GetFlag, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("MaterializeFlags"), JITEvaluatedSymbol::fromPointer(Flags::Materialize, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("Fallback"), JITEvaluatedSymbol::fromPointer(FallbackThunk, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("RaiseSignal"), JITEvaluatedSymbol::fromPointer(RaiseSignalThunk, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("LongDivide"), JITEvaluatedSymbol::fromPointer(LongDivideThunk, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+    {Mangle("LongRemainder"), JITEvaluatedSymbol::fromPointer(LongRemainderThunk, JITSymbolFlags::Exported | JITSymbolFlags::Callable)},
+  })));
+
+  CreateGlobalTypes();
+}
+
+LLVM::~LLVM() {
+  // Trackers reference the JIT's session and the code has to go before the context its modules were created in
+  BlocksByRIP.clear();
+  JIT.reset();
+}
+
+void LLVM::CreateGlobalTypes() {
   // CPUState types
   Type *i64 = Type::getInt64Ty(*con);
 
@@ -99,6 +315,12 @@ void LLVM::CreateGlobalVariables(llvm::ExecutionEngine *engine, llvm::Module *mo
   //uint64_t xmm[16][2];
   //uint64_t gs;
   //uint64_t fs;
+  //uint64_t rflags;
+  //uint64_t flags_op;
+  //uint64_t flags_size;
+  //uint64_t flags_src1;
+  //uint64_t flags_src2;
+  //uint64_t flags_res;
   state.cpustatetype = StructType::create(*con,
       {
         i64, // RIP
@@ -107,59 +329,175 @@ void LLVM::CreateGlobalVariables(llvm::ExecutionEngine *engine, llvm::Module *mo
         i64,
         i64,
         i64,
-      });
-  module->getOrInsertGlobal("X86StateGlobal", state.cpustatetype->getPointerTo());
-  state.cpustatevar = module->getNamedGlobal("X86StateGlobal");
-  state.cpustatevar->setInitializer(ConstantInt::getIntegerValue(state.cpustatetype->getPointerTo(), APInt(64, (uint64_t)&cpu->ParentThread->CPUState)));
-  state.cpustate = builder->CreateLoad(state.cpustatevar, builder->getInt32(0), "X86State");
+        i64,
+        i64,
+        i64,
+        i64,
+        i64,
+      }, "X86State");
 
-  {
 //  struct SyscallArguments {
 //    static constexpr std::size_t MAX_ARGS = 7;
 //    uint64_t Argument[MAX_ARGS];
 //  };
+  state.syscalltype = FunctionType::get(i64,
+      {
+        i64,
+        ArrayType::get(i64, SyscallHandler::SyscallArguments::MAX_ARGS)->getPointerTo(),
+        state.cpustatetype->getPointerTo(),
+      },
+      false);
 
-    auto functype = FunctionType::get(i64,
-        {
-          i64,
-          ArrayType::get(i64, SyscallHandler::SyscallArguments::MAX_ARGS)->getPointerTo(),
-        },
-        false);
-    state.syscallfunction = Function::Create(functype,
-        Function::ExternalLinkage,
-        "Syscall",
-        module);
-
-    using ClassPtr = uint64_t (Emu::SyscallHandler::*)(SyscallHandler::SyscallArguments *Args);
-    union Test{
-      ClassPtr ClassData;
-      void* Data;
-    };
-    Test A;
-    A.ClassData = &Emu::SyscallHandler::HandleSyscall;
-    engine->addGlobalMapping(state.syscallfunction, A.Data);
-
-  auto loadmemfunctype = FunctionType::get(i64,
-        {
-          i64,
-          i64,
-        },
-        false);
-
-    state.loadmem4function = Function::Create(loadmemfunctype,
-        Function::ExternalLinkage,
-        "LoadMem4",
-        module);
-    engine->addGlobalMapping(state.loadmem4function, (void*)LoadMem4);
-
-    state.loadmem8function = Function::Create(loadmemfunctype,
-        Function::ExternalLinkage,
-        "LoadMem8",
-        module);
-    engine->addGlobalMapping(state.loadmem8function, (void*)LoadMem8);
+  state.getflagtype = FunctionType::get(i64,
+      {
+        state.cpustatetype->getPointerTo(),
+        Type::getInt32Ty(*con),
+      },
+      false);
+
+  state.materializeflagstype = FunctionType::get(Type::getVoidTy(*con),
+      {
+        state.cpustatetype->getPointerTo(),
+      },
+      false);
+
+  state.fallbacktype = FunctionType::get(i64,
+      {
+        i64,
+        state.cpustatetype->getPointerTo(),
+        i64,
+      },
+      false);
+
+  state.raisesignaltype = FunctionType::get(Type::getVoidTy(*con),
+      {
+        i64,
+        state.cpustatetype->getPointerTo(),
+        i64,
+      },
+      false);
+
+  state.longdividetype = FunctionType::get(i64,
+      {
+        i64,
+        i64,
+        i64,
+      },
+      false);
+
+  MDBuilder MDB(*con);
+  state.tbaaroot = MDB.createTBAARoot("X86Emu TBAA");
+  auto MemoryType = MDB.createTBAAScalarTypeNode("guest memory", state.tbaaroot);
+  state.memorytbaa = MDB.createTBAAStructTagNode(MemoryType, MemoryType, 0);
+
+  auto Domain = MDB.createAnonymousAliasScopeDomain("Block");
+  state.statescope = MDNode::get(*con, MDB.createAnonymousAliasScope(Domain, "X86State"));
+  state.memoryscope = MDNode::get(*con, MDB.createAnonymousAliasScope(Domain, "Guest memory"));
+}
+
+llvm::Type *LLVM::GetMemoryType(uint8_t Size) {
+  switch (Size) {
+  case 1: return Type::getInt8Ty(*con);
+  case 2: return Type::getInt16Ty(*con);
+  case 4: return Type::getInt32Ty(*con);
+  case 8: return Type::getInt64Ty(*con);
+  default:
+    printf("Unknown memory access size: %d\n", Size);
+    std::abort();
+    return nullptr;
   }
 }
 
+llvm::Value *LLVM::CreateMemoryGEP(IR::AlignmentType Address, IR::AlignmentType Index, llvm::Type *AccessType) {
+  // Guest addresses are offsets from the memory base
+  Value *Src = Values[Address];
+  if (Index != ~0U)
+    Src = builder->CreateAdd(Src, Values[Index]);
+  Src = builder->CreateGEP(builder->getInt8Ty(), state.membase, Src);
+  return builder->CreateBitCast(Src, AccessType->getPointerTo());
+}
+
+llvm::Value *LLVM::CreateCompare(IR::IROp_Select::ComparisonOp Comparison, llvm::Value *Src1, llvm::Value *Src2) {
+  CmpInst::Predicate Predicate;
+  switch (Comparison) {
+  case IR::IROp_Select::COMP_EQ: Predicate = CmpInst::ICMP_EQ; break;
+  case IR::IROp_Select::COMP_NEQ: Predicate = CmpInst::ICMP_NE; break;
+  case IR::IROp_Select::COMP_SLT: Predicate = CmpInst::ICMP_SLT; break;
+  case IR::IROp_Select::COMP_SLE: Predicate = CmpInst::ICMP_SLE; break;
+  case IR::IROp_Select::COMP_SGT: Predicate = CmpInst::ICMP_SGT; break;
+  case IR::IROp_Select::COMP_SGE: Predicate = CmpInst::ICMP_SGE; break;
+  case IR::IROp_Select::COMP_ULT: Predicate = CmpInst::ICMP_ULT; break;
+  case IR::IROp_Select::COMP_ULE: Predicate = CmpInst::ICMP_ULE; break;
+  case IR::IROp_Select::COMP_UGT: Predicate = CmpInst::ICMP_UGT; break;
+  case IR::IROp_Select::COMP_UGE: Predicate = CmpInst::ICMP_UGE; break;
+  default:
+    printf("Unknown comparison case\n");
+    std::abort();
+    break;
+  }
+  return builder->CreateICmp(Predicate, Src1, Src2);
+}
+
+void LLVM::TagContextAccess(llvm::Instruction *Inst, uint64_t Offset) {
+  // Each field gets its own type so an access to one never aliases another
+  auto &Tag = state.contexttbaa[Offset];
+  if (!Tag) {
+    MDBuilder MDB(*con);
+    auto FieldType = MDB.createTBAAScalarTypeNode("X86State+" + std::to_string(Offset), state.tbaaroot);
+    Tag = MDB.createTBAAStructTagNode(FieldType, FieldType, 0);
+  }
+  Inst->setMetadata(LLVMContext::MD_tbaa, Tag);
+  Inst->setMetadata(LLVMContext::MD_alias_scope, state.statescope);
+  Inst->setMetadata(LLVMContext::MD_noalias, state.memoryscope);
+}
+
+void LLVM::TagMemoryAccess(llvm::Instruction *Inst) {
+  Inst->setMetadata(LLVMContext::MD_tbaa, state.memorytbaa);
+  Inst->setMetadata(LLVMContext::MD_alias_scope, state.memoryscope);
+  Inst->setMetadata(LLVMContext::MD_noalias, state.statescope);
+}
+
+void LLVM::DeclareHelpers(llvm::Module *module) {
+  // Declarations are per module, the addresses come from the JITDylib
+  state.syscallfunction = Function::Create(state.syscalltype,
+      Function::ExternalLinkage,
+      "Syscall",
+      module);
+
+  state.getflagfunction = Function::Create(state.getflagtype,
+      Function::ExternalLinkage,
+      "GetFlag",
+      module);
+  state.getflagfunction->setOnlyReadsMemory();
+
+  state.materializeflagsfunction = Function::Create(state.materializeflagstype,
+      Function::ExternalLinkage,
+      "MaterializeFlags",
+      module);
+
+  state.fallbackfunction = Function::Create(state.fallbacktype,
+      Function::ExternalLinkage,
+      "Fallback",
+      module);
+
+  state.raisesignalfunction = Function::Create(state.raisesignaltype,
+      Function::ExternalLinkage,
+      "RaiseSignal",
+      module);
+
+  state.longdividefunction = Function::Create(state.longdividetype,
+      Function::ExternalLinkage,
+      "LongDivide",
+      module);
+  state.longdividefunction->setDoesNotAccessMemory();
+
+  state.longremainderfunction = Function::Create(state.longdividetype,
+      Function::ExternalLinkage,
+      "LongRemainder",
+      module);
+  state.longremainderfunction->setDoesNotAccessMemory();
+}
+
 llvm::Value *LLVM::CreateContextGEP(uint64_t Offset) {
   std::vector<llvm::Value*> gepvalues = {
     builder->getInt32(0), // "first" instance of cpustate
@@ -180,10 +518,13 @@ llvm::Value *LLVM::CreateContextGEP(uint64_t Offset) {
   else if (Offset == offsetof(X86State, rflags)) {
     gepvalues.emplace_back(builder->getInt32(5));
   }
+  else if (Offset >= offsetof(X86State, flags_op) && Offset <= offsetof(X86State, flags_res)) {
+    gepvalues.emplace_back(builder->getInt32(6 + (Offset - offsetof(X86State, flags_op)) / 8));
+  }
   else
     std::abort();
 
-  auto gep = builder->CreateGEP(state.cpustate, gepvalues, "Context");
+  auto gep = builder->CreateGEP(state.cpustatetype, state.cpustate, gepvalues, "Context");
   return gep;
 }
 
@@ -205,20 +546,20 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
 
       builder->SetInsertPoint(NewBlock);
       BlockJumpTargets[CurrentRIP] = NewBlock;
-      printf("\tAdding Block Target: %zx\n", CurrentRIP);
     }
   break;
   }
   case IR::OP_ENDBLOCK: {
     auto EndOp = op->C<IR::IROp_EndBlock>();
-    auto downcountValue = builder->CreateGEP(state.cpustate,
+    auto downcountValue = builder->CreateGEP(state.cpustatetype, state.cpustate,
         {
           builder->getInt32(0),
           builder->getInt32(0),
         }, "RIP");
-    auto load = builder->CreateLoad(downcountValue);
+    auto load = builder->CreateLoad(builder->getInt64Ty(), downcountValue);
+    TagContextAccess(load, offsetof(X86State, rip));
     auto newvalue = builder->CreateAdd(load, builder->getInt64(EndOp->RIPIncrement));
-    builder->CreateStore(newvalue, downcountValue);
+    TagContextAccess(builder->CreateStore(newvalue, downcountValue), offsetof(X86State, rip));
     builder->CreateRetVoid();
 
     // If we are at the end of a block and we have blocks in our stack then change over to that as an active block
@@ -229,34 +570,32 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
   break;
   }
   case IR::OP_JUMP_TGT:
-    printf("Landed on jump target\n");
   break;
   case IR::OP_COND_JUMP: {
     // Conditional jump
     // if the value is true then it'll jump to the target
-    // if the value is false then it'll fall through
+    // if the value is false then it'll fall through in to the exit path
     auto JumpOp = op->C<IR::IROp_CondJump>();
 
-    auto TruePath = BasicBlock::Create(*con, "true", func);
-    auto FalsePath = BasicBlock::Create(*con, "false", func);
+    auto ExitPath = BasicBlock::Create(*con, "exit", func);
+    auto ContinuePath = BasicBlock::Create(*con, "continue", func);
 
-    auto Comp = builder->CreateICmpNE(Values[JumpOp->Cond], builder->getInt64(0));
+    auto Comp = CreateCompare(JumpOp->Cond, Values[JumpOp->Args[0]], Values[JumpOp->Args[1]]);
 
-    printf("\tJUMP wanting to go to RIP: 0x%zx\n", JumpOp->RIPTarget);
+    // The ops up to the next EndBlock are the exit path that only runs when the condition is false
     auto target = BlockJumpTargets.find(JumpOp->RIPTarget);
     if (target != BlockJumpTargets.end()) {
-      printf("\tCOND JUMP Has a found rip target!\n");
-      builder->CreateCondBr(Comp, target->second, FalsePath);
-      builder->SetInsertPoint(TruePath);
+      builder->CreateCondBr(Comp, ContinuePath, target->second);
+      builder->SetInsertPoint(ExitPath);
     } else {
 
-      builder->CreateCondBr(Comp, TruePath, FalsePath);
+      builder->CreateCondBr(Comp, ContinuePath, ExitPath);
 
-      builder->SetInsertPoint(TruePath);
+      builder->SetInsertPoint(ExitPath);
     }
 
     // Will create a dead block for us in the case we have a real target
-    BlockStack.emplace_back(FalsePath);
+    BlockStack.emplace_back(ContinuePath);
 
   }
   break;
@@ -271,9 +610,10 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
     std::vector<Value*> Args;
     Args.emplace_back(builder->getInt64((uint64_t)&cpu->syscallhandler));
 
-    auto args = builder->CreateAlloca(ArrayType::get(Type::getInt64Ty(*con), SyscallHandler::SyscallArguments::MAX_ARGS));
-    for (int i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i) {
-      auto location = builder->CreateGEP(args,
+    auto argstype = ArrayType::get(Type::getInt64Ty(*con), SyscallHandler::SyscallArguments::MAX_ARGS);
+    auto args = builder->CreateAlloca(argstype);
+    for (size_t i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i) {
+      auto location = builder->CreateGEP(argstype, args,
           {
             builder->getInt32(0),
             builder->getInt32(i),
@@ -282,17 +622,38 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
       builder->CreateStore(Values[SyscallOp->Arguments[i]], location);
     }
     Args.emplace_back(args);
+    Args.emplace_back(state.cpustate);
 
     Values[Offset] = builder->CreateCall(state.syscallfunction, Args);
   break;
   }
+  case IR::OP_FALLBACK: {
+    auto FallbackOp = op->C<IR::IROp_Fallback>();
+    Values[Offset] = builder->CreateCall(state.fallbackfunction,
+      {
+        builder->getInt64((uint64_t)cpu),
+        state.cpustate,
+        builder->getInt64(FallbackOp->RIP),
+      });
+  break;
+  }
+  case IR::OP_RAISE_SIGNAL: {
+    builder->CreateCall(state.raisesignalfunction,
+      {
+        builder->getInt64((uint64_t)cpu),
+        state.cpustate,
+        builder->getInt64(op->C<IR::IROp_RaiseSignal>()->Signal),
+      });
+  break;
+  }
 
   case IR::OP_LOADCONTEXT: {
     auto LoadOp = op->C<IR::IROp_LoadContext>();
     LogMan::Throw::A(LoadOp->Size == 8, "Can only handle 8 byte");
 
     auto Value = CreateContextGEP(LoadOp->Offset);
-    auto load = builder->CreateLoad(Value);
+    auto load = builder->CreateLoad(builder->getInt64Ty(), Value);
+    TagContextAccess(load, LoadOp->Offset);
     Values[Offset] = load;
   }
   break;
@@ -301,7 +662,7 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
     LogMan::Throw::A(StoreOp->Size == 8, "Can only handle 8 byte");
 
     auto Value = CreateContextGEP(StoreOp->Offset);
-    builder->CreateStore(Values[StoreOp->Arg], Value);
+    TagContextAccess(builder->CreateStore(Values[StoreOp->Arg], Value), StoreOp->Offset);
   }
   break;
   case IR::OP_ADD: {
@@ -334,6 +695,11 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
     Values[Offset] = builder->CreateLShr(Values[ShrOp->Args[0]], Values[ShrOp->Args[1]]);
   }
   break;
+  case IR::OP_ASHR: {
+    auto AshrOp = op->C<IR::IROp_Ashr>();
+    Values[Offset] = builder->CreateAShr(Values[AshrOp->Args[0]], Values[AshrOp->Args[1]]);
+  }
+  break;
   case IR::OP_AND: {
     auto AndOp = op->C<IR::IROp_And>();
     Values[Offset] = builder->CreateAnd(Values[AndOp->Args[0]], Values[AndOp->Args[1]]);
@@ -346,19 +712,7 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
   break;
   case IR::OP_SELECT: {
     auto SelectOp = op->C<IR::IROp_Select>();
-    Value *Comp;
-    switch (SelectOp->Op) {
-    case IR::IROp_Select::COMP_EQ:
-      Comp = builder->CreateICmpEQ(Values[SelectOp->Args[0]], Values[SelectOp->Args[1]]);
-      break;
-    case IR::IROp_Select::COMP_NEQ:
-      Comp = builder->CreateICmpNE(Values[SelectOp->Args[0]], Values[SelectOp->Args[1]]);
-      break;
-    default:
-      printf("Unknown comparison case\n");
-      std::abort();
-      break;
-    };
+    auto Comp = CreateCompare(SelectOp->Op, Values[SelectOp->Args[0]], Values[SelectOp->Args[1]]);
     Values[Offset] = builder->CreateSelect(Comp, Values[SelectOp->Args[2]], Values[SelectOp->Args[3]]);
   }
   break;
@@ -369,6 +723,53 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
     Values[Offset] = Mask;
   }
   break;
+  case IR::OP_MUL: {
+    auto MulOp = op->C<IR::IROp_Mul>();
+    Values[Offset] = builder->CreateMul(Values[MulOp->Args[0]], Values[MulOp->Args[1]]);
+  }
+  break;
+  case IR::OP_UMULH:
+  case IR::OP_SMULH: {
+    auto MulHOp = op->C<IR::IROp_BiOp>();
+    auto Int128 = Type::getInt128Ty(*con);
+    bool Signed = op->Op == IR::OP_SMULH;
+    auto Src1 = builder->CreateIntCast(Values[MulHOp->Args[0]], Int128, Signed);
+    auto Src2 = builder->CreateIntCast(Values[MulHOp->Args[1]], Int128, Signed);
+    auto High = builder->CreateLShr(builder->CreateMul(Src1, Src2), 64);
+    Values[Offset] = builder->CreateTrunc(High, Type::getInt64Ty(*con));
+  }
+  break;
+  case IR::OP_UDIV: {
+    auto UDivOp = op->C<IR::IROp_UDiv>();
+    Values[Offset] = builder->CreateUDiv(Values[UDivOp->Args[0]], Values[UDivOp->Args[1]]);
+  }
+  break;
+  case IR::OP_SDIV: {
+    auto SDivOp = op->C<IR::IROp_SDiv>();
+    Values[Offset] = builder->CreateSDiv(Values[SDivOp->Args[0]], Values[SDivOp->Args[1]]);
+  }
+  break;
+  case IR::OP_UREM: {
+    auto URemOp = op->C<IR::IROp_URem>();
+    Values[Offset] = builder->CreateURem(Values[URemOp->Args[0]], Values[URemOp->Args[1]]);
+  }
+  break;
+  case IR::OP_SREM: {
+    auto SRemOp = op->C<IR::IROp_SRem>();
+    Values[Offset] = builder->CreateSRem(Values[SRemOp->Args[0]], Values[SRemOp->Args[1]]);
+  }
+  break;
+  case IR::OP_LUDIV:
+  case IR::OP_LUREM: {
+    auto TriOp = op->C<IR::IROp_TriOp>();
+    Values[Offset] = builder->CreateCall(op->Op == IR::OP_LUDIV ? state.longdividefunction : state.longremainderfunction,
+      {
+        Values[TriOp->Args[0]],
+        Values[TriOp->Args[1]],
+        Values[TriOp->Args[2]],
+      });
+  }
+  break;
   case IR::OP_TRUNC_32: {
     auto Trunc_32Op = op->C<IR::IROp_Trunc_32>();
     auto Arg = builder->CreateTrunc(Values[Trunc_32Op->Arg], Type::getInt32Ty(*con));
@@ -376,45 +777,46 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
     Values[Offset] = Arg;
   }
   break;
+  case IR::OP_TRUNC_16: {
+    auto Trunc_16Op = op->C<IR::IROp_Trunc_16>();
+    auto Arg = builder->CreateTrunc(Values[Trunc_16Op->Arg], Type::getInt16Ty(*con));
+    Arg = builder->CreateZExt(Arg, Type::getInt64Ty(*con));
+    Values[Offset] = Arg;
+  }
+  break;
   case IR::OP_LOAD_MEM: {
     auto LoadMemOp = op->C<IR::IROp_LoadMem>();
-    Value *Src = Values[LoadMemOp->Arg[0]];
-    if (LoadMemOp->Arg[1] != ~0)
-      Src = builder->CreateAdd(Src, Values[LoadMemOp->Arg[1]]);
-#if 0
-    std::vector<Value*> Args;
-    Args.emplace_back(builder->getInt64((uint64_t)cpu));
-    Args.emplace_back(Src);
-
-    switch (LoadMemOp->Size) {
-    case 4:
-      Values[Offset] = builder->CreateCall(state.loadmem4function, Args);
-    break;
-    case 8:
-      Values[Offset] = builder->CreateCall(state.loadmem8function, Args);
-    break;
-    default:
-    printf("Unknown LoadSize: %d\n", LoadMemOp->Size);
-    std::abort();
-    break;
+    auto LoadType = GetMemoryType(LoadMemOp->Size);
+    auto load = builder->CreateLoad(LoadType, CreateMemoryGEP(LoadMemOp->Arg[0], LoadMemOp->Arg[1], LoadType));
+    TagMemoryAccess(load);
+    Values[Offset] = load;
+    // Smaller loads are zero extended like everything else in the IR, unless they asked for the sign
+    if (LoadMemOp->Size != 8) {
+      if (LoadMemOp->SignExtend)
+        Values[Offset] = builder->CreateSExt(Values[Offset], Type::getInt64Ty(*con));
+      else
+        Values[Offset] = builder->CreateZExt(Values[Offset], Type::getInt64Ty(*con));
     }
-#else
-    Src = builder->CreateAdd(Src, builder->getInt64(cpu->MemoryMapper->GetBaseOffset<uint64_t>(0)));
+  }
+  break;
+  case IR::OP_STORE_MEM: {
+    auto StoreMemOp = op->C<IR::IROp_StoreMem>();
+    auto StoreType = GetMemoryType(StoreMemOp->Size);
+    Value *Src = Values[StoreMemOp->Arg[0]];
+    if (StoreMemOp->Size != 8)
+      Src = builder->CreateTrunc(Src, StoreType);
+    auto store = builder->CreateStore(Src, CreateMemoryGEP(StoreMemOp->Arg[1], StoreMemOp->Arg[2], StoreType));
+    TagMemoryAccess(store);
+  }
+  break;
 
-    switch (LoadMemOp->Size) {
-    case 4:
-      Src = builder->CreateIntToPtr(Src, Type::getInt32PtrTy(*con));
-    break;
-    case 8:
-      Src = builder->CreateIntToPtr(Src, Type::getInt64PtrTy(*con));
-    break;
-    default:
-    printf("Unknown LoadSize: %d\n", LoadMemOp->Size);
-    std::abort();
-    break;
-    }
-    Values[Offset] = builder->CreateLoad(Src);
-#endif
+  case IR::OP_GET_FLAG: {
+    auto GetFlagOp = op->C<IR::IROp_GetFlag>();
+    Values[Offset] = builder->CreateCall(state.getflagfunction, {state.cpustate, builder->getInt32(GetFlagOp->Bit)});
+  }
+  break;
+  case IR::OP_MATERIALIZE_FLAGS: {
+    builder->CreateCall(state.materializeflagsfunction, {state.cpustate});
   }
   break;
 
@@ -425,12 +827,11 @@ void LLVM::HandleIR(uint64_t Offset, IR::IROp_Header const* op) {
   }
 }
 
-void LLVM::FindJumpTargets(Emu::IR::IntrusiveIRList const *ir) {
+void LLVM::FindJumpTargets(Emu::IR::IntrusiveIRList const *ir, uint64_t GuestRIP) {
   auto Size = ir->GetOffset();
   uint64_t i = 0;
 
-  //printf("New Jump Target! Block: 0x%zx\n", cpu->ParentThread->CPUState.rip);
-  uint64_t LocalRIP = cpu->ParentThread->CPUState.rip;
+  uint64_t LocalRIP = GuestRIP;
 
   // Walk through ops and remember IR Jump Targets
   std::unordered_map<IR::AlignmentType, bool> IRTargets;
@@ -440,8 +841,6 @@ void LLVM::FindJumpTargets(Emu::IR::IntrusiveIRList const *ir) {
       auto JumpOp = op->C<IR::IROp_CondJump>();
       IRTargets[JumpOp->Target] = true;
       JumpTargets[JumpOp->RIPTarget] = true;
-      printf("\tAdding JumpTarget(COND_TGT): %zx\n", JumpOp->RIPTarget);
-
     }
     i += Emu::IR::GetSize(op->Op);
   }
@@ -455,13 +854,11 @@ void LLVM::FindJumpTargets(Emu::IR::IntrusiveIRList const *ir) {
     }
     else if (op->Op == IR::OP_JUMP_TGT) {
       JumpTargets[LocalRIP] = true;
-      printf("\tAdding JumpTarget(TGT): %zx\n", LocalRIP);
     }
 
     // If this IR Op is a jump target
     if (IRTargets.find(i) != IRTargets.end()) {
       JumpTargets[LocalRIP] = true;
-      printf("\tAdding JumpTarget(IRTGT): %zx\n", LocalRIP);
     }
     i += Emu::IR::GetSize(op->Op);
   }
@@ -469,102 +866,194 @@ void LLVM::FindJumpTargets(Emu::IR::IntrusiveIRList const *ir) {
 }
 
 void* LLVM::CompileCode(Emu::IR::IntrusiveIRList const *ir) {
+  std::lock_guard<std::mutex> lk(CompileLock);
+
+  // Blocks start at their first instruction's marker, that lets anyone compile one without being the guest thread
+  uint64_t GuestRIP = 0;
+  for (size_t i = 0; i != ir->GetOffset(); i += Emu::IR::GetSize(ir->GetOp(i)->Op)) {
+    auto op = ir->GetOp(i);
+    if (op->Op == IR::OP_RIP_MARKER) {
+      GuestRIP = op->C<IR::IROp_RIPMarker>()->RIP;
+      break;
+    }
+  }
+
+  // Another thread already compiled this RIP
+  auto Existing = BlocksByRIP.find(GuestRIP);
+  if (Existing != BlocksByRIP.end()) {
+    Existing->second->Refs++;
+    return Existing->second.get();
+  }
+
+  auto Block = std::make_unique<CompiledBlock>();
+  Block->Backend = this;
+  Block->GuestRIP = GuestRIP;
+  Block->Refs = 1;
+  Block->Promoted = Options.Pipeline != LLVMPipeline::Tiered;
+
+  BlockFn Code = Compile(ir, GuestRIP, Options.Pipeline == LLVMPipeline::Aggressive ? LLVMPipeline::Aggressive : LLVMPipeline::Fast, Block.get());
+  if (!Code)
+    return nullptr;
+  Block->Code = Code;
+
+  if (!Block->Promoted)
+    Block->IR = std::make_unique<IR::IntrusiveIRList>(*ir);
+
+  return BlocksByRIP.emplace(GuestRIP, std::move(Block)).first->second.get();
+}
+
+void LLVM::PromoteBlock(CompiledBlock *Block) {
+  std::lock_guard<std::mutex> lk(CompileLock);
+  if (Block->Promoted)
+    return;
+  Block->Promoted = true;
+
+  // A failed recompile leaves the fast code running
+  BlockFn Code = Compile(Block->IR.get(), Block->GuestRIP, LLVMPipeline::Aggressive, Block);
+  if (Code)
+    Block->Code.store(Code, std::memory_order_release);
+  Block->IR.reset();
+}
+
+void LLVM::Optimize(llvm::Module *module, LLVMPipeline Pipeline) {
+  legacy::PassManager PM;
+  PM.add(createTargetTransformInfoWrapperPass(TM->getTargetIRAnalysis()));
+
+  if (Pipeline == LLVMPipeline::Fast) {
+    // Blocks are straight line code, these are the passes that do anything for them
+    // EarlyCSE is what forwards context loads and stores between guest instructions
+    PM.add(createPromoteMemoryToRegisterPass());
+    PM.add(createEarlyCSEPass(true));
+    PM.add(createInstructionCombiningPass());
+    PM.add(createCFGSimplificationPass());
+  }
+  else {
+    // Guest blocks are a single function of mostly context and memory accesses with no loops worth vectorizing
+    // The TBAA and scope tags on those accesses are what let GVN and DSE forward and kill them across the whole block
+    PM.add(createTypeBasedAAWrapperPass());
+    PM.add(createScopedNoAliasAAWrapperPass());
+    PM.add(createPromoteMemoryToRegisterPass());
+    PM.add(createEarlyCSEPass(true));
+    PM.add(createInstructionCombiningPass());
+    PM.add(createCFGSimplificationPass());
+    PM.add(createGVNPass());
+    PM.add(createDeadStoreEliminationPass());
+    PM.add(createReassociatePass());
+    PM.add(createInstructionCombiningPass());
+    PM.add(createAggressiveDCEPass());
+    PM.add(createCFGSimplificationPass());
+  }
+
+  PM.run(*module);
+}
+
+LLVM::BlockFn LLVM::Compile(Emu::IR::IntrusiveIRList const *ir, uint64_t GuestRIP, LLVMPipeline Pipeline, CompiledBlock *Block) {
   using namespace llvm;
-  std::string FunctionName = "Function" + std::to_string(cpu->ParentThread->CPUState.rip);
-	auto testmodule = new llvm::Module("Main Module", *con);
-  auto engine = EngineBuilder(std::unique_ptr<llvm::Module>(testmodule))
-		.setEngineKind(EngineKind::JIT)
-		.create();
 
-  auto functype = FunctionType::get(Type::getVoidTy(*con), {}, false);
+  // Each tier of a block gets its own symbol
+  std::string FunctionName = "Function" + std::to_string(GuestRIP) + (Pipeline == LLVMPipeline::Fast ? "_Fast" : "_Aggressive");
+  auto testmodule = std::make_unique<llvm::Module>("Main Module", *con);
+  testmodule->setDataLayout(JIT->getDataLayout());
+  testmodule->setTargetTriple(TM->getTargetTriple().str());
+
+  // void(X86State *State, uint8_t *MemBase)
+  auto functype = FunctionType::get(Type::getVoidTy(*con),
+      {
+        state.cpustatetype->getPointerTo(),
+        builder->getInt8PtrTy(),
+      },
+      false);
   func = Function::Create(functype,
       Function::ExternalLinkage,
       FunctionName,
-      testmodule);
+      testmodule.get());
 
   func->setCallingConv(CallingConv::C);
-
-  llvm::Function *fallback;
-  {
-    auto functype = FunctionType::get(Type::getVoidTy(*con), {Type::getInt64Ty(*con)}, false);
-    fallback = Function::Create(functype,
-        Function::ExternalLinkage,
-        "Fallback",
-        testmodule);
-
-    using ClassPtr = void(Emu::CPUCore::*)(CPUCore::ThreadState*);
-    union Test{
-      ClassPtr ClassData;
-      void* Data;
-    };
-    Test A;
-    A.ClassData = &CPUCore::FallbackToUnicorn;
-    engine->addGlobalMapping(fallback, A.Data);
-  }
+  // Nothing but this block and the helpers it passes State to touch the thread's state while it runs
+  func->addParamAttr(0, Attribute::NoAlias);
+  func->addParamAttr(0, Attribute::NoCapture);
+  func->addDereferenceableParamAttr(0, sizeof(X86State));
+  func->addParamAttr(0, Attribute::getWithAlignment(*con, Align(alignof(X86State))));
+  state.cpustate = func->getArg(0);
+  state.cpustate->setName("State");
+  state.membase = func->getArg(1);
+  state.membase->setName("MemBase");
 
   auto entry = BasicBlock::Create(*con, "entry", func);
   builder->SetInsertPoint(entry);
 
-  CreateGlobalVariables(engine, testmodule);
+  DeclareHelpers(testmodule.get());
 
   // XXX: Finding our jump targets shouldn't be this dumb
+  Values.clear();
+  BlockStack.clear();
   JumpTargets.clear();
-  FindJumpTargets(ir);
+  BlockJumpTargets.clear();
+  FindJumpTargets(ir, GuestRIP);
 
   auto Size = ir->GetOffset();
   uint64_t i = 0;
 
-  CurrentRIP = cpu->ParentThread->CPUState.rip;
-//  printf("New Block: 0x%zx\n", cpu->ParentThread->CPUState.rip);
+  CurrentRIP = GuestRIP;
   while (i != Size) {
     auto op = ir->GetOp(i);
     HandleIR(i, op);
     i += Emu::IR::GetSize(op->Op);
   }
 
-  legacy::PassManager PM;
-  PassManagerBuilder PMBuilder;
-  PMBuilder.OptLevel = 2;
-  raw_ostream& out = outs();
-  if (cpu->ParentThread->CPUState.rip == 0x402350)
-    PM.add(createPrintModulePass(out));
-
-  verifyModule(*testmodule, &out);
-  PMBuilder.populateModulePassManager(PM);
-  PM.run(*testmodule);
-  engine->finalizeObject();
-
-  functions.emplace_back(engine);
-  void *ptr = (void*)engine->getFunctionAddress(FunctionName);
-  auto GetTime = []() {
-    return std::chrono::high_resolution_clock::now();
-  };
-  if (cpu->ParentThread->CPUState.rip == 0x402350)
-  {
-    X86State state;
-    memcpy(&state, &cpu->ParentThread->CPUState, sizeof(state));
-
-    using JITPtr = void (*)(CPUCore *);
-    JITPtr call = (JITPtr)ptr;
-    for (int i = 0; i < 5; ++i) {
-      memcpy(&cpu->ParentThread->CPUState, &state, sizeof(state));
-      auto start = GetTime();
-      call(cpu);
-      auto time = GetTime();
-      printf("Test from inside app: %zd %zd\n", cpu->ParentThread->CPUState.gregs[REG_RAX], (time - start).count());
-    }
-    memcpy(&cpu->ParentThread->CPUState, &state, sizeof(state));
+  if (Options.Verify && verifyModule(*testmodule, &errs())) {
+    LogMan::Msg::E("Block at 0x%lx failed to verify", GuestRIP);
+    return nullptr;
+  }
+
+  Optimize(testmodule.get(), Pipeline);
 
-    printf("Ptr: %p\n", ptr);
-//    std::abort();
+  // The block's trackers free every tier of it together
+  auto Tracker = JIT->getMainJITDylib().createResourceTracker();
+  if (auto Err = JIT->addIRModule(Tracker, orc::ThreadSafeModule(std::move(testmodule), TSContext))) {
+    LogMan::Msg::E("Couldn't add block module: %s", toString(std::move(Err)).c_str());
+    return nullptr;
   }
 
-  return ptr;
+  bool FastISel = Pipeline == LLVMPipeline::Fast;
+  TM->setOptLevel(FastISel ? CodeGenOpt::None : CodeGenOpt::Aggressive);
+  TM->setO0WantsFastISel(FastISel);
+  TM->setFastISel(FastISel);
 
-};
+  auto Symbol = JIT->lookup(FunctionName);
+  if (!Symbol) {
+    LogMan::Msg::E("Couldn't compile block: %s", toString(Symbol.takeError()).c_str());
+    cantFail(Tracker->remove());
+    return nullptr;
+  }
+
+  Block->Trackers.emplace_back(std::move(Tracker));
+  return jitTargetAddressToPointer<BlockFn>(Symbol->getAddress());
+}
+
+void LLVM::FreeCode(void *Code) {
+  std::lock_guard<std::mutex> lk(CompileLock);
+  auto Block = reinterpret_cast<CompiledBlock*>(Code);
+  auto it = BlocksByRIP.find(Block->GuestRIP);
+  LogMan::Throw::A(it != BlocksByRIP.end() && it->second.get() == Block, "Freeing a block that the LLVM backend didn't compile");
+  if (--Block->Refs != 0)
+    return;
+  for (auto &Tracker : Block->Trackers)
+    cantFail(Tracker->remove());
+  BlocksByRIP.erase(it);
+}
+
+CPUBackend *CreateLLVMBackend(Emu::CPUCore *CPU, LLVMBackendOptions const &Options) {
+  return new LLVM(CPU, Options);
+}
+
+void ExecuteLLVMBlock(Emu::CPUCore *CPU, X86State *State, void *Handle) {
+  auto Block = reinterpret_cast<LLVM::CompiledBlock*>(Handle);
+  Block->Code.load(std::memory_order_acquire)(State, CPU->MemoryMapper->GetBaseOffset<uint8_t*>(0));
 
-CPUBackend *CreateLLVMBackend(Emu::CPUCore *CPU) {
-  return new LLVM(CPU);
+  // Exactly one run lands on the threshold, whichever thread that is does the recompile
+  if (!Block->Promoted.load(std::memory_order_relaxed) && Block->Runs.fetch_add(1, std::memory_order_relaxed) + 1 == Block->Backend->Options.HotThreshold)
+    Block->Backend->PromoteBlock(Block);
 }
 
 }
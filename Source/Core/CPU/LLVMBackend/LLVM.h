@@ -1,7 +1,36 @@
 #pragma once
 #include "Core/CPU/CPUBackend.h"
+#include <cstdint>
+#include <string>
 
 namespace Emu {
 class CPUCore;
-CPUBackend *CreateLLVMBackend(Emu::CPUCore *CPU);
+struct X86State;
+
+enum class LLVMPipeline {
+  // mem2reg, EarlyCSE, instcombine and simplifycfg with FastISel, for code that has only just been seen
+  Fast,
+  // GVN, DSE and reassociation over the TBAA tagged context accesses with optimizing ISel, for code that keeps running
+  Aggressive,
+  // Compiles with Fast then recompiles with Aggressive once a block has run HotThreshold times
+  Tiered,
+};
+
+struct LLVMBackendOptions {
+  LLVMPipeline Pipeline = LLVMPipeline::Tiered;
+  uint32_t HotThreshold = 1000;
+  // Runs the IR verifier over every module before it is compiled
+  bool Verify = false;
+  // Replaces the detected host CPU, eg "haswell". HostFeatures still decides the features it covers
+  std::string CPU;
+};
+
+CPUBackend *CreateLLVMBackend(Emu::CPUCore *CPU, LLVMBackendOptions const &Options = {});
+
+/**
+ * @brief Runs a block the LLVM backend's CompileCode returned against any state
+ *
+ * Counts towards the block's promotion the same as running it through the backend's BlockRunner
+ */
+void ExecuteLLVMBlock(Emu::CPUCore *CPU, X86State *State, void *Block);
 }
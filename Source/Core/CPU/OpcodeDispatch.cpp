@@ -2,51 +2,16 @@
 #include "Core/CPU/X86Tables.h"
 #include "LogManager.h"
 #include "OpcodeDispatch.h"
+#include <csignal>
 #include <cstddef>
 #include <iomanip>
 #include <vector>
 
 #define DISABLE_DECODE() do { DecodeFailure = true; return; } while(0)
 namespace Emu::IR {
-static uint8_t GetModRM_Mod(uint8_t modrm) {
-  return (modrm & 0b11000000) >> 6;
-}
-static uint8_t GetModRM_Reg(uint8_t modrm) {
-  return (modrm & 0b00111000) >> 3;
-}
-static uint8_t GetModRM_RM(uint8_t modrm) {
-  return modrm & 0b111;
-}
-static uint8_t GetREX_W(uint8_t rex) {
-  return (rex & 0b1000) >> 3;
-}
-static uint8_t GetREX_R(uint8_t rex) {
-  return (rex & 0b0100) >> 2;
-}
-static uint8_t GetREX_X(uint8_t rex) {
-  return (rex & 0b0010) >> 1;
-}
-static uint8_t GetREX_B(uint8_t rex) {
-  return rex & 0b0001;
-}
-
-static uint32_t MapModRMToReg(uint8_t bits) {
-  std::array<uint64_t, 8> GPRIndexes = {
-    REG_RAX,
-    REG_RCX,
-    REG_RDX,
-    REG_RBX,
-    REG_RSP,
-    REG_RBP,
-    REG_RSI,
-    REG_RDI,
-  };
-  return GPRIndexes[bits];
-}
-
-static uint32_t MapModRMToReg(uint8_t REX, uint8_t bits) {
-  std::array<uint64_t, 16> GPRIndexes = {
-    // Classical ordering?
+// Decoded register numbers are in encoding order, X86State's gregs aren't
+static uint32_t MapModRMToReg(uint8_t Reg) {
+  constexpr std::array<uint32_t, 16> GPRIndexes = {
     REG_RAX,
     REG_RCX,
     REG_RDX,
@@ -64,903 +29,814 @@ static uint32_t MapModRMToReg(uint8_t REX, uint8_t bits) {
     REG_R14,
     REG_R15,
   };
-  return GPRIndexes[(REX << 3) | bits];
-}
-
-static std::string RegToString(uint32_t Reg) {
-  switch(Reg) {
-    case REG_RAX: return "RAX";
-    case REG_RCX: return "RCX";
-    case REG_RDX: return "RDX";
-    case REG_RBX: return "RBX";
-    case REG_RSP: return "RSP";
-    case REG_RBP: return "RBP";
-    case REG_RSI: return "RSI";
-    case REG_RDI: return "RDI";
-    case REG_R8: return "R8";
-    case REG_R9: return "R9";
-    case REG_R10: return "R10";
-    case REG_R11: return "R11";
-    case REG_R12: return "R12";
-    case REG_R13: return "R13";
-    case REG_R14: return "R14";
-    case REG_R15: return "R15";
-    default: return "UNK";
-  };
+  return GPRIndexes[Reg];
+}
+
+static uint64_t GPROffset(X86Tables::DecodedOperand const &Operand) {
+  return offsetof(X86State, gregs) + MapModRMToReg(Operand.Reg) * 8;
+}
+
+// AL/AX/EAX/RAX for the forms that don't encode their register
+static constexpr X86Tables::DecodedOperand AccumulatorOperand{X86Tables::OPERAND_GPR, 0, X86Tables::INVALID_REG, 0, 0};
+// DX/EDX/RDX, the top half of the widening multiplies and divides
+static constexpr X86Tables::DecodedOperand DataOperand{X86Tables::OPERAND_GPR, 2, X86Tables::INVALID_REG, 0, 0};
+// RBP for ENTER and LEAVE
+static constexpr X86Tables::DecodedOperand FramePointerOperand{X86Tables::OPERAND_GPR, 5, X86Tables::INVALID_REG, 0, 0};
+
+// The operation in bits 3-5 of 00-3D and in ModRM.reg of the 80, 81 and 83 groups
+enum ALUType {
+  ALU_ADD,
+  ALU_OR,
+  ALU_ADC,
+  ALU_SBB,
+  ALU_AND,
+  ALU_SUB,
+  ALU_XOR,
+  ALU_CMP,
+};
+
+// Stack ops are 64bit unless they have an operand size prefix, there's no 32bit form in long mode
+static uint8_t GetStackOpSize(X86Tables::DecodedOp Op) {
+  return Op->OpSize == 2 ? 2 : 8;
 }
 
 void OpDispatchBuilder::BeginBlock() {
   IRList.AllocateOp<IROp_BeginBlock, OP_BEGINBLOCK>();
+  DeferredFlags = {};
+  StackPointer = {};
 }
 
 void OpDispatchBuilder::EndBlock(uint64_t RIPIncrement) {
+  // Flags are live out of every block
+  // An exit path only leaves on one side of its jump, the code after the JmpTarget still owes the stores
+  bool Pending = DeferredFlags.Pending;
+  StoreDeferredFlags();
+  DeferredFlags.Pending = Pending;
+
+  // Same with RSP
+  Pending = StackPointer.Pending;
+  StoreStackPointer();
+  StackPointer.Pending = Pending;
+
   auto EndOp = IRList.AllocateOp<IROp_EndBlock, OP_ENDBLOCK>();
   EndOp.first->RIPIncrement = RIPIncrement;
 }
 
-void OpDispatchBuilder::AddOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
+void OpDispatchBuilder::Fallback(uint64_t RIP, uint8_t Size) {
+  // Throw away anything the handler managed to emit before it gave up
+  IRList.Shrink(RIPLocations.at(RIP) + GetSize(OP_RIP_MARKER));
+  DecodeFailure = false;
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  // Along with any flags it generated
+  DeferredFlags = InstructionFlags;
+  StoreDeferredFlags();
+  StackPointer = InstructionStackPointer;
+  StoreStackPointer();
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
+  auto FallbackOp = IRList.AllocateOp<IROp_Fallback, OP_FALLBACK>();
+  FallbackOp.first->RIP = RIP;
 
-  uint32_t OpSize = 4;
-  AlignmentType Src;
+  // Unicorn works on real RFLAGS so the deferred flags are gone afterwards
+  DeferredFlags = {};
+  DeferredFlags.Known = true;
+  DeferredFlags.Op = Flags::DEFERRED_NONE;
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    printf("Add OpSize\n");
-    OpSize = 2;
-  }
+  // Or what it left in RSP
+  StackPointer = {};
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
+  // A fault, or an instruction that didn't finish in one step, leaves the block with the state as Unicorn left it
+  auto NextRIP = LoadConstant(RIP + Size);
+  auto JumpOp = IRList.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
+  JumpOp.first->Cond = IROp_Select::COMP_EQ;
+  JumpOp.first->Args[0] = FallbackOp.second;
+  JumpOp.first->Args[1] = NextRIP;
+  JumpOp.first->RIPTarget = ~0ULL;
 
-    if (GetREX_W(REX)) {
-      OpSize = 8;
-    }
-  } else {
-    ModRM = Code[1];
-  }
+  StoreContext(FallbackOp.second, offsetof(X86State, rip), 8);
+  EndBlock(0);
 
-  uint8_t Mod = GetModRM_Mod(ModRM);
-  uint8_t RM = GetModRM_RM(ModRM);
-  uint8_t Reg = GetModRM_Reg(ModRM);
-  if (Mod != 0b11 && Reg != 0b100) {
-    DestReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
-//    printf("XXX: ADD SIB ModRM without Byte!!Mod: %d Src: %s Base? :%s\n",
-//        Mod,
-//        RegToString(MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM))).c_str(),
-//        RegToString(MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM))).c_str()
-//        );
-    if (Mod == 0b10) {
-      // [Register + Displacement32]
-//      printf("\tXXX: R+disp32\n");
-      DecodeFailure = true;
-
-      uint32_t SrcReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-      Src = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
-
-      uint64_t Const = *(int32_t*)&Code[Op.second.Size - 4];
-      auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-
-      ConstantOp.first->Flags = IR::TYPE_I64;
-      ConstantOp.first->Constant = Const;
-
-      auto AddOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-      AddOp.first->Args[0] = Src;
-      AddOp.first->Args[1] = ConstantOp.second;
-
-      Src = AddOp.second;
-    }
-    else if (Mod == 0b00) {
-      // [Register]
-      printf("\tXXX: R\n");
-      //      DecodeFailure = true;
-      uint32_t SrcReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-      Src = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
-      auto LoadMemOp = IRList.AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
-
-      LoadMemOp.first->Size = OpSize;
-      LoadMemOp.first->Arg[0] = Src;
-      LoadMemOp.first->Arg[1] = ~0;
-      Src = LoadMemOp.second;
-    }
-    else {
-      printf("\tEarlier Mod: %d Reg: %d RM: %d\n", Mod, Reg, RM);
-      DecodeFailure = true;
-    }
-  }
-  else if (Mod == 0b11) {
-    DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-    uint32_t SrcReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
-    auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-    LoadOp.first->Size = 8;
-    LoadOp.first->Offset = offsetof(X86State, gregs) + SrcReg * 8;
-    Src = LoadOp.second;
-  }
-  else {
-    printf("\tLast Dec\n");
-    DecodeFailure = true;
-  }
+  auto TargetOp = IRList.AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
+  JumpOp.first->Target = TargetOp.second;
+}
 
-  if (DecodeFailure)
-    return;
+void OpDispatchBuilder::RaiseSignalUnless(IROp_Select::ComparisonOp Comparison, AlignmentType Src1, AlignmentType Src2, int Signal) {
+  // Same shape as a Jcc, except the exit path stays on this instruction
+  uint64_t RIP = cpu->GetTLSThread()->JITRIP;
 
+  auto JumpOp = IRList.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
+  JumpOp.first->Cond = Comparison;
+  JumpOp.first->Args[0] = Src1;
+  JumpOp.first->Args[1] = Src2;
+  JumpOp.first->RIPTarget = ~0ULL;
 
-  auto LoadDestOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadDestOp.first->Size = 8;
-  LoadDestOp.first->Offset = offsetof(X86State, gregs) + DestReg * 8;
+  // The signal sees the state from before the instruction, nothing of it has been stored yet
+  bool FlagsPending = DeferredFlags.Pending;
+  bool StackPointerPending = StackPointer.Pending;
+  StoreDeferredFlags();
+  StoreStackPointer();
 
-  auto Src1 = LoadDestOp.second;
-  auto Src2 = Src;
-  switch (OpSize) {
-  case 1: LogMan::Msg::A("Unhandled Add size 1"); break;
-  case 2: {
-    auto Trunc1 = IRList.AllocateOp<IROp_Trunc_16, OP_TRUNC_16>();
-    Trunc1.first->Arg = Src1;
+  StoreContext(LoadConstant(RIP), offsetof(X86State, rip), 8);
+  auto SignalOp = IRList.AllocateOp<IROp_RaiseSignal, OP_RAISE_SIGNAL>();
+  SignalOp.first->Signal = Signal;
+  EndBlock(0);
 
-    auto Trunc2 = IRList.AllocateOp<IROp_Trunc_16, OP_TRUNC_16>();
-    Trunc2.first->Arg = Src2;
+  DeferredFlags.Pending = FlagsPending;
+  StackPointer.Pending = StackPointerPending;
 
-    Src1 = Trunc1.second;
-    Src2 = Trunc2.second;
-  }
-  break;
-  case 4: {
-    auto Trunc1 = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-    Trunc1.first->Arg = Src1;
+  auto TargetOp = IRList.AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
+  JumpOp.first->Target = TargetOp.second;
+}
 
-    auto Trunc2 = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-    Trunc2.first->Arg = Src2;
+void OpDispatchBuilder::ALU(Emu::X86Tables::DecodedOp Op, uint32_t Type, Emu::X86Tables::DecodedOperand const &DestOperand, AlignmentType Src2, uint8_t Size) {
+  auto Src1 = LoadSource(Op, DestOperand, Size);
 
-    Src1 = Trunc1.second;
-    Src2 = Trunc2.second;
-  }
+  // Logic ops can't carry out of zero extended sources, everything else is truncated back to the operand size
+  AlignmentType Res;
+  Flags::DeferredOp FlagsOp;
+  switch (Type) {
+  case ALU_ADD:
+    Res = Truncate(BiOp(OP_ADD, Src1, Src2), Size);
+    FlagsOp = Flags::DEFERRED_ADD;
   break;
-  case 8: break;
-  }
-
-  auto AddOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-  AddOp.first->Args[0] = Src1;
-  AddOp.first->Args[1] = Src2;
-
-  auto Res = AddOp.second;
-
-  switch (OpSize) {
-  case 1: LogMan::Msg::A("Unhandled Add size 1"); break;
-  case 2: {
-    auto Trunc = IRList.AllocateOp<IROp_Trunc_16, OP_TRUNC_16>();
-    Trunc.first->Arg = Res;
-
-    Res = Trunc.second;
-  }
+  case ALU_ADC:
+    Res = Truncate(BiOp(OP_ADD, BiOp(OP_ADD, Src1, Src2), GetCondition(CC_C)), Size);
+    FlagsOp = Flags::DEFERRED_ADC;
   break;
-  case 4: {
-    auto Trunc = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-    Trunc.first->Arg = Res;
-
-    Res = Trunc.second;
-  }
+  case ALU_SBB:
+    Res = Truncate(BiOp(OP_SUB, BiOp(OP_SUB, Src1, Src2), GetCondition(CC_C)), Size);
+    FlagsOp = Flags::DEFERRED_SBB;
+  break;
+  case ALU_SUB:
+  case ALU_CMP:
+    Res = Truncate(BiOp(OP_SUB, Src1, Src2), Size);
+    FlagsOp = Flags::DEFERRED_SUB;
+  break;
+  case ALU_OR:
+    Res = BiOp(OP_OR, Src1, Src2);
+    FlagsOp = Flags::DEFERRED_LOGIC;
+  break;
+  case ALU_AND:
+    Res = BiOp(OP_AND, Src1, Src2);
+    FlagsOp = Flags::DEFERRED_LOGIC;
+  break;
+  case ALU_XOR:
+    Res = BiOp(OP_XOR, Src1, Src2);
+    FlagsOp = Flags::DEFERRED_LOGIC;
   break;
-  case 8: break;
+  default:
+    LogMan::Msg::A("Unknown ALU op: %d", Type);
+    return;
   }
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, gregs) + DestReg * 8;
-  StoreOp.first->Arg = Res;
+  // CMP only sets the flags
+  if (Type != ALU_CMP)
+    StoreResult(Op, DestOperand, Res, Size);
 
-//  printf("AddSize: %d %02x %02x %02x %02x\n", OpSize,
-//      Code[0], Code[1], Code[2], Code[3]);
+  GenerateFlags(FlagsOp, Res, Src1, Src2, Size);
 }
 
-void OpDispatchBuilder::CMPOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t SrcReg = 0;
-  uint32_t DestReg = 0;
+void OpDispatchBuilder::ALUOp(Emu::X86Tables::DecodedOp Op) {
+  // 00-3D, bits 3-5 pick the operation and the low three bits the form
+  // Eb,Gb  Ev,Gv  Gb,Eb  Gv,Ev  AL,Ib  eAX,Iz
+  uint32_t Type = (Op->Op >> 3) & 0b111;
+  uint32_t Form = Op->Op & 0b111;
+  uint8_t Size = (Form & 1) ? Op->OpSize : 1;
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  if (Form >= 4) {
+    ALU(Op, Type, AccumulatorOperand, Truncate(LoadConstant(Op->Imm), Size), Size);
+    return;
+  }
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
+  bool DestRM = !(Form & 0b10);
+  ALU(Op, Type, DestRM ? Op->RM : Op->Reg, LoadSource(Op, DestRM ? Op->Reg : Op->RM, Size), Size);
+}
 
-  uint32_t OpSize = 4;
+void OpDispatchBuilder::ALUImmOp(Emu::X86Tables::DecodedOp Op) {
+  // 80, 81 and 83 have the operation in ModRM.reg, 83's imm8 is already sign extended
+  uint8_t Size = Op->Op == 0x80 ? 1 : Op->OpSize;
+  ALU(Op, (Op->ModRM >> 3) & 0b111, Op->RM, Truncate(LoadConstant(Op->Imm), Size), Size);
+}
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    printf("Add OpSize\n");
-    OpSize = 2;
-  }
+void OpDispatchBuilder::TESTOp(Emu::X86Tables::DecodedOp Op) {
+  // 84 and 85 test ModRM.rm against ModRM.reg, A8 and A9 the accumulator against an immediate and F6 and F7 /0 ModRM.rm against one
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  bool Accumulator = Op->Op == 0xA8 || Op->Op == 0xA9;
+  bool Imm = Op->Op != 0x84 && Op->Op != 0x85;
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
+  auto Src1 = LoadSource(Op, Accumulator ? AccumulatorOperand : Op->RM, Size);
+  auto Src2 = Imm ? Truncate(LoadConstant(Op->Imm), Size) : LoadSource(Op, Op->Reg, Size);
 
-    if (GetREX_W(REX)) {
-      OpSize = 8;
-    }
-  } else {
-    ModRM = Code[1];
-  }
+  // AND that only sets the flags
+  GenerateFlags(Flags::DEFERRED_LOGIC, BiOp(OP_AND, Src1, Src2), Src1, Src2, Size);
+}
 
-  uint8_t Mod = GetModRM_Mod(ModRM);
-  uint8_t RM = GetModRM_RM(ModRM);
-  uint8_t Reg = GetModRM_Reg(ModRM);
-  if (Mod == 0b11) {
-    DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-    SrcReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
-  }
-  else {
-    DecodeFailure = true;
-  }
+void OpDispatchBuilder::INCDECOp(Emu::X86Tables::DecodedOp Op) {
+  // FE and FF /0 is INC, /1 is DEC
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  bool Dec = (Op->ModRM >> 3) & 1;
 
-  if (cpu->GetTLSThread()->JITRIP != 0x402366)
-    DecodeFailure = true;
+  // CF is left alone, it rides along as the second source
+  auto CF = GetCondition(CC_C);
+  auto Src = LoadSource(Op, Op->RM, Size);
 
-  if (DecodeFailure)
-    return;
+  auto Res = Truncate(BiOp(Dec ? OP_SUB : OP_ADD, Src, LoadConstant(1)), Size);
+  StoreResult(Op, Op->RM, Res, Size);
 
-  auto Src = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
-  auto Dest = LoadContext(offsetof(X86State, gregs) + DestReg * 8, 8);
+  GenerateFlags(Dec ? Flags::DEFERRED_DEC : Flags::DEFERRED_INC, Res, Src, CF, Size);
+}
 
-  auto SubOp = IRList.AllocateOp<IROp_Sub, OP_SUB>();
-  SubOp.first->Args[0] = Dest;
-  SubOp.first->Args[1] = Src;
+void OpDispatchBuilder::NOTOp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  uint64_t Mask = Size == 8 ? ~0ULL : ((1ULL << (Size * 8)) - 1);
 
-  printf("\t In CMP! %s, %s\n", RegToString(DestReg).c_str(), RegToString(SrcReg).c_str());
+  // Doesn't touch the flags
+  auto Src = LoadSource(Op, Op->RM, Size);
+  StoreResult(Op, Op->RM, BiOp(OP_NAND, LoadConstant(Mask), Src), Size);
+}
 
-  // Sets OF, SF, ZF, AF, PF, CF
-  // JNE depends on ZF
-  if (1) {
-    // Set ZF
-    auto ZeroConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    ZeroConstant.first->Flags = IR::TYPE_I64;
-    ZeroConstant.first->Constant = 1;
+void OpDispatchBuilder::NEGOp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
 
-    auto OneConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    OneConstant.first->Flags = IR::TYPE_I64;
-    OneConstant.first->Constant = 0;
+  // 0 - Src, so CF is set for anything but 0
+  auto Zero = LoadConstant(0);
+  auto Src = LoadSource(Op, Op->RM, Size);
+  auto Res = Truncate(BiOp(OP_SUB, Zero, Src), Size);
+  StoreResult(Op, Op->RM, Res, Size);
 
-    auto SelectOp = IRList.AllocateOp<IROp_Select, OP_SELECT>();
-    SelectOp.first->Op = IROp_Select::COMP_EQ;
-    SelectOp.first->Args[0] = Src;
-    SelectOp.first->Args[1] = Dest;
-    SelectOp.first->Args[2] = OneConstant.second;
-    SelectOp.first->Args[3] = ZeroConstant.second;
-    SetZF(SelectOp.second);
-  }
+  GenerateFlags(Flags::DEFERRED_SUB, Res, Zero, Src, Size);
 }
 
-template<uint32_t Type>
-void OpDispatchBuilder::JccOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
-
-  uint32_t FlagBit = 0;
-  bool Negate = false;
+void OpDispatchBuilder::ShiftOp(Emu::X86Tables::DecodedOp Op) {
+  // C0 and C1 shift by an imm8, D0 and D1 by 1 and D2 and D3 by CL. The even opcodes are the byte forms
+  // /4 SHL, /5 SHR, /6 SAL which is SHL again, /7 SAR
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  uint32_t Type = (Op->ModRM >> 3) & 0b111;
+
+  // The count is masked to 5 bits, 6 for a 64bit operand, before anything looks at it
+  uint64_t CountMask = Size == 8 ? 63 : 31;
+  bool ImmCount = Op->Op < 0xD2;
+  uint64_t ConstCount = (Op->Op >= 0xD0 ? 1 : Op->Imm) & CountMask;
+
+  auto Src = LoadSource(Op, Op->RM, Size);
+
+  AlignmentType Count;
+  if (ImmCount) {
+    // Nothing changes, though a 32bit register still gets its upper half zeroed
+    if (ConstCount == 0) {
+      StoreResult(Op, Op->RM, Src, Size);
+      return;
+    }
+    Count = LoadConstant(ConstCount);
+  }
+  else {
+    Count = BiOp(OP_AND, LoadContext(offsetof(X86State, gregs[REG_RCX]), 8), LoadConstant(CountMask));
+  }
 
+  AlignmentType Res;
+  Flags::DeferredOp FlagsOp;
   switch (Type) {
-  case CC_NOF:
-    Negate = true;
-  case CC_OF:
-    FlagBit = 11;
-  break;
-  case CC_NC:
-    Negate = true;
-  case CC_C:
-    FlagBit = 0;
-  break;
-
-  case CC_NZ:
-    Negate = true;
-  case CC_Z:
-    FlagBit = 6;
+  case 4:
+  case 6:
+    Res = Truncate(BiOp(OP_SHL, Src, Count), Size);
+    FlagsOp = Flags::DEFERRED_SHL;
   break;
-
-  case CC_NS:
-    Negate = true;
-  case CC_S:
-    FlagBit = 7;
+  case 5:
+    Res = BiOp(OP_SHR, Src, Count);
+    FlagsOp = Flags::DEFERRED_SHR;
   break;
-
-  case CC_NP:
-    Negate = true;
-  case CC_P:
-    FlagBit = 2;
+  case 7: {
+    // Sign extend from the operand size first so counts past it still fill with the sign
+    auto Signed = Src;
+    if (Size != 8) {
+      auto Amount = LoadConstant(64 - Size * 8);
+      Signed = BiOp(OP_ASHR, BiOp(OP_SHL, Src, Amount), Amount);
+    }
+    Res = Truncate(BiOp(OP_ASHR, Signed, Count), Size);
+    FlagsOp = Flags::DEFERRED_SAR;
   break;
-
-  case CC_NBE:
-  case CC_BE:
-  case CC_NL:
-  case CC_L:
-  case CC_NLE:
-  case CC_LE:
-//    printf("\tCouldn't handle this jmp type: %d\n", Type);
-    DecodeFailure = true;
-    break;
   }
-
-  if (cpu->GetTLSThread()->CPUState.rip != 0x402350)
-    DecodeFailure = true;
-
-  if (DecodeFailure)
+  default:
+    LogMan::Msg::A("Unknown shift op: %d", Type);
     return;
-  printf("We hit a real jump!\n");
-
-  auto FlagBitOp = GetFlagBit(FlagBit, !Negate);
-
-  auto JumpOp = IRList.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
-  JumpOp.first->Cond = FlagBitOp;
-
-  // If condition holds true
-  // Set RIP and end block. Else jump over
-  uint64_t RIPTarget = 0;
-
-  // False block
-  {
-    uint64_t ConstLocation = *(int8_t*)&Code[Op.second.Size - 1];
-    RIPTarget = cpu->GetTLSThread()->JITRIP + ConstLocation + Op.second.Size;
-    JumpOp.first->RIPTarget = RIPTarget;
-
-    auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    ConstantOp.first->Flags = IR::TYPE_I64;
-    ConstantOp.first->Constant = RIPTarget;
-    printf("\tWanting to jump to 0x%zx\n", ConstantOp.first->Constant);
-
-    auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-    StoreOp.first->Size = 8;
-    StoreOp.first->Offset = offsetof(X86State, rip);
-    StoreOp.first->Arg = ConstantOp.second;
-    StoreContext(ConstantOp.second, offsetof(X86State, rip), 8);
-
-    EndBlock(0);
   }
 
-  auto TargetOp = IRList.AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
-  JumpOp.first->Target = TargetOp.second;
-
-}
-
-void OpDispatchBuilder::RETOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
+  StoreResult(Op, Op->RM, Res, Size);
 
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, gregs[REG_RSP]);
-
-  auto EightConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  EightConstant.first->Flags = IR::TYPE_I64;
-  EightConstant.first->Constant = 8;
-
-  auto LoadMemOp = IRList.AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
-  LoadMemOp.first->Size = 8;
-  LoadMemOp.first->Arg[0] = LoadOp.second;
-  LoadMemOp.first->Arg[1] = ~0;
-
-  auto AddOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-  AddOp.first->Args[0] = LoadOp.second;
-  AddOp.first->Args[1] = EightConstant.second;
-
-  // Store new stack pointer
-  {
-    auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-    StoreOp.first->Size = 8;
-    StoreOp.first->Offset = offsetof(X86State, gregs[REG_RSP]);
-    StoreOp.first->Arg = AddOp.second;
+  if (ImmCount) {
+    GenerateFlags(FlagsOp, Res, Src, Count, Size);
+    return;
   }
 
-  // Store new RIP
-  {
-    auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-    StoreOp.first->Size = 8;
-    StoreOp.first->Offset = offsetof(X86State, rip);
-    StoreOp.first->Arg = LoadMemOp.second;
+  // A zero CL leaves the flags alone, so whichever producer was there before has to survive in X86State
+  // Each field picks between the old producer and this one, nothing in the block knows which won
+  StoreDeferredFlags();
+  auto Zero = LoadConstant(0);
+  std::array<std::pair<uint64_t, AlignmentType>, 5> Fields = {{
+    {offsetof(X86State, flags_op), LoadConstant(FlagsOp)},
+    {offsetof(X86State, flags_size), LoadConstant(Size)},
+    {offsetof(X86State, flags_src1), Src},
+    {offsetof(X86State, flags_src2), Count},
+    {offsetof(X86State, flags_res), Res},
+  }};
+
+  for (auto &Field : Fields) {
+    auto Old = LoadContext(Field.first, 8);
+    StoreContext(Select(IROp_Select::COMP_EQ, Count, Zero, Old, Field.second), Field.first, 8);
   }
-
+  DeferredFlags = {};
 }
 
-void OpDispatchBuilder::AddImmOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, gregs[REG_RAX]);
+void OpDispatchBuilder::RotateOp(Emu::X86Tables::DecodedOp Op) {
+  // Same forms as ShiftOp, /0 ROL, /1 ROR, /2 RCL and /3 RCR
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  uint32_t Bits = Size * 8;
+  uint32_t Type = (Op->ModRM >> 3) & 0b111;
+  bool ThroughCarry = Type >= 2;
 
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
+  uint64_t CountMask = Size == 8 ? 63 : 31;
+  bool ImmCount = Op->Op < 0xD2;
+  uint64_t ConstCount = (Op->Op >= 0xD0 ? 1 : Op->Imm) & CountMask;
+  // ROL and ROR come back around every Bits, RCL and RCR every Bits + 1 with CF in the loop
+  uint64_t ConstN = ThroughCarry ? ConstCount % (Bits + 1) : ConstCount & (Bits - 1);
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    ConstantOp.first->Flags = IR::TYPE_I64;
-    ConstantOp.first->Constant = *(int32_t*)&Code[Op.second.Size - 4];
+  auto Src = LoadSource(Op, Op->RM, Size);
+
+  // A full turn through CF leaves OF undefined, so it changes nothing either
+  if (ImmCount && (ConstCount == 0 || (ThroughCarry && ConstN == 0))) {
+    StoreResult(Op, Op->RM, Src, Size);
+    return;
   }
-  else if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    ConstantOp.first->Flags = IR::TYPE_I16;
-    ConstantOp.first->Constant = *(int16_t*)&Code[Op.second.Size - 2];
+
+  AlignmentType Count = ~0U;
+  AlignmentType N;
+  if (ImmCount) {
+    N = LoadConstant(ConstN);
   }
   else {
-    ConstantOp.first->Flags = IR::TYPE_I32;
-    ConstantOp.first->Constant = *(int32_t*)&Code[Op.second.Size - 4];
+    Count = BiOp(OP_AND, LoadContext(offsetof(X86State, gregs[REG_RCX]), 8), LoadConstant(CountMask));
+    N = Count;
+    if (!ThroughCarry && Bits - 1 != CountMask)
+      N = BiOp(OP_AND, Count, LoadConstant(Bits - 1));
+
+    // Only the 8bit and 16bit forms can count past Bits + 1
+    for (uint64_t Multiple = (CountMask / (Bits + 1)) * (Bits + 1); ThroughCarry && Multiple != 0; Multiple -= Bits + 1) {
+      auto MultipleConstant = LoadConstant(Multiple);
+      N = Select(IROp_Select::COMP_UGE, N, MultipleConstant, BiOp(OP_SUB, N, MultipleConstant), N);
+    }
   }
 
-  auto AddImmOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-  AddImmOp.first->Args[0] = LoadOp.second;
-  AddImmOp.first->Args[1] = ConstantOp.second;
-
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, gregs[REG_RAX]);
-  StoreOp.first->Arg = AddImmOp.second;
-}
-
-void OpDispatchBuilder::AddImmModRMOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
+  // RCL and RCR shift by N - 1 and Bits - N, so N = 0 builds them from N = 1 instead and gets selected away below
+  auto ShiftN = N;
+  if (ThroughCarry && !ImmCount)
+    ShiftN = Select(IROp_Select::COMP_EQ, N, LoadConstant(0), LoadConstant(1), N);
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  // Base + N or Base - N, a constant when the count is
+  auto CountOffset = [&](int64_t Base, bool Subtract) {
+    if (ImmCount)
+      return LoadConstant(Subtract ? Base - ConstN : Base + ConstN);
+    return Subtract ? BiOp(OP_SUB, LoadConstant(Base), ShiftN) : BiOp(OP_ADD, ShiftN, LoadConstant(Base));
+  };
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
-  uint32_t OpSize = 4;
+  // Rotates only write CF and OF, the rest of RFLAGS has to be real underneath them
+  MaterializeFlags();
+  auto OldFlags = LoadContext(offsetof(X86State, rflags), 8);
+  auto One = LoadConstant(1);
+  auto MSB = LoadConstant(Bits - 1);
+  auto OldCF = BiOp(OP_AND, OldFlags, One);
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    OpSize = 2;
+  // Double shifts keep every shift amount below 64 at N = Bits
+  AlignmentType Res, CF, OF;
+  switch (Type) {
+  case 0:
+    Res = BiOp(OP_OR, BiOp(OP_SHL, Src, N), BiOp(OP_SHR, BiOp(OP_SHR, Src, One), CountOffset(Bits - 1, true)));
+    Res = Truncate(Res, Size);
+    CF = BiOp(OP_AND, Res, One);
+  break;
+  case 1:
+    Res = BiOp(OP_OR, BiOp(OP_SHR, Src, N), BiOp(OP_SHL, BiOp(OP_SHL, Src, One), CountOffset(Bits - 1, true)));
+    Res = Truncate(Res, Size);
+    CF = BiOp(OP_BITEXTRACT, Res, MSB);
+  break;
+  case 2: {
+    // For N in 1..Bits, CF goes in below the bits shifted up and the bit shifted out last becomes CF
+    auto NMinusOne = CountOffset(-1, false);
+    auto Right = CountOffset(Bits, true);
+    Res = BiOp(OP_OR, BiOp(OP_SHL, BiOp(OP_SHL, Src, One), NMinusOne), BiOp(OP_SHL, OldCF, NMinusOne));
+    Res = Truncate(BiOp(OP_OR, Res, BiOp(OP_SHR, BiOp(OP_SHR, Src, One), Right)), Size);
+    CF = BiOp(OP_BITEXTRACT, Src, Right);
+  break;
   }
-
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
-
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
-    OpSize = 8;
-  } else {
-    ModRM = Code[1];
-
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
+  case 3: {
+    auto NMinusOne = CountOffset(-1, false);
+    auto Left = CountOffset(Bits, true);
+    Res = BiOp(OP_OR, BiOp(OP_SHR, BiOp(OP_SHR, Src, One), NMinusOne), BiOp(OP_SHL, OldCF, Left));
+    Res = Truncate(BiOp(OP_OR, Res, BiOp(OP_SHL, BiOp(OP_SHL, Src, One), Left)), Size);
+    CF = BiOp(OP_BITEXTRACT, Src, NMinusOne);
+  break;
   }
-
-  DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-
-  uint64_t Const = *(int8_t*)&Code[Op.second.Size - 1];
-  if (DecodeFailure)
+  default:
+    LogMan::Msg::A("Unknown rotate op: %d", Type);
     return;
-
-  auto Src = LoadContext(offsetof(X86State, gregs) + DestReg * 8, 8);
-
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = Const;
-
-  auto AddImmOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-  AddImmOp.first->Args[0] = Src;
-  AddImmOp.first->Args[1] = ConstantOp.second;
-
-  StoreContext(AddImmOp.second, offsetof(X86State, gregs) + DestReg * 8, 8);
-
-  if (1) {
-    // Set SF
-    auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    ConstantOp.first->Flags = IR::TYPE_I64;
-    ConstantOp.first->Constant = (OpSize * 4) - 1;
-
-    auto ShrOp = IRList.AllocateOp<IROp_Shr, OP_SHR>();
-    ShrOp.first->Args[0] = Src;
-    ShrOp.first->Args[1] = ConstantOp.second;
-    SetSF(ShrOp.second);
-  }
-
-  if (1) {
-    // Set ZF
-    auto ZeroConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    ZeroConstant.first->Flags = IR::TYPE_I64;
-    ZeroConstant.first->Constant = 1;
-
-    auto OneConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    OneConstant.first->Flags = IR::TYPE_I64;
-    OneConstant.first->Constant = 0;
-
-    auto SelectOp = IRList.AllocateOp<IROp_Select, OP_SELECT>();
-    SelectOp.first->Op = IROp_Select::COMP_EQ;
-    SelectOp.first->Args[0] = AddImmOp.second;
-    SelectOp.first->Args[1] = ZeroConstant.second;
-    SelectOp.first->Args[2] = OneConstant.second;
-    SelectOp.first->Args[3] = ZeroConstant.second;
-    SetZF(SelectOp.second);
   }
-}
-
-void OpDispatchBuilder::ShlImmOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
-
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
-
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
 
-  uint32_t OpSize = 4;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    OpSize = 2;
+  auto Zero = LoadConstant(0);
+  if (ThroughCarry && !ImmCount) {
+    Res = Select(IROp_Select::COMP_EQ, N, Zero, Src, Res);
+    CF = Select(IROp_Select::COMP_EQ, N, Zero, OldCF, CF);
   }
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
-
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
-
-    if (GetREX_W(REX)) {
-      OpSize = 8;
-    }
-  } else {
-    ModRM = Code[1];
+  // Left rotates compare the MSB with the CF they shifted out, right rotates the top two bits of the result
+  if (Type & 1)
+    OF = BiOp(OP_XOR, BiOp(OP_BITEXTRACT, Res, MSB), BiOp(OP_BITEXTRACT, Res, LoadConstant(Bits - 2)));
+  else
+    OF = BiOp(OP_XOR, CF, BiOp(OP_BITEXTRACT, Res, MSB));
+
+  auto FlagMask = LoadConstant((1ULL << Flags::FLAG_CF_LOC) | (1ULL << Flags::FLAG_OF_LOC));
+  // CF is bit 0 already
+  auto NewFlags = BiOp(OP_OR, CF, BiOp(OP_SHL, OF, LoadConstant(Flags::FLAG_OF_LOC)));
+  NewFlags = BiOp(OP_OR, BiOp(OP_NAND, OldFlags, FlagMask), NewFlags);
+  if (!ImmCount)
+    NewFlags = Select(IROp_Select::COMP_EQ, Count, Zero, OldFlags, NewFlags);
+
+  StoreContext(NewFlags, offsetof(X86State, rflags), 8);
+  StoreResult(Op, Op->RM, Res, Size);
+}
 
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
+void OpDispatchBuilder::MULOp(Emu::X86Tables::DecodedOp Op) {
+  // F6 and F7 /4 is MUL and /5 IMUL, the accumulator times ModRM.rm in to AX or rDX:rAX
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  bool Signed = (Op->ModRM >> 3) & 1;
+
+  auto Src1 = LoadSource(Op, AccumulatorOperand, Size);
+  auto Src2 = LoadSource(Op, Op->RM, Size);
+  auto Zero = LoadConstant(0);
+  auto One = LoadConstant(1);
+
+  // CF and OF say whether the high half is anything but the extension of the low half
+  AlignmentType Low, Overflow;
+  if (Size == 8) {
+    Low = BiOp(OP_MUL, Src1, Src2);
+    auto High = BiOp(Signed ? OP_SMULH : OP_UMULH, Src1, Src2);
+    Overflow = Select(IROp_Select::COMP_NEQ, High, Signed ? BiOp(OP_ASHR, Low, LoadConstant(63)) : Zero, One, Zero);
+    StoreGPR(Op, AccumulatorOperand, Low, Size);
+    StoreGPR(Op, DataOperand, High, Size);
   }
-
-  if (DecodeFailure)
-    return;
-
-  {
-    DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-
-    auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-    LoadOp.first->Size = 8;
-    LoadOp.first->Offset = offsetof(X86State, gregs) + DestReg * 8;
-
-    auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-    ConstantOp.first->Flags = IR::TYPE_I8;
-    ConstantOp.first->Constant = *(int8_t*)&Code[Op.second.Size - 1];
-
-    auto Src = LoadOp.second;
-    switch (OpSize) {
-    case 1: LogMan::Msg::A("Unhandled Add size 1"); break;
-    case 2: {
-      auto Trunc1 = IRList.AllocateOp<IROp_Trunc_16, OP_TRUNC_16>();
-      Trunc1.first->Arg = Src;
-      Src = Trunc1.second;
-    }
-    break;
-    case 4: {
-      auto Trunc1 = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-      Trunc1.first->Arg = Src;
-      Src = Trunc1.second;
-    }
-    break;
-    case 8: break;
-    }
-
-    auto ShlOp = IRList.AllocateOp<IROp_Shl, OP_SHL>();
-    ShlOp.first->Args[0] = Src;
-    ShlOp.first->Args[1] = ConstantOp.second;
-    auto Res = ShlOp.second;
-
-    switch (OpSize) {
-    case 1: LogMan::Msg::A("Unhandled Add size 1"); break;
-    case 2: {
-      auto Trunc = IRList.AllocateOp<IROp_Trunc_16, OP_TRUNC_16>();
-      Trunc.first->Arg = Res;
-
-      Res = Trunc.second;
+  else {
+    // The whole product fits in 64bits
+    if (Signed) {
+      Src1 = SignExtend(Src1, Size);
+      Src2 = SignExtend(Src2, Size);
     }
-    break;
-    case 4: {
-      auto Trunc = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-      Trunc.first->Arg = Res;
+    auto Product = BiOp(OP_MUL, Src1, Src2);
+    Low = Truncate(Product, Size);
+    Overflow = Select(IROp_Select::COMP_NEQ, Product, Signed ? SignExtend(Low, Size) : Low, One, Zero);
 
-      Res = Trunc.second;
+    if (Size == 1) {
+      StoreGPR(Op, AccumulatorOperand, Product, 2);
     }
-    break;
-    case 8: break;
-    }
-
-    auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-    StoreOp.first->Size = 8;
-    StoreOp.first->Offset = offsetof(X86State, gregs) + DestReg * 8;
-    StoreOp.first->Arg = Res;
-
-    // Calculate CF value
-    if (0) {
-      uint32_t ShrAmount = (OpSize * 8) - ConstantOp.first->Constant;
-      auto ShrConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-      ShrConstantOp.first->Flags = IR::TYPE_I8;
-      ShrConstantOp.first->Constant = ShrAmount;
-
-      auto ShrOp = IRList.AllocateOp<IROp_Shl, OP_SHR>();
-      ShrOp.first->Args[0] = Src;
-      ShrOp.first->Args[1] = ShrConstantOp.second;
-      SetCF(ShrOp.second);
+    else {
+      StoreGPR(Op, AccumulatorOperand, Low, Size);
+      StoreGPR(Op, DataOperand, BiOp(OP_SHR, Product, LoadConstant(Size * 8)), Size);
     }
   }
-}
-
-void OpDispatchBuilder::XorOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
-  uint32_t SrcReg = 0;
-
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
+  GenerateFlags(Flags::DEFERRED_MUL, Low, Overflow, Zero, Size);
+}
 
-  uint32_t OpSize = 4;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    OpSize = 2;
+void OpDispatchBuilder::IMULOp(Emu::X86Tables::DecodedOp Op) {
+  // 0F AF is Gv = Gv * Ev, 69 and 6B are Gv = Ev * imm and 6B's imm8 is already sign extended
+  // Only the low half is kept, CF and OF say whether it lost anything
+  uint8_t Size = Op->OpSize;
+  auto Src1 = LoadSource(Op, Op->RM, Size);
+  auto Src2 = Op->Op == 0xAF ? LoadSource(Op, Op->Reg, Size) : Truncate(LoadConstant(Op->Imm), Size);
+  auto Zero = LoadConstant(0);
+  auto One = LoadConstant(1);
+
+  AlignmentType Res, Overflow;
+  if (Size == 8) {
+    Res = BiOp(OP_MUL, Src1, Src2);
+    Overflow = Select(IROp_Select::COMP_NEQ, BiOp(OP_SMULH, Src1, Src2), BiOp(OP_ASHR, Res, LoadConstant(63)), One, Zero);
   }
-
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
-
-    if (GetREX_W(REX)) {
-      OpSize = 8;
-    }
-
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
-
-  } else {
-    ModRM = Code[1];
-
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
+  else {
+    auto Product = BiOp(OP_MUL, SignExtend(Src1, Size), SignExtend(Src2, Size));
+    Res = Truncate(Product, Size);
+    Overflow = Select(IROp_Select::COMP_NEQ, Product, SignExtend(Res, Size), One, Zero);
   }
 
-  if (DecodeFailure)
-    return;
-
-  DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-  SrcReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
-
-  auto Src1 = LoadContext(offsetof(X86State, gregs) + DestReg * 8, 8);
-  auto Src2 = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
-
-  Src1 = Truncate(Src1, OpSize);
-  Src2 = Truncate(Src2, OpSize);
-
-  auto XorOp = IRList.AllocateOp<IROp_Xor, OP_XOR>();
-  XorOp.first->Args[0] = Src1;
-  XorOp.first->Args[1] = Src2;
-
-  StoreContext(Truncate(XorOp.second, OpSize), offsetof(X86State, gregs) + DestReg * 8, 8);
+  StoreResult(Op, Op->Reg, Res, Size);
+  GenerateFlags(Flags::DEFERRED_MUL, Res, Overflow, Zero, Size);
 }
 
-void OpDispatchBuilder::MovOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
-  uint32_t SrcReg = 0;
+void OpDispatchBuilder::DIVOp(Emu::X86Tables::DecodedOp Op) {
+  // F6 and F7 /6 is DIV and /7 IDIV, AX or rDX:rAX by ModRM.rm
+  // The quotient goes in AL or rAX and the remainder in AH or rDX, the flags are undefined and left alone
+  uint8_t Size = (Op->Op & 1) ? Op->OpSize : 1;
+  bool Signed = (Op->ModRM >> 3) & 1;
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE)
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  auto Divisor = LoadSource(Op, Op->RM, Size);
+  auto Zero = LoadConstant(0);
 
-  uint8_t ModRM = 0;
-
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    uint8_t REX = Code[0];
-    ModRM = Code[2];
-    DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-    SrcReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
+  // Below 64bits the whole dividend fits in one value, rDX:rAX needs the 128bit divide
+  AlignmentType Low, High, Dividend;
+  if (Size == 1) {
+    Dividend = LoadGPR(Op, AccumulatorOperand, 2);
+    High = BiOp(OP_SHR, Dividend, LoadConstant(8));
   }
   else {
-    ModRM = Code[1];
-    DestReg = MapModRMToReg(GetModRM_RM(ModRM));
-    SrcReg = MapModRMToReg(GetModRM_Reg(ModRM));
+    Low = LoadGPR(Op, AccumulatorOperand, Size);
+    High = LoadGPR(Op, DataOperand, Size);
+    if (Size != 8)
+      Dividend = BiOp(OP_OR, BiOp(OP_SHL, High, LoadConstant(Size * 8)), Low);
   }
 
-  if (GetModRM_Mod(ModRM) != 0b11)
-    DecodeFailure = true;
-
-  if (DecodeFailure)
-    return;
-
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, gregs) + SrcReg * 8;
-
-  AlignmentType ResultOffset = LoadOp.second;
-
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_REX)) {
-    auto Trunc_32Op = IRList.AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
-    Trunc_32Op.first->Arg = LoadOp.second;
-    ResultOffset = Trunc_32Op.second;
+  // A zero divisor or a quotient too big for the operand size is #DE, which the guest sees as SIGFPE
+  AlignmentType Quotient, Remainder;
+  if (!Signed) {
+    // The quotient fits as long as the top half is below the divisor, which rules out 0 too
+    RaiseSignalUnless(IROp_Select::COMP_ULT, High, Divisor, SIGFPE);
+    if (Size == 8) {
+      Quotient = TriOp(OP_LUDIV, Low, High, Divisor);
+      Remainder = TriOp(OP_LUREM, Low, High, Divisor);
+    }
+    else {
+      Quotient = BiOp(OP_UDIV, Dividend, Divisor);
+      Remainder = BiOp(OP_UREM, Dividend, Divisor);
+    }
+  }
+  else if (Size == 8) {
+    // Divide the magnitudes, then the same top half check is exact for the unsigned quotient
+    auto One = LoadConstant(1);
+    auto AbsLow = Select(IROp_Select::COMP_SLT, High, Zero, BiOp(OP_SUB, Zero, Low), Low);
+    auto Borrow = Select(IROp_Select::COMP_NEQ, Low, Zero, One, Zero);
+    auto AbsHigh = Select(IROp_Select::COMP_SLT, High, Zero, BiOp(OP_SUB, BiOp(OP_SUB, Zero, High), Borrow), High);
+    auto AbsDivisor = Select(IROp_Select::COMP_SLT, Divisor, Zero, BiOp(OP_SUB, Zero, Divisor), Divisor);
+    RaiseSignalUnless(IROp_Select::COMP_ULT, AbsHigh, AbsDivisor, SIGFPE);
+
+    auto AbsQuotient = TriOp(OP_LUDIV, AbsLow, AbsHigh, AbsDivisor);
+    auto AbsRemainder = TriOp(OP_LUREM, AbsLow, AbsHigh, AbsDivisor);
+
+    // A negative quotient can go one further than a positive one
+    auto Negative = BiOp(OP_XOR, High, Divisor);
+    auto Limit = Select(IROp_Select::COMP_SLT, Negative, Zero, LoadConstant(1ULL << 63), LoadConstant(~0ULL >> 1));
+    RaiseSignalUnless(IROp_Select::COMP_ULE, AbsQuotient, Limit, SIGFPE);
+
+    // The remainder takes the dividend's sign
+    Quotient = Select(IROp_Select::COMP_SLT, Negative, Zero, BiOp(OP_SUB, Zero, AbsQuotient), AbsQuotient);
+    Remainder = Select(IROp_Select::COMP_SLT, High, Zero, BiOp(OP_SUB, Zero, AbsRemainder), AbsRemainder);
+  }
+  else {
+    // INT64_MIN can only be a 32bit dividend, which overflows whatever the divisor is
+    auto Min = LoadConstant(1ULL << 63);
+    Dividend = SignExtend(Dividend, Size * 2);
+    Divisor = SignExtend(Divisor, Size);
+    RaiseSignalUnless(IROp_Select::COMP_NEQ, Select(IROp_Select::COMP_EQ, Divisor, Zero, Min, Dividend), Min, SIGFPE);
+    Quotient = BiOp(OP_SDIV, Dividend, Divisor);
+    Remainder = BiOp(OP_SREM, Dividend, Divisor);
+
+    // The quotient can still be too big for the operand size
+    RaiseSignalUnless(IROp_Select::COMP_EQ, SignExtend(Quotient, Size), Quotient, SIGFPE);
   }
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, gregs) + DestReg * 8;
-  StoreOp.first->Arg = ResultOffset;
+  if (Size == 1) {
+    auto Res = BiOp(OP_OR, BiOp(OP_SHL, Truncate(Remainder, 1), LoadConstant(8)), Truncate(Quotient, 1));
+    StoreGPR(Op, AccumulatorOperand, Res, 2);
+  }
+  else {
+    StoreGPR(Op, AccumulatorOperand, Quotient, Size);
+    StoreGPR(Op, DataOperand, Remainder, Size);
+  }
 }
 
-void OpDispatchBuilder::BTOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t DestReg = 0;
-  uint32_t SrcReg = 0;
-  uint8_t RexDest = 0;
-  uint8_t RexSrc = 0;
-  uint8_t ModRMOffset = 1;
+template<uint32_t Type>
+void OpDispatchBuilder::JccOp(Emu::X86Tables::DecodedOp Op) {
+  // Skip over the taken path when the condition doesn't hold
+  // With the flag producer in the block this is a single compare and branch on its sources
+  IROp_Select::ComparisonOp Comparison;
+  AlignmentType Src1, Src2;
+  CompareCC(Type ^ 1, &Comparison, &Src1, &Src2);
+  uint64_t RIPTarget = cpu->GetTLSThread()->JITRIP + Op->Size + Op->Imm;
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE)
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  auto JumpOp = IRList.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
+  JumpOp.first->Cond = Comparison;
+  JumpOp.first->Args[0] = Src1;
+  JumpOp.first->Args[1] = Src2;
+  JumpOp.first->RIPTarget = RIPTarget;
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[3];
+  // Taken
+  StoreContext(LoadConstant(RIPTarget), offsetof(X86State, rip), 8);
+  EndBlock(0);
 
-  } else {
-    ModRM = Code[2];
-  }
+  auto TargetOp = IRList.AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
+  JumpOp.first->Target = TargetOp.second;
+}
 
-  if (GetModRM_Mod(ModRM) != 0b11) {
-    DecodeFailure = true;
-  }
+template<uint32_t Type>
+void OpDispatchBuilder::SETccOp(Emu::X86Tables::DecodedOp Op) {
+  StoreResult(Op, Op->RM, GetCondition(Type), 1);
+}
 
-  if (DecodeFailure)
-    return;
+template<uint32_t Type>
+void OpDispatchBuilder::CMOVccOp(Emu::X86Tables::DecodedOp Op) {
+  // The source is read and a 32bit destination zero extended even when the condition doesn't hold
+  auto Src = LoadSource(Op, Op->RM, Op->OpSize);
+  auto Dest = LoadSource(Op, Op->Reg, Op->OpSize);
+  StoreResult(Op, Op->Reg, SelectCC(Type, Src, Dest), Op->OpSize);
+}
 
-  DestReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-  SrcReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
+// The decode tables reference every condition
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_OF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NOF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_C>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NC>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_Z>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NZ>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_BE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NBE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_S>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NS>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_P>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NP>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_L>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NL>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_LE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NLE>(Emu::X86Tables::DecodedOp Op);
+
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_OF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NOF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_C>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NC>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_Z>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NZ>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_BE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NBE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_S>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NS>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_P>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NP>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_L>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NL>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_LE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NLE>(Emu::X86Tables::DecodedOp Op);
+
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_OF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NOF>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_C>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NC>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_Z>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NZ>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_BE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NBE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_S>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NS>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_P>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NP>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_L>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NL>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_LE>(Emu::X86Tables::DecodedOp Op);
+template void OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NLE>(Emu::X86Tables::DecodedOp Op);
+
+void OpDispatchBuilder::RETOp(Emu::X86Tables::DecodedOp Op) {
+  // A 16bit return address is never what 64bit code wants
+  if (Op->OpSize == 2)
+    DISABLE_DECODE();
+
+  // C2 releases another imm16 bytes of arguments after the return address
+  uint64_t Release = Op->Op == 0xC2 ? Op->Imm & 0xFFFF : 0;
+  auto ReturnRIP = Pop(8);
+  if (Release)
+    AdjustStackPointer(Release);
+
+  StoreContext(ReturnRIP, offsetof(X86State, rip), 8);
+}
 
-  auto Src1 = LoadContext(offsetof(X86State, gregs) + DestReg * 8, 8);
-  auto Src2 = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
+void OpDispatchBuilder::PUSHOp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = GetStackOpSize(Op);
 
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I8;
-  ConstantOp.first->Constant = 31;
+  // 50-57 have the register in the opcode, 68 and 6A an immediate and FF /6 take ModRM.rm
+  // The value is read first so PUSH RSP stores the old RSP
+  AlignmentType Value;
+  if (Op->Op == 0x68 || Op->Op == 0x6A)
+    Value = LoadConstant(Op->Imm);
+  else
+    Value = LoadSource(Op, Op->Op == 0xFF ? Op->RM : Op->Reg, Size);
 
-  auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
-  AndOp.first->Args[0] = Src2;
-  AndOp.first->Args[1] = ConstantOp.second;
+  Push(Size, Value);
+}
 
-  auto BitExtractOp = IRList.AllocateOp<IROp_BitExtract, OP_BITEXTRACT>();
-  BitExtractOp.first->Args[0] = Src1;
-  BitExtractOp.first->Args[1] = AndOp.second;
+void OpDispatchBuilder::POPOp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = GetStackOpSize(Op);
 
-  // Result sis stored in CF
-  SetCF(BitExtractOp.second);
+  // 58-5F have the register in the opcode, 8F /0 takes ModRM.rm
+  // RSP is incremented before a memory destination's address is calculated, POP RSP keeps the value it loaded
+  auto Value = Pop(Size);
+  StoreResult(Op, Op->Op == 0x8F ? Op->RM : Op->Reg, Value, Size);
 }
 
-void OpDispatchBuilder::JMPOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  uint32_t SrcReg = 0;
+void OpDispatchBuilder::CALLOp(Emu::X86Tables::DecodedOp Op) {
+  // Near calls always push a 64bit return address in long mode
+  if (Op->OpSize == 2)
+    DISABLE_DECODE();
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_SIB)
-    DecodeFailure = true;
+  uint64_t ReturnRIP = cpu->GetTLSThread()->JITRIP + Op->Size;
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
+  // E8 is relative to the next instruction, FF /2 reads the target before RSP moves
+  AlignmentType Target;
+  if (Op->Op == 0xE8)
+    Target = LoadConstant(ReturnRIP + Op->Imm);
+  else
+    Target = LoadSource(Op, Op->RM, 8);
 
-  uint32_t OpSize = 8;
+  // Nothing steps a call that fails part way, don't leave RSP moved
+  if (DecodeFailure)
+    return;
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
-    printf("Hit REX %02x %02x\n", REX, ModRM);
-  } else {
-    ModRM = Code[1];
-  }
+  Push(8, LoadConstant(ReturnRIP));
+  StoreContext(Target, offsetof(X86State, rip), 8);
+}
 
-  if (GetModRM_Mod(ModRM) != 0b11)
-    DecodeFailure = true;
+void OpDispatchBuilder::LEAVEOp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = GetStackOpSize(Op);
 
+  // RSP = RBP, then pop RBP
+  StoreContext(LoadGPR(Op, FramePointerOperand, 8), offsetof(X86State, gregs[REG_RSP]), 8);
+  StoreGPR(Op, FramePointerOperand, Pop(Size), Size);
+}
 
-  if (DecodeFailure)
-    return;
+void OpDispatchBuilder::ENTEROp(Emu::X86Tables::DecodedOp Op) {
+  uint8_t Size = GetStackOpSize(Op);
+  uint64_t FrameSize = Op->Imm & 0xFFFF;
+  uint8_t Level = (Op->Imm >> 16) & 0x1F;
 
-  SrcReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
+  // Nested frames copy the enclosing frame pointers, leave those to Unicorn
+  if (Level != 0)
+    DISABLE_DECODE();
 
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, gregs) + SrcReg * 8;
+  // RBP = the RSP that RBP was pushed to, then the frame is allocated below it
+  Push(Size, LoadGPR(Op, FramePointerOperand, Size));
+  StoreGPR(Op, FramePointerOperand, GetStackPointer(), Size);
+  AdjustStackPointer(-static_cast<int64_t>(FrameSize));
+}
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, rip);
-  StoreOp.first->Arg = LoadOp.second;
+void OpDispatchBuilder::MovOp(Emu::X86Tables::DecodedOp Op) {
+  // 88 and 89 move in to ModRM.rm, 8A and 8B in to ModRM.reg. The even opcodes are the byte forms
+  bool DestRM = !(Op->Op & 0b10);
+  uint8_t OpSize = (Op->Op & 1) ? Op->OpSize : 1;
+  auto const &DestOperand = DestRM ? Op->RM : Op->Reg;
+  auto const &SrcOperand = DestRM ? Op->Reg : Op->RM;
 
-  printf("JMP Op Reg %d(%d %d)! %d\n", SrcReg, GetREX_B(REX), GetModRM_RM(ModRM),  OpSize);
+  StoreResult(Op, DestOperand, LoadSource(Op, SrcOperand, OpSize), OpSize);
 }
 
-void OpDispatchBuilder::LEAOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-//  DISABLE_DECODE();
-
-  bool SIB = !!(Op.second.Flags & X86Tables::DECODE_FLAG_SIB);
-  uint32_t DestReg = 0;
-  uint32_t SrcReg = 0;
+void OpDispatchBuilder::MovImmOp(Emu::X86Tables::DecodedOp Op) {
+  // B0-BF have the register in the opcode, C6 and C7 take ModRM.rm
+  bool DestRM = Op->Op == 0xC6 || Op->Op == 0xC7;
+  bool ByteForm = Op->Op == 0xC6 || (Op->Op & 0xF8) == 0xB0;
+  uint8_t OpSize = ByteForm ? 1 : Op->OpSize;
 
-  if (!(Op.second.Flags & X86Tables::DECODE_FLAG_MODRM))
-    DecodeFailure = true;
+  // The rest of the C6 and C7 groups are XABORT and XBEGIN
+  if (DestRM && ((Op->ModRM >> 3) & 0b111) != 0)
+    DISABLE_DECODE();
 
-  uint8_t REX = 0;
-  uint8_t ModRM = 0;
-  AlignmentType Src;
+  StoreResult(Op, DestRM ? Op->RM : Op->Reg, Truncate(LoadConstant(Op->Imm), OpSize), OpSize);
+}
 
-  uint32_t OpSize = 4;
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_OPSIZE) {
-    OpSize = 2;
-  }
+void OpDispatchBuilder::BTOp(Emu::X86Tables::DecodedOp Op) {
+  // A register bit offset can reach outside of a memory operand
+  if (Op->RM.Type != X86Tables::OPERAND_GPR)
+    DISABLE_DECODE();
 
-  if (Op.second.Flags & X86Tables::DECODE_FLAG_REX) {
-    REX = Code[0];
-    ModRM = Code[2];
+  uint8_t OpSize = Op->OpSize;
+  auto Src1 = LoadSource(Op, Op->RM, OpSize);
+  auto Src2 = LoadSource(Op, Op->Reg, OpSize);
 
-    if (GetREX_W(REX)) {
-      OpSize = 8;
-    }
-    uint8_t Mod = GetModRM_Mod(ModRM);
-    uint8_t RM = GetModRM_RM(ModRM);
-    uint8_t Reg = GetModRM_Reg(ModRM);
-    if (Mod != 0b11 && Reg != 0b100) {
- //     printf("XXX: SIB ModRM without Byte!!Mod: %d Src: %s Base? :%s\n",
- //         Mod,
- //         RegToString(MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM))).c_str(),
- //         RegToString(MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM))).c_str()
- //         );
-      if (Mod == 0b10) {
-        // Register + Displacement32
-        DestReg = MapModRMToReg(GetREX_R(REX), GetModRM_Reg(ModRM));
-        SrcReg = MapModRMToReg(GetREX_B(REX), GetModRM_RM(ModRM));
-        Src = LoadContext(offsetof(X86State, gregs) + SrcReg * 8, 8);
-
-        uint64_t Const = *(int32_t*)&Code[Op.second.Size - 4];
-        auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-
-        ConstantOp.first->Flags = IR::TYPE_I64;
-        ConstantOp.first->Constant = Const;
-
-        auto AddOp = IRList.AllocateOp<IROp_Add, OP_ADD>();
-        AddOp.first->Args[0] = Src;
-        AddOp.first->Args[1] = ConstantOp.second;
-
-        Src = AddOp.second;
-      }
-      else {
-        DecodeFailure = true;
-      }
-    }
-    else
-      DecodeFailure = true;
+  // Register bit offsets wrap at the operand size
+  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
+  ConstantOp.first->Flags = IR::TYPE_I8;
+  ConstantOp.first->Constant = OpSize * 8 - 1;
 
-  } else {
-    ModRM = Code[1];
+  auto BitExtract = BiOp(OP_BITEXTRACT, Src1, BiOp(OP_AND, Src2, ConstantOp.second));
 
-    DecodeFailure = true;
-    if (GetModRM_Mod(ModRM) != 0b11)
-      DecodeFailure = true;
-  }
+  // Result is stored in CF
+  SetCF(BitExtract);
+}
 
-//    DecodeFailure = true;
+void OpDispatchBuilder::JMPOp(Emu::X86Tables::DecodedOp Op) {
+  // Always a 64bit target in long mode
+  StoreContext(LoadSource(Op, Op->RM, 8), offsetof(X86State, rip), 8);
+}
 
-  if (DecodeFailure)
-    return;
+void OpDispatchBuilder::LEAOp(Emu::X86Tables::DecodedOp Op) {
+  // The register form is a #UD
+  if (Op->RM.Type == X86Tables::OPERAND_GPR)
+    DISABLE_DECODE();
 
-  // 48 8d 97 90 01 00 00    lea    rdx,[rdi+0x190]
-  StoreContext(Src, offsetof(X86State, gregs) + DestReg * 8, 8);
+  // LEA ignores segment overrides
+  auto Address = GetEffectiveAddress(Op, Op->RM, false);
+  StoreResult(Op, Op->Reg, Truncate(Address, Op->OpSize), Op->OpSize);
 }
 
-void OpDispatchBuilder::SyscallOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
-  std::array<AlignmentType, 6> ArgOffsets;
+void OpDispatchBuilder::SyscallOp(Emu::X86Tables::DecodedOp Op) {
+  std::array<AlignmentType, IROp_Syscall::MAX_ARGS> ArgOffsets;
   std::array<uint64_t, 7> GPRIndexes = {
     REG_RAX,
     REG_RDI,
@@ -970,7 +846,12 @@ void OpDispatchBuilder::SyscallOp(Emu::X86Tables::DecodedOp Op, uint8_t const *C
     REG_R8,
     REG_R9,
   };
-  for (int i = 0; i < IROp_Syscall::MAX_ARGS; ++i) {
+
+  // The syscall handler and anything it spawns only knows about RFLAGS and X86State's RSP
+  MaterializeFlags();
+  StoreStackPointer();
+
+  for (size_t i = 0; i < IROp_Syscall::MAX_ARGS; ++i) {
     auto Arg = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
     Arg.first->Size = 8;
     Arg.first->Offset = offsetof(X86State, gregs) + GPRIndexes[i] * 8;
@@ -978,7 +859,7 @@ void OpDispatchBuilder::SyscallOp(Emu::X86Tables::DecodedOp Op, uint8_t const *C
   }
 
   auto SyscallOp = IRList.AllocateOp<IROp_Syscall, OP_SYSCALL>();
-  for (int i = 0; i < IROp_Syscall::MAX_ARGS; ++i) {
+  for (size_t i = 0; i < IROp_Syscall::MAX_ARGS; ++i) {
     SyscallOp.first->Arguments[i] = ArgOffsets[i];
   }
 
@@ -986,229 +867,608 @@ void OpDispatchBuilder::SyscallOp(Emu::X86Tables::DecodedOp Op, uint8_t const *C
   StoreOp.first->Size = 8;
   StoreOp.first->Offset = offsetof(X86State, gregs[REG_RAX]);
   StoreOp.first->Arg = SyscallOp.second;
+
+  // rt_sigreturn and friends can hand back a different RSP
+  StackPointer = {};
 }
 
-void OpDispatchBuilder::UnknownOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
+void OpDispatchBuilder::UnknownOp(Emu::X86Tables::DecodedOp Op) {
   std::ostringstream str;
-  str << "Unknown Op: " << Op.first->Name << " 0x";
-  for (int i = 0; i < 4; ++i) {
-    str << " " << std::setw(2) << std::setfill('0') << std::hex << (uint32_t)Code[i];
-  }
+  str << "Unknown Op: " << Op->TableInfo->Name << " 0x" << std::setw(2) << std::setfill('0') << std::hex << (uint32_t)Op->Op;
   LogMan::Msg::A(str.str().c_str());
 }
 
-void OpDispatchBuilder::NoOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code) {
+void OpDispatchBuilder::NoOp(Emu::X86Tables::DecodedOp Op) {
 }
 
-void OpDispatchBuilder::SetCF(AlignmentType Value) {
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, rflags);
+AlignmentType OpDispatchBuilder::LoadGPR(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, uint8_t Size) {
+  // Without a REX the byte forms of RSP, RBP, RSI and RDI are AH, CH, DH and BH
+  bool HighByte = Size == 1 && !(Op->Flags & X86Tables::DECODE_FLAG_REX) && Operand.Reg >= 4 && Operand.Reg < 8;
+  uint8_t Reg = HighByte ? Operand.Reg - 4 : Operand.Reg;
 
-  // Value put in in to the CF is in bit 0 of Value
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
+  auto Value = LoadContext(offsetof(X86State, gregs) + MapModRMToReg(Reg) * 8, 8);
+  if (HighByte)
+    Value = BiOp(OP_SHR, Value, LoadConstant(8));
+  return Truncate(Value, Size);
+}
 
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = 1;
+void OpDispatchBuilder::StoreGPR(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, AlignmentType Value, uint8_t Size) {
+  bool HighByte = Size == 1 && !(Op->Flags & X86Tables::DECODE_FLAG_REX) && Operand.Reg >= 4 && Operand.Reg < 8;
+  uint8_t Reg = HighByte ? Operand.Reg - 4 : Operand.Reg;
+  uint64_t Offset = offsetof(X86State, gregs) + MapModRMToReg(Reg) * 8;
 
-  auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
-  AndOp.first->Args[0] = Value;
-  AndOp.first->Args[1] = ConstantOp.second;
+  // 32bit writes zero the upper half, 8bit and 16bit writes leave the rest of the register alone
+  if (Size >= 4) {
+    StoreContext(Truncate(Value, Size), Offset, 8);
+    return;
+  }
 
-  auto NandOp = IRList.AllocateOp<IROp_Nand, OP_NAND>();
-  NandOp.first->Args[0] = LoadOp.second;
-  NandOp.first->Args[1] = ConstantOp.second;
+  uint64_t Shift = HighByte ? 8 : 0;
+  uint64_t Mask = ((1ULL << (Size * 8)) - 1) << Shift;
 
-  auto OrOp = IRList.AllocateOp<IROp_Or, OP_OR>();
-  OrOp.first->Args[0] = AndOp.second;
-  OrOp.first->Args[1] = NandOp.second;
+  auto Insert = Truncate(Value, Size);
+  if (Shift)
+    Insert = BiOp(OP_SHL, Insert, LoadConstant(Shift));
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, rflags);
-  StoreOp.first->Arg = OrOp.second;
+  auto Old = BiOp(OP_NAND, LoadContext(Offset, 8), LoadConstant(Mask));
+  StoreContext(BiOp(OP_OR, Old, Insert), Offset, 8);
 }
 
-void OpDispatchBuilder::SetZF(AlignmentType Value) {
-  constexpr uint32_t BIT_LOCATION = 6;
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, rflags);
+AlignmentType OpDispatchBuilder::GetEffectiveAddress(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, bool AddSegmentBase, AlignmentType *IndexOut) {
+  // Displacement and RIP fold in to a single constant
+  uint64_t Displacement = static_cast<int64_t>(Operand.Displacement);
+  AlignmentType Base = ~0U;
+  AlignmentType Index = ~0U;
 
-  // Value put in in to the ZF is in bit 0 of Value
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = 1;
+  if (Operand.Type == X86Tables::OPERAND_RIP_RELATIVE) {
+    Displacement += cpu->GetTLSThread()->JITRIP + Op->Size;
+  }
+  else {
+    if (Operand.Reg != X86Tables::INVALID_REG)
+      Base = LoadContext(GPROffset(Operand), 8);
 
-  auto ZFBitConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ZFBitConstant.first->Flags = IR::TYPE_I64;
-  ZFBitConstant.first->Constant = (1 << BIT_LOCATION);
+    if (Operand.Index != X86Tables::INVALID_REG) {
+      Index = LoadContext(offsetof(X86State, gregs) + MapModRMToReg(Operand.Index) * 8, 8);
+      if (Operand.Scale != 1)
+        Index = BiOp(OP_SHL, Index, LoadConstant(__builtin_ctz(Operand.Scale)));
+    }
+  }
 
-  auto ShiftConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ShiftConstant.first->Flags = IR::TYPE_I64;
-  ShiftConstant.first->Constant = BIT_LOCATION;
+  AlignmentType Address;
+  if (Base == ~0U && Displacement == 0 && Index != ~0U) {
+    // [Index * Scale]
+    Address = Index;
+    Index = ~0U;
+  }
+  else if (Base == ~0U) {
+    Address = LoadConstant(Displacement);
+  }
+  else {
+    Address = Displacement ? BiOp(OP_ADD, Base, LoadConstant(Displacement)) : Base;
+  }
 
-  // Clear the rest of the bits
-  auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
-  AndOp.first->Args[0] = Value;
-  AndOp.first->Args[1] = ConstantOp.second;
+  // A 64bit address can leave the index for the load to add, 32bit addresses wrap before the segment base goes on
+  bool SplitIndex = IndexOut && Op->AddrSize == 8;
+  if (Index != ~0U && !SplitIndex) {
+    Address = BiOp(OP_ADD, Address, Index);
+    Index = ~0U;
+  }
 
-  // Shift in to the correct position
-  auto ShiftOp = IRList.AllocateOp<IROp_Shl, OP_SHL>();
-  ShiftOp.first->Args[0] = AndOp.second;
-  ShiftOp.first->Args[1] = ShiftConstant.second;
+  if (Op->AddrSize == 4)
+    Address = Truncate(Address, 4);
 
-  // Clear the location in the FLAGS
-  auto NandOp = IRList.AllocateOp<IROp_Nand, OP_NAND>();
-  NandOp.first->Args[0] = LoadOp.second;
-  NandOp.first->Args[1] = ZFBitConstant.second;
+  // CS, DS, ES and SS have no base in long mode
+  if (AddSegmentBase && (Op->Flags & X86Tables::DECODE_FLAG_FS))
+    Address = BiOp(OP_ADD, Address, LoadContext(offsetof(X86State, fs), 8));
+  else if (AddSegmentBase && (Op->Flags & X86Tables::DECODE_FLAG_GS))
+    Address = BiOp(OP_ADD, Address, LoadContext(offsetof(X86State, gs), 8));
 
-  // Or the values together
-  auto OrOp = IRList.AllocateOp<IROp_Or, OP_OR>();
-  OrOp.first->Args[0] = ShiftOp.second;
-  OrOp.first->Args[1] = NandOp.second;
+  if (IndexOut)
+    *IndexOut = Index;
+  return Address;
+}
+
+AlignmentType OpDispatchBuilder::LoadMem(uint8_t Size, AlignmentType Address, AlignmentType Index, bool SignExtend) {
+  auto LoadMemOp = IRList.AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
+  LoadMemOp.first->Size = Size;
+  LoadMemOp.first->SignExtend = SignExtend;
+  LoadMemOp.first->Arg[0] = Address;
+  LoadMemOp.first->Arg[1] = Index;
+  return LoadMemOp.second;
+}
 
+void OpDispatchBuilder::StoreMem(uint8_t Size, AlignmentType Value, AlignmentType Address, AlignmentType Index) {
+  auto StoreMemOp = IRList.AllocateOp<IROp_StoreMem, OP_STORE_MEM>();
+  StoreMemOp.first->Size = Size;
+  StoreMemOp.first->Arg[0] = Value;
+  StoreMemOp.first->Arg[1] = Address;
+  StoreMemOp.first->Arg[2] = Index;
+}
+
+AlignmentType OpDispatchBuilder::GetStackPointer() {
+  if (StackPointer.Base == ~0U)
+    return LoadContext(offsetof(X86State, gregs[REG_RSP]), 8);
+
+  if (StackPointer.Offset == 0)
+    return StackPointer.Base;
+
+  return BiOp(OP_ADD, StackPointer.Base, LoadConstant(StackPointer.Offset));
+}
+
+void OpDispatchBuilder::AdjustStackPointer(int64_t Amount) {
+  // Make sure there is a base to offset from
+  if (StackPointer.Base == ~0U)
+    GetStackPointer();
+  StackPointer.Offset += Amount;
+  StackPointer.Pending = true;
+}
+
+void OpDispatchBuilder::StoreStackPointer() {
+  if (!StackPointer.Pending)
+    return;
+
+  // Straight to the op, StoreContext would only hand it back to StackPointer
+  auto Value = GetStackPointer();
   auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
   StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, rflags);
-  StoreOp.first->Arg = OrOp.second;
+  StoreOp.first->Offset = offsetof(X86State, gregs[REG_RSP]);
+  StoreOp.first->Arg = Value;
+  StackPointer.Pending = false;
+}
+
+void OpDispatchBuilder::Push(uint8_t Size, AlignmentType Value) {
+  AdjustStackPointer(-static_cast<int64_t>(Size));
+  StoreMem(Size, Value, GetStackPointer());
+}
+
+AlignmentType OpDispatchBuilder::Pop(uint8_t Size) {
+  auto Value = LoadMem(Size, GetStackPointer());
+  AdjustStackPointer(Size);
+  return Value;
+}
+
+AlignmentType OpDispatchBuilder::LoadSource(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, uint8_t Size) {
+  switch (Operand.Type) {
+  case X86Tables::OPERAND_GPR:
+    return LoadGPR(Op, Operand, Size);
+  case X86Tables::OPERAND_MEMORY:
+  case X86Tables::OPERAND_RIP_RELATIVE: {
+    AlignmentType Index;
+    auto Address = GetEffectiveAddress(Op, Operand, true, &Index);
+    return LoadMem(Size, Address, Index);
+  }
+  default:
+    DecodeFailure = true;
+    return ~0U;
+  }
+}
+
+void OpDispatchBuilder::StoreResult(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, AlignmentType Value, uint8_t Size) {
+  switch (Operand.Type) {
+  case X86Tables::OPERAND_GPR:
+    StoreGPR(Op, Operand, Value, Size);
+  break;
+  case X86Tables::OPERAND_MEMORY:
+  case X86Tables::OPERAND_RIP_RELATIVE: {
+    AlignmentType Index;
+    auto Address = GetEffectiveAddress(Op, Operand, true, &Index);
+    StoreMem(Size, Value, Address, Index);
+  break;
+  }
+  default:
+    DecodeFailure = true;
+  break;
+  }
 }
 
-void OpDispatchBuilder::SetSF(AlignmentType Value) {
-  constexpr uint32_t BIT_LOCATION = 7;
+void OpDispatchBuilder::SetRFLAG(AlignmentType Value, uint32_t BitLocation) {
+  // Inserting a single bit requires the rest of RFLAGS to be real
+  MaterializeFlags();
+
   auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
   LoadOp.first->Size = 8;
   LoadOp.first->Offset = offsetof(X86State, rflags);
 
-  // Value put in in to the SF is in bit 0 of Value
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = 1;
-
-  auto SFBitConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  SFBitConstant.first->Flags = IR::TYPE_I64;
-  SFBitConstant.first->Constant = (1 << BIT_LOCATION);
-
-  auto ShiftConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ShiftConstant.first->Flags = IR::TYPE_I64;
-  ShiftConstant.first->Constant = BIT_LOCATION;
+  // Value put in to the flag is in bit 0 of Value
+  auto OneConstant = LoadConstant(1);
+  auto BitConstant = LoadConstant(1ULL << BitLocation);
+  auto ShiftConstant = LoadConstant(BitLocation);
 
   // Clear the rest of the bits
   auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
   AndOp.first->Args[0] = Value;
-  AndOp.first->Args[1] = ConstantOp.second;
+  AndOp.first->Args[1] = OneConstant;
 
   // Shift in to the correct position
   auto ShiftOp = IRList.AllocateOp<IROp_Shl, OP_SHL>();
   ShiftOp.first->Args[0] = AndOp.second;
-  ShiftOp.first->Args[1] = ShiftConstant.second;
+  ShiftOp.first->Args[1] = ShiftConstant;
 
   // Clear the location in the FLAGS
   auto NandOp = IRList.AllocateOp<IROp_Nand, OP_NAND>();
   NandOp.first->Args[0] = LoadOp.second;
-  NandOp.first->Args[1] = SFBitConstant.second;
+  NandOp.first->Args[1] = BitConstant;
 
   // Or the values together
   auto OrOp = IRList.AllocateOp<IROp_Or, OP_OR>();
   OrOp.first->Args[0] = ShiftOp.second;
   OrOp.first->Args[1] = NandOp.second;
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, rflags);
-  StoreOp.first->Arg = OrOp.second;
+  StoreContext(OrOp.second, offsetof(X86State, rflags), 8);
 }
 
-void OpDispatchBuilder::SetOF(AlignmentType Value) {
-  constexpr uint32_t BIT_LOCATION = 11;
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, rflags);
+void OpDispatchBuilder::GenerateFlags(Flags::DeferredOp Op, AlignmentType Res, AlignmentType Src1, AlignmentType Src2, uint8_t Size) {
+  // Only record what generated the flags, they get calculated once something reads them
+  // The context doesn't see the producer until something outside of the block could, a later producer in the block replaces it for free
+  DeferredFlags.Pending = true;
+  DeferredFlags.Known = true;
+  DeferredFlags.Op = Op;
+  DeferredFlags.Size = Size;
+  DeferredFlags.Src1 = Src1;
+  DeferredFlags.Src2 = Src2;
+  DeferredFlags.Res = Res;
+}
 
-  // Value put in in to the OF is in bit 0 of Value
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = 1;
+void OpDispatchBuilder::StoreDeferredFlags() {
+  if (!DeferredFlags.Pending)
+    return;
 
-  auto OFBitConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  OFBitConstant.first->Flags = IR::TYPE_I64;
-  OFBitConstant.first->Constant = (1 << BIT_LOCATION);
+  StoreContext(LoadConstant(DeferredFlags.Op), offsetof(X86State, flags_op), 8);
+  StoreContext(LoadConstant(DeferredFlags.Size), offsetof(X86State, flags_size), 8);
+  StoreContext(DeferredFlags.Src1, offsetof(X86State, flags_src1), 8);
+  StoreContext(DeferredFlags.Src2, offsetof(X86State, flags_src2), 8);
+  StoreContext(DeferredFlags.Res, offsetof(X86State, flags_res), 8);
+  DeferredFlags.Pending = false;
+}
 
-  auto ShiftConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ShiftConstant.first->Flags = IR::TYPE_I64;
-  ShiftConstant.first->Constant = BIT_LOCATION;
+void OpDispatchBuilder::MaterializeFlags() {
+  if (DeferredFlags.Known && DeferredFlags.Op == Flags::DEFERRED_NONE)
+    return;
 
-  // Clear the rest of the bits
-  auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
-  AndOp.first->Args[0] = Value;
-  AndOp.first->Args[1] = ConstantOp.second;
+  StoreDeferredFlags();
+  IRList.AllocateOp<IROp_MaterializeFlags, OP_MATERIALIZE_FLAGS>();
+  DeferredFlags.Known = true;
+  DeferredFlags.Op = Flags::DEFERRED_NONE;
+}
 
-  // Shift in to the correct position
-  auto ShiftOp = IRList.AllocateOp<IROp_Shl, OP_SHL>();
-  ShiftOp.first->Args[0] = AndOp.second;
-  ShiftOp.first->Args[1] = ShiftConstant.second;
+AlignmentType OpDispatchBuilder::CalculateDeferredFlagBit(uint32_t bit) {
+  // The flag producer is in this block so we can calculate directly from its values
+  // Returns ~0 if the flag isn't worth inlining
+  auto Src1 = DeferredFlags.Src1;
+  auto Src2 = DeferredFlags.Src2;
+  auto Res = DeferredFlags.Res;
+  auto MSB = LoadConstant(DeferredFlags.Size * 8 - 1);
 
-  // Clear the location in the FLAGS
-  auto NandOp = IRList.AllocateOp<IROp_Nand, OP_NAND>();
-  NandOp.first->Args[0] = LoadOp.second;
-  NandOp.first->Args[1] = OFBitConstant.second;
+  switch (bit) {
+  case Flags::FLAG_ZF_LOC: {
+    auto ZeroConstant = LoadConstant(0);
+    auto OneConstant = LoadConstant(1);
 
-  // Or the values together
-  auto OrOp = IRList.AllocateOp<IROp_Or, OP_OR>();
-  OrOp.first->Args[0] = ShiftOp.second;
-  OrOp.first->Args[1] = NandOp.second;
+    auto SelectOp = IRList.AllocateOp<IROp_Select, OP_SELECT>();
+    SelectOp.first->Op = IROp_Select::COMP_EQ;
+    SelectOp.first->Args[0] = Res;
+    SelectOp.first->Args[1] = ZeroConstant;
+    SelectOp.first->Args[2] = OneConstant;
+    SelectOp.first->Args[3] = ZeroConstant;
+    return SelectOp.second;
+  }
+  case Flags::FLAG_SF_LOC:
+    return BiOp(OP_BITEXTRACT, Res, MSB);
+  default:
+  break;
+  }
 
-  auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
-  StoreOp.first->Size = 8;
-  StoreOp.first->Offset = offsetof(X86State, rflags);
-  StoreOp.first->Arg = OrOp.second;
+  switch (DeferredFlags.Op) {
+  case Flags::DEFERRED_ADD:
+  case Flags::DEFERRED_ADC:
+    if (bit == Flags::FLAG_CF_LOC) {
+      // Carry out of the top bit: (a & b) | ((a | b) & ~res)
+      auto Carry = BiOp(OP_OR, BiOp(OP_AND, Src1, Src2), BiOp(OP_NAND, BiOp(OP_OR, Src1, Src2), Res));
+      return BiOp(OP_BITEXTRACT, Carry, MSB);
+    }
+    else if (bit == Flags::FLAG_OF_LOC) {
+      // (a ^ res) & (b ^ res)
+      auto Overflow = BiOp(OP_AND, BiOp(OP_XOR, Src1, Res), BiOp(OP_XOR, Src2, Res));
+      return BiOp(OP_BITEXTRACT, Overflow, MSB);
+    }
+  break;
+  case Flags::DEFERRED_SUB:
+  case Flags::DEFERRED_SBB:
+    if (bit == Flags::FLAG_CF_LOC) {
+      // Borrow out of the top bit: (~a & b) | (~(a ^ b) & res)
+      auto Borrow = BiOp(OP_OR, BiOp(OP_NAND, Src2, Src1), BiOp(OP_NAND, Res, BiOp(OP_XOR, Src1, Src2)));
+      return BiOp(OP_BITEXTRACT, Borrow, MSB);
+    }
+    else if (bit == Flags::FLAG_OF_LOC) {
+      // (a ^ b) & (a ^ res)
+      auto Overflow = BiOp(OP_AND, BiOp(OP_XOR, Src1, Src2), BiOp(OP_XOR, Src1, Res));
+      return BiOp(OP_BITEXTRACT, Overflow, MSB);
+    }
+  break;
+  case Flags::DEFERRED_LOGIC:
+    if (bit == Flags::FLAG_CF_LOC || bit == Flags::FLAG_OF_LOC)
+      return LoadConstant(0);
+  break;
+  case Flags::DEFERRED_INC:
+  case Flags::DEFERRED_DEC:
+    if (bit == Flags::FLAG_CF_LOC) {
+      return Src2;
+    }
+    else if (bit == Flags::FLAG_OF_LOC) {
+      // res & ~a for INC, a & ~res for DEC
+      bool Inc = DeferredFlags.Op == Flags::DEFERRED_INC;
+      return BiOp(OP_BITEXTRACT, Inc ? BiOp(OP_NAND, Res, Src1) : BiOp(OP_NAND, Src1, Res), MSB);
+    }
+  break;
+  case Flags::DEFERRED_SHL:
+    if (bit == Flags::FLAG_CF_LOC || bit == Flags::FLAG_OF_LOC) {
+      // Last bit shifted out of the top, OF is whether it differs from the new top bit
+      auto Carry = BiOp(OP_BITEXTRACT, BiOp(OP_SHL, Src1, BiOp(OP_SUB, Src2, LoadConstant(1))), MSB);
+      if (bit == Flags::FLAG_CF_LOC)
+        return Carry;
+      return BiOp(OP_XOR, Carry, BiOp(OP_BITEXTRACT, Res, MSB));
+    }
+  break;
+  case Flags::DEFERRED_SHR:
+    if (bit == Flags::FLAG_CF_LOC)
+      return BiOp(OP_BITEXTRACT, Src1, BiOp(OP_SUB, Src2, LoadConstant(1)));
+    else if (bit == Flags::FLAG_OF_LOC)
+      return BiOp(OP_BITEXTRACT, Src1, MSB);
+  break;
+  case Flags::DEFERRED_SAR:
+    if (bit == Flags::FLAG_CF_LOC) {
+      // Counts past the operand size shift in copies of the sign bit
+      auto Signed = Src1;
+      if (DeferredFlags.Size != 8) {
+        auto Amount = LoadConstant(64 - DeferredFlags.Size * 8);
+        Signed = BiOp(OP_ASHR, BiOp(OP_SHL, Src1, Amount), Amount);
+      }
+      return BiOp(OP_BITEXTRACT, Signed, BiOp(OP_SUB, Src2, LoadConstant(1)));
+    }
+    else if (bit == Flags::FLAG_OF_LOC) {
+      return LoadConstant(0);
+    }
+  break;
+  case Flags::DEFERRED_MUL:
+    if (bit == Flags::FLAG_CF_LOC || bit == Flags::FLAG_OF_LOC)
+      return Src1;
+  break;
+  default:
+  break;
+  }
+
+  return ~0U;
 }
 
-AlignmentType OpDispatchBuilder::GetFlagBit(uint32_t bit, bool negate) {
-  auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
-  LoadOp.first->Size = 8;
-  LoadOp.first->Offset = offsetof(X86State, rflags);
+bool OpDispatchBuilder::GetConditionCompare(uint32_t Type, IROp_Select::ComparisonOp *Comparison, AlignmentType *Src1, AlignmentType *Src2) {
+  // Only when the flag producer is in this block, its sources are still around to compare directly
+  if (!DeferredFlags.Known)
+    return false;
 
-  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ConstantOp.first->Flags = IR::TYPE_I64;
-  ConstantOp.first->Constant = 1;
+  // Values are zero extended from the operand size, shifting them to the top makes signed comparisons work at any size
+  auto SignBits = [this](AlignmentType Value) {
+    if (DeferredFlags.Size == 8)
+      return Value;
+    return BiOp(OP_SHL, Value, LoadConstant(64 - DeferredFlags.Size * 8));
+  };
 
-  auto BitConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  BitConstant.first->Flags = IR::TYPE_I64;
-  BitConstant.first->Constant = (1 << bit);
+  switch (DeferredFlags.Op) {
+  case Flags::DEFERRED_SUB: {
+    bool Signed = false;
+    switch (Type) {
+    case CC_Z:   *Comparison = IROp_Select::COMP_EQ;  break;
+    case CC_NZ:  *Comparison = IROp_Select::COMP_NEQ; break;
+    case CC_C:   *Comparison = IROp_Select::COMP_ULT; break;
+    case CC_NC:  *Comparison = IROp_Select::COMP_UGE; break;
+    case CC_BE:  *Comparison = IROp_Select::COMP_ULE; break;
+    case CC_NBE: *Comparison = IROp_Select::COMP_UGT; break;
+    case CC_L:   *Comparison = IROp_Select::COMP_SLT; Signed = true; break;
+    case CC_NL:  *Comparison = IROp_Select::COMP_SGE; Signed = true; break;
+    case CC_LE:  *Comparison = IROp_Select::COMP_SLE; Signed = true; break;
+    case CC_NLE: *Comparison = IROp_Select::COMP_SGT; Signed = true; break;
+    case CC_S:
+    case CC_NS:
+      *Comparison = Type == CC_S ? IROp_Select::COMP_SLT : IROp_Select::COMP_SGE;
+      *Src1 = SignBits(DeferredFlags.Res);
+      *Src2 = LoadConstant(0);
+      return true;
+    default: return false;
+    }
 
-  auto ShiftConstant = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
-  ShiftConstant.first->Flags = IR::TYPE_I64;
-  ShiftConstant.first->Constant = bit;
+    *Src1 = Signed ? SignBits(DeferredFlags.Src1) : DeferredFlags.Src1;
+    *Src2 = Signed ? SignBits(DeferredFlags.Src2) : DeferredFlags.Src2;
+    return true;
+  }
+  case Flags::DEFERRED_ADD:
+    if (Type == CC_C || Type == CC_NC) {
+      // The truncated result wraps below the first source when it carries
+      *Comparison = Type == CC_C ? IROp_Select::COMP_ULT : IROp_Select::COMP_UGE;
+      *Src1 = DeferredFlags.Res;
+      *Src2 = DeferredFlags.Src1;
+      return true;
+    }
+    [[fallthrough]];
+  case Flags::DEFERRED_ADC:
+  case Flags::DEFERRED_SBB:
+  case Flags::DEFERRED_INC:
+  case Flags::DEFERRED_DEC:
+  case Flags::DEFERRED_SHL:
+  case Flags::DEFERRED_SHR:
+  case Flags::DEFERRED_SAR:
+  case Flags::DEFERRED_MUL:
+    // Anything that needs CF or OF has to go through the flag bits
+    switch (Type) {
+    case CC_Z:  *Comparison = IROp_Select::COMP_EQ;  break;
+    case CC_NZ: *Comparison = IROp_Select::COMP_NEQ; break;
+    case CC_S:  *Comparison = IROp_Select::COMP_SLT; break;
+    case CC_NS: *Comparison = IROp_Select::COMP_SGE; break;
+    default: return false;
+    }
 
-  auto AndOp = IRList.AllocateOp<IROp_And, OP_AND>();
-  AndOp.first->Args[0] = LoadOp.second;
-  AndOp.first->Args[1] = BitConstant.second;
+    *Src1 = SignBits(DeferredFlags.Res);
+    *Src2 = LoadConstant(0);
+    return true;
+  case Flags::DEFERRED_LOGIC:
+    // Logic ops clear CF and OF, everything left is the result against zero
+    switch (Type) {
+    case CC_Z:
+    case CC_BE:  *Comparison = IROp_Select::COMP_EQ;  break;
+    case CC_NZ:
+    case CC_NBE: *Comparison = IROp_Select::COMP_NEQ; break;
+    case CC_S:
+    case CC_L:   *Comparison = IROp_Select::COMP_SLT; break;
+    case CC_NS:
+    case CC_NL:  *Comparison = IROp_Select::COMP_SGE; break;
+    case CC_LE:  *Comparison = IROp_Select::COMP_SLE; break;
+    case CC_NLE: *Comparison = IROp_Select::COMP_SGT; break;
+    default: return false;
+    }
 
-  // Shift in to the correct position
-  auto ShiftOp = IRList.AllocateOp<IROp_Shr, OP_SHR>();
-  ShiftOp.first->Args[0] = AndOp.second;
-  ShiftOp.first->Args[1] = ShiftConstant.second;
+    *Src1 = SignBits(DeferredFlags.Res);
+    *Src2 = LoadConstant(0);
+    return true;
+  default:
+    return false;
+  }
+}
+
+void OpDispatchBuilder::CompareCC(uint32_t Type, IROp_Select::ComparisonOp *Comparison, AlignmentType *Src1, AlignmentType *Src2) {
+  if (GetConditionCompare(Type, Comparison, Src1, Src2))
+    return;
+
+  *Comparison = IROp_Select::COMP_NEQ;
+  *Src1 = GetCondition(Type);
+  *Src2 = LoadConstant(0);
+}
+
+AlignmentType OpDispatchBuilder::Select(IROp_Select::ComparisonOp Comparison, AlignmentType Src1, AlignmentType Src2, AlignmentType True, AlignmentType False) {
+  auto SelectOp = IRList.AllocateOp<IROp_Select, OP_SELECT>();
+  SelectOp.first->Op = Comparison;
+  SelectOp.first->Args[0] = Src1;
+  SelectOp.first->Args[1] = Src2;
+  SelectOp.first->Args[2] = True;
+  SelectOp.first->Args[3] = False;
+  return SelectOp.second;
+}
+
+AlignmentType OpDispatchBuilder::GetCondition(uint32_t Type) {
+  IROp_Select::ComparisonOp Comparison;
+  AlignmentType Src1, Src2;
+  if (GetConditionCompare(Type, &Comparison, &Src1, &Src2))
+    return Select(Comparison, Src1, Src2, LoadConstant(1), LoadConstant(0));
+
+  // Odd conditions are the inverse of the even one before them
+  bool Negate = Type & 1;
+  AlignmentType Result;
+  switch (Type & ~1U) {
+  case CC_OF: Result = GetFlagBit(Flags::FLAG_OF_LOC, false); break;
+  case CC_C:  Result = GetFlagBit(Flags::FLAG_CF_LOC, false); break;
+  case CC_Z:  Result = GetFlagBit(Flags::FLAG_ZF_LOC, false); break;
+  case CC_BE: Result = BiOp(OP_OR, GetFlagBit(Flags::FLAG_CF_LOC, false), GetFlagBit(Flags::FLAG_ZF_LOC, false)); break;
+  case CC_S:  Result = GetFlagBit(Flags::FLAG_SF_LOC, false); break;
+  case CC_P:  Result = GetFlagBit(Flags::FLAG_PF_LOC, false); break;
+  case CC_L:  Result = BiOp(OP_XOR, GetFlagBit(Flags::FLAG_SF_LOC, false), GetFlagBit(Flags::FLAG_OF_LOC, false)); break;
+  case CC_LE: {
+    auto Less = BiOp(OP_XOR, GetFlagBit(Flags::FLAG_SF_LOC, false), GetFlagBit(Flags::FLAG_OF_LOC, false));
+    Result = BiOp(OP_OR, Less, GetFlagBit(Flags::FLAG_ZF_LOC, false));
+  break;
+  }
+  default:
+    LogMan::Msg::A("Unknown condition code: %d", Type);
+    return ~0U;
+  }
+
+  return Negate ? BiOp(OP_XOR, Result, LoadConstant(1)) : Result;
+}
+
+AlignmentType OpDispatchBuilder::SelectCC(uint32_t Type, AlignmentType True, AlignmentType False) {
+  IROp_Select::ComparisonOp Comparison;
+  AlignmentType Src1, Src2;
+  CompareCC(Type, &Comparison, &Src1, &Src2);
+  return Select(Comparison, Src1, Src2, True, False);
+}
+
+AlignmentType OpDispatchBuilder::GetFlagBit(uint32_t bit, bool negate) {
+  AlignmentType Result = ~0U;
+
+  if (DeferredFlags.Known && DeferredFlags.Op == Flags::DEFERRED_NONE) {
+    // RFLAGS is real, pull the bit out of it
+    Result = BiOp(OP_BITEXTRACT, LoadContext(offsetof(X86State, rflags), 8), LoadConstant(bit));
+  }
+  else if (DeferredFlags.Known) {
+    Result = CalculateDeferredFlagBit(bit);
+  }
+
+  if (Result == ~0U) {
+    // Producer lives in a previous block or the flag isn't worth inlining, let the backend calculate it from X86State
+    StoreDeferredFlags();
+    auto GetFlagOp = IRList.AllocateOp<IROp_GetFlag, OP_GET_FLAG>();
+    GetFlagOp.first->Bit = bit;
+    Result = GetFlagOp.second;
+  }
 
   if (negate) {
     auto XorOp = IRList.AllocateOp<IROp_Xor, OP_XOR>();
-    XorOp.first->Args[0] = XorOp.second;
-    XorOp.first->Args[1] = ConstantOp.second;
+    XorOp.first->Args[0] = Result;
+    XorOp.first->Args[1] = LoadConstant(1);
     return XorOp.second;
   }
   else {
-    return ShiftOp.second;
+    return Result;
   }
 }
 
+AlignmentType OpDispatchBuilder::BiOp(IROps Op, AlignmentType Arg0, AlignmentType Arg1) {
+  // All BiOps share the same layout
+  auto Res = IRList.AllocateOp<IROp_BiOp, OP_ADD>();
+  Res.first->Header.Op = Op;
+  Res.first->Args[0] = Arg0;
+  Res.first->Args[1] = Arg1;
+  return Res.second;
+}
+
+AlignmentType OpDispatchBuilder::TriOp(IROps Op, AlignmentType Arg0, AlignmentType Arg1, AlignmentType Arg2) {
+  auto Res = IRList.AllocateOp<IROp_TriOp, OP_LUDIV>();
+  Res.first->Header.Op = Op;
+  Res.first->Args[0] = Arg0;
+  Res.first->Args[1] = Arg1;
+  Res.first->Args[2] = Arg2;
+  return Res.second;
+}
+
+AlignmentType OpDispatchBuilder::LoadConstant(uint64_t Constant) {
+  auto ConstantOp = IRList.AllocateOp<IROp_Constant, OP_CONSTANT>();
+  ConstantOp.first->Flags = IR::TYPE_I64;
+  ConstantOp.first->Constant = Constant;
+  return ConstantOp.second;
+}
+
 AlignmentType OpDispatchBuilder::LoadContext(uint64_t Offset, uint64_t Size) {
+  bool IsStackPointer = Offset == offsetof(X86State, gregs[REG_RSP]) && Size == 8;
+  if (IsStackPointer && StackPointer.Base != ~0U)
+    return GetStackPointer();
+
   auto LoadOp = IRList.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
   LoadOp.first->Size = Size;
   LoadOp.first->Offset = Offset;
+
+  // The first load of RSP is what the stack ops offset from
+  if (IsStackPointer) {
+    StackPointer.Base = LoadOp.second;
+    StackPointer.Offset = 0;
+  }
   return LoadOp.second;
 }
 
 void OpDispatchBuilder::StoreContext(AlignmentType Value, uint64_t Offset, uint64_t Size) {
+  // Writes to RSP wait in StackPointer along with the pushes and pops
+  if (Offset == offsetof(X86State, gregs[REG_RSP]) && Size == 8) {
+    StackPointer.Pending = true;
+    StackPointer.Base = Value;
+    StackPointer.Offset = 0;
+    return;
+  }
+
   auto StoreOp = IRList.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
   StoreOp.first->Size = Size;
   StoreOp.first->Offset = Offset;
@@ -1230,6 +1490,9 @@ AlignmentType OpDispatchBuilder::Truncate(AlignmentType Value, uint64_t Size) {
     return Trunc.second;
   }
   break;
+  case 1:
+    return BiOp(OP_AND, Value, LoadConstant(0xFF));
+  break;
   default:
     LogMan::Msg::A("Unhandled truncate size\n");
   break;
@@ -1237,71 +1500,16 @@ AlignmentType OpDispatchBuilder::Truncate(AlignmentType Value, uint64_t Size) {
   return ~0;
 }
 
+AlignmentType OpDispatchBuilder::SignExtend(AlignmentType Value, uint8_t Size) {
+  if (Size == 8)
+    return Value;
 
-OpDispatchBuilder::OpDispatchBuilder(CPUCore *CPU)
-  : cpu {CPU} {
+  auto Amount = LoadConstant(64 - Size * 8);
+  return BiOp(OP_ASHR, BiOp(OP_SHL, Value, Amount), Amount);
 }
 
-void InstallOpcodeHandlers() {
-  const std::vector<std::tuple<uint8_t, uint8_t, X86Tables::OpDispatchPtr>> BaseOpTable = {
-    // Instructions
-    {0x00, 1, &OpDispatchBuilder::UnknownOp},
-    {0x01, 1, &OpDispatchBuilder::AddOp},
-    {0x02, 1, &OpDispatchBuilder::UnknownOp},
-    {0x03, 1, &OpDispatchBuilder::AddOp},
-    {0x04, 1, &OpDispatchBuilder::UnknownOp},
-    {0x05, 1, &OpDispatchBuilder::AddImmOp},
-    {0x31, 1, &OpDispatchBuilder::XorOp},
-    {0x39, 1, &OpDispatchBuilder::CMPOp},
-    {0x70, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_OF>},
-    {0x71, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NOF>},
-    {0x72, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_C>},
-    {0x73, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NC>},
-    {0x74, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_Z>},
-    {0x75, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NZ>},
-    {0x76, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_BE>},
-    {0x77, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NBE>},
-    {0x78, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_S>},
-    {0x79, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NS>},
-    {0x7A, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_P>},
-    {0x7B, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NP>},
-    {0x7C, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_L>},
-    {0x7D, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NL>},
-    {0x7E, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_LE>},
-    {0x7F, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NLE>},
-    {0x89, 1, &OpDispatchBuilder::MovOp},
-    {0x8D, 1, &OpDispatchBuilder::LEAOp},
-    {0x90, 1, &OpDispatchBuilder::NoOp},
-    {0xC3, 1, &OpDispatchBuilder::RETOp},
-  };
-
-  const std::vector<std::tuple<uint8_t, uint8_t, X86Tables::OpDispatchPtr>> TwoByteOpTable = {
-    // Instructions
-    {0x05, 1, &OpDispatchBuilder::SyscallOp},
-    {0x1F, 1, &OpDispatchBuilder::NoOp},
-    {0xA3, 1, &OpDispatchBuilder::BTOp},
-  };
-
-  const std::vector<std::tuple<uint16_t, uint8_t, X86Tables::OpDispatchPtr>> ModRMOpTable = {
-    {0x8300, 1, &OpDispatchBuilder::AddImmModRMOp},
-    {0xC104, 1, &OpDispatchBuilder::ShlImmOp},
-    {0xFF04, 1, &OpDispatchBuilder::JMPOp},
-  };
-
-  auto InstallToTable = [](auto& FinalTable, auto& LocalTable) {
-    for (auto Op : LocalTable) {
-      auto OpNum = std::get<0>(Op);
-      auto Dispatcher = std::get<2>(Op);
-      for (uint8_t i = 0; i < std::get<1>(Op); ++i) {
-        LogMan::Throw::A(FinalTable[OpNum + i].OpcodeDispatcher == 0, "Duplicate Entry");
-        FinalTable[OpNum + i].OpcodeDispatcher = Dispatcher;
-      }
-    }
-  };
-
-  InstallToTable(Emu::X86Tables::BaseOps, BaseOpTable);
-  InstallToTable(Emu::X86Tables::SecondBaseOps, TwoByteOpTable);
-  InstallToTable(Emu::X86Tables::ModRMOps, ModRMOpTable);
 
+OpDispatchBuilder::OpDispatchBuilder(CPUCore *CPU)
+  : cpu {CPU} {
 }
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include "Flags.h"
 #include "IntrusiveIRList.h"
 #include "X86Tables.h"
 #include <unordered_map>
@@ -16,20 +17,31 @@ public:
   void EndBlock(uint64_t RIPIncrement);
 
   // Op handlers
-  void AddOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void AddImmOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void AddImmModRMOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void ShlImmOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void XorOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void MovOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void BTOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void JMPOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void LEAOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void CMPOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-
-  void SyscallOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void UnknownOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void NoOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
+  void ALUOp(Emu::X86Tables::DecodedOp Op);
+  void ALUImmOp(Emu::X86Tables::DecodedOp Op);
+  void TESTOp(Emu::X86Tables::DecodedOp Op);
+  void INCDECOp(Emu::X86Tables::DecodedOp Op);
+  void NOTOp(Emu::X86Tables::DecodedOp Op);
+  void NEGOp(Emu::X86Tables::DecodedOp Op);
+  void ShiftOp(Emu::X86Tables::DecodedOp Op);
+  void RotateOp(Emu::X86Tables::DecodedOp Op);
+  void MULOp(Emu::X86Tables::DecodedOp Op);
+  void IMULOp(Emu::X86Tables::DecodedOp Op);
+  void DIVOp(Emu::X86Tables::DecodedOp Op);
+  void MovOp(Emu::X86Tables::DecodedOp Op);
+  void MovImmOp(Emu::X86Tables::DecodedOp Op);
+  void BTOp(Emu::X86Tables::DecodedOp Op);
+  void JMPOp(Emu::X86Tables::DecodedOp Op);
+  void LEAOp(Emu::X86Tables::DecodedOp Op);
+  void PUSHOp(Emu::X86Tables::DecodedOp Op);
+  void POPOp(Emu::X86Tables::DecodedOp Op);
+  void CALLOp(Emu::X86Tables::DecodedOp Op);
+  void LEAVEOp(Emu::X86Tables::DecodedOp Op);
+  void ENTEROp(Emu::X86Tables::DecodedOp Op);
+
+  void SyscallOp(Emu::X86Tables::DecodedOp Op);
+  void UnknownOp(Emu::X86Tables::DecodedOp Op);
+  void NoOp(Emu::X86Tables::DecodedOp Op);
 
   // Jump types
   enum JumpType {
@@ -51,34 +63,135 @@ public:
     CC_NLE,
   };
   template<uint32_t Type>
-  void JccOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
-  void RETOp(Emu::X86Tables::DecodedOp Op, uint8_t const *Code);
+  void JccOp(Emu::X86Tables::DecodedOp Op);
+  template<uint32_t Type>
+  void SETccOp(Emu::X86Tables::DecodedOp Op);
+  template<uint32_t Type>
+  void CMOVccOp(Emu::X86Tables::DecodedOp Op);
+  void RETOp(Emu::X86Tables::DecodedOp Op);
 
   Emu::IR::IntrusiveIRList const &GetWorkingIR() { return IRList; }
-  void ResetWorkingList() { RIPLocations.clear(); IRList.Reset(); DecodeFailure = false; }
+  void ResetWorkingList() { RIPLocations.clear(); IRList.Reset(); DecodeFailure = false; DeferredFlags = {}; InstructionFlags = {}; StackPointer = {}; InstructionStackPointer = {}; }
   bool HadDecodeFailure() { return DecodeFailure; }
   void AddRIPMarker(uint64_t RIP) {
     auto Marker = IRList.AllocateOp<IROp_RIPMarker, OP_RIP_MARKER>();
     Marker.first->RIP = RIP;
     RIPLocations[RIP] = Marker.second;
+    InstructionFlags = DeferredFlags;
+    InstructionStackPointer = StackPointer;
   }
 
+  /**
+   * @brief Replaces whatever the instruction at RIP emitted with a call out to Unicorn for it
+   *
+   * Only for instructions that can't change control flow. The block carries on afterwards if Unicorn stopped at
+   * RIP + Size, otherwise it leaves for wherever Unicorn stopped
+   */
+  void Fallback(uint64_t RIP, uint8_t Size);
+
 private:
   AlignmentType LoadContext(uint64_t Offset, uint64_t Size);
   void StoreContext(AlignmentType Value, uint64_t Offset, uint64_t Size);
 
+  // Type is the operation as 00-3D encode it, DestOperand is both the first source and the destination
+  void ALU(Emu::X86Tables::DecodedOp Op, uint32_t Type, Emu::X86Tables::DecodedOperand const &DestOperand, AlignmentType Src2, uint8_t Size);
+
+  /**
+   * @brief Leaves the block with Signal raised on the current instruction unless Src1 Comparison Src2 holds
+   *
+   * RIP is left on the instruction and none of its results are stored, the way the exception leaves the guest natively
+   */
+  void RaiseSignalUnless(IROp_Select::ComparisonOp Comparison, AlignmentType Src1, AlignmentType Src2, int Signal);
+
   AlignmentType Truncate(AlignmentType Value, uint64_t Size);
+  AlignmentType SignExtend(AlignmentType Value, uint8_t Size);
+  AlignmentType BiOp(IROps Op, AlignmentType Arg0, AlignmentType Arg1);
+  AlignmentType TriOp(IROps Op, AlignmentType Arg0, AlignmentType Arg1, AlignmentType Arg2);
+  AlignmentType LoadConstant(uint64_t Constant);
+
+  // Guest memory at Address + Index, Index can be ~0
+  AlignmentType LoadMem(uint8_t Size, AlignmentType Address, AlignmentType Index = ~0U, bool SignExtend = false);
+  void StoreMem(uint8_t Size, AlignmentType Value, AlignmentType Address, AlignmentType Index = ~0U);
+
+  // RSP as the block currently has it, LoadContext and StoreContext of RSP go through here too
+  AlignmentType GetStackPointer();
+  void AdjustStackPointer(int64_t Amount);
+  /**
+   * @brief Writes RSP out to X86State if the stack ops in the block have moved it since
+   */
+  void StoreStackPointer();
+  void Push(uint8_t Size, AlignmentType Value);
+  AlignmentType Pop(uint8_t Size);
+
+  // Guest operands in any ModRM form, sized 1, 2, 4 or 8 bytes
+  // Loaded values are zero extended, stores merge in to the register the way x86 does
+  AlignmentType LoadGPR(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, uint8_t Size);
+  void StoreGPR(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, AlignmentType Value, uint8_t Size);
+  /**
+   * @brief Base + Index * Scale + Displacement of a memory operand, with the FS or GS base if AddSegmentBase
+   *
+   * @param IndexOut If given, a 64bit Index * Scale may be handed back here instead of added for LoadMem's second argument, ~0 otherwise
+   */
+  AlignmentType GetEffectiveAddress(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, bool AddSegmentBase, AlignmentType *IndexOut = nullptr);
+  AlignmentType LoadSource(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, uint8_t Size);
+  void StoreResult(Emu::X86Tables::DecodedOp Op, Emu::X86Tables::DecodedOperand const &Operand, AlignmentType Value, uint8_t Size);
   AlignmentType GetFlagBit(uint32_t bit, bool negate);
-  void SetCF(AlignmentType Value);
-  void SetZF(AlignmentType Value);
-  void SetSF(AlignmentType Value);
-  void SetOF(AlignmentType Value);
+
+  // Condition codes in JumpType order, which is the x86 encoding order
+  bool GetConditionCompare(uint32_t Type, IROp_Select::ComparisonOp *Comparison, AlignmentType *Src1, AlignmentType *Src2);
+  /**
+   * @brief Comparison that holds when the condition does, falls back to testing GetCondition against zero
+   */
+  void CompareCC(uint32_t Type, IROp_Select::ComparisonOp *Comparison, AlignmentType *Src1, AlignmentType *Src2);
+  AlignmentType Select(IROp_Select::ComparisonOp Comparison, AlignmentType Src1, AlignmentType Src2, AlignmentType True, AlignmentType False);
+  /**
+   * @brief 1 if the condition holds, 0 if it doesn't
+   */
+  AlignmentType GetCondition(uint32_t Type);
+  /**
+   * @brief True if the condition holds, False if it doesn't, without branching
+   */
+  AlignmentType SelectCC(uint32_t Type, AlignmentType True, AlignmentType False);
+  AlignmentType CalculateDeferredFlagBit(uint32_t bit);
+  void GenerateFlags(Flags::DeferredOp Op, AlignmentType Res, AlignmentType Src1, AlignmentType Src2, uint8_t Size);
+  /**
+   * @brief Writes the block's flag producer out to X86State if it isn't there yet
+   */
+  void StoreDeferredFlags();
+  void MaterializeFlags();
+  void SetRFLAG(AlignmentType Value, uint32_t BitLocation);
+  void SetCF(AlignmentType Value) { SetRFLAG(Value, Flags::FLAG_CF_LOC); }
+  void SetZF(AlignmentType Value) { SetRFLAG(Value, Flags::FLAG_ZF_LOC); }
+  void SetSF(AlignmentType Value) { SetRFLAG(Value, Flags::FLAG_SF_LOC); }
+  void SetOF(AlignmentType Value) { SetRFLAG(Value, Flags::FLAG_OF_LOC); }
   Emu::IR::IntrusiveIRList IRList{8 * 1024 * 1024};
+
+  // What we know about the deferred flags inside of the current block
+  // If the block hasn't generated flags yet then the state lives in X86State only
+  struct DeferredFlagState {
+    bool Known;
+    bool Pending; ///< X86State doesn't have the producer yet
+    Flags::DeferredOp Op;
+    uint8_t Size;
+    AlignmentType Src1;
+    AlignmentType Src2;
+    AlignmentType Res;
+  } DeferredFlags{};
+  // DeferredFlags from before the current instruction, for when Fallback throws the instruction away
+  DeferredFlagState InstructionFlags{};
+
+  // RSP is kept as a base value plus a constant so that pushes and pops only add up an offset
+  // X86State sees a single store when something outside of the block's straight line code needs it
+  struct StackPointerState {
+    bool Pending{false}; ///< X86State doesn't have the new RSP yet
+    AlignmentType Base{~0U}; ///< ~0 until RSP is loaded in the block
+    int64_t Offset{0};
+  } StackPointer{};
+  // StackPointer from before the current instruction, for when Fallback throws the instruction away
+  StackPointerState InstructionStackPointer{};
   std::unordered_map<uint64_t, uint32_t> RIPLocations;
 
   CPUCore *cpu;
   bool DecodeFailure{false};
 };
-
-void InstallOpcodeHandlers();
 }
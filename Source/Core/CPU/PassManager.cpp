@@ -1,11 +1,20 @@
 #include "PassManager.h"
 
 namespace Emu::IR {
-void BlockPassManager::Run() {
+bool PassManager::RunPasses(IntrusiveIRList *IR) {
+  bool Changed = false;
+  for (auto &pass : passes) {
+    Changed |= pass->Run(IR);
+  }
+  return Changed;
 }
 
-void FunctionPassManager::Run() {
+bool BlockPassManager::Run(IntrusiveIRList *IR) {
+  return RunPasses(IR);
 }
 
+bool FunctionPassManager::Run(IntrusiveIRList *IR) {
+  return RunPasses(IR);
 }
 
+}
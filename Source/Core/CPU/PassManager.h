@@ -1,52 +1,62 @@
 #pragma once
+#include <memory>
 #include <string>
 #include <vector>
 
 namespace Emu::IR {
+class IntrusiveIRList;
 class PassManager;
 
 class Pass {
 public:
+  virtual ~Pass() {}
   virtual std::string GetName() = 0;
 
 protected:
 friend PassManager;
   Pass() {}
-  virtual void Run() = 0;
+  /**
+   * @return true if the pass changed the IR
+   */
+  virtual bool Run(IntrusiveIRList *IR) = 0;
 };
 
 class BlockPass : public Pass {
 public:
 
 private:
-  virtual void Run() override final { RunOnBlock(); }
-  virtual void RunOnBlock() = 0;
+  virtual bool Run(IntrusiveIRList *IR) override final { return RunOnBlock(IR); }
+  virtual bool RunOnBlock(IntrusiveIRList *IR) = 0;
 };
 
 class FunctionPass : public Pass {
 public:
 
 private:
-  virtual void Run() override final { RunOnFunction(); }
-  virtual void RunOnFunction() = 0;
+  virtual bool Run(IntrusiveIRList *IR) override final { return RunOnFunction(IR); }
+  virtual bool RunOnFunction(IntrusiveIRList *IR) = 0;
 };
 
 class PassManager {
 public:
-  virtual void Run() = 0;
-  void AddPass(Pass* pass) { passes.emplace_back(); }
+  virtual ~PassManager() {}
+  virtual bool Run(IntrusiveIRList *IR) = 0;
+  void AddPass(Pass* pass) { passes.emplace_back(pass); }
+
+protected:
+  bool RunPasses(IntrusiveIRList *IR);
 
 private:
-  std::vector<Pass*> passes;
+  std::vector<std::unique_ptr<Pass>> passes;
 };
 
 class BlockPassManager final : public PassManager {
 public:
-  void Run();
+  bool Run(IntrusiveIRList *IR) override;
 };
 
 class FunctionPassManager final : public PassManager {
 public:
-  void Run();
+  bool Run(IntrusiveIRList *IR) override;
 };
 }
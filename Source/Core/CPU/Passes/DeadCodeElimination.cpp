@@ -0,0 +1,89 @@
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/PassManager.h"
+#include "Core/CPU/Passes/Passes.h"
+#include <vector>
+
+namespace Emu::IR {
+
+class DeadCodeElimination final : public BlockPass {
+public:
+  std::string GetName() override { return "DeadCodeElimination"; }
+
+private:
+  bool RunOnBlock(IntrusiveIRList *IR) override;
+};
+
+bool DeadCodeElimination::RunOnBlock(IntrusiveIRList *IR) {
+  size_t Size = IR->GetOffset();
+
+  std::vector<AlignmentType> Ops;
+  for (size_t i = 0; i != Size; i += GetSize(IR->GetOp(i)->Op)) {
+    Ops.emplace_back(i);
+  }
+
+  // Arguments always come before their users, so one backwards walk finds everything live
+  std::vector<bool> Live(Size);
+  size_t NumDead = 0;
+  for (auto it = Ops.rbegin(); it != Ops.rend(); ++it) {
+    auto op = IR->GetOp(*it);
+    if (HasSideEffects(op->Op)) {
+      Live[*it] = true;
+    }
+
+    if (!Live[*it]) {
+      ++NumDead;
+      continue;
+    }
+
+    auto Args = GetArgs(op);
+    for (size_t j = 0; j < Args.second; ++j) {
+      Live[Args.first[j]] = true;
+    }
+  }
+
+  if (NumDead == 0) {
+    return false;
+  }
+
+  // Jumps go forward, so work out every new offset before moving anything
+  std::vector<AlignmentType> NewOffsets(Size);
+  AlignmentType CurrentOffset = 0;
+  for (auto Offset : Ops) {
+    if (Live[Offset]) {
+      NewOffsets[Offset] = CurrentOffset;
+      CurrentOffset += GetSize(IR->GetOp(Offset)->Op);
+    }
+  }
+
+  // Ops only ever move down, so compacting in place never overwrites an op we still need to read
+  for (auto Offset : Ops) {
+    if (!Live[Offset])
+      continue;
+
+    auto op = IR->GetOp(Offset);
+    auto Args = GetArgs(op);
+    for (size_t j = 0; j < Args.second; ++j) {
+      Args.first[j] = NewOffsets[Args.first[j]];
+    }
+
+    if (op->Op == OP_COND_JUMP) {
+      auto CondJumpOp = op->CW<IROp_CondJump>();
+      CondJumpOp->Target = NewOffsets[CondJumpOp->Target];
+    }
+    else if (op->Op == OP_JUMP) {
+      auto JumpOp = op->CW<IROp_Jump>();
+      JumpOp->Target = NewOffsets[JumpOp->Target];
+    }
+
+    memmove(IR->GetOp(NewOffsets[Offset]), op, GetSize(op->Op));
+  }
+
+  IR->Shrink(CurrentOffset);
+  return true;
+}
+
+Pass* CreateDeadCodeEliminationPass() {
+  return new DeadCodeElimination{};
+}
+
+}
@@ -0,0 +1,178 @@
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/PassManager.h"
+#include "Core/CPU/Passes/Passes.h"
+#include <algorithm>
+#include <vector>
+
+namespace Emu::IR {
+
+namespace {
+uint64_t GetSizeMask(uint32_t Size) {
+  return Size >= 8 ? ~0ULL : ((1ULL << (Size * 8)) - 1);
+}
+
+// Bits set in the returned mask are always zero in a value that fits in Bits bits
+uint64_t ZeroAbove(uint32_t Bits) {
+  return Bits >= 64 ? 0 : ~((1ULL << Bits) - 1);
+}
+
+// Number of low bits that can be set in a value with this known zero mask
+uint32_t SignificantBits(uint64_t KnownZero) {
+  return KnownZero == ~0ULL ? 0 : 64 - __builtin_clzll(~KnownZero);
+}
+}
+
+class KnownBits final : public BlockPass {
+public:
+  std::string GetName() override { return "KnownBits"; }
+
+private:
+  bool RunOnBlock(IntrusiveIRList *IR) override;
+};
+
+bool KnownBits::RunOnBlock(IntrusiveIRList *IR) {
+  bool Changed = false;
+  size_t Size = IR->GetOffset();
+
+  // Bits that are known to be zero in each value
+  std::vector<uint64_t> KnownZero(Size);
+  std::vector<AlignmentType> Remap(Size);
+
+  auto GetConstant = [IR](AlignmentType Offset, uint64_t *Value) {
+    auto op = IR->GetOp(Offset);
+    if (op->Op != OP_CONSTANT)
+      return false;
+    *Value = op->C<IROp_Constant>()->Constant;
+    return true;
+  };
+
+  size_t i = 0;
+  while (i != Size) {
+    auto op = IR->GetOp(i);
+    Remap[i] = i;
+
+    auto Args = GetArgs(op);
+    for (size_t j = 0; j < Args.second; ++j) {
+      AlignmentType NewArg = Remap[Args.first[j]];
+      if (NewArg != Args.first[j]) {
+        Args.first[j] = NewArg;
+        Changed = true;
+      }
+    }
+
+    uint64_t Zero = 0;
+    switch (op->Op) {
+    case OP_CONSTANT:
+      Zero = ~op->C<IROp_Constant>()->Constant;
+    break;
+    case OP_LOADCONTEXT:
+      Zero = ~GetSizeMask(op->C<IROp_LoadContext>()->Size);
+    break;
+    case OP_LOAD_MEM:
+      // Sign extended loads can set any of the top bits
+      if (!op->C<IROp_LoadMem>()->SignExtend)
+        Zero = ~GetSizeMask(op->C<IROp_LoadMem>()->Size);
+    break;
+    case OP_TRUNC_32:
+    case OP_TRUNC_16: {
+      uint64_t Mask = op->Op == OP_TRUNC_32 ? GetSizeMask(4) : GetSizeMask(2);
+      AlignmentType Arg = op->C<IROp_MonoOp>()->Arg;
+      if ((KnownZero[Arg] | Mask) == ~0ULL) {
+        // Upper bits are already zero
+        Remap[i] = Arg;
+        Changed = true;
+      }
+      Zero = KnownZero[Arg] | ~Mask;
+    break;
+    }
+    case OP_AND: {
+      auto BiOp = op->C<IROp_BiOp>();
+      Zero = KnownZero[BiOp->Args[0]] | KnownZero[BiOp->Args[1]];
+
+      // A mask that only clears bits which are already zero does nothing
+      for (size_t j = 0; j < 2; ++j) {
+        uint64_t Mask;
+        AlignmentType Other = BiOp->Args[j ^ 1];
+        if (GetConstant(BiOp->Args[j], &Mask) &&
+            (KnownZero[Other] | Mask) == ~0ULL) {
+          Remap[i] = Other;
+          Changed = true;
+          break;
+        }
+      }
+    break;
+    }
+    case OP_OR:
+    case OP_XOR: {
+      auto BiOp = op->C<IROp_BiOp>();
+      Zero = KnownZero[BiOp->Args[0]] & KnownZero[BiOp->Args[1]];
+    break;
+    }
+    case OP_ADD: {
+      auto BiOp = op->C<IROp_BiOp>();
+      uint32_t Bits = std::max(SignificantBits(KnownZero[BiOp->Args[0]]), SignificantBits(KnownZero[BiOp->Args[1]]));
+      // Carry out can add at most one bit
+      Zero = ZeroAbove(Bits + 1);
+    break;
+    }
+    case OP_SHL:
+    case OP_SHR: {
+      auto BiOp = op->C<IROp_BiOp>();
+      uint64_t Shift;
+      if (GetConstant(BiOp->Args[1], &Shift) && Shift < 64) {
+        if (op->Op == OP_SHL)
+          Zero = (KnownZero[BiOp->Args[0]] << Shift) | ((1ULL << Shift) - 1);
+        else
+          Zero = (KnownZero[BiOp->Args[0]] >> Shift) | ~(~0ULL >> Shift);
+      }
+      else if (op->Op == OP_SHR) {
+        // Shifting right never sets any of the upper bits
+        Zero = ZeroAbove(SignificantBits(KnownZero[BiOp->Args[0]]));
+      }
+    break;
+    }
+    case OP_MUL: {
+      auto BiOp = op->C<IROp_BiOp>();
+      Zero = ZeroAbove(SignificantBits(KnownZero[BiOp->Args[0]]) + SignificantBits(KnownZero[BiOp->Args[1]]));
+    break;
+    }
+    case OP_UDIV:
+    case OP_UREM: {
+      // Never larger than the dividend, and a remainder is smaller than the divisor too
+      auto BiOp = op->C<IROp_BiOp>();
+      uint32_t Bits = SignificantBits(KnownZero[BiOp->Args[0]]);
+      if (op->Op == OP_UREM)
+        Bits = std::min(Bits, SignificantBits(KnownZero[BiOp->Args[1]]));
+      Zero = ZeroAbove(Bits);
+    break;
+    }
+    case OP_LUREM: {
+      auto TriOp = op->C<IROp_TriOp>();
+      Zero = ZeroAbove(SignificantBits(KnownZero[TriOp->Args[2]]));
+    break;
+    }
+    case OP_SELECT: {
+      auto SelectOp = op->C<IROp_Select>();
+      Zero = KnownZero[SelectOp->Args[2]] & KnownZero[SelectOp->Args[3]];
+    break;
+    }
+    case OP_BITEXTRACT:
+    case OP_GET_FLAG:
+      Zero = ~1ULL;
+    break;
+    default:
+    break;
+    }
+
+    KnownZero[i] = Zero;
+    i += GetSize(op->Op);
+  }
+
+  return Changed;
+}
+
+Pass* CreateKnownBitsPass() {
+  return new KnownBits{};
+}
+
+}
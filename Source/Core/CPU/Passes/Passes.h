@@ -0,0 +1,25 @@
+#pragma once
+
+namespace Emu::IR {
+class Pass;
+
+/**
+ * @brief Merges ops that calculate the same value
+ *
+ * Constants, pure ALU ops and context loads that have no store between them are all folded in to the first
+ * op that produced the value. The ops that become unused are left for dead code elimination to remove.
+ */
+Pass* CreateValueNumberingPass();
+
+/**
+ * @brief Tracks which bits of each value are known to be zero
+ *
+ * Truncations and constant masks that can't change their argument are replaced by the argument.
+ */
+Pass* CreateKnownBitsPass();
+
+/**
+ * @brief Removes ops whose values are never used and compacts the IR list
+ */
+Pass* CreateDeadCodeEliminationPass();
+}
@@ -0,0 +1,238 @@
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/Passes/RegisterAllocation.h"
+#include "LogManager.h"
+#include <algorithm>
+#include <functional>
+#include <queue>
+#include <unordered_map>
+
+namespace Emu::IR {
+
+namespace {
+struct LiveInterval {
+  AlignmentType Value;
+  uint32_t Start;
+  uint32_t End;
+  bool CrossesCall;
+};
+}
+
+bool IsCallOp(IROps Op) {
+  switch (Op) {
+  case OP_CALL:
+  case OP_EXTERN_CALL:
+  case OP_SYSCALL:
+  case OP_FALLBACK:
+  case OP_RAISE_SIGNAL:
+  case OP_GET_FLAG:
+  case OP_MATERIALIZE_FLAGS:
+    return true;
+  default:
+    return false;
+  }
+}
+
+uint32_t FindPinnedRegister(RegisterAllocationData const &Data, uint32_t ContextOffset, uint8_t Size) {
+  if (Size != 8)
+    return RegisterAssignment::INVALID;
+
+  for (auto &Pin : Data.Pinned) {
+    if (Pin.ContextOffset == ContextOffset)
+      return Pin.Register;
+  }
+  return RegisterAssignment::INVALID;
+}
+
+RegisterAllocationData AllocateRegisters(IntrusiveIRList const *IR, RegisterFile const &Registers) {
+  LogMan::Throw::A(Registers.NumRegisters <= 64, "Too many registers in register file");
+
+  RegisterAllocationData Data;
+  size_t Size = IR->GetOffset();
+  Data.Assignments.resize(Size);
+
+  // Interval index of each value, indexed by the defining op's offset
+  std::vector<uint32_t> IntervalIndex(Size, ~0U);
+  std::vector<LiveInterval> Intervals;
+  std::vector<uint32_t> CallPositions;
+
+  // Guest RIP of every marker and the position where it sits
+  std::unordered_map<uint64_t, uint32_t> RIPPositions;
+  // Start and end position of loops created by jumping back to an earlier RIP
+  std::vector<std::pair<uint32_t, uint32_t>> Loops;
+
+  // How many context accesses pinning each piece of state would turn in to register moves
+  // Partial accesses have to write the register back and reload it around them
+  std::array<int32_t, PinnedStatePriority.size()> StateUses{};
+  auto CountStateAccess = [&StateUses](uint32_t Offset, uint8_t Size) {
+    for (size_t j = 0; j < PinnedStatePriority.size(); ++j) {
+      uint32_t State = PinnedStatePriority[j];
+      if (Offset == State && Size == 8)
+        StateUses[j]++;
+      else if (Offset < State + 8 && State < Offset + Size)
+        StateUses[j] -= 2;
+    }
+  };
+  uint32_t NumExits = 0;
+
+  uint32_t Position = 0;
+  for (size_t i = 0; i != Size; i += GetSize(IR->GetOp(i)->Op), ++Position) {
+    auto op = IR->GetOp(i);
+
+    if (op->Op == OP_LOADCONTEXT) {
+      CountStateAccess(op->C<IROp_LoadContext>()->Offset, op->C<IROp_LoadContext>()->Size);
+    }
+    else if (op->Op == OP_STORECONTEXT) {
+      CountStateAccess(op->C<IROp_StoreContext>()->Offset, op->C<IROp_StoreContext>()->Size);
+    }
+    else if (op->Op == OP_ENDBLOCK) {
+      NumExits++;
+    }
+
+    auto Args = GetArgs(op);
+    for (size_t j = 0; j < Args.second; ++j) {
+      uint32_t Index = IntervalIndex[Args.first[j]];
+      LogMan::Throw::A(Index != ~0U, "Op uses a value that was never defined");
+      Intervals[Index].End = Position;
+    }
+
+    if (IsCallOp(op->Op)) {
+      CallPositions.emplace_back(Position);
+    }
+
+    if (op->Op == OP_RIP_MARKER) {
+      RIPPositions[op->C<IROp_RIPMarker>()->RIP] = Position;
+    }
+    else if (op->Op == OP_COND_JUMP) {
+      auto it = RIPPositions.find(op->C<IROp_CondJump>()->RIPTarget);
+      if (it != RIPPositions.end()) {
+        Loops.emplace_back(it->second, Position);
+      }
+    }
+
+    if (HasDest(op->Op)) {
+      IntervalIndex[i] = Intervals.size();
+      Intervals.emplace_back(LiveInterval{static_cast<AlignmentType>(i), Position, Position, false});
+    }
+  }
+
+  for (auto &Interval : Intervals) {
+    // Anything live in to a loop header has to survive until the back edge
+    for (auto &Loop : Loops) {
+      if (Interval.Start < Loop.first && Interval.End >= Loop.first) {
+        Interval.End = std::max(Interval.End, Loop.second);
+      }
+    }
+
+    // A call that defines or consumes the value doesn't clobber it
+    auto Call = std::upper_bound(CallPositions.begin(), CallPositions.end(), Interval.Start);
+    Interval.CrossesCall = Call != CallPositions.end() && *Call < Interval.End;
+  }
+
+  uint64_t AllRegisters = Registers.NumRegisters == 64 ? ~0ULL : ((1ULL << Registers.NumRegisters) - 1);
+
+  if (Registers.MaxPinned) {
+    // Most values live at once, and of those the ones that need a callee saved register
+    uint32_t PeakLive = 0;
+    uint32_t PeakCrossing = 0;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> LiveEnds;
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> CrossingEnds;
+    for (auto &Interval : Intervals) {
+      while (!LiveEnds.empty() && LiveEnds.top() < Interval.Start)
+        LiveEnds.pop();
+      while (!CrossingEnds.empty() && CrossingEnds.top() < Interval.Start)
+        CrossingEnds.pop();
+
+      LiveEnds.push(Interval.End);
+      if (Interval.CrossesCall)
+        CrossingEnds.push(Interval.End);
+      PeakLive = std::max<uint32_t>(PeakLive, LiveEnds.size());
+      PeakCrossing = std::max<uint32_t>(PeakCrossing, CrossingEnds.size());
+    }
+
+    // Pinned state gets loaded on entry, then written back at every exit and around every call
+    int32_t PinCost = 1 + NumExits + 2 * static_cast<int32_t>(CallPositions.size());
+    uint32_t NumCalleeSaved = __builtin_popcountll(AllRegisters & ~Registers.CallerSavedMask);
+    uint32_t MaxPinned = std::min({
+      Registers.MaxPinned,
+      NumCalleeSaved - std::min(PeakCrossing, NumCalleeSaved),
+      Registers.NumRegisters - std::min(PeakLive, Registers.NumRegisters),
+    });
+
+    std::array<uint32_t, PinnedStatePriority.size()> Order;
+    for (size_t j = 0; j < Order.size(); ++j)
+      Order[j] = j;
+    std::stable_sort(Order.begin(), Order.end(), [&StateUses](uint32_t A, uint32_t B) { return StateUses[A] > StateUses[B]; });
+
+    // Callee saved registers come off of the top of the file so values keep the low ones
+    int32_t Reg = Registers.NumRegisters - 1;
+    for (uint32_t State : Order) {
+      if (Data.Pinned.size() == MaxPinned || StateUses[State] <= PinCost)
+        break;
+      while (Registers.CallerSavedMask & (1ULL << Reg))
+        --Reg;
+      Data.Pinned.emplace_back(PinnedRegister{PinnedStatePriority[State], static_cast<uint32_t>(Reg)});
+      AllRegisters &= ~(1ULL << Reg);
+      --Reg;
+    }
+  }
+  uint64_t CalleeSaved = AllRegisters & ~Registers.CallerSavedMask;
+  uint64_t FreeRegisters = AllRegisters;
+
+  // Active intervals that hold a register, kept sorted by increasing end
+  std::vector<LiveInterval*> Active;
+
+  auto Spill = [&Data](LiveInterval *Interval) {
+    auto &Assignment = Data.Assignments[Interval->Value];
+    Assignment.Register = RegisterAssignment::INVALID;
+    Assignment.SpillSlot = Data.SpillSlots++;
+    Data.SpillCount++;
+  };
+
+  auto Assign = [&](LiveInterval *Interval, uint32_t Reg) {
+    Data.Assignments[Interval->Value].Register = Reg;
+    Data.UsedRegisters |= 1ULL << Reg;
+    FreeRegisters &= ~(1ULL << Reg);
+    auto it = std::upper_bound(Active.begin(), Active.end(), Interval,
+      [](LiveInterval const *A, LiveInterval const *B) { return A->End < B->End; });
+    Active.insert(it, Interval);
+  };
+
+  // Intervals are already sorted by start since values are defined in order
+  for (auto &Interval : Intervals) {
+    // Expire everything that ended before this value is defined
+    // Ending on the defining op isn't enough, the op still reads its arguments
+    while (!Active.empty() && Active.front()->End < Interval.Start) {
+      FreeRegisters |= 1ULL << Data.Assignments[Active.front()->Value].Register;
+      Active.erase(Active.begin());
+    }
+
+    uint64_t Allowed = Interval.CrossesCall ? CalleeSaved : AllRegisters;
+    uint64_t Candidates = FreeRegisters & Allowed;
+    if (Candidates) {
+      // Leave callee saved registers for the values that need them
+      uint64_t Preferred = Candidates & Registers.CallerSavedMask;
+      Assign(&Interval, __builtin_ctzll(Preferred ? Preferred : Candidates));
+      continue;
+    }
+
+    // Steal the register from the active value that lives the longest, if it outlives us
+    auto Victim = std::find_if(Active.rbegin(), Active.rend(), [&](LiveInterval *Other) {
+      return (1ULL << Data.Assignments[Other->Value].Register) & Allowed;
+    });
+
+    if (Victim != Active.rend() && (*Victim)->End > Interval.End) {
+      uint32_t Reg = Data.Assignments[(*Victim)->Value].Register;
+      Spill(*Victim);
+      Active.erase(std::next(Victim).base());
+      FreeRegisters |= 1ULL << Reg;
+      Assign(&Interval, Reg);
+    }
+    else {
+      Spill(&Interval);
+    }
+  }
+
+  return Data;
+}
+
+}
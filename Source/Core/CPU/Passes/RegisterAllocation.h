@@ -0,0 +1,102 @@
+#pragma once
+#include "Core/CPU/CPUState.h"
+#include "Core/CPU/IR.h"
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace Emu::IR {
+class IntrusiveIRList;
+
+/**
+ * @brief A piece of guest state that permanently lives in a host register
+ */
+struct PinnedRegister {
+  uint32_t ContextOffset;
+  uint32_t Register;
+};
+
+/**
+ * @brief Describes the host registers a backend hands to the allocator
+ *
+ * Registers are numbered 0 to NumRegisters - 1, the backend maps those to real host registers
+ * Scratch registers needed to reload spilled values must not be part of the file
+ */
+struct RegisterFile {
+  uint32_t NumRegisters;
+  // Registers that are clobbered when the JIT calls out to C++
+  uint64_t CallerSavedMask;
+  // Most callee saved registers the allocator may pin guest state to, it picks how many per block
+  uint32_t MaxPinned{};
+};
+
+/**
+ * @brief Guest state offsets that can be pinned, ties in how often a block uses them go to the earlier one
+ */
+constexpr std::array<uint32_t, 9> PinnedStatePriority = {
+  offsetof(X86State, gregs) + REG_RAX * 8,
+  offsetof(X86State, gregs) + REG_RSP * 8,
+  offsetof(X86State, gregs) + REG_RDI * 8,
+  offsetof(X86State, gregs) + REG_RSI * 8,
+  offsetof(X86State, flags_res),
+  offsetof(X86State, flags_src1),
+  offsetof(X86State, flags_src2),
+  offsetof(X86State, flags_op),
+  offsetof(X86State, flags_size),
+};
+
+struct RegisterAssignment {
+  static constexpr uint32_t INVALID = ~0U;
+  uint32_t Register{INVALID};
+  uint32_t SpillSlot{INVALID};
+
+  bool IsSpilled() const { return SpillSlot != INVALID; }
+};
+
+struct RegisterAllocationData {
+  // Indexed by the offset of the op that defines the value
+  std::vector<RegisterAssignment> Assignments;
+  // Spill slots the block needs, each is 8 bytes
+  uint32_t SpillSlots{};
+  // Number of values that didn't get a register
+  uint32_t SpillCount{};
+  // Registers that were handed out at least once
+  uint64_t UsedRegisters{};
+  // Guest state this block keeps in callee saved registers, those are never handed out to values
+  // Pinned state must be written back to X86State before anything in C++ can look at it
+  std::vector<PinnedRegister> Pinned;
+
+  RegisterAssignment const& Get(AlignmentType Offset) const { return Assignments[Offset]; }
+};
+
+/**
+ * @brief Finds the register a full width context access lives in
+ *
+ * @return The pinned register or RegisterAssignment::INVALID if it lives in X86State
+ */
+uint32_t FindPinnedRegister(RegisterAllocationData const &Data, uint32_t ContextOffset, uint8_t Size);
+
+/**
+ * @brief Ops that backends lower as a call in to C++
+ *
+ * Values live across one of these can't stay in a caller saved register
+ */
+bool IsCallOp(IROps Op);
+
+/**
+ * @brief Ops where pinned guest state has to be written back to X86State first and reloaded after
+ */
+static bool NeedsStateWriteback(IROps Op) { return IsCallOp(Op) || Op == OP_ENDBLOCK; }
+
+/**
+ * @brief Linear scan register allocation over a block's IR
+ *
+ * Live intervals are taken from the linear op order. Values live in to a guest RIP that a conditional
+ * jump in the block branches back to stay live until that jump.
+ * A value that doesn't get a register is spilled for its whole interval.
+ * Guest state is only pinned when the block touches it more often than the writebacks pinning costs,
+ * and only with the callee saved registers the block's own values don't need.
+ */
+RegisterAllocationData AllocateRegisters(IntrusiveIRList const *IR, RegisterFile const &Registers);
+}
@@ -0,0 +1,227 @@
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/PassManager.h"
+#include "Core/CPU/Passes/Passes.h"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace Emu::IR {
+
+namespace {
+struct ValueKey {
+  IROps Op;
+  uint64_t Imm;     ///< Constant value, context offset and size or comparison type
+  uint64_t Version; ///< Context version the load saw
+  AlignmentType Args[4];
+
+  bool operator==(ValueKey const &Other) const {
+    return Op == Other.Op &&
+      Imm == Other.Imm &&
+      Version == Other.Version &&
+      Args[0] == Other.Args[0] &&
+      Args[1] == Other.Args[1] &&
+      Args[2] == Other.Args[2] &&
+      Args[3] == Other.Args[3];
+  }
+};
+
+struct ValueKeyHash {
+  size_t operator()(ValueKey const &Key) const {
+    uint64_t Hash = Key.Op;
+    auto Mix = [&Hash](uint64_t Value) {
+      Hash ^= Value + 0x9E3779B97F4A7C15ULL + (Hash << 6) + (Hash >> 2);
+    };
+    Mix(Key.Imm);
+    Mix(Key.Version);
+    for (auto Arg : Key.Args)
+      Mix(Arg);
+    return Hash;
+  }
+};
+
+// Context is versioned in 8 byte slots
+constexpr uint32_t CONTEXT_SLOT_SIZE = 8;
+}
+
+class ValueNumbering final : public BlockPass {
+public:
+  std::string GetName() override { return "ValueNumbering"; }
+
+private:
+  bool RunOnBlock(IntrusiveIRList *IR) override;
+};
+
+bool ValueNumbering::RunOnBlock(IntrusiveIRList *IR) {
+  bool Changed = false;
+  size_t Size = IR->GetOffset();
+
+  // Offset of the value that each op's value was merged in to
+  std::vector<AlignmentType> Remap(Size);
+  std::unordered_map<ValueKey, AlignmentType, ValueKeyHash> Values;
+
+  // Every store to a context slot gives it a new version, so loads on either side of it never merge
+  // Anything that can write to the context without telling us bumps the epoch instead
+  std::unordered_map<uint32_t, uint32_t> ContextVersions;
+  uint32_t Epoch = 0;
+  uint32_t NextVersion = 0;
+  auto GetContextVersion = [&](uint32_t Offset) -> uint64_t {
+    auto it = ContextVersions.find(Offset / CONTEXT_SLOT_SIZE);
+    uint32_t Version = it == ContextVersions.end() ? 0 : it->second;
+    return (uint64_t(Epoch) << 32) | Version;
+  };
+
+  // The exit path of a conditional jump doesn't dominate anything after its JmpTarget
+  // Values found inside it get dropped once we land on the target
+  struct Scope {
+    AlignmentType Target;
+    size_t LogSize;
+  };
+  std::vector<Scope> Scopes;
+  std::vector<ValueKey> Log;
+
+  auto ResetAll = [&]() {
+    Values.clear();
+    Scopes.clear();
+    Log.clear();
+    ++Epoch;
+  };
+
+  auto Insert = [&](ValueKey const &Key, AlignmentType Offset) {
+    if (Values.emplace(Key, Offset).second)
+      Log.emplace_back(Key);
+  };
+
+  // Backends can turn a conditional jump to an earlier guest RIP in this block in to a loop
+  // Nothing before that RIP dominates the ops after it any more
+  std::unordered_set<uint64_t> RIPTargets;
+  for (size_t i = 0; i != Size; i += GetSize(IR->GetOp(i)->Op)) {
+    auto op = IR->GetOp(i);
+    if (op->Op == OP_COND_JUMP) {
+      RIPTargets.emplace(op->C<IROp_CondJump>()->RIPTarget);
+    }
+  }
+
+  size_t i = 0;
+  while (i != Size) {
+    auto op = IR->GetOp(i);
+    Remap[i] = i;
+
+    auto Args = GetArgs(op);
+    for (size_t j = 0; j < Args.second; ++j) {
+      AlignmentType NewArg = Remap[Args.first[j]];
+      if (NewArg != Args.first[j]) {
+        Args.first[j] = NewArg;
+        Changed = true;
+      }
+    }
+
+    ValueKey Key{};
+    Key.Op = op->Op;
+    bool Numbered = false;
+
+    switch (op->Op) {
+    case OP_CONSTANT:
+      Key.Imm = op->C<IROp_Constant>()->Constant;
+      Numbered = true;
+    break;
+    case OP_LOADCONTEXT: {
+      auto LoadOp = op->C<IROp_LoadContext>();
+      Key.Imm = (uint64_t(LoadOp->Size) << 32) | LoadOp->Offset;
+      Key.Version = GetContextVersion(LoadOp->Offset);
+      Numbered = true;
+    break;
+    }
+    case OP_STORECONTEXT: {
+      auto StoreOp = op->C<IROp_StoreContext>();
+      for (uint32_t Slot = StoreOp->Offset / CONTEXT_SLOT_SIZE;
+           Slot <= (StoreOp->Offset + StoreOp->Size - 1) / CONTEXT_SLOT_SIZE;
+           ++Slot) {
+        ContextVersions[Slot] = ++NextVersion;
+      }
+
+      // A full width load right after the store gets the stored value
+      if (StoreOp->Size == 8) {
+        ValueKey LoadKey{};
+        LoadKey.Op = OP_LOADCONTEXT;
+        LoadKey.Imm = (uint64_t(StoreOp->Size) << 32) | StoreOp->Offset;
+        LoadKey.Version = GetContextVersion(StoreOp->Offset);
+        Insert(LoadKey, StoreOp->Arg);
+      }
+    break;
+    }
+    case OP_SYSCALL:
+    case OP_FALLBACK:
+    case OP_RAISE_SIGNAL:
+    case OP_CALL:
+    case OP_EXTERN_CALL:
+    case OP_MATERIALIZE_FLAGS:
+      // These can change the context behind our back
+      ++Epoch;
+    break;
+    case OP_COND_JUMP:
+      Scopes.emplace_back(Scope{op->C<IROp_CondJump>()->Target, Log.size()});
+    break;
+    case OP_JUMP_TGT:
+      if (!Scopes.empty() && Scopes.back().Target == i) {
+        for (size_t j = Scopes.back().LogSize; j < Log.size(); ++j) {
+          Values.erase(Log[j]);
+        }
+        Log.resize(Scopes.back().LogSize);
+        Scopes.pop_back();
+      }
+      else {
+        ResetAll();
+      }
+    break;
+    case OP_RIP_MARKER:
+      if (RIPTargets.find(op->C<IROp_RIPMarker>()->RIP) != RIPTargets.end()) {
+        ResetAll();
+      }
+    break;
+    case OP_SELECT:
+      Key.Imm = op->C<IROp_Select>()->Op;
+      [[fallthrough]];
+    default:
+      if (IsPure(op->Op)) {
+        for (size_t j = 0; j < Args.second; ++j) {
+          Key.Args[j] = Args.first[j];
+        }
+
+        // Canonicalize commutative ops
+        switch (op->Op) {
+        case OP_ADD:
+        case OP_OR:
+        case OP_XOR:
+        case OP_AND:
+          if (Key.Args[0] > Key.Args[1])
+            std::swap(Key.Args[0], Key.Args[1]);
+        break;
+        default: break;
+        }
+        Numbered = true;
+      }
+    break;
+    }
+
+    if (Numbered) {
+      auto it = Values.find(Key);
+      if (it != Values.end()) {
+        Remap[i] = it->second;
+        Changed = true;
+      }
+      else {
+        Insert(Key, i);
+      }
+    }
+
+    i += GetSize(op->Op);
+  }
+
+  return Changed;
+}
+
+Pass* CreateValueNumberingPass() {
+  return new ValueNumbering{};
+}
+
+}
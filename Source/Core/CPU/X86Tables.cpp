@@ -1,571 +1,1321 @@
-#include "LogManager.h"
+#include "OpcodeDispatch.h"
 #include "X86Tables.h"
 #include <array>
-#include <tuple>
-#include <vector>
+#include <cstring>
 
 namespace Emu {
 namespace X86Tables {
+using IR::OpDispatchBuilder;
 
-std::array<X86InstInfo, 255> BaseOps;
-std::array<X86InstInfo, 255> SecondBaseOps;
-std::array<X86InstInfo, (1 << 16) - 1> ModRMOps;
+namespace {
+struct InfoEntry {
+  uint16_t Op;
+  uint8_t Count;
+  X86InstInfo Info;
+};
 
-void InitializeInfoTables() {
-  auto UnknownOp = X86InstInfo{"UND", TYPE_UNKNOWN, FLAGS_NONE, 0, 0};
-  for (uint32_t i = 0; i < BaseOps.size(); ++i) {
-    BaseOps[i] = UnknownOp;
-  }
-  for (uint32_t i = 0; i < SecondBaseOps.size(); ++i) {
-    SecondBaseOps[i] = UnknownOp;
+struct DispatchEntry {
+  uint16_t Op;
+  uint8_t Count;
+  OpDispatchPtr Dispatcher;
+};
+
+constexpr X86InstInfo UnknownOp = X86InstInfo{"UND", TYPE_UNKNOWN, FLAGS_NONE, 0, 0};
+constexpr uint8_t NO_MODRM_GROUP = 0xFF;
+
+constexpr InfoEntry BaseOpTable[] = {
+  // Prefixes
+  {0x66, 1, X86InstInfo{"",      TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x67, 1, X86InstInfo{"",      TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x2E, 1, X86InstInfo{"CS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x3E, 1, X86InstInfo{"DS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x26, 1, X86InstInfo{"ES",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x64, 1, X86InstInfo{"FS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x65, 1, X86InstInfo{"GS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0x36, 1, X86InstInfo{"SS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0xF0, 1, X86InstInfo{"LOCK",  TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0xF2, 1, X86InstInfo{"REP",   TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+  {0xF3, 1, X86InstInfo{"REPNZ", TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
+
+  // REX
+  {0x40, 16, X86InstInfo{"", TYPE_REX_PREFIX, FLAGS_NONE, 0, 0}},
+
+  // Instructions
+  {0x00, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x01, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_DST_MODRM | FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 0, 0}},
+  {0x02, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x03, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_SRC_MODRM | FLAGS_HAS_MODRM,                             0, 0}},
+  {0x04, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x05, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_SRC_IMM | FLAGS_DISPLACE_SIZE_DIV_2,                     4, 0}},
+  {0x08, 4, X86InstInfo{"OR",     TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x0C, 1, X86InstInfo{"OR",     TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x0D, 1, X86InstInfo{"OR",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x10, 4, X86InstInfo{"ADC",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x14, 1, X86InstInfo{"ADC",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x15, 1, X86InstInfo{"ADC",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x18, 4, X86InstInfo{"SBB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x1C, 1, X86InstInfo{"SBB",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x1D, 1, X86InstInfo{"SBB",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x20, 4, X86InstInfo{"AND",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x24, 1, X86InstInfo{"AND",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x25, 1, X86InstInfo{"AND",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x28, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x29, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 0, 0}},
+  {0x2A, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x2B, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x2C, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x2D, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x30, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x31, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x32, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x33, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x34, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x35, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x38, 4, X86InstInfo{"CMP",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x3C, 1, X86InstInfo{"CMP",    TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x3D, 1, X86InstInfo{"CMP",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x50, 8, X86InstInfo{"PUSH",   TYPE_INST, FLAGS_REX_IN_BYTE,         0, 0}},
+  {0x58, 8, X86InstInfo{"POP",    TYPE_INST, FLAGS_REX_IN_BYTE,         0, 0}},
+  {0x63, 1, X86InstInfo{"MOVSXD", TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x68, 1, X86InstInfo{"PUSH",   TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x69, 1, X86InstInfo{"IMUL",   TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,   4, 0}},
+  {0x6A, 1, X86InstInfo{"PUSH",   TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0x6B, 1, X86InstInfo{"IMUL",   TYPE_INST, FLAGS_HAS_MODRM,           1, 0}},
+  {0x70, 1, X86InstInfo{"JO",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x71, 1, X86InstInfo{"JNO",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x72, 1, X86InstInfo{"JB",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x73, 1, X86InstInfo{"JNB",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x74, 1, X86InstInfo{"JZ",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x75, 1, X86InstInfo{"JNZ",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x76, 1, X86InstInfo{"JBE",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x77, 1, X86InstInfo{"JNBE",   TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x78, 1, X86InstInfo{"JS",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x79, 1, X86InstInfo{"JNS",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7A, 1, X86InstInfo{"JP",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7B, 1, X86InstInfo{"JNP",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7C, 1, X86InstInfo{"JL",     TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7D, 1, X86InstInfo{"JNL",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7E, 1, X86InstInfo{"JLE",    TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x7F, 1, X86InstInfo{"JNLE",   TYPE_INST, FLAGS_SETS_RIP,            1, 0}},
+  {0x82, 1, X86InstInfo{"[INV]",  TYPE_INVALID, FLAGS_NONE,                0, 0}},
+  {0x84, 2, X86InstInfo{"TEST",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x88, 5, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x8E, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x8D, 1, X86InstInfo{"LEA",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x90, 1, X86InstInfo{"NOP",    TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0x98, 1, X86InstInfo{"CDQE",   TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0x99, 1, X86InstInfo{"CQO",    TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0xA0, 4, X86InstInfo{"MOV",    TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0xA8, 1, X86InstInfo{"TEST",   TYPE_INST, FLAGS_NONE,                1, 0}},
+  {0xA9, 1, X86InstInfo{"TEST",   TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0xAA, 2, X86InstInfo{"STOS",   TYPE_INST, FLAGS_STRING_OP,           0, 0}},
+
+  {0xB0, 8, X86InstInfo{"MOV",    TYPE_INST, FLAGS_REX_IN_BYTE,         1, 0}},
+  {0xB8, 8, X86InstInfo{"MOV",    TYPE_INST, FLAGS_REX_IN_BYTE | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_DISPLACE_SIZE_MUL_2, 4, 0}},
+  {0xC2, 1, X86InstInfo{"RET",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_BLOCK_END,                2, 0}},
+  {0xC3, 1, X86InstInfo{"RET",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_BLOCK_END,                0, 0}},
+  // VEX and EVEX, LES, LDS and BOUND in 32bit mode
+  {0x62, 1, X86InstInfo{"EVEX",   TYPE_EVEX_PREFIX, FLAGS_NONE,          0, 0}},
+  {0xC4, 2, X86InstInfo{"VEX",    TYPE_VEX_PREFIX, FLAGS_NONE,           0, 0}},
+  {0xC6, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           1, 0}},
+  {0xC7, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0xC8, 1, X86InstInfo{"ENTER",  TYPE_INST, FLAGS_NONE,                3, 0}},
+  {0xC9, 1, X86InstInfo{"LEAVE",  TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0xD4, 3, X86InstInfo{"[INV]",  TYPE_INVALID, FLAGS_NONE,                0, 0}},
+
+  {0xE8, 1, X86InstInfo{"CALL",   TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_BLOCK_END, 4, 0}},
+  {0xE9, 1, X86InstInfo{"JMP",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_BLOCK_END, 4, 0}},
+  {0xEB, 1, X86InstInfo{"JMP",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_BLOCK_END,                             1, 0}},
+
+  // ModRM table
+  {0x80, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0x81, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0x83, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0x8F, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xC0, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xC1, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xD0, 4, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xD8, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xF6, 2, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xFE, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+  {0xFF, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
+};
+
+constexpr InfoEntry TwoByteOpTable[] = {
+  // Instructions
+  {0x05, 1, X86InstInfo{"SYSCALL",    TYPE_INST, FLAGS_BLOCK_END, 0, 0}},
+  {0x1f, 1, X86InstInfo{"NOP",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x31, 1, X86InstInfo{"RDTSC",      TYPE_INST, FLAGS_NONE,      0, 0}},
+  {0x40, 1, X86InstInfo{"CMOVO",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x41, 1, X86InstInfo{"CMOVNO",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x42, 1, X86InstInfo{"CMOVB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x43, 1, X86InstInfo{"CMOVNB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x44, 1, X86InstInfo{"CMOVZ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x45, 1, X86InstInfo{"CMOVNZ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x46, 1, X86InstInfo{"CMOVBE",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x47, 1, X86InstInfo{"CMOVNBE",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x48, 1, X86InstInfo{"CMOVS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x49, 1, X86InstInfo{"CMOVNS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4A, 1, X86InstInfo{"CMOVP",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4B, 1, X86InstInfo{"CMOVNP",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4C, 1, X86InstInfo{"CMOVL",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4D, 1, X86InstInfo{"CMOVNL",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4E, 1, X86InstInfo{"CMOVLE",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x4F, 1, X86InstInfo{"CMOVNLE",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  {0x6E, 1, X86InstInfo{"MOVD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x6F, 1, X86InstInfo{"MOVDQU",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0x7E, 1, X86InstInfo{"MOVD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x7F, 1, X86InstInfo{"MOVDQU",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x80, 1, X86InstInfo{"JO",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x81, 1, X86InstInfo{"JNO",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x82, 1, X86InstInfo{"JB",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x83, 1, X86InstInfo{"JNB",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x84, 1, X86InstInfo{"JZ",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x85, 1, X86InstInfo{"JNZ",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x86, 1, X86InstInfo{"JBE",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x87, 1, X86InstInfo{"JNBE",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x88, 1, X86InstInfo{"JS",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x89, 1, X86InstInfo{"JNS",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8A, 1, X86InstInfo{"JP",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8B, 1, X86InstInfo{"JNP",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8C, 1, X86InstInfo{"JL",      TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8D, 1, X86InstInfo{"JNL",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8E, 1, X86InstInfo{"JLE",     TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x8F, 1, X86InstInfo{"JNLE",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0x90, 1, X86InstInfo{"SETO",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x91, 1, X86InstInfo{"SETNO",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x92, 1, X86InstInfo{"SETB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x93, 1, X86InstInfo{"SETNB",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x94, 1, X86InstInfo{"SETZ",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x95, 1, X86InstInfo{"SETNZ",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x96, 1, X86InstInfo{"SETBE",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x97, 1, X86InstInfo{"SETNBE",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x98, 1, X86InstInfo{"SETS",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x99, 1, X86InstInfo{"SETNS",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9A, 1, X86InstInfo{"SETP",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9B, 1, X86InstInfo{"SETNP",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9C, 1, X86InstInfo{"SETL",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9D, 1, X86InstInfo{"SETNL",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9E, 1, X86InstInfo{"SETLE",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0x9F, 1, X86InstInfo{"SETNLE",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xA2, 1, X86InstInfo{"CPUID",   TYPE_INST, FLAGS_NONE,                0, 0}},
+  {0xA3, 1, X86InstInfo{"BT",      TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xAF, 1, X86InstInfo{"IMUL",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xB0, 2, X86InstInfo{"CMPXCHG", TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xBA, 1, X86InstInfo{"BT",      TYPE_INST, FLAGS_HAS_MODRM,           1, 0}},
+  {0xB6, 2, X86InstInfo{"MOVZX",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xBC, 2, X86InstInfo{"BSF",     TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xBE, 2, X86InstInfo{"MOVSX",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  // SSE
+  {0x10, 2, X86InstInfo{"MOVUPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16, 2, X86InstInfo{"MOVHPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29, 1, X86InstInfo{"MOVAPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xEB, 1, X86InstInfo{"POR",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // SSE2
+  {0x60, 1, X86InstInfo{"PUNPCKLBW",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x61, 1, X86InstInfo{"PUNPCKLWD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x62, 1, X86InstInfo{"PUNPCKLDQ",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x66, 1, X86InstInfo{"PCMPGTD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x6A, 1, X86InstInfo{"PUNPCKHDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x6C, 1, X86InstInfo{"PUNPCKLQDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x6D, 1, X86InstInfo{"PUNPCKHQDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x70, 1, X86InstInfo{"PSHUFD",     TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
+  {0x73, 1, X86InstInfo{"PSLLQ",      TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
+  {0x74, 1, X86InstInfo{"PCMPEQB",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0x72, 1, X86InstInfo{"PSLLD",      TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
+  {0x76, 1, X86InstInfo{"PCMPEQD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0xD4, 1, X86InstInfo{"PADDQ",      TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0xD6, 1, X86InstInfo{"MOVQ",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0xD7, 1, X86InstInfo{"PMOVMSKB",   TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0xEF, 1, X86InstInfo{"PXOR",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+  {0xFE, 1, X86InstInfo{"PADDD",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
+};
+
+// Indexed by (opcode << 8) | ModRM.reg, each opcode gets its own group of eight
+constexpr InfoEntry ModRMOpTable[] = {
+  {0x8000, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8001, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8002, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8003, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8004, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8005, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8006, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8007, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+
+  {0x8100, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8101, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8102, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8103, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8104, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8105, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8106, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+  {0x8107, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
+
+  {0x8300, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8301, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8302, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8303, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8304, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8305, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8306, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0x8307, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+
+  // The rest of 8F is AMD's XOP prefix
+  {0x8F00, 1, X86InstInfo{"POP",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xC000, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC001, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC002, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC003, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC004, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC005, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC006, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC007, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+
+  {0xC100, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC101, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC102, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC103, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC104, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC105, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC106, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+  {0xC107, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
+
+  {0xD000, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD001, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD002, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD003, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD004, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD005, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD006, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD007, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xD100, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD101, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD102, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD103, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD104, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD105, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD106, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD107, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xD200, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD201, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD202, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD203, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD204, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD205, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD206, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD207, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xD300, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD301, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD302, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD303, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD304, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD305, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD306, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xD307, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xF600, 2, X86InstInfo{"TEST", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0xF602, 1, X86InstInfo{"NOT",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF603, 1, X86InstInfo{"NEG",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF604, 1, X86InstInfo{"MUL",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF605, 1, X86InstInfo{"IMUL", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF606, 1, X86InstInfo{"DIV",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF607, 1, X86InstInfo{"IDIV", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF700, 2, X86InstInfo{"TEST", TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
+  {0xF702, 1, X86InstInfo{"NOT",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF703, 1, X86InstInfo{"NEG",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF704, 1, X86InstInfo{"MUL",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF705, 1, X86InstInfo{"IMUL", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF706, 1, X86InstInfo{"DIV",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xF707, 1, X86InstInfo{"IDIV", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  {0xFE00, 1, X86InstInfo{"INC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xFE01, 1, X86InstInfo{"DEC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+
+  {0xFF00, 1, X86InstInfo{"INC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xFF01, 1, X86InstInfo{"DEC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+  {0xFF02, 1, X86InstInfo{"CALL",  TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
+  {0xFF03, 1, X86InstInfo{"CALLF", TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
+  {0xFF04, 1, X86InstInfo{"JMP",   TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
+  {0xFF05, 1, X86InstInfo{"JMPF",  TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
+  {0xFF06, 1, X86InstInfo{"PUSH",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
+};
+
+// 0F 38, everything has a ModRM
+constexpr InfoEntry ThreeByte38OpTable[] = {
+  // SSSE3
+  {0x00, 1, X86InstInfo{"PSHUFB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x01, 1, X86InstInfo{"PHADDW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x02, 1, X86InstInfo{"PHADDD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x03, 1, X86InstInfo{"PHADDSW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x04, 1, X86InstInfo{"PMADDUBSW",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x05, 1, X86InstInfo{"PHSUBW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x06, 1, X86InstInfo{"PHSUBD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x07, 1, X86InstInfo{"PHSUBSW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x08, 1, X86InstInfo{"PSIGNB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x09, 1, X86InstInfo{"PSIGNW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x0A, 1, X86InstInfo{"PSIGND",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x0B, 1, X86InstInfo{"PMULHRSW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1C, 1, X86InstInfo{"PABSB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D, 1, X86InstInfo{"PABSW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E, 1, X86InstInfo{"PABSD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // SSE4.1
+  {0x10, 1, X86InstInfo{"PBLENDVB",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x14, 1, X86InstInfo{"BLENDVPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15, 1, X86InstInfo{"BLENDVPD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17, 1, X86InstInfo{"PTEST",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20, 1, X86InstInfo{"PMOVSXBW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21, 1, X86InstInfo{"PMOVSXBD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22, 1, X86InstInfo{"PMOVSXBQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23, 1, X86InstInfo{"PMOVSXWD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x24, 1, X86InstInfo{"PMOVSXWQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x25, 1, X86InstInfo{"PMOVSXDQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28, 1, X86InstInfo{"PMULDQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29, 1, X86InstInfo{"PCMPEQQ",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A, 1, X86InstInfo{"MOVNTDQA",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B, 1, X86InstInfo{"PACKUSDW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x30, 1, X86InstInfo{"PMOVZXBW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x31, 1, X86InstInfo{"PMOVZXBD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x32, 1, X86InstInfo{"PMOVZXBQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x33, 1, X86InstInfo{"PMOVZXWD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x34, 1, X86InstInfo{"PMOVZXWQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x35, 1, X86InstInfo{"PMOVZXDQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x38, 1, X86InstInfo{"PMINSB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x39, 1, X86InstInfo{"PMINSD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3A, 1, X86InstInfo{"PMINUW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3B, 1, X86InstInfo{"PMINUD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3C, 1, X86InstInfo{"PMAXSB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3D, 1, X86InstInfo{"PMAXSD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3E, 1, X86InstInfo{"PMAXUW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x3F, 1, X86InstInfo{"PMAXUD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x40, 1, X86InstInfo{"PMULLD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x41, 1, X86InstInfo{"PHMINPOSUW", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // SSE4.2
+  {0x37, 1, X86InstInfo{"PCMPGTQ",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // VMX
+  {0x80, 1, X86InstInfo{"INVEPT",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x81, 1, X86InstInfo{"INVVPID",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x82, 1, X86InstInfo{"INVPCID",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // SHA
+  {0xC8, 1, X86InstInfo{"SHA1NEXTE",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xC9, 1, X86InstInfo{"SHA1MSG1",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xCA, 1, X86InstInfo{"SHA1MSG2",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xCB, 1, X86InstInfo{"SHA256RNDS2", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xCC, 1, X86InstInfo{"SHA256MSG1",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xCD, 1, X86InstInfo{"SHA256MSG2",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // AES
+  {0xDB, 1, X86InstInfo{"AESIMC",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xDC, 1, X86InstInfo{"AESENC",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xDD, 1, X86InstInfo{"AESENCLAST", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xDE, 1, X86InstInfo{"AESDEC",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0xDF, 1, X86InstInfo{"AESDECLAST", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // MOVBE without a prefix, CRC32 with F2
+  {0xF0, 2, X86InstInfo{"MOVBE",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // ADCX with 66, ADOX with F3
+  {0xF6, 1, X86InstInfo{"ADCX",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+};
+
+// 0F 3A, everything has a ModRM and an imm8
+constexpr InfoEntry ThreeByte3AOpTable[] = {
+  // SSSE3
+  {0x0F, 1, X86InstInfo{"PALIGNR",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+
+  // SSE4.1
+  {0x08, 1, X86InstInfo{"ROUNDPS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x09, 1, X86InstInfo{"ROUNDPD",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x0A, 1, X86InstInfo{"ROUNDSS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x0B, 1, X86InstInfo{"ROUNDSD",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x0C, 1, X86InstInfo{"BLENDPS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x0D, 1, X86InstInfo{"BLENDPD",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x0E, 1, X86InstInfo{"PBLENDW",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x14, 1, X86InstInfo{"PEXTRB",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x15, 1, X86InstInfo{"PEXTRW",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x16, 1, X86InstInfo{"PEXTRD",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x17, 1, X86InstInfo{"EXTRACTPS",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x20, 1, X86InstInfo{"PINSRB",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x21, 1, X86InstInfo{"INSERTPS",   TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x22, 1, X86InstInfo{"PINSRD",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x40, 1, X86InstInfo{"DPPS",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x41, 1, X86InstInfo{"DPPD",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x42, 1, X86InstInfo{"MPSADBW",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+
+  // PCLMUL
+  {0x44, 1, X86InstInfo{"PCLMULQDQ",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+
+  // SSE4.2
+  {0x60, 1, X86InstInfo{"PCMPESTRM",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x61, 1, X86InstInfo{"PCMPESTRI",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x62, 1, X86InstInfo{"PCMPISTRM",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x63, 1, X86InstInfo{"PCMPISTRI",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+
+  // SHA
+  {0xCC, 1, X86InstInfo{"SHA1RNDS4",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+
+  // AES
+  {0xDF, 1, X86InstInfo{"AESKEYGENASSIST", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+};
+
+// Indexed by (VEX map << 8) | opcode, map 1 is 0F, 2 is 0F 38 and 3 is 0F 3A
+// EVEX uses the same maps, the AVX-512 only instructions are listed along with the rest
+// The mandatory prefix lives in VEX.pp, entries are named after the form without one where it exists
+constexpr InfoEntry VEXOpTable[] = {
+  // Map 1
+  {0x110, 2, X86InstInfo{"VMOVUPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x112, 2, X86InstInfo{"VMOVLPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x114, 1, X86InstInfo{"VUNPCKLPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x115, 1, X86InstInfo{"VUNPCKHPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x116, 2, X86InstInfo{"VMOVHPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x128, 2, X86InstInfo{"VMOVAPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12A, 1, X86InstInfo{"VCVTSI2SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12B, 1, X86InstInfo{"VMOVNTPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12C, 1, X86InstInfo{"VCVTTSS2SI",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12D, 1, X86InstInfo{"VCVTSS2SI",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12E, 1, X86InstInfo{"VUCOMISS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x12F, 1, X86InstInfo{"VCOMISS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // AVX-512 mask register logic
+  {0x141, 2, X86InstInfo{"KANDW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x144, 4, X86InstInfo{"KNOTW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x14A, 2, X86InstInfo{"KADDW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x150, 1, X86InstInfo{"VMOVMSKPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x151, 1, X86InstInfo{"VSQRTPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x152, 1, X86InstInfo{"VRSQRTPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x153, 1, X86InstInfo{"VRCPPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x154, 1, X86InstInfo{"VANDPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x155, 1, X86InstInfo{"VANDNPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x156, 1, X86InstInfo{"VORPS",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x157, 1, X86InstInfo{"VXORPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x158, 1, X86InstInfo{"VADDPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x159, 1, X86InstInfo{"VMULPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15A, 1, X86InstInfo{"VCVTPS2PD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15B, 1, X86InstInfo{"VCVTDQ2PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15C, 1, X86InstInfo{"VSUBPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15D, 1, X86InstInfo{"VMINPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15E, 1, X86InstInfo{"VDIVPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x15F, 1, X86InstInfo{"VMAXPS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x160, 1, X86InstInfo{"VPUNPCKLBW",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x161, 1, X86InstInfo{"VPUNPCKLWD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x162, 1, X86InstInfo{"VPUNPCKLDQ",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x163, 1, X86InstInfo{"VPACKSSWB",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x164, 1, X86InstInfo{"VPCMPGTB",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x165, 1, X86InstInfo{"VPCMPGTW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x166, 1, X86InstInfo{"VPCMPGTD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x167, 1, X86InstInfo{"VPACKUSWB",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x168, 1, X86InstInfo{"VPUNPCKHBW",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x169, 1, X86InstInfo{"VPUNPCKHWD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16A, 1, X86InstInfo{"VPUNPCKHDQ",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16B, 1, X86InstInfo{"VPACKSSDW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16C, 1, X86InstInfo{"VPUNPCKLQDQ", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16D, 1, X86InstInfo{"VPUNPCKHQDQ", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16E, 1, X86InstInfo{"VMOVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x16F, 1, X86InstInfo{"VMOVDQA",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x170, 1, X86InstInfo{"VPSHUFD",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  // Shift by immediate groups, ModRM.reg picks the shift
+  {0x171, 1, X86InstInfo{"VPSRLW",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x172, 1, X86InstInfo{"VPSRLD",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x173, 1, X86InstInfo{"VPSRLQ",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x174, 1, X86InstInfo{"VPCMPEQB",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x175, 1, X86InstInfo{"VPCMPEQW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x176, 1, X86InstInfo{"VPCMPEQD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // VZEROALL with VEX.L
+  {0x177, 1, X86InstInfo{"VZEROUPPER",  TYPE_INST, FLAGS_NONE,      0, 0}},
+  {0x178, 1, X86InstInfo{"VCVTTPS2UDQ", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x179, 1, X86InstInfo{"VCVTPS2UDQ",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17A, 1, X86InstInfo{"VCVTUDQ2PD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17B, 1, X86InstInfo{"VCVTUSI2SD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17C, 1, X86InstInfo{"VHADDPD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17D, 1, X86InstInfo{"VHSUBPD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17E, 1, X86InstInfo{"VMOVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x17F, 1, X86InstInfo{"VMOVDQA",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x190, 4, X86InstInfo{"KMOVW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x198, 2, X86InstInfo{"KORTESTW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // VLDMXCSR and VSTMXCSR, ModRM.reg picks
+  {0x1AE, 1, X86InstInfo{"VLDMXCSR",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1C2, 1, X86InstInfo{"VCMPPS",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x1C4, 1, X86InstInfo{"VPINSRW",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x1C5, 1, X86InstInfo{"VPEXTRW",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x1C6, 1, X86InstInfo{"VSHUFPS",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x1D0, 1, X86InstInfo{"VADDSUBPD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D1, 1, X86InstInfo{"VPSRLW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D2, 1, X86InstInfo{"VPSRLD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D3, 1, X86InstInfo{"VPSRLQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D4, 1, X86InstInfo{"VPADDQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D5, 1, X86InstInfo{"VPMULLW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D6, 1, X86InstInfo{"VMOVQ",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D7, 1, X86InstInfo{"VPMOVMSKB",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D8, 1, X86InstInfo{"VPSUBUSB",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1D9, 1, X86InstInfo{"VPSUBUSW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DA, 1, X86InstInfo{"VPMINUB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DB, 1, X86InstInfo{"VPAND",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DC, 1, X86InstInfo{"VPADDUSB",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DD, 1, X86InstInfo{"VPADDUSW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DE, 1, X86InstInfo{"VPMAXUB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1DF, 1, X86InstInfo{"VPANDN",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E0, 1, X86InstInfo{"VPAVGB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E1, 1, X86InstInfo{"VPSRAW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E2, 1, X86InstInfo{"VPSRAD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E3, 1, X86InstInfo{"VPAVGW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E4, 1, X86InstInfo{"VPMULHUW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E5, 1, X86InstInfo{"VPMULHW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E6, 1, X86InstInfo{"VCVTTPD2DQ",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E7, 1, X86InstInfo{"VMOVNTDQ",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E8, 1, X86InstInfo{"VPSUBSB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1E9, 1, X86InstInfo{"VPSUBSW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1EA, 1, X86InstInfo{"VPMINSW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1EB, 1, X86InstInfo{"VPOR",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1EC, 1, X86InstInfo{"VPADDSB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1ED, 1, X86InstInfo{"VPADDSW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1EE, 1, X86InstInfo{"VPMAXSW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1EF, 1, X86InstInfo{"VPXOR",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F0, 1, X86InstInfo{"VLDDQU",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F1, 1, X86InstInfo{"VPSLLW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F2, 1, X86InstInfo{"VPSLLD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F3, 1, X86InstInfo{"VPSLLQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F4, 1, X86InstInfo{"VPMULUDQ",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F5, 1, X86InstInfo{"VPMADDWD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F6, 1, X86InstInfo{"VPSADBW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F7, 1, X86InstInfo{"VMASKMOVDQU", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F8, 1, X86InstInfo{"VPSUBB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1F9, 1, X86InstInfo{"VPSUBW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1FA, 1, X86InstInfo{"VPSUBD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1FB, 1, X86InstInfo{"VPSUBQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1FC, 1, X86InstInfo{"VPADDB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1FD, 1, X86InstInfo{"VPADDW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x1FE, 1, X86InstInfo{"VPADDD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // Map 2
+  {0x200, 1, X86InstInfo{"VPSHUFB",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x201, 1, X86InstInfo{"VPHADDW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x202, 1, X86InstInfo{"VPHADDD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x203, 1, X86InstInfo{"VPHADDSW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x204, 1, X86InstInfo{"VPMADDUBSW",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x205, 1, X86InstInfo{"VPHSUBW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x206, 1, X86InstInfo{"VPHSUBD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x207, 1, X86InstInfo{"VPHSUBSW",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x208, 1, X86InstInfo{"VPSIGNB",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x209, 1, X86InstInfo{"VPSIGNW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20A, 1, X86InstInfo{"VPSIGND",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20B, 1, X86InstInfo{"VPMULHRSW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20C, 1, X86InstInfo{"VPERMILPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20D, 1, X86InstInfo{"VPERMILPD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20E, 1, X86InstInfo{"VTESTPS",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x20F, 1, X86InstInfo{"VTESTPD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x210, 1, X86InstInfo{"VPSRLVW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x211, 1, X86InstInfo{"VPSRAVW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x212, 1, X86InstInfo{"VPSLLVW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x213, 1, X86InstInfo{"VCVTPH2PS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x214, 1, X86InstInfo{"VPRORVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x215, 1, X86InstInfo{"VPROLVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x216, 1, X86InstInfo{"VPERMPS",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x217, 1, X86InstInfo{"VPTEST",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x218, 1, X86InstInfo{"VBROADCASTSS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x219, 1, X86InstInfo{"VBROADCASTSD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21A, 1, X86InstInfo{"VBROADCASTF128", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21B, 1, X86InstInfo{"VBROADCASTF32X8", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21C, 1, X86InstInfo{"VPABSB",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21D, 1, X86InstInfo{"VPABSW",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21E, 1, X86InstInfo{"VPABSD",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x21F, 1, X86InstInfo{"VPABSQ",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x220, 1, X86InstInfo{"VPMOVSXBW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x221, 1, X86InstInfo{"VPMOVSXBD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x222, 1, X86InstInfo{"VPMOVSXBQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x223, 1, X86InstInfo{"VPMOVSXWD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x224, 1, X86InstInfo{"VPMOVSXWQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x225, 1, X86InstInfo{"VPMOVSXDQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x226, 1, X86InstInfo{"VPTESTMB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x227, 1, X86InstInfo{"VPTESTMD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x228, 1, X86InstInfo{"VPMULDQ",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x229, 1, X86InstInfo{"VPCMPEQQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22A, 1, X86InstInfo{"VMOVNTDQA",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22B, 1, X86InstInfo{"VPACKUSDW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22C, 1, X86InstInfo{"VMASKMOVPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22D, 1, X86InstInfo{"VMASKMOVPD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22E, 1, X86InstInfo{"VMASKMOVPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x22F, 1, X86InstInfo{"VMASKMOVPD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x230, 1, X86InstInfo{"VPMOVZXBW",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x231, 1, X86InstInfo{"VPMOVZXBD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x232, 1, X86InstInfo{"VPMOVZXBQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x233, 1, X86InstInfo{"VPMOVZXWD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x234, 1, X86InstInfo{"VPMOVZXWQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x235, 1, X86InstInfo{"VPMOVZXDQ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x236, 1, X86InstInfo{"VPERMD",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x237, 1, X86InstInfo{"VPCMPGTQ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x238, 1, X86InstInfo{"VPMINSB",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x239, 1, X86InstInfo{"VPMINSD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23A, 1, X86InstInfo{"VPMINUW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23B, 1, X86InstInfo{"VPMINUD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23C, 1, X86InstInfo{"VPMAXSB",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23D, 1, X86InstInfo{"VPMAXSD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23E, 1, X86InstInfo{"VPMAXUW",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x23F, 1, X86InstInfo{"VPMAXUD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x240, 1, X86InstInfo{"VPMULLD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x241, 1, X86InstInfo{"VPHMINPOSUW",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x242, 1, X86InstInfo{"VGETEXPPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x243, 1, X86InstInfo{"VGETEXPSS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x244, 1, X86InstInfo{"VPLZCNTD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x245, 1, X86InstInfo{"VPSRLVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x246, 1, X86InstInfo{"VPSRAVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x247, 1, X86InstInfo{"VPSLLVD",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x24C, 1, X86InstInfo{"VRCP14PS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x24D, 1, X86InstInfo{"VRCP14SS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x24E, 1, X86InstInfo{"VRSQRT14PS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x24F, 1, X86InstInfo{"VRSQRT14SS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x250, 4, X86InstInfo{"VPDPBUSD",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x258, 1, X86InstInfo{"VPBROADCASTD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x259, 1, X86InstInfo{"VPBROADCASTQ",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x25A, 1, X86InstInfo{"VBROADCASTI128", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x25B, 1, X86InstInfo{"VBROADCASTI32X8", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x264, 1, X86InstInfo{"VPBLENDMD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x265, 1, X86InstInfo{"VBLENDMPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x266, 1, X86InstInfo{"VPBLENDMB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x275, 1, X86InstInfo{"VPERMI2B",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x276, 1, X86InstInfo{"VPERMI2D",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x277, 1, X86InstInfo{"VPERMI2PS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x278, 1, X86InstInfo{"VPBROADCASTB",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x279, 1, X86InstInfo{"VPBROADCASTW",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27A, 1, X86InstInfo{"VPBROADCASTB",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27B, 1, X86InstInfo{"VPBROADCASTW",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27C, 1, X86InstInfo{"VPBROADCASTD",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27D, 1, X86InstInfo{"VPERMT2B",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27E, 1, X86InstInfo{"VPERMT2D",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x27F, 1, X86InstInfo{"VPERMT2PS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x288, 1, X86InstInfo{"VEXPANDPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x289, 1, X86InstInfo{"VPEXPANDD",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28A, 1, X86InstInfo{"VCOMPRESSPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28B, 1, X86InstInfo{"VPCOMPRESSD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28C, 1, X86InstInfo{"VPMASKMOVD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28D, 1, X86InstInfo{"VPERMB",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x28E, 1, X86InstInfo{"VPMASKMOVD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // Gathers and scatters have a VSIB, it decodes the same as a SIB
+  {0x290, 1, X86InstInfo{"VPGATHERDD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x291, 1, X86InstInfo{"VPGATHERQD",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x292, 1, X86InstInfo{"VGATHERDPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x293, 1, X86InstInfo{"VGATHERQPS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x296, 1, X86InstInfo{"VFMADDSUB132PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x297, 1, X86InstInfo{"VFMSUBADD132PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x298, 1, X86InstInfo{"VFMADD132PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x299, 1, X86InstInfo{"VFMADD132SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29A, 1, X86InstInfo{"VFMSUB132PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29B, 1, X86InstInfo{"VFMSUB132SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29C, 1, X86InstInfo{"VFNMADD132PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29D, 1, X86InstInfo{"VFNMADD132SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29E, 1, X86InstInfo{"VFNMSUB132PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x29F, 1, X86InstInfo{"VFNMSUB132SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A0, 1, X86InstInfo{"VPSCATTERDD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A1, 1, X86InstInfo{"VPSCATTERQD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A2, 1, X86InstInfo{"VSCATTERDPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A3, 1, X86InstInfo{"VSCATTERQPS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A6, 1, X86InstInfo{"VFMADDSUB213PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A7, 1, X86InstInfo{"VFMSUBADD213PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A8, 1, X86InstInfo{"VFMADD213PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2A9, 1, X86InstInfo{"VFMADD213SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AA, 1, X86InstInfo{"VFMSUB213PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AB, 1, X86InstInfo{"VFMSUB213SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AC, 1, X86InstInfo{"VFNMADD213PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AD, 1, X86InstInfo{"VFNMADD213SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AE, 1, X86InstInfo{"VFNMSUB213PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2AF, 1, X86InstInfo{"VFNMSUB213SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B4, 1, X86InstInfo{"VPMADD52LUQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B5, 1, X86InstInfo{"VPMADD52HUQ",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B6, 1, X86InstInfo{"VFMADDSUB231PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B7, 1, X86InstInfo{"VFMSUBADD231PS", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B8, 1, X86InstInfo{"VFMADD231PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2B9, 1, X86InstInfo{"VFMADD231SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BA, 1, X86InstInfo{"VFMSUB231PS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BB, 1, X86InstInfo{"VFMSUB231SS",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BC, 1, X86InstInfo{"VFNMADD231PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BD, 1, X86InstInfo{"VFNMADD231SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BE, 1, X86InstInfo{"VFNMSUB231PS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2BF, 1, X86InstInfo{"VFNMSUB231SS",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2C4, 1, X86InstInfo{"VPCONFLICTD",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2C8, 1, X86InstInfo{"VEXP2PS",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2CA, 1, X86InstInfo{"VRCP28PS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2CB, 1, X86InstInfo{"VRCP28SS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2CC, 1, X86InstInfo{"VRSQRT28PS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2CD, 1, X86InstInfo{"VRSQRT28SS",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2CF, 1, X86InstInfo{"VGF2P8MULB",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2DB, 1, X86InstInfo{"VAESIMC",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2DC, 1, X86InstInfo{"VAESENC",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2DD, 1, X86InstInfo{"VAESENCLAST",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2DE, 1, X86InstInfo{"VAESDEC",       TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2DF, 1, X86InstInfo{"VAESDECLAST",   TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // BMI1 and BMI2, general purpose registers with VEX.W picking the size
+  {0x2F2, 1, X86InstInfo{"ANDN",          TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // BLSR, BLSMSK and BLSI, ModRM.reg picks
+  {0x2F3, 1, X86InstInfo{"BLSR",          TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // BZHI without a prefix, PEXT with F3, PDEP with F2
+  {0x2F5, 1, X86InstInfo{"BZHI",          TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  {0x2F6, 1, X86InstInfo{"MULX",          TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+  // BEXTR without a prefix, SHLX with 66, SARX with F3, SHRX with F2
+  {0x2F7, 1, X86InstInfo{"BEXTR",         TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
+
+  // Map 3, everything has an imm8
+  {0x300, 1, X86InstInfo{"VPERMQ",        TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x301, 1, X86InstInfo{"VPERMPD",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x302, 1, X86InstInfo{"VPBLENDD",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x303, 1, X86InstInfo{"VALIGND",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x304, 1, X86InstInfo{"VPERMILPS",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x305, 1, X86InstInfo{"VPERMILPD",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x306, 1, X86InstInfo{"VPERM2F128",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x308, 1, X86InstInfo{"VROUNDPS",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x309, 1, X86InstInfo{"VROUNDPD",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30A, 1, X86InstInfo{"VROUNDSS",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30B, 1, X86InstInfo{"VROUNDSD",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30C, 1, X86InstInfo{"VBLENDPS",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30D, 1, X86InstInfo{"VBLENDPD",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30E, 1, X86InstInfo{"VPBLENDW",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x30F, 1, X86InstInfo{"VPALIGNR",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x314, 1, X86InstInfo{"VPEXTRB",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x315, 1, X86InstInfo{"VPEXTRW",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x316, 1, X86InstInfo{"VPEXTRD",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x317, 1, X86InstInfo{"VEXTRACTPS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x318, 1, X86InstInfo{"VINSERTF128",   TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x319, 1, X86InstInfo{"VEXTRACTF128",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x31A, 1, X86InstInfo{"VINSERTF32X8",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x31B, 1, X86InstInfo{"VEXTRACTF32X8", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x31D, 1, X86InstInfo{"VCVTPS2PH",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x31E, 1, X86InstInfo{"VPCMPUD",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x31F, 1, X86InstInfo{"VPCMPD",        TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x320, 1, X86InstInfo{"VPINSRB",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x321, 1, X86InstInfo{"VINSERTPS",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x322, 1, X86InstInfo{"VPINSRD",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x323, 1, X86InstInfo{"VSHUFF32X4",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x325, 1, X86InstInfo{"VPTERNLOGD",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x326, 1, X86InstInfo{"VGETMANTPS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x327, 1, X86InstInfo{"VGETMANTSS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x330, 4, X86InstInfo{"KSHIFTRB",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x338, 1, X86InstInfo{"VINSERTI128",   TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x339, 1, X86InstInfo{"VEXTRACTI128",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x33A, 1, X86InstInfo{"VINSERTI32X8",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x33B, 1, X86InstInfo{"VEXTRACTI32X8", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x33E, 1, X86InstInfo{"VPCMPUB",       TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x33F, 1, X86InstInfo{"VPCMPB",        TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x340, 1, X86InstInfo{"VDPPS",         TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x341, 1, X86InstInfo{"VDPPD",         TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x342, 1, X86InstInfo{"VMPSADBW",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x343, 1, X86InstInfo{"VSHUFI32X4",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x344, 1, X86InstInfo{"VPCLMULQDQ",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x346, 1, X86InstInfo{"VPERM2I128",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  // The imm8 holds a fourth register in its top bits
+  {0x34A, 1, X86InstInfo{"VBLENDVPS",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x34B, 1, X86InstInfo{"VBLENDVPD",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x34C, 1, X86InstInfo{"VPBLENDVB",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x350, 2, X86InstInfo{"VRANGEPS",      TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x354, 2, X86InstInfo{"VFIXUPIMMPS",   TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x356, 2, X86InstInfo{"VREDUCEPS",     TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x360, 1, X86InstInfo{"VPCMPESTRM",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x361, 1, X86InstInfo{"VPCMPESTRI",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x362, 1, X86InstInfo{"VPCMPISTRM",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x363, 1, X86InstInfo{"VPCMPISTRI",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x366, 2, X86InstInfo{"VFPCLASSPS",    TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x3CE, 1, X86InstInfo{"VGF2P8AFFINEQB", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x3CF, 1, X86InstInfo{"VGF2P8AFFINEINVQB", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  {0x3DF, 1, X86InstInfo{"VAESKEYGENASSIST", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+  // BMI2
+  {0x3F0, 1, X86InstInfo{"RORX",          TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
+};
+
+constexpr DispatchEntry BaseOpDispatchers[] = {
+  // Instructions
+  {0x00, 6, &OpDispatchBuilder::ALUOp},
+  {0x08, 6, &OpDispatchBuilder::ALUOp},
+  {0x10, 6, &OpDispatchBuilder::ALUOp},
+  {0x18, 6, &OpDispatchBuilder::ALUOp},
+  {0x20, 6, &OpDispatchBuilder::ALUOp},
+  {0x28, 6, &OpDispatchBuilder::ALUOp},
+  {0x30, 6, &OpDispatchBuilder::ALUOp},
+  {0x38, 6, &OpDispatchBuilder::ALUOp},
+  {0x50, 8, &OpDispatchBuilder::PUSHOp},
+  {0x58, 8, &OpDispatchBuilder::POPOp},
+  {0x68, 1, &OpDispatchBuilder::PUSHOp},
+  {0x69, 1, &OpDispatchBuilder::IMULOp},
+  {0x6A, 1, &OpDispatchBuilder::PUSHOp},
+  {0x6B, 1, &OpDispatchBuilder::IMULOp},
+  {0x70, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_OF>},
+  {0x71, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NOF>},
+  {0x72, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_C>},
+  {0x73, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NC>},
+  {0x74, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_Z>},
+  {0x75, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NZ>},
+  {0x76, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_BE>},
+  {0x77, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NBE>},
+  {0x78, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_S>},
+  {0x79, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NS>},
+  {0x7A, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_P>},
+  {0x7B, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NP>},
+  {0x7C, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_L>},
+  {0x7D, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NL>},
+  {0x7E, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_LE>},
+  {0x7F, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NLE>},
+  {0x84, 2, &OpDispatchBuilder::TESTOp},
+  {0x88, 4, &OpDispatchBuilder::MovOp},
+  {0x8D, 1, &OpDispatchBuilder::LEAOp},
+  {0x90, 1, &OpDispatchBuilder::NoOp},
+  {0xA8, 2, &OpDispatchBuilder::TESTOp},
+  {0xB0, 16, &OpDispatchBuilder::MovImmOp},
+  {0xC2, 2, &OpDispatchBuilder::RETOp},
+  {0xC6, 2, &OpDispatchBuilder::MovImmOp},
+  {0xC8, 1, &OpDispatchBuilder::ENTEROp},
+  {0xC9, 1, &OpDispatchBuilder::LEAVEOp},
+  {0xE8, 1, &OpDispatchBuilder::CALLOp},
+};
+
+constexpr DispatchEntry TwoByteOpDispatchers[] = {
+  // Instructions
+  {0x05, 1, &OpDispatchBuilder::SyscallOp},
+  {0x1F, 1, &OpDispatchBuilder::NoOp},
+  {0x40, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_OF>},
+  {0x41, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NOF>},
+  {0x42, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_C>},
+  {0x43, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NC>},
+  {0x44, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_Z>},
+  {0x45, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NZ>},
+  {0x46, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_BE>},
+  {0x47, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NBE>},
+  {0x48, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_S>},
+  {0x49, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NS>},
+  {0x4A, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_P>},
+  {0x4B, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NP>},
+  {0x4C, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_L>},
+  {0x4D, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NL>},
+  {0x4E, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_LE>},
+  {0x4F, 1, &OpDispatchBuilder::CMOVccOp<OpDispatchBuilder::CC_NLE>},
+  {0x80, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_OF>},
+  {0x81, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NOF>},
+  {0x82, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_C>},
+  {0x83, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NC>},
+  {0x84, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_Z>},
+  {0x85, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NZ>},
+  {0x86, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_BE>},
+  {0x87, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NBE>},
+  {0x88, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_S>},
+  {0x89, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NS>},
+  {0x8A, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_P>},
+  {0x8B, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NP>},
+  {0x8C, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_L>},
+  {0x8D, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NL>},
+  {0x8E, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_LE>},
+  {0x8F, 1, &OpDispatchBuilder::JccOp<OpDispatchBuilder::CC_NLE>},
+  {0x90, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_OF>},
+  {0x91, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NOF>},
+  {0x92, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_C>},
+  {0x93, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NC>},
+  {0x94, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_Z>},
+  {0x95, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NZ>},
+  {0x96, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_BE>},
+  {0x97, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NBE>},
+  {0x98, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_S>},
+  {0x99, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NS>},
+  {0x9A, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_P>},
+  {0x9B, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NP>},
+  {0x9C, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_L>},
+  {0x9D, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NL>},
+  {0x9E, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_LE>},
+  {0x9F, 1, &OpDispatchBuilder::SETccOp<OpDispatchBuilder::CC_NLE>},
+  {0xA3, 1, &OpDispatchBuilder::BTOp},
+  {0xAF, 1, &OpDispatchBuilder::IMULOp},
+};
+
+constexpr DispatchEntry ModRMOpDispatchers[] = {
+  {0x8000, 8, &OpDispatchBuilder::ALUImmOp},
+  {0x8100, 8, &OpDispatchBuilder::ALUImmOp},
+  {0x8300, 8, &OpDispatchBuilder::ALUImmOp},
+  {0x8F00, 1, &OpDispatchBuilder::POPOp},
+  {0xC000, 4, &OpDispatchBuilder::RotateOp},
+  {0xC004, 4, &OpDispatchBuilder::ShiftOp},
+  {0xC100, 4, &OpDispatchBuilder::RotateOp},
+  {0xC104, 4, &OpDispatchBuilder::ShiftOp},
+  {0xD000, 4, &OpDispatchBuilder::RotateOp},
+  {0xD004, 4, &OpDispatchBuilder::ShiftOp},
+  {0xD100, 4, &OpDispatchBuilder::RotateOp},
+  {0xD104, 4, &OpDispatchBuilder::ShiftOp},
+  {0xD200, 4, &OpDispatchBuilder::RotateOp},
+  {0xD204, 4, &OpDispatchBuilder::ShiftOp},
+  {0xD300, 4, &OpDispatchBuilder::RotateOp},
+  {0xD304, 4, &OpDispatchBuilder::ShiftOp},
+  {0xF600, 2, &OpDispatchBuilder::TESTOp},
+  {0xF602, 1, &OpDispatchBuilder::NOTOp},
+  {0xF603, 1, &OpDispatchBuilder::NEGOp},
+  {0xF604, 2, &OpDispatchBuilder::MULOp},
+  {0xF606, 2, &OpDispatchBuilder::DIVOp},
+  {0xF700, 2, &OpDispatchBuilder::TESTOp},
+  {0xF702, 1, &OpDispatchBuilder::NOTOp},
+  {0xF703, 1, &OpDispatchBuilder::NEGOp},
+  {0xF704, 2, &OpDispatchBuilder::MULOp},
+  {0xF706, 2, &OpDispatchBuilder::DIVOp},
+  {0xFE00, 2, &OpDispatchBuilder::INCDECOp},
+  {0xFF00, 2, &OpDispatchBuilder::INCDECOp},
+  {0xFF02, 1, &OpDispatchBuilder::CALLOp},
+  {0xFF04, 1, &OpDispatchBuilder::JMPOp},
+  {0xFF06, 1, &OpDispatchBuilder::PUSHOp},
+};
+
+// Nothing in the three byte or VEX maps has a handler yet, Unicorn steps them
+constexpr std::array<DispatchEntry, 0> NoDispatchers{};
+
+// Every TYPE_MODRM_TABLE_PREFIX opcode gets a group of eight entries in ModRMOps, in the order BaseOpTable lists them
+template<size_t N>
+constexpr std::array<uint8_t, 256> GenerateModRMGroups(InfoEntry const (&Infos)[N]) {
+  std::array<uint8_t, 256> Groups{};
+  for (auto &Group : Groups)
+    Group = NO_MODRM_GROUP;
+
+  uint8_t NumGroups = 0;
+  for (auto &Info : Infos) {
+    if (Info.Info.Type != TYPE_MODRM_TABLE_PREFIX)
+      continue;
+    for (uint8_t i = 0; i < Info.Count; ++i)
+      Groups[Info.Op + i] = NumGroups++;
   }
-  for (uint32_t i = 0; i < ModRMOps.size(); ++i) {
-    ModRMOps[i] = UnknownOp;
+  return Groups;
+}
+
+constexpr std::array<uint8_t, 256> ModRMGroups = GenerateModRMGroups(BaseOpTable);
+
+constexpr size_t CountModRMGroups() {
+  size_t NumGroups = 0;
+  for (auto Group : ModRMGroups)
+    NumGroups += Group != NO_MODRM_GROUP;
+  return NumGroups;
+}
+
+constexpr size_t BaseIndex(uint16_t Op) { return Op; }
+constexpr size_t ModRMIndex(uint16_t Op) { return ModRMGroups[Op >> 8] * 8 + (Op & 0b111); }
+constexpr size_t VEXIndex(uint16_t Op) { return Op - 0x100; }
+
+// Maps 1 through 3
+constexpr size_t VEX_TABLE_SIZE = 3 * 256;
+
+/**
+ * @brief Checks that a table can be generated from the entries
+ *
+ * No two entries may claim the same opcode, ModRM entries need a group to land in
+ * and dispatchers can only go on instructions that the table knows about
+ */
+template<size_t Size, bool ModRMTable = false, typename InfoList, typename DispatchList, typename IndexFn>
+constexpr bool ValidateTable(InfoList const &Infos, DispatchList const &Dispatchers, IndexFn Index) {
+  std::array<bool, Size> HasInfo{};
+  for (auto &Info : Infos) {
+    for (uint8_t i = 0; i < Info.Count; ++i) {
+      uint16_t Op = Info.Op + i;
+      if (ModRMTable && ((Op & 0xFF) > 0b111 || ModRMGroups[Op >> 8] == NO_MODRM_GROUP))
+        return false;
+      if (Index(Op) >= Size || HasInfo[Index(Op)])
+        return false;
+      HasInfo[Index(Op)] = true;
+    }
   }
 
-  const std::vector<std::tuple<uint8_t, uint8_t, X86InstInfo>> BaseOpTable = {
-    // Prefixes
-    {0x66, 1, X86InstInfo{"",      TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x67, 1, X86InstInfo{"",      TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x2E, 1, X86InstInfo{"CS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x3E, 1, X86InstInfo{"DS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x26, 1, X86InstInfo{"ES",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x64, 1, X86InstInfo{"FS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x65, 1, X86InstInfo{"GS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0x36, 1, X86InstInfo{"SS",    TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0xF0, 1, X86InstInfo{"LOCK",  TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0xF2, 1, X86InstInfo{"REP",   TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-    {0xF3, 1, X86InstInfo{"REPNZ", TYPE_LEGACY_PREFIX, FLAGS_NONE, 0, 0}},
-
-    // REX
-    {0x40, 16, X86InstInfo{"", TYPE_REX_PREFIX, FLAGS_NONE, 0, 0}},
-
-    // Instructions
-    {0x01, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_DST_MODRM | FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 0, 0}},
-    {0x03, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_SRC_MODRM | FLAGS_HAS_MODRM,                             0, 0}},
-    {0x05, 1, X86InstInfo{"ADD",    TYPE_INST, FLAGS_SRC_IMM | FLAGS_DISPLACE_SIZE_DIV_2,                     4, 0}},
-    {0x08, 4, X86InstInfo{"OR",     TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x20, 4, X86InstInfo{"AND",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x25, 1, X86InstInfo{"AND",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x29, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 0, 0}},
-    {0x2B, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x2C, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x2D, 1, X86InstInfo{"SUB",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x30, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x31, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x32, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x33, 1, X86InstInfo{"XOR",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x38, 4, X86InstInfo{"CMP",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x3C, 1, X86InstInfo{"CMP",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x3D, 1, X86InstInfo{"CMP",    TYPE_INST, FLAGS_REX_IN_BYTE | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x50, 8, X86InstInfo{"PUSH",   TYPE_INST, FLAGS_REX_IN_BYTE,         0, 0}},
-    {0x58, 8, X86InstInfo{"POP",    TYPE_INST, FLAGS_REX_IN_BYTE,         0, 0}},
-    {0x63, 1, X86InstInfo{"MOVSXD", TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x69, 1, X86InstInfo{"IMUL",   TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,   4, 0}},
-    {0x70, 1, X86InstInfo{"JO",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x71, 1, X86InstInfo{"JNO",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x72, 1, X86InstInfo{"JB",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x73, 1, X86InstInfo{"JNB",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x74, 1, X86InstInfo{"JZ",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x75, 1, X86InstInfo{"JNZ",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x76, 1, X86InstInfo{"JBE",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x77, 1, X86InstInfo{"JNBE",   TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x78, 1, X86InstInfo{"JS",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x79, 1, X86InstInfo{"JNS",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7A, 1, X86InstInfo{"JP",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7B, 1, X86InstInfo{"JNP",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7C, 1, X86InstInfo{"JL",     TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7D, 1, X86InstInfo{"JNL",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7E, 1, X86InstInfo{"JLE",    TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x7F, 1, X86InstInfo{"JNLE",   TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0x82, 1, X86InstInfo{"[INV]",  TYPE_INVALID, FLAGS_NONE,                0, 0}},
-    {0x84, 2, X86InstInfo{"TEST",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x88, 5, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x8E, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x8D, 1, X86InstInfo{"LEA",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x90, 1, X86InstInfo{"NOP",    TYPE_INST, FLAGS_NONE,                0, 0}},
-    {0x98, 1, X86InstInfo{"CDQE",   TYPE_INST, FLAGS_NONE,                0, 0}},
-    {0x99, 1, X86InstInfo{"CQO",    TYPE_INST, FLAGS_NONE,                0, 0}},
-    {0xA0, 4, X86InstInfo{"MOV",    TYPE_INST, FLAGS_NONE,                0, 0}},
-    {0xA8, 1, X86InstInfo{"TEST",   TYPE_INST, FLAGS_NONE,                1, 0}},
-    {0xA9, 1, X86InstInfo{"TEST",   TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0xAA, 2, X86InstInfo{"STOS",   TYPE_INST, FLAGS_NONE,                0, 0}},
-
-    {0xB0, 8, X86InstInfo{"MOV",    TYPE_INST, FLAGS_REX_IN_BYTE,         1, 0}},
-    {0xB8, 8, X86InstInfo{"MOV",    TYPE_INST, FLAGS_REX_IN_BYTE | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_DISPLACE_SIZE_MUL_2, 4, 0}},
-    {0xC2, 2, X86InstInfo{"RET",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_BLOCK_END,                0, 0}},
-    {0xC4, 2, X86InstInfo{"[INV]",  TYPE_INVALID, FLAGS_NONE,                0, 0}},
-    {0xC6, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           1, 0}},
-    {0xC7, 1, X86InstInfo{"MOV",    TYPE_INST, FLAGS_HAS_MODRM,           4, 0}},
-    {0xD4, 3, X86InstInfo{"[INV]",  TYPE_INVALID, FLAGS_NONE,                0, 0}},
-
-    {0xE8, 1, X86InstInfo{"CALL",   TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_BLOCK_END, 4, 0}},
-    {0xE9, 1, X86InstInfo{"JMP",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_DISPLACE_SIZE_DIV_2 | FLAGS_BLOCK_END, 4, 0}},
-    {0xEB, 1, X86InstInfo{"JMP",    TYPE_INST, FLAGS_SETS_RIP | FLAGS_BLOCK_END,                             1, 0}},
-
-    // ModRM table
-    {0x80, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0x81, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0x83, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xC0, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xC1, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xD0, 4, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xD8, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xF6, 2, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-    {0xFF, 1, X86InstInfo{"",   TYPE_MODRM_TABLE_PREFIX, FLAGS_HAS_MODRM, 3, 0}},
-  };
-
-  const std::vector<std::tuple<uint8_t, uint8_t, X86InstInfo>> TwoByteOpTable = {
-    // Instructions
-    {0x05, 1, X86InstInfo{"SYSCALL",    TYPE_INST, FLAGS_BLOCK_END, 0, 0}},
-    {0x1f, 1, X86InstInfo{"NOP",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x31, 1, X86InstInfo{"RDTSC",      TYPE_INST, FLAGS_NONE,      0, 0}},
-    {0x40, 1, X86InstInfo{"CMOVO",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x41, 1, X86InstInfo{"CMOVNO",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x42, 1, X86InstInfo{"CMOVB",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x43, 1, X86InstInfo{"CMOVNB",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x44, 1, X86InstInfo{"CMOVZ",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x45, 1, X86InstInfo{"CMOVNZ",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x46, 1, X86InstInfo{"CMOVBE",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x47, 1, X86InstInfo{"CMOVNBE",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x48, 1, X86InstInfo{"CMOVS",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x49, 1, X86InstInfo{"CMOVNS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4A, 1, X86InstInfo{"CMOVP",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4B, 1, X86InstInfo{"CMOVNP",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4C, 1, X86InstInfo{"CMOVL",      TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4D, 1, X86InstInfo{"CMOVNL",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4E, 1, X86InstInfo{"CMOVLE",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x4F, 1, X86InstInfo{"CMOVNLE",    TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-
-    {0x6E, 1, X86InstInfo{"MOVD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x6F, 1, X86InstInfo{"MOVDQU",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    {0x7E, 1, X86InstInfo{"MOVD",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x7F, 1, X86InstInfo{"MOVDQU",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x80, 1, X86InstInfo{"JO",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x81, 1, X86InstInfo{"JNO",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x82, 1, X86InstInfo{"JB",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x83, 1, X86InstInfo{"JNB",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x84, 1, X86InstInfo{"JZ",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x85, 1, X86InstInfo{"JNZ",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x86, 1, X86InstInfo{"JBE",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x87, 1, X86InstInfo{"JNBE",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x88, 1, X86InstInfo{"JS",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x89, 1, X86InstInfo{"JNS",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8A, 1, X86InstInfo{"JP",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8B, 1, X86InstInfo{"JNP",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8C, 1, X86InstInfo{"JL",      TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8D, 1, X86InstInfo{"JNL",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8E, 1, X86InstInfo{"JLE",     TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x8F, 1, X86InstInfo{"JNLE",    TYPE_INST, FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0x90, 1, X86InstInfo{"SETO",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x91, 1, X86InstInfo{"SETNO",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x92, 1, X86InstInfo{"SETB",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x93, 1, X86InstInfo{"SETNB",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x94, 1, X86InstInfo{"SETZ",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x95, 1, X86InstInfo{"SETNZ",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x96, 1, X86InstInfo{"SETBE",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x97, 1, X86InstInfo{"SETNBE",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x98, 1, X86InstInfo{"SETS",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x99, 1, X86InstInfo{"SETNS",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9A, 1, X86InstInfo{"SETP",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9B, 1, X86InstInfo{"SETNP",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9C, 1, X86InstInfo{"SETL",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9D, 1, X86InstInfo{"SETNL",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9E, 1, X86InstInfo{"SETLE",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0x9F, 1, X86InstInfo{"SETNLE",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xA2, 1, X86InstInfo{"CPUID",   TYPE_INST, FLAGS_NONE,                0, 0}},
-    {0xA3, 1, X86InstInfo{"BT",      TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xAF, 1, X86InstInfo{"IMUL",    TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xB0, 2, X86InstInfo{"CMPXCHG", TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xBA, 1, X86InstInfo{"BT",      TYPE_INST, FLAGS_HAS_MODRM,           1, 0}},
-    {0xB6, 2, X86InstInfo{"MOVZX",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xBC, 2, X86InstInfo{"BSF",     TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xBE, 2, X86InstInfo{"MOVSX",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    // SSE
-    {0x10, 2, X86InstInfo{"MOVUPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x16, 2, X86InstInfo{"MOVHPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0x29, 1, X86InstInfo{"MOVAPS",     TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xEB, 1, X86InstInfo{"POR",        TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-
-    // SSE2
-    {0x60, 1, X86InstInfo{"PUNPCKLBW",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x61, 1, X86InstInfo{"PUNPCKLWD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x62, 1, X86InstInfo{"PUNPCKLDQ",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x66, 1, X86InstInfo{"PCMPGTD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x6A, 1, X86InstInfo{"PUNPCKHDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x6C, 1, X86InstInfo{"PUNPCKLQDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x6D, 1, X86InstInfo{"PUNPCKHQDQ", TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x70, 1, X86InstInfo{"PSHUFD",     TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
-    {0x73, 1, X86InstInfo{"PSLLQ",      TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
-    {0x74, 1, X86InstInfo{"PCMPEQB",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0x72, 1, X86InstInfo{"PSLLD",      TYPE_INST, FLAGS_HAS_MODRM,          1, 0}},
-    {0x76, 1, X86InstInfo{"PCMPEQD",    TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0xD4, 1, X86InstInfo{"PADDQ",      TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0xD6, 1, X86InstInfo{"MOVQ",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0xD7, 1, X86InstInfo{"PMOVMSKB",   TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0xEF, 1, X86InstInfo{"PXOR",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-    {0xFE, 1, X86InstInfo{"PADDD",       TYPE_INST, FLAGS_HAS_MODRM,          0, 0}},
-  };
-
-  const std::vector<std::tuple<uint16_t, uint8_t, X86InstInfo>> ModRMOpTable = {
-    {0x8000, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8001, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8002, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8003, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8004, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8005, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8006, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8007, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-
-    {0x8100, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8101, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8102, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8103, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8104, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8105, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8106, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-    {0x8107, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2,           4, 0}},
-
-    {0x8300, 1, X86InstInfo{"ADD",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8301, 1, X86InstInfo{"OR",   TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8302, 1, X86InstInfo{"ADC",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8303, 1, X86InstInfo{"SBB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8304, 1, X86InstInfo{"AND",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8305, 1, X86InstInfo{"SUB",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8306, 1, X86InstInfo{"XOR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0x8307, 1, X86InstInfo{"CMP",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-
-    {0xC000, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC001, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC002, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC003, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC004, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC005, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC006, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC007, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-
-    {0xC100, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC101, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC102, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC103, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC104, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC105, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC106, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-    {0xC107, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_DST_MODRM | FLAGS_SRC_IMM | FLAGS_HAS_MODRM,           1, 0}},
-
-    {0xD000, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD001, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD002, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD003, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD004, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD005, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD006, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD007, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    {0xD100, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD101, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD102, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD103, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD104, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD105, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD106, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD107, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    {0xD200, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD201, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD202, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD203, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD204, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD205, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD206, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD207, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    {0xD300, 1, X86InstInfo{"ROL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD301, 1, X86InstInfo{"ROR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD302, 1, X86InstInfo{"RCL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD303, 1, X86InstInfo{"RCR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD304, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD305, 1, X86InstInfo{"SHR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD306, 1, X86InstInfo{"SHL",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xD307, 1, X86InstInfo{"SAR",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-
-    {0xF600, 2, X86InstInfo{"TEST", TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
-    {0xF604, 1, X86InstInfo{"MUL",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF606, 1, X86InstInfo{"DIV",  TYPE_INST, FLAGS_HAS_MODRM, 1, 0}},
-    {0xF700, 2, X86InstInfo{"TEST", TYPE_INST, FLAGS_HAS_MODRM | FLAGS_DISPLACE_SIZE_DIV_2, 4, 0}},
-    {0xF702, 1, X86InstInfo{"NOT",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF703, 1, X86InstInfo{"NEG",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF704, 1, X86InstInfo{"MUL",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF705, 1, X86InstInfo{"IMUL", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF706, 1, X86InstInfo{"DIV",  TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-    {0xF707, 1, X86InstInfo{"IDIV", TYPE_INST, FLAGS_HAS_MODRM, 0, 0}},
-
-    {0xFF00, 1, X86InstInfo{"INC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xFF01, 1, X86InstInfo{"DEC",   TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-    {0xFF02, 1, X86InstInfo{"CALL",  TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
-    {0xFF03, 1, X86InstInfo{"CALLF", TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
-    {0xFF04, 1, X86InstInfo{"JMP",   TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
-    {0xFF05, 1, X86InstInfo{"JMPF",  TYPE_INST, FLAGS_SETS_RIP | FLAGS_HAS_MODRM | FLAGS_BLOCK_END,           0, 0}},
-    {0xFF06, 1, X86InstInfo{"PUSH",  TYPE_INST, FLAGS_HAS_MODRM,           0, 0}},
-  };
-
-  auto GenerateTable = [](auto& FinalTable, auto& LocalTable) {
-    for (auto Op : LocalTable) {
-      auto OpNum = std::get<0>(Op);
-      auto Info = std::get<2>(Op);
-      for (uint8_t i = 0; i < std::get<1>(Op); ++i) {
-        LogMan::Throw::A(FinalTable[OpNum + i].Type == TYPE_UNKNOWN, "Duplicate Entry");
-        FinalTable[OpNum + i] = Info;
-      }
+  std::array<bool, Size> HasDispatcher{};
+  for (auto &Dispatch : Dispatchers) {
+    for (uint8_t i = 0; i < Dispatch.Count; ++i) {
+      uint16_t Op = Dispatch.Op + i;
+      if (ModRMTable && ModRMGroups[Op >> 8] == NO_MODRM_GROUP)
+        return false;
+      if (Index(Op) >= Size || !HasInfo[Index(Op)] || HasDispatcher[Index(Op)])
+        return false;
+      HasDispatcher[Index(Op)] = true;
     }
-  };
+  }
+  return true;
+}
 
-  GenerateTable(BaseOps, BaseOpTable);
-  GenerateTable(SecondBaseOps, TwoByteOpTable);
-  GenerateTable(ModRMOps, ModRMOpTable);
+template<size_t Size, typename InfoList, typename DispatchList, typename IndexFn>
+constexpr std::array<X86InstInfo, Size> GenerateTable(InfoList const &Infos, DispatchList const &Dispatchers, IndexFn Index) {
+  std::array<X86InstInfo, Size> Table{};
+  for (auto &Entry : Table)
+    Entry = UnknownOp;
+
+  for (auto &Info : Infos) {
+    for (uint8_t i = 0; i < Info.Count; ++i)
+      Table[Index(Info.Op + i)] = Info.Info;
+  }
+
+  for (auto &Dispatch : Dispatchers) {
+    for (uint8_t i = 0; i < Dispatch.Count; ++i)
+      Table[Index(Dispatch.Op + i)].OpcodeDispatcher = Dispatch.Dispatcher;
+  }
+  return Table;
 }
 
-DecodedOp GetInstInfo(uint8_t const *Inst) {
-  X86InstInfo *Info{nullptr};
-  X86InstDecodeFlags Flags{};
-  uint8_t InstructionSize = 0;
-  std::array<uint8_t, 15> Instruction;
-
-  bool DoAgain = false;
-  uint8_t REXOptions = 0;
-  bool HasWideningDisplacement = false;
-  bool HasNarrowingDisplacement = false;
-OnceMore:
-
-  uint8_t AdditionalBytes = 0;
-  Instruction[InstructionSize] = Inst[InstructionSize]; InstructionSize++;
-  uint8_t Op = Inst[InstructionSize - 1];
-
-  auto NormalOp = [&](auto &Table, auto Op) {
-    Info = &Table[Op];
-
-    // We hit a prefix, go again
-    if (Info->Type == TYPE_PREFIX || Info->Type == TYPE_LEGACY_PREFIX) {
-      DoAgain = true;
-      return;
-    }
+constexpr size_t MODRM_TABLE_SIZE = CountModRMGroups() * 8;
+
+static_assert(ValidateTable<256>(BaseOpTable, BaseOpDispatchers, BaseIndex), "Duplicate or missing entry in the base op table");
+static_assert(ValidateTable<256>(TwoByteOpTable, TwoByteOpDispatchers, BaseIndex), "Duplicate or missing entry in the two byte op table");
+static_assert(ValidateTable<MODRM_TABLE_SIZE, true>(ModRMOpTable, ModRMOpDispatchers, ModRMIndex), "Duplicate or missing entry in the ModRM op table");
+static_assert(ValidateTable<256>(ThreeByte38OpTable, NoDispatchers, BaseIndex), "Duplicate or missing entry in the 0F 38 op table");
+static_assert(ValidateTable<256>(ThreeByte3AOpTable, NoDispatchers, BaseIndex), "Duplicate or missing entry in the 0F 3A op table");
+static_assert(ValidateTable<VEX_TABLE_SIZE>(VEXOpTable, NoDispatchers, VEXIndex), "Duplicate or missing entry in the VEX op table");
 
-    bool HasMODRM = (Info->Flags & FLAGS_HAS_MODRM) || (REXOptions & 1);
-
-    if (Info->Flags & FLAGS_REX_IN_BYTE)
-      HasMODRM = false;
-
-    bool HasSIB = REXOptions & 2;
-    uint8_t Disp = 0;
-
-    if (HasMODRM) {
-      union {
-        uint8_t Hex;
-        struct {
-          uint8_t rm : 3;
-          uint8_t reg : 3;
-          uint8_t mod : 2;
-        };
-      } ModRM;
-      ModRM.Hex = Inst[InstructionSize];
-
-      // if ModRM.Mod != 0b11
-      // AND
-      // ModRM.rm == 0b100
-      HasSIB = HasSIB ||
-               ((ModRM.mod != 0b11) &&
-                (ModRM.rm == 0b100));
-
-      // Do we have an offset?
-      if (ModRM.mod == 0b01)
-        Disp = 1;
-      else if (ModRM.mod == 0b10)
-        Disp = 4;
-      else if (ModRM.mod == 0 && ModRM.rm == 0b101)
-        Disp = 4;
-
-      ;//printf("ModRM: 0x%02x HasSIB? %s Disp: %d %d %d %d\n", ModRM.Hex, HasSIB ? "Yes" : "No", Disp, ModRM.mod, ModRM.reg, ModRM.rm);
-      if (HasSIB) {
-        union {
-          uint8_t Hex;
-          struct {
-            uint8_t base : 3;
-            uint8_t index : 3;
-            uint8_t scale : 2;
-          };
-        } SIB;
-        SIB.Hex = Inst[InstructionSize+1];
-        ;//printf("\tSIB: 0x%02x %d %d %d\n", SIB.Hex, SIB.base, SIB.index, SIB.scale);
-
-        // If the SIB base is 0b101, aka BP or R13 then we have a 32bit displacement
-        if (SIB.base == 0b101 && Disp == 0) {
-          ;//printf("\tDisp now 4\n");
-          Disp = 4;
-        }
-      }
+// Built by the compiler, nothing runs at startup
+constexpr std::array<X86InstInfo, 256> BaseOps = GenerateTable<256>(BaseOpTable, BaseOpDispatchers, BaseIndex);
+constexpr std::array<X86InstInfo, 256> SecondBaseOps = GenerateTable<256>(TwoByteOpTable, TwoByteOpDispatchers, BaseIndex);
+constexpr std::array<X86InstInfo, MODRM_TABLE_SIZE> ModRMOps = GenerateTable<MODRM_TABLE_SIZE>(ModRMOpTable, ModRMOpDispatchers, ModRMIndex);
+constexpr std::array<X86InstInfo, 256> ThreeByte38Ops = GenerateTable<256>(ThreeByte38OpTable, NoDispatchers, BaseIndex);
+constexpr std::array<X86InstInfo, 256> ThreeByte3AOps = GenerateTable<256>(ThreeByte3AOpTable, NoDispatchers, BaseIndex);
+constexpr std::array<X86InstInfo, VEX_TABLE_SIZE> VEXOps = GenerateTable<VEX_TABLE_SIZE>(VEXOpTable, NoDispatchers, VEXIndex);
+}
+
+template<typename T>
+static uint64_t ReadImm(uint8_t const *Inst) {
+  T Value;
+  memcpy(&Value, Inst, sizeof(T));
+  return static_cast<int64_t>(Value);
+}
+
+static void DecodeModRM(uint8_t const *Inst, uint8_t &Offset, DecodedInst *Decoded) {
+  uint8_t ModRM = Inst[Offset++];
+  uint8_t Mod = ModRM >> 6;
+  uint8_t RM = ModRM & 0b111;
+  uint8_t REX = Decoded->REX;
+
+  Decoded->ModRM = ModRM;
+  Decoded->Flags |= DECODE_FLAG_MODRM;
+  Decoded->Reg.Type = OPERAND_GPR;
+  Decoded->Reg.Reg = ((REX & 0b0100) << 1) | ((ModRM >> 3) & 0b111);
+
+  auto &Operand = Decoded->RM;
+  if (Mod == 0b11) {
+    Operand.Type = OPERAND_GPR;
+    Operand.Reg = ((REX & 0b0001) << 3) | RM;
+    return;
+  }
+
+  Operand.Type = OPERAND_MEMORY;
+  Operand.Reg = ((REX & 0b0001) << 3) | RM;
+  Operand.Index = INVALID_REG;
+  Operand.Scale = 1;
+
+  bool Disp32 = Mod == 0b10;
+  if (RM == 0b100) {
+    uint8_t SIB = Inst[Offset++];
+    uint8_t Index = ((REX & 0b0010) << 2) | ((SIB >> 3) & 0b111);
+    Decoded->SIB = SIB;
+    Decoded->Flags |= DECODE_FLAG_SIB;
+
+    // RSP can't be an index, R12 can
+    Operand.Index = Index == 0b100 ? INVALID_REG : Index;
+    Operand.Scale = 1 << (SIB >> 6);
+    Operand.Reg = ((REX & 0b0001) << 3) | (SIB & 0b111);
+    if (Mod == 0b00 && (SIB & 0b111) == 0b101) {
+      Operand.Reg = INVALID_REG;
+      Disp32 = true;
     }
+  }
+  else if (Mod == 0b00 && RM == 0b101) {
+    Operand.Type = OPERAND_RIP_RELATIVE;
+    Operand.Reg = INVALID_REG;
+    Disp32 = true;
+  }
 
-    if (HasMODRM) { // MODRM
-      AdditionalBytes++;
-      Flags.Flags |= DECODE_FLAG_MODRM;
+  if (Mod == 0b01) {
+    Operand.Displacement = static_cast<int8_t>(Inst[Offset]);
+    Offset += 1;
+  }
+  else if (Disp32) {
+    Operand.Displacement = static_cast<int32_t>(ReadImm<int32_t>(&Inst[Offset]));
+    Offset += 4;
+  }
+}
+
+bool DecodeInstruction(uint8_t const *Inst, DecodedInst *Decoded) {
+  uint8_t Offset = 0;
+  Decoded->Flags = 0;
+  Decoded->REX = 0;
+
+  // Legacy prefixes come in any order, a REX only counts if the opcode comes straight after it
+  for (;; ++Offset) {
+    if (Offset == MAX_INST_SIZE)
+      return false;
+
+    uint8_t Prefix = Inst[Offset];
+    InstType Type = BaseOps[Prefix].Type;
+    if (Type == TYPE_REX_PREFIX) {
+      Decoded->REX = Prefix;
+      Decoded->Flags |= DECODE_FLAG_REX;
+      continue;
     }
+    if (Type != TYPE_LEGACY_PREFIX)
+      break;
 
-    if (HasSIB) {
-      AdditionalBytes++;
-      Flags.Flags |= DECODE_FLAG_SIB;
+    Decoded->REX = 0;
+    Decoded->Flags &= ~DECODE_FLAG_REX;
+    switch (Prefix) {
+    case 0x66: Decoded->Flags |= DECODE_FLAG_OPSIZE; break;
+    case 0x67: Decoded->Flags |= DECODE_FLAG_ADSIZE; break;
+    case 0xF0: Decoded->Flags |= DECODE_FLAG_LOCK; break;
+    case 0xF2: Decoded->Flags |= DECODE_FLAG_REPNE; break;
+    case 0xF3: Decoded->Flags |= DECODE_FLAG_REP; break;
+    case 0x64: Decoded->Flags |= DECODE_FLAG_FS; break;
+    case 0x65: Decoded->Flags |= DECODE_FLAG_GS; break;
+    // CS, DS, ES and SS do nothing in long mode
+    default: break;
     }
+  }
+
+  Decoded->PrefixBytes = Offset;
+  Decoded->OpSize = (Decoded->REX & 0b1000) ? 8 : (Decoded->Flags & DECODE_FLAG_OPSIZE) ? 2 : 4;
+  Decoded->AddrSize = (Decoded->Flags & DECODE_FLAG_ADSIZE) ? 4 : 8;
+  Decoded->Reg = {OPERAND_NONE, INVALID_REG, INVALID_REG, 0, 0};
+  Decoded->RM = {OPERAND_NONE, INVALID_REG, INVALID_REG, 0, 0};
+  Decoded->ModRM = 0;
+  Decoded->SIB = 0;
 
-    AdditionalBytes += Disp;
+  Decoded->VEXvvvv = INVALID_REG;
+  Decoded->VEXL = 0;
+  Decoded->OpMask = 0;
 
-    uint8_t Bytes = Info->MoreBytes;
-    if ((Info->Flags & FLAGS_DISPLACE_SIZE_MUL_2) && HasWideningDisplacement) {
-      ;//printf("Cool, nondefault displacement\n");
-      Bytes *= 2;
+  X86InstInfo const *Info;
+  bool HasModRM = false;
+  uint8_t EVEX[3]{};
+  uint8_t Op = Inst[Offset++];
+  InstType Type = BaseOps[Op].Type;
+  if (Type == TYPE_VEX_PREFIX || Type == TYPE_EVEX_PREFIX) {
+    // The prefix carries REX and the mandatory prefix itself, having them as well is a #UD
+    if (Decoded->Flags & (DECODE_FLAG_REX | DECODE_FLAG_OPSIZE | DECODE_FLAG_LOCK | DECODE_FLAG_REP | DECODE_FLAG_REPNE))
+      return false;
+
+    // R, X, B and vvvv are stored inverted
+    uint8_t Map, RXB, W, vvvv, pp;
+    if (Op == 0xC5) {
+      uint8_t Byte1 = Inst[Offset++];
+      Map = 1;
+      RXB = (~Byte1 >> 5) & 0b100;
+      W = 0;
+      vvvv = (~Byte1 >> 3) & 0b1111;
+      Decoded->VEXL = (Byte1 >> 2) & 1;
+      pp = Byte1 & 0b11;
+    }
+    else if (Op == 0xC4) {
+      uint8_t Byte1 = Inst[Offset++];
+      uint8_t Byte2 = Inst[Offset++];
+      Map = Byte1 & 0b11111;
+      RXB = (~Byte1 >> 5) & 0b111;
+      W = Byte2 >> 7;
+      vvvv = (~Byte2 >> 3) & 0b1111;
+      Decoded->VEXL = (Byte2 >> 2) & 1;
+      pp = Byte2 & 0b11;
     }
-    if ((Info->Flags & FLAGS_DISPLACE_SIZE_DIV_2) && HasNarrowingDisplacement) {
-      ;//printf("Cool, nondefault displacement\n");
-      Bytes /= 2;
+    else {
+      memcpy(EVEX, &Inst[Offset], 3);
+      Offset += 3;
+      // P1 bit 2 is always set, it is what tells EVEX apart from BOUND in 32bit mode
+      if ((EVEX[1] & 0b100) == 0)
+        return false;
+      Map = EVEX[0] & 0b111;
+      RXB = (~EVEX[0] >> 5) & 0b111;
+      W = EVEX[1] >> 7;
+      vvvv = ((~EVEX[2] & 0b1000) << 1) | ((~EVEX[1] >> 3) & 0b1111);
+      pp = EVEX[1] & 0b11;
+      // With EVEX.b on a register source L'L is the rounding mode, it's left to the handler
+      Decoded->VEXL = (EVEX[2] >> 5) & 0b11;
+      Decoded->OpMask = EVEX[2] & 0b111;
+      Decoded->Flags |= DECODE_FLAG_EVEX;
+      if (EVEX[2] & 0x80)
+        Decoded->Flags |= DECODE_FLAG_EVEX_Z;
+      if (EVEX[2] & 0x10)
+        Decoded->Flags |= DECODE_FLAG_EVEX_B;
     }
 
-    AdditionalBytes += Bytes;
-  };
-
-  auto ModRMOp = [&]() {
-    uint8_t Prefix = Inst[InstructionSize - 1];
-    uint8_t ModRM = Inst[InstructionSize];
-
-    // Get the Prefix Info
-    auto PrefixInfo = &BaseOps[Prefix];
-    uint8_t ValidModRMMask = (1 << PrefixInfo->MoreBytes) - 1;
-    uint16_t Op = (Prefix << 8) | (((ModRM & 0b111000) >> 3) & (ValidModRMMask));
-    ;//printf("ModRM Op: 0x%04x\n", Op);
-
-    // Find the instruction Info
-    NormalOp(ModRMOps, Op);
-  };
-
-
-  switch (Op) {
-  case 0x0F: { // Escape
-    Flags.PrefixBytes++;
-    Instruction[InstructionSize] = Inst[InstructionSize]; InstructionSize++;
-
-    switch (Inst[InstructionSize]) {
-    case 0x0F: // Escape
-      ;//printf("3DNow!\n");
-      Flags.PrefixBytes++;
-      // This turns in to ModRM
-      Instruction[InstructionSize] = Inst[InstructionSize]; InstructionSize++;
-    break;
-    case 0x38: // Escape
-      ;//printf("F38 Table!\n");
-      Flags.PrefixBytes++;
-    break;
-    case 0x3A: // Escape
-      ;//printf("F3A Table!\n");
-      Flags.PrefixBytes++;
-    break;
-    default: // Two Byte op table
-      ;//printf("TwoByte Op Table!\n");
-      NormalOp(SecondBaseOps, Inst[InstructionSize - 1]);
-    break;
+    if (Map < 1 || Map > 3)
+      return false;
+
+    Decoded->REX = 0x40 | (W << 3) | RXB;
+    Decoded->OpSize = W ? 8 : 4;
+    Decoded->VEXvvvv = vvvv;
+    Decoded->Flags |= DECODE_FLAG_VEX;
+    switch (pp) {
+    case 1: Decoded->Flags |= DECODE_FLAG_OPSIZE; break;
+    case 2: Decoded->Flags |= DECODE_FLAG_REP; break;
+    case 3: Decoded->Flags |= DECODE_FLAG_REPNE; break;
+    default: break;
     }
+
+    Op = Inst[Offset++];
+    Info = &VEXOps[VEXIndex((Map << 8) | Op)];
   }
-  break;
-
-  case 0x66: // Operand size prefix
-    ;//printf("Operand size prefix!\n");
-    // 66 83 78 36 38          cmp    WORD PTR [rax+0x36],0x38
-    HasNarrowingDisplacement = true;
-    Flags.PrefixBytes++;
-    Flags.Flags |= DECODE_FLAG_OPSIZE;
-    DoAgain = true;
-  break;
-  case 0x67: // Address size override prefix
-    ;//printf("Address size override prefix\n");
-    Flags.PrefixBytes++;
-    Flags.Flags |= DECODE_FLAG_ADSIZE;
-    DoAgain = true;
-  break;
-  case 0x40: // REX - 0x40-0x4F
-  case 0x41:
-  case 0x42:
-  case 0x43:
-  case 0x44:
-  case 0x45:
-  case 0x46:
-  case 0x47:
-  case 0x48:
-  case 0x49:
-  case 0x4A:
-  case 0x4B:
-  case 0x4C:
-  case 0x4D:
-  case 0x4E:
-  case 0x4F: {
-    ;//printf("REX Op\n");
-    uint8_t REXValue = Inst[InstructionSize - 1];
-    Info = &BaseOps[Inst[InstructionSize - 1]];
-
-    REXOptions |= 0b100;
-    // ModRM
-    if (REXValue & 0b0101)
-      REXOptions |= 0b001;
-
-    // SIB
-    if (REXValue & 0b0010)
-      REXOptions |= 0b010;
-
-    // XXX: Throw in to REXOptions
-    if (REXValue & 0b1000)
-      HasWideningDisplacement = true;
-
-    Flags.Flags |= DECODE_FLAG_REX;
-    ;//printf("REX 0x%01x\n", REXValue & 0xF);
-
-    DoAgain = true;
-  }
-  break;
-  case 0xF0: {
-    Flags.Flags |= DECODE_FLAG_LOCK;
-    DoAgain = true;
-  }
-  break;
-  default: // Default Base Op
-    ;//printf("Default op! 0x%02x\n", Op);
-    Info = &BaseOps[Inst[InstructionSize - 1]];
-    if (Info->Type == TYPE_MODRM_TABLE_PREFIX) {
-      ModRMOp();
+  else if (Op == 0x0F) {
+    Op = Inst[Offset++];
+    // 3DNow! isn't in the tables
+    if (Op == 0x0F)
+      return false;
+    if (Op == 0x38) {
+      Op = Inst[Offset++];
+      Info = &ThreeByte38Ops[Op];
+    }
+    else if (Op == 0x3A) {
+      Op = Inst[Offset++];
+      Info = &ThreeByte3AOps[Op];
     }
     else {
-      NormalOp(BaseOps, Inst[InstructionSize - 1]);
+      Info = &SecondBaseOps[Op];
+    }
+  }
+  else {
+    Info = &BaseOps[Op];
+    if (Info->Type == TYPE_MODRM_TABLE_PREFIX) {
+      uint8_t ValidModRMMask = (1 << Info->MoreBytes) - 1;
+      Info = &ModRMOps[ModRMIndex((Op << 8) | ((Inst[Offset] >> 3) & ValidModRMMask))];
+      HasModRM = true;
     }
-  break;
   }
 
-  // Read any additional bytes specified
-  for (uint32_t i = 0; i < AdditionalBytes; ++i) {
-    Instruction[InstructionSize] = Inst[InstructionSize]; InstructionSize++;
+  if (Info->Type == TYPE_UNKNOWN)
+    return false;
+
+  Decoded->TableInfo = Info;
+  Decoded->Op = Op;
+
+  if (Info->Flags & FLAGS_REX_IN_BYTE) {
+    Decoded->Reg.Type = OPERAND_GPR;
+    Decoded->Reg.Reg = ((Decoded->REX & 0b0001) << 3) | (Op & 0b111);
+  }
+  else if (HasModRM || (Info->Flags & FLAGS_HAS_MODRM)) {
+    DecodeModRM(Inst, Offset, Decoded);
+
+    // EVEX has 32 vector registers, R' tops up ModRM.reg and X tops up a register ModRM.rm
+    // Compressed disp8*N depends on the instruction, the displacement is left unscaled for the handler
+    if (Decoded->Flags & DECODE_FLAG_EVEX) {
+      if ((EVEX[0] & 0x10) == 0)
+        Decoded->Reg.Reg |= 0x10;
+      if (Decoded->RM.Type == OPERAND_GPR && (EVEX[0] & 0x40) == 0)
+        Decoded->RM.Reg |= 0x10;
+    }
   }
 
-  if (DoAgain) {
-    DoAgain = false;
-    goto OnceMore;
+  uint8_t ImmSize = Info->MoreBytes;
+  if ((Info->Flags & FLAGS_DISPLACE_SIZE_MUL_2) && Decoded->OpSize == 8)
+    ImmSize *= 2;
+  else if ((Info->Flags & FLAGS_DISPLACE_SIZE_DIV_2) && Decoded->OpSize == 2)
+    ImmSize /= 2;
+
+  switch (ImmSize) {
+  case 1: Decoded->Imm = ReadImm<int8_t>(&Inst[Offset]); break;
+  case 2: Decoded->Imm = ReadImm<int16_t>(&Inst[Offset]); break;
+  // Only ENTER, the frame size and nesting level are both zero extended
+  case 3: Decoded->Imm = ReadImm<uint16_t>(&Inst[Offset]) | (uint64_t(Inst[Offset + 2]) << 16); break;
+  case 4: Decoded->Imm = ReadImm<int32_t>(&Inst[Offset]); break;
+  case 8: Decoded->Imm = ReadImm<uint64_t>(&Inst[Offset]); break;
+  default: Decoded->Imm = 0; break;
   }
+  Offset += ImmSize;
 
-//  printf("Instruction: ");
-//  if (Info) {
-//    printf("%s :", Info->Name);
-//  }
-//
-//  for (uint8_t i = 0; i < InstructionSize; ++i) {
-//    printf("%02x ", Instruction[i]);
-//  }
-//  printf("\n");
-  Flags.Size = InstructionSize;
-  return std::make_pair(Info ? Info->Type == TYPE_UNKNOWN ? nullptr : Info : nullptr, Flags);
+  Decoded->ImmSize = ImmSize;
+  Decoded->Size = Offset;
+  return Offset <= MAX_INST_SIZE;
 }
 }
 }
@@ -1,10 +1,11 @@
 #pragma once
 
 #include <array>
+#include <cstdint>
 
 namespace Emu {
 namespace IR {
-  struct OpDispatchBuilder;
+  class OpDispatchBuilder;
 }
 namespace X86Tables {
 
@@ -14,6 +15,8 @@ enum InstType {
   TYPE_PREFIX,
   TYPE_REX_PREFIX,
   TYPE_MODRM_TABLE_PREFIX,
+  TYPE_VEX_PREFIX,
+  TYPE_EVEX_PREFIX,
   TYPE_INST,
   TYPE_INVALID,
 };
@@ -27,7 +30,8 @@ enum InstFlags {
   FLAGS_DST_MODRM           = (1 << 5),
   FLAGS_SRC_IMM             = (1 << 6),
   FLAGS_BLOCK_END           = (1 << 7),
-  FLAGS_SETS_RIP            = (1 << 8),
+  FLAGS_SETS_RIP            = (1 << 8), ///< Can change RIP, only ends the block along with FLAGS_BLOCK_END
+  FLAGS_STRING_OP           = (1 << 9), ///< REP and REPNE repeat it
 };
 
 enum DecodeFlags {
@@ -38,17 +42,64 @@ enum DecodeFlags {
   DECODE_FLAG_MODRM  = (1 << 3),
   DECODE_FLAG_SIB    = (1 << 4),
   DECODE_FLAG_LOCK   = (1 << 5),
+  DECODE_FLAG_REP    = (1 << 6),
+  DECODE_FLAG_REPNE  = (1 << 7),
+  DECODE_FLAG_FS     = (1 << 8),
+  DECODE_FLAG_GS     = (1 << 9),
+  DECODE_FLAG_VEX    = (1 << 10), ///< Set for EVEX as well
+  DECODE_FLAG_EVEX   = (1 << 11),
+  DECODE_FLAG_EVEX_Z = (1 << 12), ///< Zero the masked off elements instead of merging
+  DECODE_FLAG_EVEX_B = (1 << 13), ///< Broadcast, or rounding control on register sources
+};
+
+// Longest encoding the hardware accepts
+constexpr uint8_t MAX_INST_SIZE = 15;
+// Register numbers are the x86 encoding with the REX bit on top, 0 = RAX/XMM0 through 15 = R15/XMM15
+// EVEX vector registers go up to 31
+constexpr uint8_t INVALID_REG = 0xFF;
 
+enum OperandType : uint8_t {
+  OPERAND_NONE,
+  OPERAND_GPR,           ///< Reg
+  OPERAND_MEMORY,        ///< [Base + Index * Scale + Displacement], Base and Index can be INVALID_REG
+  OPERAND_RIP_RELATIVE,  ///< [RIP of the next instruction + Displacement]
 };
-struct X86InstDecodeFlags {
-  uint8_t Size        : 4;
-  uint8_t PrefixBytes : 4;
-  uint8_t Flags; ///< Must be larger that DecodeFlags enum
+
+struct DecodedOperand {
+  OperandType Type;
+  uint8_t Reg;   ///< Register or the memory base
+  uint8_t Index;
+  uint8_t Scale;
+  int32_t Displacement;
 };
 
 struct X86InstInfo;
-using DecodedOp = std::pair<X86InstInfo*, X86InstDecodeFlags>;
-using OpDispatchPtr = void (IR::OpDispatchBuilder::*)(Emu::X86Tables::DecodedOp, uint8_t const *Code);
+
+/**
+ * @brief Everything the op handlers need to know about an instruction, filled in by one pass over its bytes
+ */
+struct DecodedInst {
+  X86InstInfo const *TableInfo;
+  uint64_t Imm;           ///< Sign extended from ImmSize bytes
+  DecodedOperand Reg;     ///< ModRM.reg or the register in the low bits of the opcode
+  DecodedOperand RM;      ///< ModRM.rm
+  uint16_t Flags;         ///< DecodeFlags
+  uint8_t Size;           ///< Bytes including prefixes and immediates
+  uint8_t PrefixBytes;
+  uint8_t OpSize;         ///< 2, 4 or 8. Byte forms are up to the handler
+  uint8_t AddrSize;       ///< 4 or 8
+  uint8_t REX;            ///< VEX and EVEX fill in the R, X, B and W bits here too
+  uint8_t Op;             ///< Opcode byte after any escape or VEX prefix
+  uint8_t ModRM;
+  uint8_t SIB;
+  uint8_t ImmSize;
+  uint8_t VEXvvvv;        ///< Extra source register, INVALID_REG without a VEX prefix
+  uint8_t VEXL;           ///< Vector length, 0 = 128bit, 1 = 256bit, 2 = 512bit
+  uint8_t OpMask;         ///< EVEX.aaa, k0 means no masking
+};
+
+using DecodedOp = DecodedInst const*;
+using OpDispatchPtr = void (IR::OpDispatchBuilder::*)(Emu::X86Tables::DecodedOp);
 
 struct X86InstInfo {
   char const *Name;
@@ -57,11 +108,12 @@ struct X86InstInfo {
   uint8_t MoreBytes;
   OpDispatchPtr OpcodeDispatcher;
 };
-extern std::array<X86InstInfo, 255> BaseOps;
-extern std::array<X86InstInfo, 255> SecondBaseOps;
-extern std::array<X86InstInfo, (1 << 16) - 1> ModRMOps;
 
-void InitializeInfoTables();
-DecodedOp GetInstInfo(uint8_t const *Inst);
+/**
+ * @brief Decodes the instruction at Inst
+ *
+ * @return false if the encoding isn't in the tables, Decoded is left partially filled
+ */
+bool DecodeInstruction(uint8_t const *Inst, DecodedInst *Decoded);
 }
 }
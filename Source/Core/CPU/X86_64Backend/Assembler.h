@@ -0,0 +1,271 @@
+#pragma once
+#include "LogManager.h"
+#include <cstdint>
+#include <initializer_list>
+#include <vector>
+
+namespace Emu::X86_64Asm {
+
+enum Reg : uint8_t {
+  RAX = 0, RCX, RDX, RBX, RSP, RBP, RSI, RDI,
+  R8, R9, R10, R11, R12, R13, R14, R15,
+  NO_REG = 0xFF,
+};
+
+enum Cond : uint8_t {
+  CC_O = 0, CC_NO, CC_B, CC_AE, CC_E, CC_NE, CC_BE, CC_A,
+  CC_S, CC_NS, CC_P, CC_NP, CC_L, CC_GE, CC_LE, CC_G,
+};
+
+// Opcode of the `op r/m64, r64` form
+enum ALUOp : uint8_t {
+  ALU_ADD = 0x01,
+  ALU_OR  = 0x09,
+  ALU_AND = 0x21,
+  ALU_SUB = 0x29,
+  ALU_XOR = 0x31,
+  ALU_CMP = 0x39,
+};
+
+// [Base + Index + Disp]
+struct Mem {
+  Reg Base;
+  Reg Index;
+  int32_t Disp;
+
+  Mem(Reg _Base, int32_t _Disp) : Base {_Base}, Index {NO_REG}, Disp {_Disp} {}
+  Mem(Reg _Base, Reg _Index, int32_t _Disp) : Base {_Base}, Index {_Index}, Disp {_Disp} {}
+};
+
+/**
+ * @brief Minimal x86-64 encoder for the instructions the JIT needs
+ *
+ * All code it emits is position independent, so a finished buffer can be copied anywhere
+ */
+class Assembler final {
+public:
+  using Label = uint32_t;
+
+  void Reset() {
+    Code.clear();
+    Labels.clear();
+  }
+
+  size_t GetSize() const { return Code.size(); }
+  uint8_t const *GetData() const { return Code.data(); }
+
+  Label NewLabel() {
+    Labels.emplace_back();
+    return Labels.size() - 1;
+  }
+
+  void Bind(Label L) {
+    auto &Data = Labels[L];
+    LogMan::Throw::A(Data.Position == -1, "Label bound twice");
+    Data.Position = Code.size();
+    for (auto Fixup : Data.Fixups) {
+      PatchRel32(Fixup, Data.Position);
+    }
+    Data.Fixups.clear();
+  }
+
+  // Moves
+  void Mov(Reg Dst, Reg Src) { EmitRR(true, {0x89}, Src, Dst); }
+  void Mov32(Reg Dst, Reg Src) { EmitRR(false, {0x89}, Src, Dst); }
+  void Movzx16(Reg Dst, Reg Src) { EmitRR(false, {0x0F, 0xB7}, Dst, Src); }
+  void Movzx8(Reg Dst, Reg Src) { EmitRR(false, {0x0F, 0xB6}, Dst, Src, true); }
+
+  void MovImm(Reg Dst, uint64_t Imm) {
+    if (Imm <= 0xFFFF'FFFFULL) {
+      // 32bit moves zero extend
+      EmitREX(false, 0, 0, Dst);
+      Emit8(0xB8 + (Dst & 7));
+      Emit32(Imm);
+    }
+    else if (static_cast<int64_t>(Imm) == static_cast<int32_t>(Imm)) {
+      EmitRR(true, {0xC7}, 0, Dst);
+      Emit32(Imm);
+    }
+    else {
+      EmitREX(true, 0, 0, Dst);
+      Emit8(0xB8 + (Dst & 7));
+      Emit64(Imm);
+    }
+  }
+
+  // Loads smaller than 8 bytes zero extend
+  void Load(uint8_t Size, Reg Dst, Mem Src) {
+    switch (Size) {
+    case 8: EmitRM(true, {0x8B}, Dst, Src); break;
+    case 4: EmitRM(false, {0x8B}, Dst, Src); break;
+    case 2: EmitRM(false, {0x0F, 0xB7}, Dst, Src); break;
+    case 1: EmitRM(false, {0x0F, 0xB6}, Dst, Src); break;
+    default: LogMan::Msg::A("Unhandled load size: %d", Size); break;
+    }
+  }
+
+  void LoadSigned(uint8_t Size, Reg Dst, Mem Src) {
+    switch (Size) {
+    case 8: EmitRM(true, {0x8B}, Dst, Src); break;
+    case 4: EmitRM(true, {0x63}, Dst, Src); break;
+    case 2: EmitRM(true, {0x0F, 0xBF}, Dst, Src); break;
+    case 1: EmitRM(true, {0x0F, 0xBE}, Dst, Src); break;
+    default: LogMan::Msg::A("Unhandled load size: %d", Size); break;
+    }
+  }
+
+  void Store(uint8_t Size, Mem Dst, Reg Src) {
+    switch (Size) {
+    case 8: EmitRM(true, {0x89}, Src, Dst); break;
+    case 4: EmitRM(false, {0x89}, Src, Dst); break;
+    case 2: Emit8(0x66); EmitRM(false, {0x89}, Src, Dst); break;
+    case 1: EmitRM(false, {0x88}, Src, Dst, true); break;
+    default: LogMan::Msg::A("Unhandled store size: %d", Size); break;
+    }
+  }
+
+  void Lea(Reg Dst, Mem Src) { EmitRM(true, {0x8D}, Dst, Src); }
+
+  // ALU
+  void ALU(ALUOp Op, Reg Dst, Reg Src) { EmitRR(true, {Op}, Src, Dst); }
+  void Test(Reg A, Reg B) { EmitRR(true, {0x85}, B, A); }
+  void Not(Reg R) { EmitRR(true, {0xF7}, 2, R); }
+  void ShlCL(Reg R) { EmitRR(true, {0xD3}, 4, R); }
+  void ShrCL(Reg R) { EmitRR(true, {0xD3}, 5, R); }
+  void SarCL(Reg R) { EmitRR(true, {0xD3}, 7, R); }
+  void ShrImm(Reg R, uint8_t Imm) { EmitRR(true, {0xC1}, 5, R); Emit8(Imm); }
+  void AndImm8(Reg R, int8_t Imm) { EmitRR(true, {0x83}, 4, R); Emit8(Imm); }
+  void AddImm(Reg R, int32_t Imm) { EmitRR(true, {0x81}, 0, R); Emit32(Imm); }
+  void SubImm(Reg R, int32_t Imm) { EmitRR(true, {0x81}, 5, R); Emit32(Imm); }
+  void AddImm(Mem M, int32_t Imm) { EmitRM(true, {0x81}, 0, M); Emit32(Imm); }
+  void CMov(Cond CC, Reg Dst, Reg Src) { EmitRR(true, {0x0F, static_cast<uint8_t>(0x40 + CC)}, Dst, Src); }
+  void Imul(Reg Dst, Reg Src) { EmitRR(true, {0x0F, 0xAF}, Dst, Src); }
+
+  // RDX:RAX is the implied other operand and destination
+  void Mul(Reg R) { EmitRR(true, {0xF7}, 4, R); }
+  void Imul(Reg R) { EmitRR(true, {0xF7}, 5, R); }
+  void Div(Reg R) { EmitRR(true, {0xF7}, 6, R); }
+  void Idiv(Reg R) { EmitRR(true, {0xF7}, 7, R); }
+  void Cqo() { Emit8(0x48); Emit8(0x99); }
+
+  // POPCNT and BMI2, only emit these when HostFeatures says they exist
+  void Popcnt(Reg Dst, Reg Src) { Emit8(0xF3); EmitRR(true, {0x0F, 0xB8}, Dst, Src); }
+  // The count can be any register and flags are left alone
+  void Shlx(Reg Dst, Reg Src, Reg Count) { EmitVEX0F38RR(true, 0b01, 0xF7, Dst, Count, Src); }
+  void Shrx(Reg Dst, Reg Src, Reg Count) { EmitVEX0F38RR(true, 0b11, 0xF7, Dst, Count, Src); }
+  void Sarx(Reg Dst, Reg Src, Reg Count) { EmitVEX0F38RR(true, 0b10, 0xF7, Dst, Count, Src); }
+
+  // Stack and control flow
+  void Push(Reg R) { EmitREX(false, 0, 0, R); Emit8(0x50 + (R & 7)); }
+  void Pop(Reg R) { EmitREX(false, 0, 0, R); Emit8(0x58 + (R & 7)); }
+  void Call(Reg R) { EmitRR(false, {0xFF}, 2, R); }
+  void Ret() { Emit8(0xC3); }
+
+  void Jmp(Label L) {
+    Emit8(0xE9);
+    EmitRel32(L);
+  }
+
+  void Jcc(Cond CC, Label L) {
+    Emit8(0x0F);
+    Emit8(0x80 + CC);
+    EmitRel32(L);
+  }
+
+private:
+  struct LabelData {
+    int64_t Position{-1};
+    std::vector<size_t> Fixups;
+  };
+
+  std::vector<uint8_t> Code;
+  std::vector<LabelData> Labels;
+
+  void Emit8(uint8_t Value) { Code.emplace_back(Value); }
+  void Emit32(uint32_t Value) {
+    for (int i = 0; i < 4; ++i)
+      Emit8(Value >> (i * 8));
+  }
+  void Emit64(uint64_t Value) {
+    Emit32(Value);
+    Emit32(Value >> 32);
+  }
+
+  void PatchRel32(size_t Fixup, size_t Target) {
+    // Relative to the end of the displacement
+    int32_t Rel = static_cast<int64_t>(Target) - static_cast<int64_t>(Fixup + 4);
+    for (int i = 0; i < 4; ++i)
+      Code[Fixup + i] = Rel >> (i * 8);
+  }
+
+  void EmitRel32(Label L) {
+    auto &Data = Labels[L];
+    size_t Fixup = Code.size();
+    Emit32(0);
+    if (Data.Position != -1)
+      PatchRel32(Fixup, Data.Position);
+    else
+      Data.Fixups.emplace_back(Fixup);
+  }
+
+  // Byte accesses to SPL/BPL/SIL/DIL need an empty REX, otherwise they mean AH/CH/DH/BH
+  void EmitREX(bool W, uint8_t R, uint8_t X, uint8_t B, bool Force = false) {
+    uint8_t REX = 0x40 | (W << 3) | ((R >> 3) << 2) | ((X >> 3) << 1) | (B >> 3);
+    if (REX != 0x40 || Force)
+      Emit8(REX);
+  }
+
+  void EmitOpcode(std::initializer_list<uint8_t> Opcode) {
+    for (auto Byte : Opcode)
+      Emit8(Byte);
+  }
+
+  void EmitRR(bool W, std::initializer_list<uint8_t> Opcode, uint8_t R, uint8_t RM, bool ByteRegs = false) {
+    EmitREX(W, R, 0, RM, ByteRegs && ((R >= 4 && R < 8) || (RM >= 4 && RM < 8)));
+    EmitOpcode(Opcode);
+    Emit8(0xC0 | ((R & 7) << 3) | (RM & 7));
+  }
+
+  // Three byte VEX in the 0F38 map with L = 0, pp selects the implied 66/F3/F2 prefix
+  void EmitVEX0F38RR(bool W, uint8_t pp, uint8_t Opcode, uint8_t R, uint8_t V, uint8_t RM) {
+    Emit8(0xC4);
+    Emit8((((~R >> 3) & 1) << 7) | (1 << 6) | (((~RM >> 3) & 1) << 5) | 0b00010);
+    Emit8((W << 7) | ((~V & 0xF) << 3) | pp);
+    Emit8(Opcode);
+    Emit8(0xC0 | ((R & 7) << 3) | (RM & 7));
+  }
+
+  void EmitRM(bool W, std::initializer_list<uint8_t> Opcode, uint8_t R, Mem M, bool ByteRegs = false) {
+    LogMan::Throw::A(M.Index != RSP, "RSP can't be an index register");
+    uint8_t Index = M.Index == NO_REG ? 0 : M.Index;
+    EmitREX(W, R, Index, M.Base, ByteRegs && R >= 4 && R < 8);
+    EmitOpcode(Opcode);
+
+    uint8_t Base = M.Base & 7;
+    uint8_t Mod;
+    // RBP and R13 as a base always need a displacement
+    if (M.Disp == 0 && Base != 5)
+      Mod = 0;
+    else if (M.Disp == static_cast<int8_t>(M.Disp))
+      Mod = 1;
+    else
+      Mod = 2;
+
+    // RSP and R12 as a base always need a SIB byte
+    if (M.Index != NO_REG || Base == 4) {
+      uint8_t SIBIndex = M.Index == NO_REG ? 4 : (M.Index & 7);
+      Emit8((Mod << 6) | ((R & 7) << 3) | 4);
+      Emit8((SIBIndex << 3) | Base);
+    }
+    else {
+      Emit8((Mod << 6) | ((R & 7) << 3) | Base);
+    }
+
+    if (Mod == 1)
+      Emit8(M.Disp);
+    else if (Mod == 2)
+      Emit32(M.Disp);
+  }
+};
+
+}
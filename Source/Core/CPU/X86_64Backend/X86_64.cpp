@@ -0,0 +1,603 @@
+#include "Core/CPU/CodeBuffer.h"
+#include "Core/CPU/CPUCore.h"
+#include "Core/CPU/Flags.h"
+#include "Core/CPU/HostFeatures.h"
+#include "Core/CPU/IR.h"
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/Passes/RegisterAllocation.h"
+#include "Core/CPU/X86_64Backend/Assembler.h"
+#include "Core/CPU/X86_64Backend/X86_64.h"
+#include "LogManager.h"
+#include <unordered_map>
+
+namespace Emu {
+using namespace X86_64Asm;
+
+// Host registers handed to the register allocator
+// Caller saved first, guest state gets pinned to the callee saved ones at the top
+constexpr std::array<Reg, 10> HostRegisters = {
+  RDX, RSI, RDI, R8, R9, R10,
+  RBX, RBP, R12, R13,
+};
+constexpr uint64_t HOST_CALLER_SAVED_MASK = 0b00'0011'1111;
+
+// Registers the allocator never sees
+constexpr Reg STATE_REG = R14;  ///< X86State*
+constexpr Reg MEMBASE_REG = R15; ///< Guest memory base
+constexpr Reg DST_SCRATCH = RAX;
+constexpr Reg SRC_SCRATCH0 = RCX; ///< Also the shift count
+constexpr Reg SRC_SCRATCH1 = R11;
+
+constexpr std::array<Reg, 6> SavedRegisters = {RBX, RBP, R12, R13, R14, R15};
+
+// Frame layout after the prologue, relative to RSP
+constexpr int32_t SYSCALL_ARGS_OFFSET = 0;
+constexpr int32_t SPILL_OFFSET = SYSCALL_ARGS_OFFSET + IR::IROp_Syscall::MAX_ARGS * 8;
+
+// Most guest state the allocator keeps in host registers while a block runs
+// It pins less for blocks whose own values need the callee saved registers
+constexpr uint32_t NUM_PINNED_REGISTERS = 4;
+
+constexpr size_t CODE_BUFFER_SIZE = 128 * 1024 * 1024;
+
+static uint64_t SyscallThunk(SyscallHandler *Handler, SyscallHandler::SyscallArguments *Args) {
+  return Handler->HandleSyscall(Args);
+}
+
+static uint64_t FallbackThunk(CPUCore *CPU, X86State *State, uint64_t RIP) {
+  return CPU->FallbackInstruction(State, RIP);
+}
+
+static void SignalThunk(CPUCore *CPU, X86State *State, uint64_t Signal) {
+  CPU->RaiseSignal(State, Signal);
+}
+
+static bool GetComparisonCC(IR::IROp_Select::ComparisonOp Comparison, Cond *CC) {
+  switch (Comparison) {
+  case IR::IROp_Select::COMP_EQ: *CC = CC_E; break;
+  case IR::IROp_Select::COMP_NEQ: *CC = CC_NE; break;
+  case IR::IROp_Select::COMP_SLT: *CC = CC_L; break;
+  case IR::IROp_Select::COMP_SLE: *CC = CC_LE; break;
+  case IR::IROp_Select::COMP_SGT: *CC = CC_G; break;
+  case IR::IROp_Select::COMP_SGE: *CC = CC_GE; break;
+  case IR::IROp_Select::COMP_ULT: *CC = CC_B; break;
+  case IR::IROp_Select::COMP_ULE: *CC = CC_BE; break;
+  case IR::IROp_Select::COMP_UGT: *CC = CC_A; break;
+  case IR::IROp_Select::COMP_UGE: *CC = CC_AE; break;
+  default: return false;
+  }
+  return true;
+}
+
+class X86_64 final : public CPUBackend {
+public:
+  explicit X86_64(CPUCore *CPU);
+  std::string GetName() override { return "X86_64"; }
+  void* CompileCode(Emu::IR::IntrusiveIRList const *ir) override;
+  void FreeCode(void *Block) override { Code.Free(Block); }
+
+private:
+  CPUCore *cpu;
+  IR::RegisterFile RegisterFile;
+  HostFeatures Features;
+
+  CodeBuffer Code{CODE_BUFFER_SIZE};
+};
+
+namespace {
+class BlockEmitter final {
+public:
+  BlockEmitter(CPUCore *CPU, IR::RegisterFile const &Registers, HostFeatures const &Features, IR::IntrusiveIRList const *ir)
+    : cpu {CPU}
+    , RegisterFile {Registers}
+    , Features {Features}
+    , IR {ir}
+    , RA {IR::AllocateRegisters(ir, Registers)} {
+  }
+
+  bool Emit();
+  Assembler const &GetAssembler() const { return Asm; }
+
+private:
+  CPUCore *cpu;
+  IR::RegisterFile const &RegisterFile;
+  HostFeatures const &Features;
+  IR::IntrusiveIRList const *IR;
+  IR::RegisterAllocationData RA;
+  Assembler Asm;
+  std::unordered_map<IR::AlignmentType, Assembler::Label> Labels;
+  int32_t FrameSize;
+
+  Assembler::Label GetLabel(IR::AlignmentType Offset) {
+    auto it = Labels.find(Offset);
+    if (it == Labels.end())
+      it = Labels.emplace(Offset, Asm.NewLabel()).first;
+    return it->second;
+  }
+
+  Mem SpillMem(uint32_t Slot) const { return Mem(RSP, SPILL_OFFSET + Slot * 8); }
+
+  Reg GetSrc(IR::AlignmentType Value, Reg Scratch) {
+    auto &Assignment = RA.Get(Value);
+    if (!Assignment.IsSpilled())
+      return HostRegisters[Assignment.Register];
+    Asm.Load(8, Scratch, SpillMem(Assignment.SpillSlot));
+    return Scratch;
+  }
+
+  Reg GetDst(IR::AlignmentType Value) {
+    auto &Assignment = RA.Get(Value);
+    return Assignment.IsSpilled() ? DST_SCRATCH : HostRegisters[Assignment.Register];
+  }
+
+  void StoreDst(IR::AlignmentType Value, Reg R) {
+    auto &Assignment = RA.Get(Value);
+    if (Assignment.IsSpilled())
+      Asm.Store(8, SpillMem(Assignment.SpillSlot), R);
+  }
+
+  void WritebackPinned() {
+    for (auto &Pin : RA.Pinned)
+      Asm.Store(8, Mem(STATE_REG, Pin.ContextOffset), HostRegisters[Pin.Register]);
+  }
+
+  void ReloadPinned() {
+    for (auto &Pin : RA.Pinned)
+      Asm.Load(8, HostRegisters[Pin.Register], Mem(STATE_REG, Pin.ContextOffset));
+  }
+
+  // Reads an 8 byte state field from wherever it lives while the block runs
+  void LoadStateField(Reg Dst, uint32_t ContextOffset) {
+    uint32_t Pin = IR::FindPinnedRegister(RA, ContextOffset, 8);
+    if (Pin != IR::RegisterAssignment::INVALID)
+      Asm.Mov(Dst, HostRegisters[Pin]);
+    else
+      Asm.Load(8, Dst, Mem(STATE_REG, ContextOffset));
+  }
+
+  // Partial accesses to pinned state go through X86State
+  template<typename F>
+  void ForEachOverlappingPin(uint32_t Offset, uint8_t Size, F Func) {
+    for (auto &Pin : RA.Pinned) {
+      if (Offset < Pin.ContextOffset + 8 && Pin.ContextOffset < Offset + Size)
+        Func(Pin);
+    }
+  }
+
+  void CallHelper(void *Func) {
+    Asm.MovImm(RAX, reinterpret_cast<uint64_t>(Func));
+    Asm.Call(RAX);
+  }
+
+  void EmitPrologue();
+  void EmitEpilogue();
+  void EmitParityFlag(Reg Dst);
+  bool EmitOp(IR::AlignmentType Offset, IR::IROp_Header const *op);
+};
+
+void BlockEmitter::EmitPrologue() {
+  for (auto R : SavedRegisters)
+    Asm.Push(R);
+
+  // Keep RSP 16 byte aligned for calls, the return address and pushes leave it off by 8
+  FrameSize = SPILL_OFFSET + RA.SpillSlots * 8;
+  FrameSize = ((FrameSize + 15) & ~15) + 8;
+  Asm.SubImm(RSP, FrameSize);
+
+  // Code caches are per thread, so the thread's state can be baked in
+  Asm.MovImm(STATE_REG, reinterpret_cast<uint64_t>(&cpu->GetTLSThread()->CPUState));
+  Asm.MovImm(MEMBASE_REG, cpu->MemoryMapper->GetBaseOffset<uint64_t>(0));
+  ReloadPinned();
+}
+
+void BlockEmitter::EmitEpilogue() {
+  WritebackPinned();
+  Asm.AddImm(RSP, FrameSize);
+  for (auto it = SavedRegisters.rbegin(); it != SavedRegisters.rend(); ++it)
+    Asm.Pop(*it);
+  Asm.Ret();
+}
+
+// PF only depends on the low byte of the result for every deferred op, so it doesn't need the helper
+void BlockEmitter::EmitParityFlag(Reg Dst) {
+  auto Deferred = Asm.NewLabel();
+  auto Done = Asm.NewLabel();
+
+  LoadStateField(Dst, offsetof(X86State, flags_op));
+  Asm.Test(Dst, Dst);
+  Asm.Jcc(CC_NE, Deferred);
+  LoadStateField(Dst, offsetof(X86State, rflags));
+  Asm.ShrImm(Dst, Flags::FLAG_PF_LOC);
+  Asm.Jmp(Done);
+
+  Asm.Bind(Deferred);
+  LoadStateField(Dst, offsetof(X86State, flags_res));
+  Asm.Movzx8(Dst, Dst);
+  Asm.Popcnt(Dst, Dst);
+  // Set on an even number of bits
+  Asm.Not(Dst);
+
+  Asm.Bind(Done);
+  Asm.AndImm8(Dst, 1);
+}
+
+bool BlockEmitter::EmitOp(IR::AlignmentType Offset, IR::IROp_Header const *op) {
+  switch (op->Op) {
+  case IR::OP_BEGINBLOCK:
+  case IR::OP_RIP_MARKER:
+  break;
+  case IR::OP_ENDBLOCK: {
+    auto EndOp = op->C<IR::IROp_EndBlock>();
+    if (EndOp->RIPIncrement) {
+      LogMan::Throw::A(EndOp->RIPIncrement < 0x8000'0000ULL, "RIP increment too large");
+      Asm.AddImm(Mem(STATE_REG, offsetof(X86State, rip)), EndOp->RIPIncrement);
+    }
+    EmitEpilogue();
+  break;
+  }
+  case IR::OP_JUMP_TGT:
+    Asm.Bind(GetLabel(Offset));
+  break;
+  case IR::OP_JUMP:
+    Asm.Jmp(GetLabel(op->C<IR::IROp_Jump>()->Target));
+  break;
+  case IR::OP_COND_JUMP: {
+    auto JumpOp = op->C<IR::IROp_CondJump>();
+    Cond CC;
+    if (!GetComparisonCC(JumpOp->Cond, &CC)) {
+      LogMan::Msg::E("Unknown jump comparison: %d", JumpOp->Cond);
+      return false;
+    }
+
+    Asm.ALU(ALU_CMP, GetSrc(JumpOp->Args[0], SRC_SCRATCH0), GetSrc(JumpOp->Args[1], SRC_SCRATCH1));
+    Asm.Jcc(CC, GetLabel(JumpOp->Target));
+  break;
+  }
+  case IR::OP_CONSTANT: {
+    Reg Dst = GetDst(Offset);
+    Asm.MovImm(Dst, op->C<IR::IROp_Constant>()->Constant);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LOADCONTEXT: {
+    auto LoadOp = op->C<IR::IROp_LoadContext>();
+    Reg Dst = GetDst(Offset);
+    uint32_t Pin = IR::FindPinnedRegister(RA, LoadOp->Offset, LoadOp->Size);
+    if (Pin != IR::RegisterAssignment::INVALID) {
+      Asm.Mov(Dst, HostRegisters[Pin]);
+    }
+    else {
+      ForEachOverlappingPin(LoadOp->Offset, LoadOp->Size, [this](IR::PinnedRegister const &Pin) {
+        Asm.Store(8, Mem(STATE_REG, Pin.ContextOffset), HostRegisters[Pin.Register]);
+      });
+      Asm.Load(LoadOp->Size, Dst, Mem(STATE_REG, LoadOp->Offset));
+    }
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_STORECONTEXT: {
+    auto StoreOp = op->C<IR::IROp_StoreContext>();
+    Reg Src = GetSrc(StoreOp->Arg, SRC_SCRATCH0);
+    uint32_t Pin = IR::FindPinnedRegister(RA, StoreOp->Offset, StoreOp->Size);
+    if (Pin != IR::RegisterAssignment::INVALID) {
+      Asm.Mov(HostRegisters[Pin], Src);
+    }
+    else {
+      ForEachOverlappingPin(StoreOp->Offset, StoreOp->Size, [this](IR::PinnedRegister const &Pin) {
+        Asm.Store(8, Mem(STATE_REG, Pin.ContextOffset), HostRegisters[Pin.Register]);
+      });
+      Asm.Store(StoreOp->Size, Mem(STATE_REG, StoreOp->Offset), Src);
+      ForEachOverlappingPin(StoreOp->Offset, StoreOp->Size, [this](IR::PinnedRegister const &Pin) {
+        Asm.Load(8, HostRegisters[Pin.Register], Mem(STATE_REG, Pin.ContextOffset));
+      });
+    }
+  break;
+  }
+  case IR::OP_ADD:
+  case IR::OP_SUB:
+  case IR::OP_OR:
+  case IR::OP_XOR:
+  case IR::OP_AND: {
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    ALUOp ALU;
+    switch (op->Op) {
+    case IR::OP_ADD: ALU = ALU_ADD; break;
+    case IR::OP_SUB: ALU = ALU_SUB; break;
+    case IR::OP_OR:  ALU = ALU_OR; break;
+    case IR::OP_XOR: ALU = ALU_XOR; break;
+    default:         ALU = ALU_AND; break;
+    }
+    // Destinations never share a register with their arguments
+    Reg Src1 = GetSrc(BiOp->Args[0], SRC_SCRATCH0);
+    Reg Src2 = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, Src1);
+    Asm.ALU(ALU, Dst, Src2);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_NAND: {
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    Reg Src1 = GetSrc(BiOp->Args[0], SRC_SCRATCH0);
+    Reg Src2 = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, Src2);
+    Asm.Not(Dst);
+    Asm.ALU(ALU_AND, Dst, Src1);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_SHL:
+  case IR::OP_SHR:
+  case IR::OP_ASHR:
+  case IR::OP_BITEXTRACT: {
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    if (Features.SupportsBMI2) {
+      Reg Src = GetSrc(BiOp->Args[0], SRC_SCRATCH0);
+      Reg Shift = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+      Reg Dst = GetDst(Offset);
+      if (op->Op == IR::OP_SHL)
+        Asm.Shlx(Dst, Src, Shift);
+      else if (op->Op == IR::OP_ASHR)
+        Asm.Sarx(Dst, Src, Shift);
+      else
+        Asm.Shrx(Dst, Src, Shift);
+      if (op->Op == IR::OP_BITEXTRACT)
+        Asm.AndImm8(Dst, 1);
+      StoreDst(Offset, Dst);
+      break;
+    }
+
+    Reg Shift = GetSrc(BiOp->Args[1], SRC_SCRATCH0);
+    if (Shift != RCX)
+      Asm.Mov(RCX, Shift);
+    Reg Src = GetSrc(BiOp->Args[0], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, Src);
+    if (op->Op == IR::OP_SHL) {
+      Asm.ShlCL(Dst);
+    }
+    else if (op->Op == IR::OP_ASHR) {
+      Asm.SarCL(Dst);
+    }
+    else {
+      Asm.ShrCL(Dst);
+      if (op->Op == IR::OP_BITEXTRACT)
+        Asm.AndImm8(Dst, 1);
+    }
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_MUL: {
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    Reg Src1 = GetSrc(BiOp->Args[0], SRC_SCRATCH0);
+    Reg Src2 = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, Src1);
+    Asm.Imul(Dst, Src2);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_UMULH:
+  case IR::OP_SMULH:
+  case IR::OP_UDIV:
+  case IR::OP_SDIV:
+  case IR::OP_UREM:
+  case IR::OP_SREM: {
+    // These only come in the RDX:RAX form, RDX belongs to the allocator so it gets parked in SRC_SCRATCH0
+    auto BiOp = op->C<IR::IROp_BiOp>();
+    Asm.Mov(RAX, GetSrc(BiOp->Args[0], SRC_SCRATCH0));
+    Reg Src2 = GetSrc(BiOp->Args[1], SRC_SCRATCH1);
+    if (Src2 == RDX) {
+      Asm.Mov(SRC_SCRATCH1, RDX);
+      Src2 = SRC_SCRATCH1;
+    }
+    Asm.Mov(SRC_SCRATCH0, RDX);
+
+    Reg Result = RDX;
+    switch (op->Op) {
+    case IR::OP_UMULH: Asm.Mul(Src2); break;
+    case IR::OP_SMULH: Asm.Imul(Src2); break;
+    case IR::OP_UDIV:
+    case IR::OP_UREM:
+      Asm.ALU(ALU_XOR, RDX, RDX);
+      Asm.Div(Src2);
+      Result = op->Op == IR::OP_UDIV ? RAX : RDX;
+    break;
+    default:
+      Asm.Cqo();
+      Asm.Idiv(Src2);
+      Result = op->Op == IR::OP_SDIV ? RAX : RDX;
+    break;
+    }
+
+    // A destination in RDX means nothing else was living there
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, Result);
+    if (Dst != RDX)
+      Asm.Mov(RDX, SRC_SCRATCH0);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LUDIV:
+  case IR::OP_LUREM: {
+    // The high half is below the divisor so div can't fault, RDX gets parked the same way
+    auto TriOp = op->C<IR::IROp_TriOp>();
+    Reg Divisor = GetSrc(TriOp->Args[2], SRC_SCRATCH1);
+    if (Divisor == RDX) {
+      Asm.Mov(SRC_SCRATCH1, RDX);
+      Divisor = SRC_SCRATCH1;
+    }
+    Asm.Mov(SRC_SCRATCH0, RDX);
+
+    Reg Low = GetSrc(TriOp->Args[0], RAX);
+    if (Low != RAX)
+      Asm.Mov(RAX, Low);
+    Reg High = GetSrc(TriOp->Args[1], RDX);
+    if (High != RDX)
+      Asm.Mov(RDX, High);
+    Asm.Div(Divisor);
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, op->Op == IR::OP_LUDIV ? RAX : RDX);
+    if (Dst != RDX)
+      Asm.Mov(RDX, SRC_SCRATCH0);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_SELECT: {
+    auto SelectOp = op->C<IR::IROp_Select>();
+    Cond CC;
+    if (!GetComparisonCC(SelectOp->Op, &CC)) {
+      LogMan::Msg::E("Unknown select comparison: %d", SelectOp->Op);
+      return false;
+    }
+
+    Asm.ALU(ALU_CMP, GetSrc(SelectOp->Args[0], SRC_SCRATCH0), GetSrc(SelectOp->Args[1], SRC_SCRATCH1));
+    // Reloading spilled values doesn't touch the flags
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, GetSrc(SelectOp->Args[3], SRC_SCRATCH0));
+    Asm.CMov(CC, Dst, GetSrc(SelectOp->Args[2], SRC_SCRATCH1));
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_TRUNC_32:
+  case IR::OP_TRUNC_16: {
+    Reg Src = GetSrc(op->C<IR::IROp_MonoOp>()->Arg, SRC_SCRATCH0);
+    Reg Dst = GetDst(Offset);
+    if (op->Op == IR::OP_TRUNC_32)
+      Asm.Mov32(Dst, Src);
+    else
+      Asm.Movzx16(Dst, Src);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_LOAD_MEM: {
+    auto LoadMemOp = op->C<IR::IROp_LoadMem>();
+    Reg Addr = GetSrc(LoadMemOp->Arg[0], SRC_SCRATCH0);
+    if (LoadMemOp->Arg[1] != ~0U) {
+      Asm.Lea(SRC_SCRATCH0, Mem(Addr, GetSrc(LoadMemOp->Arg[1], SRC_SCRATCH1), 0));
+      Addr = SRC_SCRATCH0;
+    }
+    Reg Dst = GetDst(Offset);
+    if (LoadMemOp->SignExtend)
+      Asm.LoadSigned(LoadMemOp->Size, Dst, Mem(MEMBASE_REG, Addr, 0));
+    else
+      Asm.Load(LoadMemOp->Size, Dst, Mem(MEMBASE_REG, Addr, 0));
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_STORE_MEM: {
+    auto StoreMemOp = op->C<IR::IROp_StoreMem>();
+    // The address takes both scratch registers while it's being formed
+    Reg Addr = GetSrc(StoreMemOp->Arg[1], SRC_SCRATCH0);
+    if (StoreMemOp->Arg[2] != ~0U) {
+      Asm.Lea(SRC_SCRATCH0, Mem(Addr, GetSrc(StoreMemOp->Arg[2], SRC_SCRATCH1), 0));
+      Addr = SRC_SCRATCH0;
+    }
+    Asm.Store(StoreMemOp->Size, Mem(MEMBASE_REG, Addr, 0), GetSrc(StoreMemOp->Arg[0], SRC_SCRATCH1));
+  break;
+  }
+  case IR::OP_SYSCALL: {
+    auto SyscallOp = op->C<IR::IROp_Syscall>();
+    for (size_t i = 0; i < IR::IROp_Syscall::MAX_ARGS; ++i) {
+      Asm.Store(8, Mem(RSP, SYSCALL_ARGS_OFFSET + i * 8), GetSrc(SyscallOp->Arguments[i], SRC_SCRATCH0));
+    }
+    WritebackPinned();
+    Asm.MovImm(RDI, reinterpret_cast<uint64_t>(&cpu->syscallhandler));
+    Asm.Lea(RSI, Mem(RSP, SYSCALL_ARGS_OFFSET));
+    CallHelper(reinterpret_cast<void*>(SyscallThunk));
+    ReloadPinned();
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, RAX);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_FALLBACK: {
+    WritebackPinned();
+    Asm.MovImm(RDI, reinterpret_cast<uint64_t>(cpu));
+    Asm.Mov(RSI, STATE_REG);
+    Asm.MovImm(RDX, op->C<IR::IROp_Fallback>()->RIP);
+    CallHelper(reinterpret_cast<void*>(FallbackThunk));
+    ReloadPinned();
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, RAX);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_RAISE_SIGNAL:
+    WritebackPinned();
+    Asm.MovImm(RDI, reinterpret_cast<uint64_t>(cpu));
+    Asm.Mov(RSI, STATE_REG);
+    Asm.MovImm(RDX, op->C<IR::IROp_RaiseSignal>()->Signal);
+    CallHelper(reinterpret_cast<void*>(SignalThunk));
+    ReloadPinned();
+  break;
+  case IR::OP_GET_FLAG: {
+    if (Features.SupportsPOPCNT && op->C<IR::IROp_GetFlag>()->Bit == Flags::FLAG_PF_LOC) {
+      Reg Dst = GetDst(Offset);
+      EmitParityFlag(Dst);
+      StoreDst(Offset, Dst);
+      break;
+    }
+
+    WritebackPinned();
+    Asm.Mov(RDI, STATE_REG);
+    Asm.MovImm(RSI, op->C<IR::IROp_GetFlag>()->Bit);
+    CallHelper(reinterpret_cast<void*>(Flags::GetFlag));
+
+    Reg Dst = GetDst(Offset);
+    Asm.Mov(Dst, RAX);
+    StoreDst(Offset, Dst);
+  break;
+  }
+  case IR::OP_MATERIALIZE_FLAGS:
+    WritebackPinned();
+    Asm.Mov(RDI, STATE_REG);
+    CallHelper(reinterpret_cast<void*>(Flags::Materialize));
+    ReloadPinned();
+  break;
+  default:
+    // Function level ops never come out of the op dispatcher
+    LogMan::Msg::E("Unknown IR Op: %d(%s)", op->Op, IR::GetName(op->Op).data());
+    return false;
+  }
+
+  return true;
+}
+
+bool BlockEmitter::Emit() {
+  EmitPrologue();
+
+  size_t Size = IR->GetOffset();
+  for (size_t i = 0; i != Size; i += IR::GetSize(IR->GetOp(i)->Op)) {
+    if (!EmitOp(i, IR->GetOp(i)))
+      return false;
+  }
+  return true;
+}
+}
+
+X86_64::X86_64(CPUCore *CPU)
+  : cpu {CPU}
+  , Features {GetHostFeatures()} {
+  RegisterFile.NumRegisters = HostRegisters.size();
+  RegisterFile.CallerSavedMask = HOST_CALLER_SAVED_MASK;
+  RegisterFile.MaxPinned = NUM_PINNED_REGISTERS;
+}
+
+void* X86_64::CompileCode(Emu::IR::IntrusiveIRList const *ir) {
+  BlockEmitter Emitter(cpu, RegisterFile, Features, ir);
+  if (!Emitter.Emit())
+    return nullptr;
+
+  auto &Asm = Emitter.GetAssembler();
+  return Code.Copy(Asm.GetData(), Asm.GetSize());
+}
+
+CPUBackend *CreateX86_64Backend(Emu::CPUCore *CPU) {
+  return new X86_64(CPU);
+}
+}
@@ -0,0 +1,7 @@
+#pragma once
+#include "Core/CPU/CPUBackend.h"
+
+namespace Emu {
+class CPUCore;
+CPUBackend *CreateX86_64Backend(Emu::CPUCore *CPU);
+}
@@ -0,0 +1,109 @@
+// Checks the AArch64 encoder against golden encodings
+// The expected words come from llvm-mc -triple=aarch64 -show-encoding for the listed assembly
+#include "Core/CPU/AArch64Backend/Assembler.h"
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+using namespace Emu::AArch64Asm;
+
+namespace {
+struct EncodingTest {
+  char const *Asm;
+  void (*Emit)(Assembler &A);
+  std::vector<uint32_t> Expected;
+};
+
+std::vector<EncodingTest> const Tests = {
+  {"mov x0, x1", [](Assembler &A) { A.Mov(X0, X1); }, {0xAA0103E0}},
+  {"mov x30, x17", [](Assembler &A) { A.Mov(X30, X17); }, {0xAA1103FE}},
+  {"mov w2, w3", [](Assembler &A) { A.Mov32(X2, X3); }, {0x2A0303E2}},
+  {"uxth w4, w5", [](Assembler &A) { A.Uxth(X4, X5); }, {0x53003CA4}},
+  {"movz x0, #0", [](Assembler &A) { A.MovImm(X0, 0); }, {0xD2800000}},
+  {"movn x1, #0", [](Assembler &A) { A.MovImm(X1, ~0ULL); }, {0x92800001}},
+  {"movz x2, #0x1234", [](Assembler &A) { A.MovImm(X2, 0x1234); }, {0xD2824682}},
+  {"movz x3, #0x1234, lsl #16", [](Assembler &A) { A.MovImm(X3, 0x12340000); }, {0xD2A24683}},
+  {"movz x4, #0xdef0; movk x4, #0x9abc, lsl #16; movk x4, #0x5678, lsl #32; movk x4, #0x1234, lsl #48", [](Assembler &A) { A.MovImm(X4, 0x123456789ABCDEF0ULL); }, {0xD29BDE04, 0xF2B35784, 0xF2CACF04, 0xF2E24684}},
+  {"movn x5, #0xedcb", [](Assembler &A) { A.MovImm(X5, 0xFFFFFFFFFFFF1234ULL); }, {0x929DB965}},
+  {"movn x6, #0xa987; movk x6, #0x1234, lsl #32", [](Assembler &A) { A.MovImm(X6, 0xFFFF1234FFFF5678ULL); }, {0x929530E6, 0xF2C24686}},
+  {"movz x7, #0xffff; movk x7, #0xffff, lsl #32", [](Assembler &A) { A.MovImm(X7, 0x0000FFFF0000FFFFULL); }, {0xD29FFFE7, 0xF2DFFFE7}},
+  {"ldr x0, [x1, #16]", [](Assembler &A) { A.Load(8, X0, X1, 16); }, {0xF9400820}},
+  {"ldr w2, [x3, #4092]", [](Assembler &A) { A.Load(4, X2, X3, 4092); }, {0xB94FFC62}},
+  {"ldrh w4, [x5, #2]", [](Assembler &A) { A.Load(2, X4, X5, 2); }, {0x794004A4}},
+  {"ldrb w6, [x7, #4095]", [](Assembler &A) { A.Load(1, X6, X7, 4095); }, {0x397FFCE6}},
+  {"ldr x8, [sp, #32760]", [](Assembler &A) { A.Load(8, X8, SP, 32760); }, {0xF97FFFE8}},
+  {"str x9, [x10, #8]", [](Assembler &A) { A.Store(8, X9, X10, 8); }, {0xF9000549}},
+  {"str w11, [x12]", [](Assembler &A) { A.Store(4, X11, X12, 0); }, {0xB900018B}},
+  {"strh w13, [x14, #6]", [](Assembler &A) { A.Store(2, X13, X14, 6); }, {0x79000DCD}},
+  {"strb w15, [x16, #1]", [](Assembler &A) { A.Store(1, X15, X16, 1); }, {0x3900060F}},
+  {"ldr x0, [x1, x2]", [](Assembler &A) { A.LoadIndexed(8, X0, X1, X2); }, {0xF8626820}},
+  {"ldr w3, [x4, x5]", [](Assembler &A) { A.LoadIndexed(4, X3, X4, X5); }, {0xB8656883}},
+  {"ldrh w6, [x7, x8]", [](Assembler &A) { A.LoadIndexed(2, X6, X7, X8); }, {0x786868E6}},
+  {"ldrb w9, [x10, x11]", [](Assembler &A) { A.LoadIndexed(1, X9, X10, X11); }, {0x386B6949}},
+  {"ldr x0, [x1, x2]", [](Assembler &A) { A.LoadSignedIndexed(8, X0, X1, X2); }, {0xF8626820}},
+  {"ldrsw x3, [x4, x5]", [](Assembler &A) { A.LoadSignedIndexed(4, X3, X4, X5); }, {0xB8A56883}},
+  {"ldrsh x6, [x7, x8]", [](Assembler &A) { A.LoadSignedIndexed(2, X6, X7, X8); }, {0x78A868E6}},
+  {"ldrsb x9, [x10, x11]", [](Assembler &A) { A.LoadSignedIndexed(1, X9, X10, X11); }, {0x38AB6949}},
+  {"str x12, [x13, x14]", [](Assembler &A) { A.StoreIndexed(8, X12, X13, X14); }, {0xF82E69AC}},
+  {"str w15, [x16, x17]", [](Assembler &A) { A.StoreIndexed(4, X15, X16, X17); }, {0xB8316A0F}},
+  {"strh w18, [x19, x20]", [](Assembler &A) { A.StoreIndexed(2, X18, X19, X20); }, {0x78346A72}},
+  {"strb w21, [x22, x23]", [](Assembler &A) { A.StoreIndexed(1, X21, X22, X23); }, {0x38376AD5}},
+  {"stp x29, x30, [sp, #-16]!", [](Assembler &A) { A.Stp(X29, X30); }, {0xA9BF7BFD}},
+  {"ldp x19, x20, [sp], #16", [](Assembler &A) { A.Ldp(X19, X20); }, {0xA8C153F3}},
+  {"add x0, x1, x2", [](Assembler &A) { A.Add(X0, X1, X2); }, {0x8B020020}},
+  {"sub x3, x4, x5", [](Assembler &A) { A.Sub(X3, X4, X5); }, {0xCB050083}},
+  {"and x6, x7, x8", [](Assembler &A) { A.And(X6, X7, X8); }, {0x8A0800E6}},
+  {"orr x9, x10, x11", [](Assembler &A) { A.Orr(X9, X10, X11); }, {0xAA0B0149}},
+  {"eor x12, x13, x14", [](Assembler &A) { A.Eor(X12, X13, X14); }, {0xCA0E01AC}},
+  {"bic x15, x16, x17", [](Assembler &A) { A.Bic(X15, X16, X17); }, {0x8A31020F}},
+  {"lsl x18, x19, x20", [](Assembler &A) { A.Lslv(X18, X19, X20); }, {0x9AD42272}},
+  {"lsr x21, x22, x23", [](Assembler &A) { A.Lsrv(X21, X22, X23); }, {0x9AD726D5}},
+  {"asr x24, x25, x26", [](Assembler &A) { A.Asrv(X24, X25, X26); }, {0x9ADA2B38}},
+  {"mul x27, x28, x29", [](Assembler &A) { A.Mul(X27, X28, X29); }, {0x9B1D7F9B}},
+  {"umulh x0, x1, x2", [](Assembler &A) { A.Umulh(X0, X1, X2); }, {0x9BC27C20}},
+  {"smulh x3, x4, x5", [](Assembler &A) { A.Smulh(X3, X4, X5); }, {0x9B457C83}},
+  {"udiv x6, x7, x8", [](Assembler &A) { A.Udiv(X6, X7, X8); }, {0x9AC808E6}},
+  {"sdiv x9, x10, x11", [](Assembler &A) { A.Sdiv(X9, X10, X11); }, {0x9ACB0D49}},
+  {"msub x12, x13, x14, x15", [](Assembler &A) { A.Msub(X12, X13, X14, X15); }, {0x9B0EBDAC}},
+  {"cmp x16, x17", [](Assembler &A) { A.Cmp(X16, X17); }, {0xEB11021F}},
+  {"csel x0, x1, x2, eq", [](Assembler &A) { A.Csel(CC_EQ, X0, X1, X2); }, {0x9A820020}},
+  {"csel x3, x4, x5, le", [](Assembler &A) { A.Csel(CC_LE, X3, X4, X5); }, {0x9A85D083}},
+  {"and x6, x7, #1", [](Assembler &A) { A.AndOne(X6, X7); }, {0x924000E6}},
+  {"add x0, x1, #1", [](Assembler &A) { A.AddImm(X0, X1, 1); }, {0x91000420}},
+  {"add sp, sp, #4095", [](Assembler &A) { A.AddImm(SP, SP, 4095); }, {0x913FFFFF}},
+  {"sub x2, sp, #16", [](Assembler &A) { A.SubImm(X2, SP, 16); }, {0xD10043E2}},
+  {"blr x16", [](Assembler &A) { A.Blr(X16); }, {0xD63F0200}},
+  {"ret", [](Assembler &A) { A.Ret(); }, {0xD65F03C0}},
+  {"b #8; ret", [](Assembler &A) { auto L = A.NewLabel(); A.B(L); A.Ret(); A.Bind(L); }, {0x14000002, 0xD65F03C0}},
+  {"ret; b #-4", [](Assembler &A) { auto L = A.NewLabel(); A.Bind(L); A.Ret(); A.B(L); }, {0xD65F03C0, 0x17FFFFFF}},
+  {"b.ne #12; ret; ret", [](Assembler &A) { auto L = A.NewLabel(); A.BCond(CC_NE, L); A.Ret(); A.Ret(); A.Bind(L); }, {0x54000061, 0xD65F03C0, 0xD65F03C0}},
+  {"ret; b.hi #-4", [](Assembler &A) { auto L = A.NewLabel(); A.Bind(L); A.Ret(); A.BCond(CC_HI, L); }, {0xD65F03C0, 0x54FFFFE8}},
+  {"cbnz x3, #8; ret", [](Assembler &A) { auto L = A.NewLabel(); A.Cbnz(X3, L); A.Ret(); A.Bind(L); }, {0xB5000043, 0xD65F03C0}},
+  {"ret; ret; cbnz x4, #-8", [](Assembler &A) { auto L = A.NewLabel(); A.Bind(L); A.Ret(); A.Ret(); A.Cbnz(X4, L); }, {0xD65F03C0, 0xD65F03C0, 0xB5FFFFC4}},
+};
+}
+
+int main() {
+  size_t Failures = 0;
+  for (auto const &Test : Tests) {
+    Assembler A;
+    Test.Emit(A);
+
+    std::vector<uint32_t> Got(A.GetSize() / sizeof(uint32_t));
+    memcpy(Got.data(), A.GetData(), A.GetSize());
+    if (Got == Test.Expected)
+      continue;
+
+    ++Failures;
+    printf("FAIL: %s\n  expected:", Test.Asm);
+    for (auto Word : Test.Expected)
+      printf(" %08x", Word);
+    printf("\n  got:     ");
+    for (auto Word : Got)
+      printf(" %08x", Word);
+    printf("\n");
+  }
+
+  printf("%zd/%zd encodings match\n", Tests.size() - Failures, Tests.size());
+  return Failures != 0;
+}
@@ -0,0 +1,363 @@
+// Checks the results and flags of the ALU, shift and rotate instructions on every backend
+// The expected values come from the SDM's operation pseudocode, written out bit by bit so it doesn't share mistakes with the emulator
+#include "Core/CPU/Flags.h"
+#include "TestGuest.h"
+
+#include <array>
+#include <cstring>
+
+using namespace Emu;
+
+namespace {
+constexpr uint64_t BLOCK_RIP = 0x1000;
+// Fills the register bits outside of the operand so partial writes show up
+constexpr uint64_t UPPER_PATTERN = 0xA5A5'A5A5'A5A5'A5A5ULL;
+
+// The order matches the ALU opcode rows and the shift group's ModRM reg field
+enum Operation {
+  ADD, OR, ADC, SBB, AND, SUB, XOR, CMP,
+  ROL, ROR, RCL, RCR, SHL, SHR, SAL_UNUSED, SAR,
+  TEST, INC, DEC, NOT, NEG,
+};
+
+bool IsShift(Operation Op) { return Op >= ROL && Op <= SAR; }
+bool IsUnary(Operation Op) { return Op >= INC; }
+
+constexpr std::array<Operation, 20> Operations = {
+  ADD, OR, ADC, SBB, AND, SUB, XOR, CMP, TEST,
+  INC, DEC, NOT, NEG,
+  ROL, ROR, RCL, RCR, SHL, SHR, SAR,
+};
+
+constexpr std::array<const char*, 21> OperationNames = {
+  "add", "or", "adc", "sbb", "and", "sub", "xor", "cmp",
+  "rol", "ror", "rcl", "rcr", "shl", "shr", "sal", "sar",
+  "test", "inc", "dec", "not", "neg",
+};
+
+// Where a shift or rotate gets its count from
+enum CountForm {
+  COUNT_IMM8,
+  COUNT_ONE,
+  COUNT_CL,
+};
+
+/**
+ * @brief An operand size and which registers hold the operands
+ *
+ * Byte operations also get run on ah and bh
+ */
+struct OperandForm {
+  uint8_t Size;
+  bool HighByte;
+};
+
+constexpr std::array<OperandForm, 5> OperandForms = {{
+  {1, false}, {1, true}, {2, false}, {4, false}, {8, false},
+}};
+
+struct Outcome {
+  uint64_t Result;
+  uint64_t RFLAGS;
+  uint64_t Defined; ///< Flags the SDM defines for this operation, the rest are free to be anything
+  bool WritesResult;
+};
+
+Outcome Reference(Operation Op, uint8_t Size, uint64_t Dest, uint64_t Src, uint64_t RFLAGS) {
+  const uint32_t Bits = Size * 8;
+  const uint64_t Mask = Size == 8 ? ~0ULL : (1ULL << Bits) - 1;
+  const bool CF = (RFLAGS >> Flags::FLAG_CF_LOC) & 1;
+
+  Outcome Out {Dest, RFLAGS, Flags::ARITH_FLAGS_MASK, Op != CMP && Op != TEST};
+  auto MSB = [Bits](uint64_t Value) -> bool { return (Value >> (Bits - 1)) & 1; };
+  auto SetFlag = [&Out](uint32_t Loc, bool Value) {
+    Out.RFLAGS = (Out.RFLAGS & ~(1ULL << Loc)) | (static_cast<uint64_t>(Value) << Loc);
+  };
+  auto SetResultFlags = [&](uint64_t Res) {
+    SetFlag(Flags::FLAG_ZF_LOC, Res == 0);
+    SetFlag(Flags::FLAG_SF_LOC, MSB(Res));
+    SetFlag(Flags::FLAG_PF_LOC, (__builtin_popcountll(Res & 0xFF) & 1) == 0);
+  };
+
+  auto Add = [&](uint64_t A, uint64_t B, bool Carry) {
+    unsigned __int128 Wide = static_cast<unsigned __int128>(A) + B + Carry;
+    uint64_t Res = static_cast<uint64_t>(Wide) & Mask;
+    SetFlag(Flags::FLAG_CF_LOC, (Wide >> Bits) & 1);
+    SetFlag(Flags::FLAG_OF_LOC, MSB(~(A ^ B) & (A ^ Res)));
+    SetFlag(Flags::FLAG_AF_LOC, ((A ^ B ^ Res) >> 4) & 1);
+    SetResultFlags(Res);
+    return Res;
+  };
+  auto Sub = [&](uint64_t A, uint64_t B, bool Borrow) {
+    uint64_t Res = (A - B - Borrow) & Mask;
+    SetFlag(Flags::FLAG_CF_LOC, static_cast<unsigned __int128>(A) < static_cast<unsigned __int128>(B) + Borrow);
+    SetFlag(Flags::FLAG_OF_LOC, MSB((A ^ B) & (A ^ Res)));
+    SetFlag(Flags::FLAG_AF_LOC, ((A ^ B ^ Res) >> 4) & 1);
+    SetResultFlags(Res);
+    return Res;
+  };
+  auto Logic = [&](uint64_t Res) {
+    SetFlag(Flags::FLAG_CF_LOC, false);
+    SetFlag(Flags::FLAG_OF_LOC, false);
+    Out.Defined &= ~(1ULL << Flags::FLAG_AF_LOC);
+    SetResultFlags(Res);
+    return Res;
+  };
+
+  switch (Op) {
+  case ADD: Out.Result = Add(Dest, Src, false); return Out;
+  case ADC: Out.Result = Add(Dest, Src, CF); return Out;
+  case SUB:
+  case CMP: Out.Result = Sub(Dest, Src, false); return Out;
+  case SBB: Out.Result = Sub(Dest, Src, CF); return Out;
+  case AND:
+  case TEST: Out.Result = Logic(Dest & Src); return Out;
+  case OR: Out.Result = Logic(Dest | Src); return Out;
+  case XOR: Out.Result = Logic(Dest ^ Src); return Out;
+  case INC:
+    Out.Result = Add(Dest, 1, false);
+    SetFlag(Flags::FLAG_CF_LOC, CF);
+    return Out;
+  case DEC:
+    Out.Result = Sub(Dest, 1, false);
+    SetFlag(Flags::FLAG_CF_LOC, CF);
+    return Out;
+  case NOT: Out.Result = ~Dest & Mask; return Out;
+  case NEG: Out.Result = Sub(0, Dest, false); return Out;
+  default: break;
+  }
+
+  // Shifts and rotates, a masked count of 0 leaves every flag alone
+  const uint64_t Count = Src & (Size == 8 ? 63 : 31);
+  if (Count == 0)
+    return Out;
+
+  uint64_t Res = Dest;
+  bool Carry = CF;
+  switch (Op) {
+  case SHL:
+  case SHR:
+  case SAR:
+    for (uint64_t i = 0; i < Count; ++i) {
+      if (Op == SHL) {
+        Carry = MSB(Res);
+        Res = (Res << 1) & Mask;
+      }
+      else {
+        Carry = Res & 1;
+        Res = (Res >> 1) | (Op == SAR && MSB(Res) ? 1ULL << (Bits - 1) : 0);
+      }
+    }
+    SetFlag(Flags::FLAG_CF_LOC, Carry);
+    SetFlag(Flags::FLAG_OF_LOC, Op == SHL ? MSB(Res) != Carry : Op == SHR ? MSB(Dest) : false);
+    SetResultFlags(Res);
+    // SHL and SHR shift everything out with counts past the width, where the CF is undefined
+    Out.Defined &= ~(1ULL << Flags::FLAG_AF_LOC);
+    if (Op != SAR && Count >= Bits)
+      Out.Defined &= ~(1ULL << Flags::FLAG_CF_LOC);
+    break;
+  case ROL:
+  case ROR:
+    for (uint64_t i = 0; i < Count % Bits; ++i) {
+      if (Op == ROL)
+        Res = ((Res << 1) | MSB(Res)) & Mask;
+      else
+        Res = (Res >> 1) | ((Res & 1) << (Bits - 1));
+    }
+    SetFlag(Flags::FLAG_CF_LOC, Op == ROL ? Res & 1 : MSB(Res));
+    SetFlag(Flags::FLAG_OF_LOC, Op == ROL ? MSB(Res) != (Res & 1) : MSB(Res) != ((Res >> (Bits - 2)) & 1));
+    break;
+  case RCL:
+  case RCR: {
+    // The carry is the extra bit of the rotation, so byte and word counts wrap at 9 and 17
+    uint64_t RotateCount = Bits == 8 ? Count % 9 : Bits == 16 ? Count % 17 : Count;
+    SetFlag(Flags::FLAG_OF_LOC, MSB(Dest) != CF);
+    for (uint64_t i = 0; i < RotateCount; ++i) {
+      bool ShiftedOut = Op == RCL ? MSB(Res) : Res & 1;
+      if (Op == RCL)
+        Res = ((Res << 1) | Carry) & Mask;
+      else
+        Res = (Res >> 1) | (static_cast<uint64_t>(Carry) << (Bits - 1));
+      Carry = ShiftedOut;
+    }
+    SetFlag(Flags::FLAG_CF_LOC, Carry);
+    if (Op == RCL)
+      SetFlag(Flags::FLAG_OF_LOC, MSB(Res) != Carry);
+    break;
+  }
+  default:
+    break;
+  }
+
+  // The OF is only defined for single bit shifts and rotates
+  if (Count != 1)
+    Out.Defined &= ~(1ULL << Flags::FLAG_OF_LOC);
+  Out.Result = Res;
+  return Out;
+}
+
+/**
+ * @brief Encodes Op with rax or ah as the destination and rbx, bh, an imm8 or cl as the source
+ */
+std::vector<uint8_t> Encode(Operation Op, OperandForm Form, CountForm Counts, uint8_t Count) {
+  std::vector<uint8_t> Inst;
+  if (Form.Size == 2)
+    Inst.push_back(0x66);
+  else if (Form.Size == 8)
+    Inst.push_back(0x48);
+
+  // The byte forms are the opcode below the 16/32/64bit ones
+  auto Opcode = [&](uint8_t Op) { Inst.push_back(Form.Size == 1 ? Op - 1 : Op); };
+  auto ModRM = [&](uint8_t Reg) { Inst.push_back(0xC0 | (Reg << 3) | (Form.HighByte ? 4 : 0)); };
+  const uint8_t SrcReg = Form.HighByte ? 7 : 3;
+
+  switch (Op) {
+  case TEST: Opcode(0x85); ModRM(SrcReg); break;
+  case INC: Opcode(0xFF); ModRM(0); break;
+  case DEC: Opcode(0xFF); ModRM(1); break;
+  case NOT: Opcode(0xF7); ModRM(2); break;
+  case NEG: Opcode(0xF7); ModRM(3); break;
+  default:
+    if (!IsShift(Op)) {
+      Opcode(Op * 8 + 1);
+      ModRM(SrcReg);
+      break;
+    }
+    Opcode(Counts == COUNT_IMM8 ? 0xC1 : Counts == COUNT_ONE ? 0xD1 : 0xD3);
+    ModRM(Op - ROL);
+    if (Counts == COUNT_IMM8)
+      Inst.push_back(Count);
+    break;
+  }
+  return Inst;
+}
+
+// Zero, one, the AF and signed overflow edges, all ones and a pattern with a bit of everything
+std::vector<uint64_t> Values(uint8_t Size) {
+  uint64_t Mask = Size == 8 ? ~0ULL : (1ULL << (Size * 8)) - 1;
+  uint64_t SignBit = 1ULL << (Size * 8 - 1);
+  return {0, 1, 0xF, SignBit - 1, SignBit, SignBit + 1, Mask, 0x9E37'79B9'7F4A'7C15ULL & Mask};
+}
+
+// 0, 1 and width - 1, then the counts that only mean something once they're masked
+std::vector<uint64_t> Counts(uint8_t Size) {
+  uint64_t Bits = Size * 8;
+  uint64_t CountMask = Size == 8 ? 63 : 31;
+  return {0, 1, Bits - 1, Bits, Bits + 1, CountMask, CountMask + 1};
+}
+
+class ALUTest final {
+public:
+  void Run() {
+    for (auto Op : Operations) {
+      for (auto Form : OperandForms) {
+        for (uint64_t Dest : Values(Form.Size)) {
+          if (IsUnary(Op)) {
+            RunCase(Op, Form, COUNT_IMM8, Dest, 0);
+          }
+          else if (IsShift(Op)) {
+            for (uint64_t Count : Counts(Form.Size)) {
+              RunCase(Op, Form, COUNT_IMM8, Dest, Count);
+              RunCase(Op, Form, COUNT_CL, Dest, Count);
+              if (Count == 1)
+                RunCase(Op, Form, COUNT_ONE, Dest, Count);
+            }
+          }
+          else {
+            for (uint64_t Src : Values(Form.Size))
+              RunCase(Op, Form, COUNT_IMM8, Dest, Src);
+          }
+        }
+      }
+    }
+  }
+
+  size_t GetTotal() const { return Total; }
+  size_t GetFailures() const { return Failures; }
+
+private:
+  TestGuest Guest;
+  size_t Total{};
+  size_t Failures{};
+
+  // Places Value where the operand form reads it from, with the pattern around it
+  static uint64_t PlaceOperand(OperandForm Form, uint64_t Value) {
+    if (Form.HighByte)
+      return (UPPER_PATTERN & ~0xFF00ULL) | (Value << 8);
+    uint64_t Mask = Form.Size == 8 ? ~0ULL : (1ULL << (Form.Size * 8)) - 1;
+    return (UPPER_PATTERN & ~Mask) | Value;
+  }
+
+  // What the destination register holds after writing Value, 32bit writes zero the upper half
+  static uint64_t WriteOperand(OperandForm Form, uint64_t Reg, uint64_t Value) {
+    if (Form.HighByte)
+      return (Reg & ~0xFF00ULL) | (Value << 8);
+    if (Form.Size >= 4)
+      return Value;
+    uint64_t Mask = (1ULL << (Form.Size * 8)) - 1;
+    return (Reg & ~Mask) | Value;
+  }
+
+  void RunCase(Operation Op, OperandForm Form, CountForm Counts, uint64_t Dest, uint64_t Src) {
+    auto Inst = Encode(Op, Form, Counts, Src);
+
+    // The carry goes in both ways, with the other flags following it so the untouched ones get checked too
+    for (uint64_t RFLAGS : {0x2ULL, 0x2ULL | Flags::ARITH_FLAGS_MASK}) {
+      ++Total;
+      char Name[128];
+      snprintf(Name, sizeof(Name), "%s%s size %d 0x%lx, 0x%lx%s, rflags 0x%lx", OperationNames[Op], Form.HighByte ? " ah" : "",
+        Form.Size, Dest, Src, Counts == COUNT_CL ? " in cl" : Counts == COUNT_ONE ? " by one" : "", RFLAGS);
+
+      Emu::IR::IntrusiveIRList IR(1 << 16);
+      if (!Guest.BuildBlock(BLOCK_RIP, {Inst}, &IR)) {
+        ++Failures;
+        printf("FAIL: %s: couldn't translate the instruction\n", Name);
+        continue;
+      }
+      Guest.Optimize(&IR);
+
+      X86State Initial{};
+      Initial.rip = BLOCK_RIP;
+      Initial.rflags = RFLAGS;
+      Initial.gregs[REG_RAX] = PlaceOperand(Form, Dest);
+      Initial.gregs[REG_RBX] = PlaceOperand(Form, IsShift(Op) ? 0 : Src);
+      Initial.gregs[REG_RCX] = (UPPER_PATTERN & ~0xFFULL) | (Src & 0xFF);
+
+      auto Expected = Reference(Op, Form.Size, Dest, Src, RFLAGS);
+      X86State ExpectedState = Initial;
+      ExpectedState.rip = BLOCK_RIP + Inst.size();
+      if (Expected.WritesResult)
+        ExpectedState.gregs[REG_RAX] = WriteOperand(Form, Initial.gregs[REG_RAX], Expected.Result);
+
+      for (auto &Backend : Guest.GetBackends()) {
+        Guest.State() = Initial;
+        if (!Guest.Run(Backend.get(), &IR)) {
+          ++Failures;
+          printf("FAIL: %s: %s couldn't compile the block\n", Name, Backend->GetName().c_str());
+          continue;
+        }
+
+        auto &State = Guest.State();
+        uint64_t FlagsDifference = (Flags::CalculateRFLAGS(&State) ^ Expected.RFLAGS) & Expected.Defined;
+        if (State.rip == ExpectedState.rip &&
+            memcmp(State.gregs, ExpectedState.gregs, sizeof(State.gregs)) == 0 &&
+            FlagsDifference == 0)
+          continue;
+
+        ++Failures;
+        printf("FAIL: %s: %s gave rax 0x%lx rflags 0x%lx, expected rax 0x%lx rflags 0x%lx with 0x%lx defined\n", Name, Backend->GetName().c_str(),
+          State.gregs[REG_RAX], Flags::CalculateRFLAGS(&State) & Flags::ARITH_FLAGS_MASK,
+          ExpectedState.gregs[REG_RAX], Expected.RFLAGS & Flags::ARITH_FLAGS_MASK, Expected.Defined);
+      }
+    }
+  }
+};
+}
+
+int main() {
+  ALUTest Test;
+  Test.Run();
+
+  printf("%zd cases, %zd failures\n", Test.GetTotal(), Test.GetFailures());
+  return Test.GetFailures() != 0;
+}
@@ -0,0 +1,346 @@
+// Runs random IR blocks on the interpreter and on the host's native backend and compares the guest state and memory
+// Usage: BackendDifferentialTest [blocks] [seed]
+#include "Core/CPU/Flags.h"
+#include "TestGuest.h"
+
+#include <array>
+#include <cstring>
+#include <random>
+
+using namespace Emu;
+using namespace Emu::IR;
+
+namespace {
+// Guest memory the blocks can touch, addresses get masked in to it
+constexpr uint64_t MEMORY_WINDOW = 0x10000;
+
+class BlockGenerator final {
+public:
+  explicit BlockGenerator(uint64_t Seed) : RNG {Seed} {}
+
+  uint64_t Rand(uint64_t Range) { return RNG() % Range; }
+  uint64_t Rand() { return RNG(); }
+
+  // Small values, 32bit values, anything and small negatives, those are where the edge cases are
+  uint64_t Value() {
+    switch (Rand(4)) {
+    case 0: return Rand(64);
+    case 1: return RNG() & 0xFFFF'FFFF;
+    case 2: return RNG();
+    default: return -static_cast<int64_t>(Rand(5));
+    }
+  }
+
+  uint8_t AccessSize() { return std::array<uint8_t, 4>{1, 2, 4, 8}[Rand(4)]; }
+  uint32_t GPROffset() { return offsetof(X86State, gregs) + Rand(16) * 8; }
+
+  IntrusiveIRList Generate();
+
+private:
+  std::mt19937_64 RNG;
+  IntrusiveIRList *IR;
+  std::vector<AlignmentType> Values;
+
+  AlignmentType Pick() { return Values[Rand(Values.size())]; }
+
+  AlignmentType Constant(uint64_t Value) {
+    auto Op = IR->AllocateOp<IROp_Constant, OP_CONSTANT>();
+    Op.first->Constant = Value;
+    Values.emplace_back(Op.second);
+    return Op.second;
+  }
+
+  AlignmentType BiOp(IROps Op, AlignmentType Src1, AlignmentType Src2) {
+    auto Res = IR->AllocateOp<IROp_BiOp, OP_ADD>();
+    Res.first->Header.Op = Op;
+    Res.first->Args[0] = Src1;
+    Res.first->Args[1] = Src2;
+    Values.emplace_back(Res.second);
+    return Res.second;
+  }
+
+  void StoreContext(uint32_t Offset, uint8_t Size, AlignmentType Value) {
+    auto Op = IR->AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
+    Op.first->Size = Size;
+    Op.first->Offset = Offset;
+    Op.first->Arg = Value;
+  }
+
+  // Keeps guest addresses inside of the window with room for an index and an 8 byte access
+  AlignmentType Address() {
+    return BiOp(OP_AND, Pick(), Constant(MEMORY_WINDOW - 0x10));
+  }
+
+  void EmitALU();
+  void EmitMemory();
+  void EmitFlags();
+  void EmitSideExit();
+};
+
+void BlockGenerator::EmitALU() {
+  static constexpr std::array<IROps, 16> Ops = {
+    OP_ADD, OP_SUB, OP_OR, OP_XOR, OP_AND, OP_NAND, OP_SHL, OP_SHR,
+    OP_BITEXTRACT, OP_MUL, OP_UMULH, OP_SMULH, OP_UDIV, OP_SDIV, OP_UREM, OP_SREM,
+  };
+
+  // The dispatcher only hands 128bit divides a high half below the divisor
+  if (Rand(8) == 0) {
+    AlignmentType Divisor = BiOp(OP_OR, Pick(), Constant(1));
+    AlignmentType High = BiOp(OP_UREM, Pick(), Divisor);
+    auto Res = IR->AllocateOp<IROp_TriOp, OP_LUDIV>();
+    if (Rand(2))
+      Res.first->Header.Op = OP_LUREM;
+    Res.first->Args[0] = Pick();
+    Res.first->Args[1] = High;
+    Res.first->Args[2] = Divisor;
+    Values.emplace_back(Res.second);
+    return;
+  }
+
+  IROps Op = Ops[Rand(Ops.size())];
+  AlignmentType Src1 = Pick();
+  AlignmentType Src2 = Pick();
+  switch (Op) {
+  case OP_SHL:
+  case OP_SHR:
+  case OP_BITEXTRACT:
+    Src2 = Constant(Rand(64));
+  break;
+  case OP_UDIV:
+  case OP_SDIV:
+  case OP_UREM:
+  case OP_SREM:
+    // The dispatcher guards these against zero and INT_MIN / -1, keep the divisor odd and positive
+    Src2 = BiOp(OP_OR, BiOp(OP_AND, Src2, Constant(Rand(2) ? 0x7FFF'FFFF'FFFF'FFFFULL : 0xFFFF)), Constant(1));
+  break;
+  default:
+  break;
+  }
+  BiOp(Op, Src1, Src2);
+}
+
+void BlockGenerator::EmitMemory() {
+  AlignmentType Base = Address();
+  AlignmentType Index = ~0U;
+  if (Rand(2))
+    Index = Constant(Rand(8));
+
+  if (Rand(2)) {
+    auto Op = IR->AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
+    Op.first->Size = AccessSize();
+    Op.first->SignExtend = Rand(2);
+    Op.first->Arg[0] = Base;
+    Op.first->Arg[1] = Index;
+    Values.emplace_back(Op.second);
+  }
+  else {
+    auto Op = IR->AllocateOp<IROp_StoreMem, OP_STORE_MEM>();
+    Op.first->Size = AccessSize();
+    Op.first->Arg[0] = Pick();
+    Op.first->Arg[1] = Base;
+    Op.first->Arg[2] = Index;
+  }
+}
+
+void BlockGenerator::EmitFlags() {
+  // Sets up deferred flags the way the dispatcher does, then reads one back
+  StoreContext(offsetof(X86State, flags_op), 8, Constant(Flags::DEFERRED_ADD + Rand(3)));
+  StoreContext(offsetof(X86State, flags_size), 8, Constant(AccessSize()));
+  StoreContext(offsetof(X86State, flags_src1), 8, Pick());
+  StoreContext(offsetof(X86State, flags_src2), 8, Pick());
+  StoreContext(offsetof(X86State, flags_res), 8, Pick());
+
+  static constexpr std::array<uint8_t, 6> Bits = {
+    Flags::FLAG_CF_LOC, Flags::FLAG_PF_LOC, Flags::FLAG_AF_LOC,
+    Flags::FLAG_ZF_LOC, Flags::FLAG_SF_LOC, Flags::FLAG_OF_LOC,
+  };
+  auto Op = IR->AllocateOp<IROp_GetFlag, OP_GET_FLAG>();
+  Op.first->Bit = Bits[Rand(Bits.size())];
+  Values.emplace_back(Op.second);
+
+  if (Rand(3) == 0)
+    IR->AllocateOp<IROp_MaterializeFlags, OP_MATERIALIZE_FLAGS>();
+}
+
+void BlockGenerator::EmitSideExit() {
+  // Jumps over an exit path when the condition holds, like the op dispatcher's guards
+  auto Jump = IR->AllocateOp<IROp_CondJump, OP_COND_JUMP>();
+  Jump.first->Cond = static_cast<IROp_Select::ComparisonOp>(Rand(IROp_Select::COMP_UGE + 1));
+  Jump.first->Args[0] = Pick();
+  Jump.first->Args[1] = Pick();
+  Jump.first->RIPTarget = ~0ULL;
+  AlignmentType JumpOffset = Jump.second;
+
+  // Values defined on the exit path don't exist past it
+  StoreContext(GPROffset(), 8, Pick());
+  StoreContext(offsetof(X86State, rip), 8, Constant(0x1234));
+  Values.pop_back();
+  IR->AllocateOp<IROp_EndBlock, OP_ENDBLOCK>().first->RIPIncrement = 0;
+
+  auto Target = IR->AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
+  IR->GetOpAs<IROp_CondJump>(JumpOffset)->Target = Target.second;
+}
+
+IntrusiveIRList BlockGenerator::Generate() {
+  IntrusiveIRList List(1 << 16);
+  IR = &List;
+  Values.clear();
+
+  IR->AllocateOp<IROp_BeginBlock, OP_BEGINBLOCK>();
+  Constant(Value());
+  Constant(Value());
+
+  bool HasSideExit = false;
+  for (uint64_t i = 0, NumOps = 5 + Rand(60); i < NumOps; ++i) {
+    switch (Rand(20)) {
+    case 0:
+      Constant(Value());
+    break;
+    case 1:
+    case 2: {
+      // Full width loads can come from pinned state, partial ones have to see it written back
+      auto Op = IR->AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
+      Op.first->Size = Rand(2) ? 8 : AccessSize();
+      Op.first->Offset = GPROffset();
+      Values.emplace_back(Op.second);
+    break;
+    }
+    case 3:
+      StoreContext(GPROffset(), AccessSize(), Pick());
+    break;
+    case 4: case 5: case 6: case 7: case 8: case 9: case 10:
+      EmitALU();
+    break;
+    case 11: {
+      auto Op = IR->AllocateOp<IROp_Trunc_32, OP_TRUNC_32>();
+      if (Rand(2))
+        Op.first->Header.Op = OP_TRUNC_16;
+      Op.first->Arg = Pick();
+      Values.emplace_back(Op.second);
+    break;
+    }
+    case 12: {
+      auto Op = IR->AllocateOp<IROp_Select, OP_SELECT>();
+      Op.first->Op = static_cast<IROp_Select::ComparisonOp>(Rand(IROp_Select::COMP_UGE + 1));
+      for (auto &Arg : Op.first->Args)
+        Arg = Pick();
+      // Equal operands are where signed and unsigned comparisons get their edges wrong
+      if (Rand(2))
+        Op.first->Args[1] = Op.first->Args[0];
+      Values.emplace_back(Op.second);
+    break;
+    }
+    case 13:
+    case 14:
+      EmitMemory();
+    break;
+    case 15:
+      EmitFlags();
+    break;
+    case 16:
+      if (!HasSideExit) {
+        EmitSideExit();
+        HasSideExit = true;
+      }
+    break;
+    default:
+      StoreContext(Rand(2) ? GPROffset() : offsetof(X86State, flags_src1) + Rand(3) * 8, 8, Pick());
+    break;
+    }
+  }
+
+  // Make the values observable
+  for (size_t i = 0, NumValues = Values.size(); i < NumValues; ++i) {
+    if (Rand(3) == 0)
+      StoreContext(GPROffset(), 8, Values[i]);
+  }
+  IR->AllocateOp<IROp_EndBlock, OP_ENDBLOCK>().first->RIPIncrement = Rand(16);
+  return List;
+}
+
+X86State RandomState(BlockGenerator &Gen) {
+  X86State State{};
+  State.rip = 0x1000;
+  for (auto &Reg : State.gregs)
+    Reg = Gen.Value();
+  State.rflags = Gen.Rand() | 2;
+  State.flags_op = Gen.Rand(Flags::DEFERRED_LOGIC + 1);
+  State.flags_size = Gen.AccessSize();
+  State.flags_src1 = Gen.Rand();
+  State.flags_src2 = Gen.Rand();
+  State.flags_res = Gen.Rand();
+  return State;
+}
+
+void PrintStateDifference(X86State const &Expected, X86State const &Got) {
+  if (Expected.rip != Got.rip)
+    printf("  rip: expected 0x%zx got 0x%zx\n", Expected.rip, Got.rip);
+  for (size_t i = 0; i < 16; ++i) {
+    if (Expected.gregs[i] != Got.gregs[i])
+      printf("  gregs[%zd]: expected 0x%zx got 0x%zx\n", i, Expected.gregs[i], Got.gregs[i]);
+  }
+  if (Expected.rflags != Got.rflags)
+    printf("  rflags: expected 0x%zx got 0x%zx\n", Expected.rflags, Got.rflags);
+}
+}
+
+int main(int argc, char **argv) {
+  uint64_t NumBlocks = argc > 1 ? std::stoull(argv[1]) : 2000;
+  uint64_t Seed = argc > 2 ? std::stoull(argv[2]) : 1234;
+
+  TestGuest Guest;
+  auto &Backends = Guest.GetBackends();
+  if (Backends.size() < 2) {
+    printf("No native backend for this host, nothing to compare against\n");
+    return 0;
+  }
+
+  BlockGenerator Gen(Seed);
+  std::vector<uint8_t> InitialMemory(MEMORY_WINDOW);
+  std::vector<uint8_t> ExpectedMemory(MEMORY_WINDOW);
+
+  size_t Failures = 0;
+  for (uint64_t Block = 0; Block < NumBlocks; ++Block) {
+    IntrusiveIRList IR = Gen.Generate();
+    // Every other block goes through the optimization passes so both forms of IR get covered
+    if (Block & 1)
+      Guest.Optimize(&IR);
+
+    X86State Initial = RandomState(Gen);
+    for (auto &Byte : InitialMemory)
+      Byte = Gen.Rand();
+
+    X86State Expected{};
+    for (auto &Backend : Backends) {
+      Guest.State() = Initial;
+      memcpy(Guest.Memory(), InitialMemory.data(), MEMORY_WINDOW);
+      if (!Guest.Run(Backend.get(), &IR)) {
+        printf("FAIL: block %zd: %s couldn't compile it\n", Block, Backend->GetName().c_str());
+        IR.Dump();
+        ++Failures;
+        break;
+      }
+
+      if (&Backend == &Backends.front()) {
+        Expected = Guest.State();
+        memcpy(ExpectedMemory.data(), Guest.Memory(), MEMORY_WINDOW);
+        continue;
+      }
+
+      bool StateMatches = memcmp(&Expected, &Guest.State(), sizeof(X86State)) == 0;
+      bool MemoryMatches = memcmp(ExpectedMemory.data(), Guest.Memory(), MEMORY_WINDOW) == 0;
+      if (StateMatches && MemoryMatches)
+        continue;
+
+      ++Failures;
+      printf("FAIL: block %zd: %s disagrees with %s\n", Block, Backend->GetName().c_str(), Backends.front()->GetName().c_str());
+      PrintStateDifference(Expected, Guest.State());
+      if (!MemoryMatches)
+        printf("  guest memory differs\n");
+      IR.Dump();
+    }
+  }
+
+  printf("%zd/%zd blocks match\n", NumBlocks - Failures, NumBlocks);
+  return Failures != 0;
+}
@@ -0,0 +1,310 @@
+// Checks SETcc, CMOVcc and Jcc for all 16 condition codes on every backend
+// The expected outcome is the condition evaluated on Flags::CalculateRFLAGS of the state the consumer starts from
+// With the producer in the same block that covers the fused compares and the inline flag calculation
+#include "Core/CPU/Flags.h"
+#include "TestGuest.h"
+
+#include <array>
+#include <cstring>
+
+using namespace Emu;
+
+namespace {
+constexpr uint64_t BLOCK_RIP = 0x1000;
+
+// The arithmetic flags in the order the RFLAGS combinations get built from
+constexpr std::array<uint32_t, 6> FlagLocations = {
+  Flags::FLAG_CF_LOC, Flags::FLAG_PF_LOC, Flags::FLAG_AF_LOC,
+  Flags::FLAG_ZF_LOC, Flags::FLAG_SF_LOC, Flags::FLAG_OF_LOC,
+};
+
+// The condition code table from the SDM, odd codes are the inverse of the one below them
+bool ConditionHolds(uint32_t CC, uint64_t RFLAGS) {
+  bool CF = (RFLAGS >> Flags::FLAG_CF_LOC) & 1;
+  bool PF = (RFLAGS >> Flags::FLAG_PF_LOC) & 1;
+  bool ZF = (RFLAGS >> Flags::FLAG_ZF_LOC) & 1;
+  bool SF = (RFLAGS >> Flags::FLAG_SF_LOC) & 1;
+  bool OF = (RFLAGS >> Flags::FLAG_OF_LOC) & 1;
+
+  bool Result;
+  switch (CC >> 1) {
+  case 0: Result = OF; break;              // O
+  case 1: Result = CF; break;              // B
+  case 2: Result = ZF; break;              // Z
+  case 3: Result = CF || ZF; break;        // BE
+  case 4: Result = SF; break;              // S
+  case 5: Result = PF; break;              // P
+  case 6: Result = SF != OF; break;        // L
+  default: Result = ZF || SF != OF; break; // LE
+  }
+  return (CC & 1) ? !Result : Result;
+}
+
+enum ConsumerKind {
+  SETCC,     // setcc dl
+  CMOVCC,    // cmovcc rdx, rsi
+  JCC_REL8,  // jcc +0x10
+  JCC_REL32, // jcc +0x100
+};
+constexpr std::array<const char*, 4> ConsumerNames = {"setcc", "cmovcc", "jcc rel8", "jcc rel32"};
+
+std::vector<uint8_t> EncodeConsumer(ConsumerKind Kind, uint32_t CC) {
+  switch (Kind) {
+  case SETCC: return {0x0F, static_cast<uint8_t>(0x90 + CC), 0xC2};
+  case CMOVCC: return {0x48, 0x0F, static_cast<uint8_t>(0x40 + CC), 0xD6};
+  case JCC_REL8: return {static_cast<uint8_t>(0x70 + CC), 0x10};
+  default: return {0x0F, static_cast<uint8_t>(0x80 + CC), 0x00, 0x01, 0x00, 0x00};
+  }
+}
+
+// Flag producers, all of them work on rax with rbx or an imm8 from rbx's low byte
+struct Producer {
+  const char *Name;
+  uint8_t Opcode; ///< The 16/32/64bit form, the 8bit form is the opcode below it
+  uint8_t ModRM;  ///< rm is rax, reg is rbx or the group's op
+  bool Imm8;      ///< Shifts and rotates take their count as an imm8
+  bool Unary;
+};
+
+constexpr std::array<Producer, 17> Producers = {{
+  {"add",  0x01, 0xD8, false, false},
+  {"or",   0x09, 0xD8, false, false},
+  {"adc",  0x11, 0xD8, false, false},
+  {"sbb",  0x19, 0xD8, false, false},
+  {"and",  0x21, 0xD8, false, false},
+  {"sub",  0x29, 0xD8, false, false},
+  {"xor",  0x31, 0xD8, false, false},
+  {"cmp",  0x39, 0xD8, false, false},
+  {"test", 0x85, 0xD8, false, false},
+  {"inc",  0xFF, 0xC0, false, true},
+  {"dec",  0xFF, 0xC8, false, true},
+  {"neg",  0xF7, 0xD8, false, true},
+  {"rol",  0xC1, 0xC0, true,  false},
+  {"rcr",  0xC1, 0xD8, true,  false},
+  {"shl",  0xC1, 0xE0, true,  false},
+  {"shr",  0xC1, 0xE8, true,  false},
+  {"sar",  0xC1, 0xF8, true,  false},
+}};
+
+std::vector<uint8_t> EncodeProducer(Producer const &Op, uint8_t Size, uint64_t Src) {
+  std::vector<uint8_t> Inst;
+  if (Size == 2)
+    Inst.push_back(0x66);
+  else if (Size == 8)
+    Inst.push_back(0x48);
+  Inst.push_back(Size == 1 ? Op.Opcode - 1 : Op.Opcode);
+  Inst.push_back(Op.ModRM);
+  if (Op.Imm8)
+    Inst.push_back(Src);
+  return Inst;
+}
+
+// Zero, one and the signed overflow edges, shifts get counts of 0, 1 and width - 1 instead
+std::vector<uint64_t> Operands(uint8_t Size) {
+  uint64_t Mask = Size == 8 ? ~0ULL : (1ULL << (Size * 8)) - 1;
+  uint64_t SignBit = 1ULL << (Size * 8 - 1);
+  return {0, 1, SignBit - 1, SignBit, Mask};
+}
+
+std::vector<uint64_t> Counts(uint8_t Size) {
+  return {0, 1, Size * 8ULL - 1};
+}
+
+class ConditionTest final {
+public:
+  /**
+   * @brief Runs every consumer for every condition code after the flags in Before
+   *
+   * @param Producer The instruction that goes in front of the consumer, empty if the flags come from Before
+   * @param Before The state the block starts from
+   * @param Produced The state after Producer, what the consumer has to see
+   */
+  void RunConsumers(std::string const &Name, std::vector<uint8_t> const &Producer, X86State const &Before, X86State const &Produced) {
+    for (uint32_t CC = 0; CC < 16; ++CC) {
+      for (auto Kind : {SETCC, CMOVCC, JCC_REL8, JCC_REL32}) {
+        std::vector<std::vector<uint8_t>> Instructions;
+        if (!Producer.empty())
+          Instructions.emplace_back(Producer);
+        Instructions.emplace_back(EncodeConsumer(Kind, CC));
+
+        uint64_t BlockEnd = BLOCK_RIP;
+        for (auto const &Inst : Instructions)
+          BlockEnd += Inst.size();
+
+        Emu::IR::IntrusiveIRList IR(1 << 16);
+        ++Total;
+        if (!Guest.BuildBlock(BLOCK_RIP, Instructions, &IR)) {
+          Fail(Name, Kind, CC, "couldn't translate the block");
+          continue;
+        }
+        Guest.Optimize(&IR);
+
+        for (auto &Backend : Guest.GetBackends()) {
+          Guest.State() = Before;
+          if (!Guest.Run(Backend.get(), &IR)) {
+            Fail(Name, Kind, CC, Backend->GetName() + " couldn't compile the block");
+            continue;
+          }
+          Check(Name, Kind, CC, Backend->GetName(), Produced, Guest.State(), BlockEnd);
+        }
+      }
+    }
+  }
+
+  // Flags straight from RFLAGS, every combination of the arithmetic flags
+  void TestRFLAGS() {
+    for (uint32_t Combination = 0; Combination < (1U << FlagLocations.size()); ++Combination) {
+      X86State State = InitialState(0, 0);
+      for (size_t i = 0; i < FlagLocations.size(); ++i)
+        State.rflags |= static_cast<uint64_t>((Combination >> i) & 1) << FlagLocations[i];
+
+      char Name[32];
+      snprintf(Name, sizeof(Name), "rflags 0x%03lx", State.rflags);
+      RunConsumers(Name, {}, State, State);
+    }
+  }
+
+  /**
+   * @brief Flags left deferred by a producer in the previous block
+   *
+   * The consumer has to calculate them from the flags state instead of seeing the producer
+   */
+  void TestPreviousBlock() {
+    ForEachProducer([this](std::string const &Name, std::vector<uint8_t> const &Producer, X86State const &Initial) {
+      X86State Produced;
+      if (!RunProducer(Name, Producer, Initial, &Produced))
+        return;
+      RunConsumers(Name + " in the previous block", {}, Produced, Produced);
+    });
+  }
+
+  /**
+   * @brief The producer and the consumer in one block
+   *
+   * The consumer gets fused with the producer's compare or calculates the flag bits it needs inline
+   */
+  void TestSameBlock() {
+    ForEachProducer([this](std::string const &Name, std::vector<uint8_t> const &Producer, X86State const &Initial) {
+      X86State Produced;
+      if (!RunProducer(Name, Producer, Initial, &Produced))
+        return;
+      RunConsumers(Name, Producer, Initial, Produced);
+    });
+  }
+
+  size_t GetTotal() const { return Total; }
+  size_t GetFailures() const { return Failures; }
+
+private:
+  TestGuest Guest;
+  size_t Total{};
+  size_t Failures{};
+
+  X86State InitialState(uint64_t Dest, uint64_t Src) {
+    X86State State{};
+    State.rip = BLOCK_RIP;
+    State.rflags = 2;
+    State.gregs[REG_RAX] = Dest;
+    State.gregs[REG_RBX] = Src;
+    State.gregs[REG_RDX] = 0x3333'3333'3333'3333ULL;
+    State.gregs[REG_RSI] = 0x4444'4444'4444'4444ULL;
+    return State;
+  }
+
+  // Calls Func with every producer, size and operand pair, with the carry flag going in both ways
+  template<typename F>
+  void ForEachProducer(F Func) {
+    for (auto const &Op : Producers) {
+      for (uint8_t Size : {1, 2, 4, 8}) {
+        auto Dests = Operands(Size);
+        auto Srcs = Op.Imm8 ? Counts(Size) : Op.Unary ? std::vector<uint64_t>{0} : Operands(Size);
+        for (uint64_t Dest : Dests) {
+          for (uint64_t Src : Srcs) {
+            for (uint64_t CarryIn : {0, 1}) {
+              X86State Initial = InitialState(Dest, Src);
+              Initial.rflags |= CarryIn << Flags::FLAG_CF_LOC;
+
+              char Name[96];
+              snprintf(Name, sizeof(Name), "%s size %d 0x%lx, 0x%lx, cf %ld", Op.Name, Size, Dest, Src, CarryIn);
+              Func(Name, EncodeProducer(Op, Size, Src), Initial);
+            }
+          }
+        }
+      }
+    }
+  }
+
+  // Runs the producer on its own on the first backend, which gives the state the consumers get checked against
+  bool RunProducer(std::string const &Name, std::vector<uint8_t> const &Producer, X86State const &Initial, X86State *Produced) {
+    Emu::IR::IntrusiveIRList IR(1 << 16);
+    if (!Guest.BuildBlock(BLOCK_RIP, {Producer}, &IR)) {
+      ++Failures;
+      printf("FAIL: %s: couldn't translate the producer\n", Name.c_str());
+      return false;
+    }
+    Guest.Optimize(&IR);
+
+    Guest.State() = Initial;
+    if (!Guest.Run(Guest.GetBackends().front().get(), &IR)) {
+      ++Failures;
+      printf("FAIL: %s: couldn't compile the producer\n", Name.c_str());
+      return false;
+    }
+    *Produced = Guest.State();
+    Produced->rip = BLOCK_RIP;
+    return true;
+  }
+
+  void Fail(std::string const &Name, ConsumerKind Kind, uint32_t CC, std::string const &Message) {
+    ++Failures;
+    printf("FAIL: %s: %s cc 0x%x: %s\n", Name.c_str(), ConsumerNames[Kind], CC, Message.c_str());
+  }
+
+  void Check(std::string const &Name, ConsumerKind Kind, uint32_t CC, std::string const &Backend, X86State const &Produced, X86State const &After, uint64_t BlockEnd) {
+    uint64_t RFLAGS = Flags::CalculateRFLAGS(&Produced);
+    bool Holds = ConditionHolds(CC, RFLAGS);
+
+    X86State Expected = Produced;
+    Expected.rip = BlockEnd;
+    switch (Kind) {
+    case SETCC:
+      Expected.gregs[REG_RDX] = (Expected.gregs[REG_RDX] & ~0xFFULL) | Holds;
+      break;
+    case CMOVCC:
+      if (Holds)
+        Expected.gregs[REG_RDX] = Expected.gregs[REG_RSI];
+      break;
+    case JCC_REL8:
+      Expected.rip += Holds ? 0x10 : 0;
+      break;
+    case JCC_REL32:
+      Expected.rip += Holds ? 0x100 : 0;
+      break;
+    }
+
+    if (After.rip != Expected.rip)
+      Fail(Name, Kind, CC, Backend + " ended at rip 0x" + Hex(After.rip) + " instead of 0x" + Hex(Expected.rip));
+    if (memcmp(After.gregs, Expected.gregs, sizeof(After.gregs)) != 0)
+      Fail(Name, Kind, CC, Backend + " left rdx 0x" + Hex(After.gregs[REG_RDX]) + " instead of 0x" + Hex(Expected.gregs[REG_RDX]));
+    uint64_t FlagsAfter = Flags::CalculateRFLAGS(&After) & Flags::ARITH_FLAGS_MASK;
+    if (FlagsAfter != (RFLAGS & Flags::ARITH_FLAGS_MASK))
+      Fail(Name, Kind, CC, Backend + " changed rflags to 0x" + Hex(FlagsAfter) + " from 0x" + Hex(RFLAGS & Flags::ARITH_FLAGS_MASK));
+  }
+
+  static std::string Hex(uint64_t Value) {
+    char Str[17];
+    snprintf(Str, sizeof(Str), "%lx", Value);
+    return Str;
+  }
+};
+}
+
+int main() {
+  ConditionTest Test;
+  Test.TestRFLAGS();
+  Test.TestPreviousBlock();
+  Test.TestSameBlock();
+
+  printf("%zd blocks, %zd failures\n", Test.GetTotal(), Test.GetFailures());
+  return Test.GetFailures() != 0;
+}
@@ -0,0 +1,270 @@
+// Checks the one operand MUL, IMUL, DIV and IDIV on every backend, including the divides that #DE
+// The expected values come from 128bit host arithmetic on the whole double width operands
+#include "Core/CPU/Flags.h"
+#include "TestGuest.h"
+
+#include <array>
+#include <csignal>
+#include <cstring>
+
+// <csignal> brings the host's ucontext REG_* names along, so the guest's are spelled out with Emu::
+using namespace Emu;
+
+namespace {
+constexpr uint64_t BLOCK_RIP = 0x1000;
+// Fills the register bits outside of the operand so partial writes show up
+constexpr uint64_t UPPER_PATTERN = 0xA5A5'A5A5'A5A5'A5A5ULL;
+
+// The order matches the F6 and F7 group's ModRM reg field, starting from /4
+enum Operation {
+  MUL, IMUL, DIV, IDIV,
+};
+
+constexpr std::array<const char*, 4> OperationNames = {
+  "mul", "imul", "div", "idiv",
+};
+
+constexpr std::array<uint8_t, 4> Sizes = {1, 2, 4, 8};
+
+// inc rcx, so a #DE also has to leave the earlier instruction's results and flags behind
+const std::vector<uint8_t> INC_RCX = {0x48, 0xFF, 0xC1};
+
+struct Outcome {
+  bool Fault;
+  uint64_t Low;
+  uint64_t High;
+  bool Overflow; ///< CF and OF of a multiply
+};
+
+uint64_t SizeMask(uint8_t Size) {
+  return Size == 8 ? ~0ULL : (1ULL << (Size * 8)) - 1;
+}
+
+__int128 SignExtend(unsigned __int128 Value, uint32_t Bits) {
+  uint32_t Shift = 128 - Bits;
+  return static_cast<__int128>(Value << Shift) >> Shift;
+}
+
+// Low and High are the two operand sized halves of the result, AL and AH for byte operands
+Outcome Reference(Operation Op, uint8_t Size, uint64_t Low, uint64_t High, uint64_t Src) {
+  uint32_t Bits = Size * 8;
+  uint64_t Mask = SizeMask(Size);
+  Low &= Mask;
+  High &= Mask;
+  Src &= Mask;
+
+  Outcome Out{};
+  if (Op == MUL || Op == IMUL) {
+    unsigned __int128 Product;
+    if (Op == MUL)
+      Product = static_cast<unsigned __int128>(Low) * Src;
+    else
+      Product = SignExtend(Low, Bits) * SignExtend(Src, Bits);
+    Out.Low = static_cast<uint64_t>(Product) & Mask;
+    Out.High = static_cast<uint64_t>(Product >> Bits) & Mask;
+    Out.Overflow = Op == MUL ? Out.High != 0 : SignExtend(Product, Bits) != SignExtend(Product, Bits * 2);
+    return Out;
+  }
+
+  unsigned __int128 Dividend = (static_cast<unsigned __int128>(High) << Bits) | Low;
+  bool Signed = Op == IDIV;
+  bool DividendNegative = Signed && SignExtend(Dividend, Bits * 2) < 0;
+  bool DivisorNegative = Signed && SignExtend(Src, Bits) < 0;
+
+  // Magnitudes so INT_MIN / -1 doesn't overflow the host too
+  unsigned __int128 AbsDividend = DividendNegative ? -static_cast<unsigned __int128>(SignExtend(Dividend, Bits * 2)) : Dividend;
+  unsigned __int128 AbsDivisor = DivisorNegative ? -static_cast<unsigned __int128>(SignExtend(Src, Bits)) : Src;
+  if (AbsDivisor == 0) {
+    Out.Fault = true;
+    return Out;
+  }
+
+  unsigned __int128 Quotient = AbsDividend / AbsDivisor;
+  unsigned __int128 Remainder = AbsDividend % AbsDivisor;
+  bool Negative = DividendNegative != DivisorNegative;
+  unsigned __int128 Limit = Signed ? (static_cast<unsigned __int128>(1) << (Bits - 1)) - (Negative ? 0 : 1) : Mask;
+  if (Quotient > Limit) {
+    Out.Fault = true;
+    return Out;
+  }
+
+  Out.Low = static_cast<uint64_t>(Negative ? -Quotient : Quotient) & Mask;
+  Out.High = static_cast<uint64_t>(DividendNegative ? -Remainder : Remainder) & Mask;
+  return Out;
+}
+
+// F6 or F7 with ModRM.rm picking rbx
+std::vector<uint8_t> Encode(Operation Op, uint8_t Size) {
+  std::vector<uint8_t> Inst;
+  if (Size == 2)
+    Inst.emplace_back(0x66);
+  else if (Size == 8)
+    Inst.emplace_back(0x48);
+  Inst.emplace_back(Size == 1 ? 0xF6 : 0xF7);
+  Inst.emplace_back(0xC0 | ((4 + Op) << 3) | 3);
+  return Inst;
+}
+
+// What Reg holds after writing Value, 32bit writes zero the upper half
+uint64_t WriteOperand(uint8_t Size, uint64_t Reg, uint64_t Value) {
+  if (Size >= 4)
+    return Value;
+  return (Reg & ~SizeMask(Size)) | Value;
+}
+
+// Every interesting operand along with the cases that pick at the #DE checks
+std::vector<uint64_t> Values(uint8_t Size) {
+  uint64_t Mask = SizeMask(Size);
+  uint64_t Sign = 1ULL << (Size * 8 - 1);
+  return {0, 1, 2, 3, 7, Sign - 1, Sign, Sign + 1, Mask - 1, Mask, 0x1234'5678'9ABC'DEF0ULL & Mask};
+}
+
+class MulDivTest final {
+public:
+  void Run() {
+    for (auto Op : {MUL, IMUL, DIV, IDIV}) {
+      for (uint8_t Size : Sizes) {
+        for (uint64_t Low : Values(Size)) {
+          for (uint64_t Src : Values(Size)) {
+            // Only divides read the high half
+            if (Op == MUL || Op == IMUL) {
+              RunCase(Op, Size, Low, 0, Src);
+              continue;
+            }
+            for (uint64_t High : Values(Size))
+              RunCase(Op, Size, Low, High, Src);
+          }
+        }
+      }
+    }
+  }
+
+  size_t GetTotal() const { return Total; }
+  size_t GetFailures() const { return Failures; }
+
+private:
+  TestGuest Guest;
+  size_t Total{};
+  size_t Failures{};
+
+  bool Translate(std::vector<std::vector<uint8_t>> const &Instructions, Emu::IR::IntrusiveIRList *IR) {
+    if (!Guest.BuildBlock(BLOCK_RIP, Instructions, IR))
+      return false;
+    Guest.Optimize(IR);
+    return true;
+  }
+
+  void RunCase(Operation Op, uint8_t Size, uint64_t Low, uint64_t High, uint64_t Src) {
+    auto Inst = Encode(Op, Size);
+    auto Expected = Reference(Op, Size, Low, High, Src);
+
+    X86State Initial{};
+    Initial.rip = BLOCK_RIP;
+    Initial.rflags = 0x2;
+    Initial.gregs[Emu::REG_RBX] = (UPPER_PATTERN & ~SizeMask(Size)) | Src;
+    Initial.gregs[Emu::REG_RCX] = UPPER_PATTERN;
+    if (Size == 1) {
+      Initial.gregs[Emu::REG_RAX] = (UPPER_PATTERN & ~0xFFFFULL) | (High << 8) | Low;
+      Initial.gregs[Emu::REG_RDX] = UPPER_PATTERN;
+    }
+    else {
+      Initial.gregs[Emu::REG_RAX] = (UPPER_PATTERN & ~SizeMask(Size)) | Low;
+      Initial.gregs[Emu::REG_RDX] = (UPPER_PATTERN & ~SizeMask(Size)) | High;
+    }
+
+    // On its own and after another instruction in the same block
+    for (bool AfterInc : {false, true}) {
+      ++Total;
+      char Name[128];
+      snprintf(Name, sizeof(Name), "%s%s size %d 0x%lx:0x%lx, 0x%lx", AfterInc ? "inc rcx; " : "", OperationNames[Op], Size, High, Low, Src);
+
+      std::vector<std::vector<uint8_t>> Instructions;
+      if (AfterInc)
+        Instructions.emplace_back(INC_RCX);
+      Instructions.emplace_back(Inst);
+
+      Emu::IR::IntrusiveIRList IR(1 << 16);
+      if (!Translate(Instructions, &IR)) {
+        ++Failures;
+        printf("FAIL: %s: couldn't translate the instructions\n", Name);
+        continue;
+      }
+
+      // The state before the instruction, which is where a #DE leaves it
+      X86State Before = Initial;
+      if (AfterInc && !RunIncAlone(&Before)) {
+        ++Failures;
+        printf("FAIL: %s: couldn't run the inc on its own\n", Name);
+        continue;
+      }
+
+      X86State ExpectedState = Before;
+      if (!Expected.Fault) {
+        ExpectedState.rip = Before.rip + Inst.size();
+        if (Size == 1) {
+          ExpectedState.gregs[Emu::REG_RAX] = (Before.gregs[Emu::REG_RAX] & ~0xFFFFULL) | (Expected.High << 8) | Expected.Low;
+        }
+        else {
+          ExpectedState.gregs[Emu::REG_RAX] = WriteOperand(Size, Before.gregs[Emu::REG_RAX], Expected.Low);
+          ExpectedState.gregs[Emu::REG_RDX] = WriteOperand(Size, Before.gregs[Emu::REG_RDX], Expected.High);
+        }
+      }
+      int ExpectedSignal = Expected.Fault ? SIGFPE : 0;
+
+      for (auto &Backend : Guest.GetBackends()) {
+        Guest.State() = Initial;
+        Guest.PendingSignal() = 0;
+        if (!Guest.Run(Backend.get(), &IR)) {
+          ++Failures;
+          printf("FAIL: %s: %s couldn't compile the block\n", Name, Backend->GetName().c_str());
+          continue;
+        }
+
+        // Divides leave the flags undefined, a #DE leaves the ones from before it
+        auto &State = Guest.State();
+        uint64_t FlagsDifference = 0;
+        if (Expected.Fault) {
+          FlagsDifference = (Flags::CalculateRFLAGS(&State) ^ Flags::CalculateRFLAGS(&Before)) & Flags::ARITH_FLAGS_MASK;
+        }
+        else if (Op == MUL || Op == IMUL) {
+          uint64_t Overflow = Expected.Overflow ? (1ULL << Flags::FLAG_CF_LOC) | (1ULL << Flags::FLAG_OF_LOC) : 0;
+          FlagsDifference = (Flags::CalculateRFLAGS(&State) ^ Overflow) & ((1ULL << Flags::FLAG_CF_LOC) | (1ULL << Flags::FLAG_OF_LOC));
+        }
+
+        if (State.rip == ExpectedState.rip &&
+            memcmp(State.gregs, ExpectedState.gregs, sizeof(State.gregs)) == 0 &&
+            FlagsDifference == 0 &&
+            Guest.PendingSignal() == ExpectedSignal)
+          continue;
+
+        ++Failures;
+        printf("FAIL: %s: %s gave rip 0x%lx rax 0x%lx rdx 0x%lx signal %d, expected rip 0x%lx rax 0x%lx rdx 0x%lx signal %d, flags differ by 0x%lx\n",
+          Name, Backend->GetName().c_str(),
+          State.rip, State.gregs[Emu::REG_RAX], State.gregs[Emu::REG_RDX], Guest.PendingSignal(),
+          ExpectedState.rip, ExpectedState.gregs[Emu::REG_RAX], ExpectedState.gregs[Emu::REG_RDX], ExpectedSignal, FlagsDifference);
+      }
+    }
+  }
+
+  // Runs the inc through the interpreter and turns its state in to what the divide's block starts from
+  bool RunIncAlone(X86State *State) {
+    Emu::IR::IntrusiveIRList IR(1 << 16);
+    if (!Translate({INC_RCX}, &IR))
+      return false;
+
+    Guest.State() = *State;
+    if (!Guest.Run(Guest.GetBackends().front().get(), &IR))
+      return false;
+    *State = Guest.State();
+    return true;
+  }
+};
+}
+
+int main() {
+  MulDivTest Test;
+  Test.Run();
+
+  printf("%zd cases, %zd failures\n", Test.GetTotal(), Test.GetFailures());
+  return Test.GetFailures() != 0;
+}
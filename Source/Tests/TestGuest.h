@@ -0,0 +1,160 @@
+#pragma once
+#include "Core/CPU/CPUCore.h"
+#include "Core/CPU/CPUState.h"
+#include "Core/CPU/IR.h"
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/InterpreterBackend/Interpreter.h"
+#include "Core/CPU/Passes/Passes.h"
+#include "Core/CPU/X86Tables.h"
+#include "Core/Memmap.h"
+#include "LogManager.h"
+#if defined(__x86_64__)
+#include "Core/CPU/X86_64Backend/X86_64.h"
+#elif defined(__aarch64__)
+#include "Core/CPU/AArch64Backend/AArch64.h"
+#endif
+
+#include <cstdio>
+#include <functional>
+#include <memory>
+#include <vector>
+
+// A guest thread for the tests that compile and run blocks without going through ExecutionThread
+
+static void MsgHandler(LogMan::DebugLevels Level, std::string const &Message) {
+  const char *CharLevel{nullptr};
+
+  switch (Level) {
+  case LogMan::NONE:
+    CharLevel = "NONE";
+    break;
+  case LogMan::ASSERT:
+    CharLevel = "ASSERT";
+    break;
+  case LogMan::ERROR:
+    CharLevel = "ERROR";
+    break;
+  case LogMan::DEBUG:
+    CharLevel = "DEBUG";
+    break;
+  case LogMan::INFO:
+    CharLevel = "Info";
+    break;
+  default:
+    CharLevel = "???";
+    break;
+  }
+  printf("[%s] %s\n", CharLevel, Message.c_str());
+}
+
+static void AssertHandler(std::string const &Message) {
+  printf("[ASSERT] %s\n", Message.c_str());
+}
+
+/**
+ * @brief Guest memory, one guest thread and every backend that can run code on this host
+ *
+ * The thread becomes the calling thread's guest thread, so blocks run against State()
+ */
+class TestGuest final {
+public:
+  static constexpr size_t MEMORY_SIZE = 1024 * 1024;
+
+  TestGuest()
+    : CPU {&Mapper} {
+    LogMan::Throw::InstallHandler(AssertHandler);
+    LogMan::Msg::InstallHandler(MsgHandler);
+    LogMan::Throw::A(Mapper.AllocateSHMRegion(MEMORY_SIZE), "Couldn't allocate guest memory");
+
+    Thread = std::make_unique<Emu::CPUCore::ThreadState>(&CPU);
+    Emu::CPUCore::SetTLSThread(Thread.get());
+
+    Backends.emplace_back(Emu::CreateInterpreterBackend(&CPU));
+#if defined(__x86_64__)
+    Backends.emplace_back(Emu::CreateX86_64Backend(&CPU));
+#elif defined(__aarch64__)
+    Backends.emplace_back(Emu::CreateAArch64Backend(&CPU));
+#endif
+
+    // The same passes CPUCore runs on every block
+    Passes.AddPass(Emu::IR::CreateValueNumberingPass());
+    Passes.AddPass(Emu::IR::CreateKnownBitsPass());
+    Passes.AddPass(Emu::IR::CreateDeadCodeEliminationPass());
+  }
+
+  Emu::X86State &State() { return Thread->CPUState; }
+  // Left set by a block that raised a signal, cleared by whoever checks it
+  int &PendingSignal() { return Thread->PendingSignal; }
+  uint8_t *Memory() { return Mapper.GetBaseOffset<uint8_t*>(0); }
+
+  // The interpreter comes first, it is what every other backend gets compared against
+  std::vector<std::unique_ptr<Emu::CPUBackend>> const &GetBackends() const { return Backends; }
+
+  /**
+   * @brief Translates guest instructions in to one block the way CPUCore::CompileBlock does
+   *
+   * @return false if an instruction doesn't decode or the op dispatcher can't translate it
+   */
+  bool BuildBlock(uint64_t RIP, std::vector<std::vector<uint8_t>> const &Instructions, Emu::IR::IntrusiveIRList *IR) {
+    using namespace Emu;
+    auto &Dispatcher = Thread->OpDispatcher;
+    Dispatcher.ResetWorkingList();
+    Dispatcher.BeginBlock();
+
+    uint64_t Length = 0;
+    bool HitRIPSetter = false;
+    for (auto const &Inst : Instructions) {
+      // The decoder reads as far as the longest instruction could go
+      std::vector<uint8_t> Bytes {Inst};
+      Bytes.resize(X86Tables::MAX_INST_SIZE);
+
+      X86Tables::DecodedInst Decoded;
+      if (!X86Tables::DecodeInstruction(Bytes.data(), &Decoded) || Decoded.Size != Inst.size() || !Decoded.TableInfo->OpcodeDispatcher)
+        return false;
+
+      Thread->JITRIP = RIP + Length;
+      Dispatcher.AddRIPMarker(RIP + Length);
+      std::invoke(Decoded.TableInfo->OpcodeDispatcher, Dispatcher, &Decoded);
+      if (Dispatcher.HadDecodeFailure())
+        return false;
+
+      Length += Decoded.Size;
+      auto Flags = Decoded.TableInfo->Flags;
+      HitRIPSetter = (Flags & X86Tables::FLAGS_BLOCK_END) && (Flags & X86Tables::FLAGS_SETS_RIP);
+    }
+
+    Dispatcher.EndBlock(HitRIPSetter ? 0 : Length);
+    *IR = Dispatcher.GetWorkingIR();
+    Dispatcher.ResetWorkingList();
+    return true;
+  }
+
+  void Optimize(Emu::IR::IntrusiveIRList *IR) {
+    Passes.Run(IR);
+  }
+
+  /**
+   * @brief Compiles the block with Backend and runs it once against State()
+   */
+  bool Run(Emu::CPUBackend *Backend, Emu::IR::IntrusiveIRList const *IR) {
+    void *Block = Backend->CompileCode(IR);
+    if (!Block)
+      return false;
+
+    auto Runner = Backend->GetBlockRunner();
+    if (Runner)
+      Runner(&CPU, Block);
+    else
+      reinterpret_cast<void (*)(Emu::CPUCore*)>(Block)(&CPU);
+
+    Backend->FreeCode(Block);
+    return true;
+  }
+
+private:
+  Emu::Memmap Mapper;
+  Emu::CPUCore CPU;
+  std::unique_ptr<Emu::CPUCore::ThreadState> Thread;
+  std::vector<std::unique_ptr<Emu::CPUBackend>> Backends;
+  Emu::IR::BlockPassManager Passes;
+};
@@ -0,0 +1,146 @@
+#pragma once
+#include "Core/CPU/CPUState.h"
+#include "Core/CPU/Flags.h"
+#include "Core/CPU/IR.h"
+#include "Core/CPU/IntrusiveIRList.h"
+#include "LogManager.h"
+
+#include <array>
+#include <cstdio>
+
+// Blocks and state shared by the backend benchmarks
+
+static void MsgHandler(LogMan::DebugLevels Level, std::string const &Message) {
+  const char *CharLevel{nullptr};
+
+  switch (Level) {
+  case LogMan::NONE:
+    CharLevel = "NONE";
+    break;
+  case LogMan::ASSERT:
+    CharLevel = "ASSERT";
+    break;
+  case LogMan::ERROR:
+    CharLevel = "ERROR";
+    break;
+  case LogMan::DEBUG:
+    CharLevel = "DEBUG";
+    break;
+  case LogMan::INFO:
+    CharLevel = "Info";
+    break;
+  default:
+    CharLevel = "???";
+    break;
+  }
+  printf("[%s] %s\n", CharLevel, Message.c_str());
+}
+
+static void AssertHandler(std::string const &Message) {
+  printf("[ASSERT] %s\n", Message.c_str());
+}
+
+constexpr uint64_t BLOCK_RIP = 0x10000;
+constexpr size_t MEMORY_SIZE = 1024 * 1024;
+
+/**
+ * @brief Builds IR shaped like the op dispatcher's output for a run of guest ALU instructions
+ *
+ * Every instruction loads its sources from X86State, stores its result and sets up deferred flags.
+ * A load from guest memory and a conditional side exit on ZF sit in the middle.
+ */
+static Emu::IR::IntrusiveIRList BuildBlock(uint32_t NumInstructions, uint64_t RIP = BLOCK_RIP) {
+  using namespace Emu;
+  using namespace Emu::IR;
+  IntrusiveIRList ir(1 << 16);
+
+  auto LoadReg = [&ir](unsigned Reg) {
+    auto Load = ir.AllocateOp<IROp_LoadContext, OP_LOADCONTEXT>();
+    Load.first->Size = 8;
+    Load.first->Offset = offsetof(X86State, gregs) + Reg * 8;
+    return Load.second;
+  };
+  auto Store = [&ir](uint32_t Offset, AlignmentType Value) {
+    auto StoreOp = ir.AllocateOp<IROp_StoreContext, OP_STORECONTEXT>();
+    StoreOp.first->Size = 8;
+    StoreOp.first->Offset = Offset;
+    StoreOp.first->Arg = Value;
+  };
+  auto Constant = [&ir](uint64_t Value) {
+    auto ConstantOp = ir.AllocateOp<IROp_Constant, OP_CONSTANT>();
+    ConstantOp.first->Constant = Value;
+    return ConstantOp.second;
+  };
+
+  constexpr std::array<IROps, 4> ALUOps = {OP_ADD, OP_SUB, OP_XOR, OP_AND};
+
+  ir.AllocateOp<IROp_BeginBlock, OP_BEGINBLOCK>();
+  for (uint32_t i = 0; i < NumInstructions; ++i) {
+    auto RIPMarker = ir.AllocateOp<IROp_RIPMarker, OP_RIP_MARKER>();
+    RIPMarker.first->RIP = RIP + i * 3;
+
+    unsigned DestReg = i % 16;
+    auto Src1 = LoadReg(DestReg);
+    auto Src2 = LoadReg((i * 7 + 3) % 16);
+
+    if (i == NumInstructions / 2) {
+      // mov reg, [reg & mask]
+      auto Mask = Constant((MEMORY_SIZE - 1) & ~7ULL);
+      auto Addr = ir.AllocateOp<IROp_And, OP_AND>();
+      Addr.first->Args[0] = Src2;
+      Addr.first->Args[1] = Mask;
+      auto Load = ir.AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
+      Load.first->Size = 8;
+      Load.first->SignExtend = false;
+      Load.first->Arg[0] = Addr.second;
+      Load.first->Arg[1] = ~0U;
+      Store(offsetof(X86State, gregs) + DestReg * 8, Load.second);
+
+      // jz out of the block
+      auto ZF = ir.AllocateOp<IROp_GetFlag, OP_GET_FLAG>();
+      ZF.first->Bit = Flags::FLAG_ZF_LOC;
+      auto Jump = ir.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
+      Jump.first->Cond = IROp_Select::COMP_NEQ;
+      Jump.first->Args[0] = ZF.second;
+      Jump.first->Args[1] = Constant(0);
+      Jump.first->RIPTarget = 0;
+      auto ExitRIP = Constant(RIP);
+      Store(offsetof(X86State, rip), ExitRIP);
+      ir.AllocateOp<IROp_EndBlock, OP_ENDBLOCK>().first->RIPIncrement = 0;
+      auto Target = ir.AllocateOp<IROp_JmpTarget, OP_JUMP_TGT>();
+      ir.GetOpAs<IROp_CondJump>(Jump.second)->Target = Target.second;
+      continue;
+    }
+
+    IROps Op = ALUOps[i % ALUOps.size()];
+    auto Res = ir.AllocateOp<IROp_BiOp, OP_ADD>();
+    Res.first->Header.Op = Op;
+    Res.first->Args[0] = Src1;
+    Res.first->Args[1] = Src2;
+    Store(offsetof(X86State, gregs) + DestReg * 8, Res.second);
+
+    Flags::DeferredOp Deferred = Op == OP_ADD ? Flags::DEFERRED_ADD : Op == OP_SUB ? Flags::DEFERRED_SUB : Flags::DEFERRED_LOGIC;
+    auto DeferredConstant = Constant(Deferred);
+    Store(offsetof(X86State, flags_op), DeferredConstant);
+    auto SizeConstant = Constant(8);
+    Store(offsetof(X86State, flags_size), SizeConstant);
+    Store(offsetof(X86State, flags_src1), Src1);
+    Store(offsetof(X86State, flags_src2), Src2);
+    Store(offsetof(X86State, flags_res), Res.second);
+  }
+  ir.AllocateOp<IROp_EndBlock, OP_ENDBLOCK>().first->RIPIncrement = NumInstructions * 3;
+  return ir;
+}
+
+static Emu::X86State InitialState(uint64_t RIP = BLOCK_RIP) {
+  Emu::X86State State{};
+  State.rip = RIP;
+  for (unsigned i = 0; i < 16; ++i)
+    State.gregs[i] = 0x0123'4567'89AB'CDEFULL * (i + 1);
+  State.flags_op = Emu::Flags::DEFERRED_SUB;
+  State.flags_size = 8;
+  State.flags_src1 = 1;
+  State.flags_src2 = 2;
+  State.flags_res = ~0ULL;
+  return State;
+}
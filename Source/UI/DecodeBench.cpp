@@ -0,0 +1,98 @@
+#include "Core/CPU/X86Tables.h"
+#include "BenchBlocks.h"
+#include "LogManager.h"
+
+#include <chrono>
+#include <cstring>
+#include <vector>
+
+// Measures how fast the decoder gets through instruction streams
+// Usage: DecodeBench [iterations]
+
+namespace {
+struct Stream {
+  char const *Name;
+  std::vector<std::vector<uint8_t>> Instructions;
+};
+
+// What compiled code is mostly made of, and the same with the prefixes and addressing modes that cost the most to decode
+Stream const Streams[] = {
+  {"Simple", {
+    {0x48, 0x01, 0xd8},                         // add rax, rbx
+    {0x31, 0xc0},                               // xor eax, eax
+    {0x48, 0x89, 0xe5},                         // mov rbp, rsp
+    {0x48, 0x83, 0xc4, 0x08},                   // add rsp, 0x8
+    {0x75, 0xf0},                               // jnz -0x10
+    {0x50},                                     // push rax
+    {0x90},                                     // nop
+    {0xc3},                                     // ret
+  }},
+  {"Memory", {
+    {0x48, 0x8b, 0x05, 0x10, 0x00, 0x00, 0x00}, // mov rax, [rip+0x10]
+    {0x4a, 0x8d, 0x44, 0xa5, 0x08},             // lea rax, [rbp+r12*4+0x8]
+    {0x48, 0x8d, 0x97, 0x90, 0x01, 0x00, 0x00}, // lea rdx, [rdi+0x190]
+    {0x03, 0x04, 0x24},                         // add eax, [rsp]
+    {0x42, 0x8b, 0x04, 0x25, 0x00, 0x10, 0x00, 0x00}, // mov eax, [r12*1+0x1000]
+    {0x48, 0x01, 0x48, 0x08},                   // add [rax+0x8], rcx
+  }},
+  {"Prefixed", {
+    {0x66, 0x05, 0x34, 0x12},                   // add ax, 0x1234
+    {0x48, 0xb8, 1, 2, 3, 4, 5, 6, 7, 8},       // mov rax, imm64
+    {0xf0, 0x48, 0x01, 0x08},                   // lock add [rax], rcx
+    {0x64, 0x48, 0x8b, 0x04, 0x25, 0x28, 0x00, 0x00, 0x00}, // mov rax, fs:0x28
+    {0x66, 0x0f, 0xef, 0xc0},                   // pxor xmm0, xmm0
+    {0x0f, 0x05},                               // syscall
+  }},
+};
+
+constexpr size_t STREAM_SIZE = 1024 * 1024;
+}
+
+int main(int argc, char **argv) {
+  LogMan::Throw::InstallHandler(AssertHandler);
+  LogMan::Msg::InstallHandler(MsgHandler);
+
+  uint64_t Iterations = argc > 1 ? std::stoull(argv[1]) : 20;
+
+  printf("%-10s %12s %12s %12s\n", "Stream", "ns/inst", "MInst/s", "MB/s");
+  for (auto &Stream : Streams) {
+    // Repeat the stream until it is large enough that it doesn't all sit in L1
+    std::vector<uint8_t> Code;
+    size_t NumInstructions = 0;
+    while (Code.size() < STREAM_SIZE) {
+      for (auto &Inst : Stream.Instructions) {
+        Code.insert(Code.end(), Inst.begin(), Inst.end());
+        NumInstructions++;
+      }
+    }
+    size_t StreamSize = Code.size();
+    // Room for the decoder to look past the last instruction
+    Code.resize(StreamSize + Emu::X86Tables::MAX_INST_SIZE);
+
+    Emu::X86Tables::DecodedInst Decoded;
+    uint64_t Checksum = 0;
+
+    auto Start = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < Iterations; ++i) {
+      size_t Offset = 0;
+      while (Offset < StreamSize) {
+        LogMan::Throw::A(Emu::X86Tables::DecodeInstruction(&Code[Offset], &Decoded), "Couldn't decode the stream");
+        Checksum += Decoded.RM.Displacement + Decoded.Imm;
+        Offset += Decoded.Size;
+      }
+      LogMan::Throw::A(Offset == StreamSize, "Decoder lost its place in the stream");
+    }
+    auto End = std::chrono::high_resolution_clock::now();
+
+    double NS = std::chrono::duration<double, std::nano>(End - Start).count();
+    double TotalInstructions = double(NumInstructions) * Iterations;
+    double TotalBytes = double(StreamSize) * Iterations;
+    printf("%-10s %12.2f %12.1f %12.1f\n", Stream.Name, NS / TotalInstructions, TotalInstructions * 1000.0 / NS, TotalBytes * 1000.0 / NS);
+
+    // Keeps the decode from being optimized out
+    if (Checksum == 1)
+      printf("\n");
+  }
+
+  return 0;
+}
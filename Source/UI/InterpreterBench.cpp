@@ -0,0 +1,155 @@
+#include "Core/CPU/CPUCore.h"
+#include "Core/CPU/CPUState.h"
+#include "Core/CPU/Flags.h"
+#include "Core/CPU/IR.h"
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/InterpreterBackend/Interpreter.h"
+#include "Core/CPU/Passes/Passes.h"
+#include "Core/Memmap.h"
+#include "BenchBlocks.h"
+#include "LogManager.h"
+
+#include <chrono>
+#include <cstring>
+#include <map>
+#include <memory>
+
+// Compares the bytecode interpreter against the map based interpreter it replaced
+// Usage: InterpreterBench [iterations]
+
+/**
+ * @brief The interpreter as it was before it lowered to bytecode
+ *
+ * Looks the IR up by RIP, keeps values in a map and switches on every op
+ */
+static void ReferenceInterpret(std::map<uint64_t, Emu::IR::IntrusiveIRList> const &IRLists, Emu::X86State *State, uint8_t *MemBase) {
+  using namespace Emu;
+  auto IR = &IRLists.at(State->rip);
+  auto Size = IR->GetOffset();
+
+  size_t i = 0;
+  std::map<IR::AlignmentType, uint64_t> Values;
+
+  bool End = false;
+  while (i != Size && !End) {
+    auto op = IR->GetOp(i);
+    size_t opSize = IR::GetSize(op->Op);
+
+    switch (op->Op) {
+    case IR::OP_BEGINBLOCK:
+    case IR::OP_JUMP_TGT:
+    case IR::OP_RIP_MARKER:
+    break;
+    case IR::OP_ENDBLOCK:
+      State->rip += op->C<IR::IROp_EndBlock>()->RIPIncrement;
+      End = true;
+    break;
+    case IR::OP_COND_JUMP: {
+      auto JumpOp = op->C<IR::IROp_CondJump>();
+      if (!!Values[JumpOp->Cond])
+        i = JumpOp->Target - opSize;
+    break;
+    }
+    case IR::OP_CONSTANT:
+      Values[i] = op->C<IR::IROp_Constant>()->Constant;
+    break;
+    case IR::OP_LOADCONTEXT:
+      Values[i] = *reinterpret_cast<uint64_t*>(reinterpret_cast<uint8_t*>(State) + op->C<IR::IROp_LoadContext>()->Offset);
+    break;
+    case IR::OP_STORECONTEXT: {
+      auto StoreOp = op->C<IR::IROp_StoreContext>();
+      *reinterpret_cast<uint64_t*>(reinterpret_cast<uint8_t*>(State) + StoreOp->Offset) = Values[StoreOp->Arg];
+    break;
+    }
+    case IR::OP_ADD: {
+      auto BiOp = op->C<IR::IROp_BiOp>();
+      Values[i] = Values[BiOp->Args[0]] + Values[BiOp->Args[1]];
+    break;
+    }
+    case IR::OP_SUB: {
+      auto BiOp = op->C<IR::IROp_BiOp>();
+      Values[i] = Values[BiOp->Args[0]] - Values[BiOp->Args[1]];
+    break;
+    }
+    case IR::OP_XOR: {
+      auto BiOp = op->C<IR::IROp_BiOp>();
+      Values[i] = Values[BiOp->Args[0]] ^ Values[BiOp->Args[1]];
+    break;
+    }
+    case IR::OP_AND: {
+      auto BiOp = op->C<IR::IROp_BiOp>();
+      Values[i] = Values[BiOp->Args[0]] & Values[BiOp->Args[1]];
+    break;
+    }
+    case IR::OP_LOAD_MEM:
+      Values[i] = *reinterpret_cast<uint64_t*>(MemBase + Values[op->C<IR::IROp_LoadMem>()->Arg[0]]);
+    break;
+    case IR::OP_GET_FLAG:
+      Values[i] = Flags::GetFlag(State, op->C<IR::IROp_GetFlag>()->Bit);
+    break;
+    default:
+      LogMan::Msg::A("Reference interpreter doesn't handle %s", IR::GetName(op->Op).data());
+    break;
+    }
+
+    i += opSize;
+  }
+}
+
+int main(int argc, char **argv) {
+  LogMan::Throw::InstallHandler(AssertHandler);
+  LogMan::Msg::InstallHandler(MsgHandler);
+
+  uint64_t Iterations = argc > 1 ? std::stoull(argv[1]) : 200000;
+
+  Emu::Memmap Mapper;
+  LogMan::Throw::A(Mapper.AllocateSHMRegion(MEMORY_SIZE), "Couldn't allocate guest memory");
+  uint8_t *MemBase = Mapper.GetBaseOffset<uint8_t*>(0);
+  for (size_t i = 0; i < MEMORY_SIZE; ++i)
+    MemBase[i] = i * 13;
+
+  Emu::CPUCore CPU(&Mapper);
+  std::unique_ptr<Emu::CPUBackend> Backend(Emu::CreateInterpreterBackend(&CPU));
+
+  // Run the block the same way CPUCore would
+  Emu::IR::BlockPassManager Passes;
+  Passes.AddPass(Emu::IR::CreateValueNumberingPass());
+  Passes.AddPass(Emu::IR::CreateKnownBitsPass());
+  Passes.AddPass(Emu::IR::CreateDeadCodeEliminationPass());
+
+  printf("%-14s %12s %12s %12s %9s\n", "Instructions", "Map ns/blk", "Bytecode ns", "Lower us", "Speedup");
+  for (uint32_t NumInstructions : {4, 16, 64}) {
+    std::map<uint64_t, Emu::IR::IntrusiveIRList> IRLists;
+    auto IR = &IRLists.emplace(BLOCK_RIP, BuildBlock(NumInstructions)).first->second;
+    Passes.Run(IR);
+
+    auto LowerStart = std::chrono::high_resolution_clock::now();
+    void *Block = Backend->CompileCode(IR);
+    auto LowerEnd = std::chrono::high_resolution_clock::now();
+    LogMan::Throw::A(Block != nullptr, "Interpreter couldn't lower the block");
+
+    Emu::X86State ReferenceState;
+    Emu::X86State BytecodeState;
+
+    auto Start = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < Iterations; ++i) {
+      ReferenceState = InitialState();
+      ReferenceInterpret(IRLists, &ReferenceState, MemBase);
+    }
+    auto Mid = std::chrono::high_resolution_clock::now();
+    for (uint64_t i = 0; i < Iterations; ++i) {
+      BytecodeState = InitialState();
+      Emu::ExecuteInterpreterBlock(&CPU, &BytecodeState, Block);
+    }
+    auto End = std::chrono::high_resolution_clock::now();
+
+    LogMan::Throw::A(memcmp(&ReferenceState, &BytecodeState, sizeof(Emu::X86State)) == 0, "Interpreters disagree on the guest state");
+
+    double ReferenceNS = std::chrono::duration<double, std::nano>(Mid - Start).count() / Iterations;
+    double BytecodeNS = std::chrono::duration<double, std::nano>(End - Mid).count() / Iterations;
+    double LowerUS = std::chrono::duration<double, std::micro>(LowerEnd - LowerStart).count();
+    printf("%-14u %12.1f %12.1f %12.2f %8.1fx\n", NumInstructions, ReferenceNS, BytecodeNS, LowerUS, ReferenceNS / BytecodeNS);
+  }
+
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include "Core/CPU/CPUCore.h"
+#include "Core/CPU/CPUState.h"
+#include "Core/CPU/IntrusiveIRList.h"
+#include "Core/CPU/InterpreterBackend/Interpreter.h"
+#include "Core/CPU/LLVMBackend/LLVM.h"
+#include "Core/CPU/Passes/Passes.h"
+#include "Core/Memmap.h"
+#include "BenchBlocks.h"
+#include "LogManager.h"
+
+#include <chrono>
+#include <cstring>
+#include <memory>
+#include <vector>
+
+// Compares compile time against the speed of the generated code for each LLVM pipeline
+// Usage: LLVMBench [iterations] [blocks]
+
+int main(int argc, char **argv) {
+  LogMan::Throw::InstallHandler(AssertHandler);
+  LogMan::Msg::InstallHandler(MsgHandler);
+
+  uint64_t Iterations = argc > 1 ? std::stoull(argv[1]) : 200000;
+  uint32_t NumBlocks = argc > 2 ? std::stoul(argv[2]) : 20;
+
+  Emu::Memmap Mapper;
+  LogMan::Throw::A(Mapper.AllocateSHMRegion(MEMORY_SIZE), "Couldn't allocate guest memory");
+  uint8_t *MemBase = Mapper.GetBaseOffset<uint8_t*>(0);
+  for (size_t i = 0; i < MEMORY_SIZE; ++i)
+    MemBase[i] = i * 13;
+
+  Emu::CPUCore CPU(&Mapper);
+  std::unique_ptr<Emu::CPUBackend> Interpreter(Emu::CreateInterpreterBackend(&CPU));
+
+  // Run the blocks the same way CPUCore would
+  Emu::IR::BlockPassManager Passes;
+  Passes.AddPass(Emu::IR::CreateValueNumberingPass());
+  Passes.AddPass(Emu::IR::CreateKnownBitsPass());
+  Passes.AddPass(Emu::IR::CreateDeadCodeEliminationPass());
+
+  struct PipelineConfig {
+    char const *Name;
+    Emu::LLVMBackendOptions Options;
+  };
+  // Tiered promotes halfway through the timed runs so it shows both tiers' share
+  std::array<PipelineConfig, 4> Pipelines = {{
+    {"Fast",         {Emu::LLVMPipeline::Fast, 0, false, ""}},
+    {"Fast+Verify",  {Emu::LLVMPipeline::Fast, 0, true, ""}},
+    {"Aggressive",   {Emu::LLVMPipeline::Aggressive, 0, false, ""}},
+    {"Tiered",       {Emu::LLVMPipeline::Tiered, static_cast<uint32_t>(Iterations / 2), false, ""}},
+  }};
+
+  printf("%-14s %-14s %12s %12s\n", "Pipeline", "Instructions", "Compile us", "Run ns/blk");
+  for (uint32_t NumInstructions : {4, 16, 64}) {
+    // Every block sits at its own RIP so the backend can't hand back one it already compiled
+    std::vector<Emu::IR::IntrusiveIRList> Blocks;
+    for (uint32_t i = 0; i < NumBlocks; ++i) {
+      Blocks.emplace_back(BuildBlock(NumInstructions, BLOCK_RIP + i * 0x1000));
+      Passes.Run(&Blocks.back());
+    }
+
+    Emu::X86State Expected = InitialState();
+    Emu::ExecuteInterpreterBlock(&CPU, &Expected, Interpreter->CompileCode(&Blocks[0]));
+
+    for (auto &Pipeline : Pipelines) {
+      std::unique_ptr<Emu::CPUBackend> Backend(Emu::CreateLLVMBackend(&CPU, Pipeline.Options));
+
+      std::vector<void*> Compiled;
+      auto CompileStart = std::chrono::high_resolution_clock::now();
+      for (auto &Block : Blocks)
+        Compiled.emplace_back(Backend->CompileCode(&Block));
+      auto CompileEnd = std::chrono::high_resolution_clock::now();
+      for (void *Block : Compiled)
+        LogMan::Throw::A(Block != nullptr, "LLVM couldn't compile the block");
+
+      Emu::X86State State;
+      auto Start = std::chrono::high_resolution_clock::now();
+      for (uint64_t i = 0; i < Iterations; ++i) {
+        State = InitialState();
+        Emu::ExecuteLLVMBlock(&CPU, &State, Compiled[0]);
+      }
+      auto End = std::chrono::high_resolution_clock::now();
+
+      LogMan::Throw::A(memcmp(&Expected, &State, sizeof(Emu::X86State)) == 0, "LLVM and the interpreter disagree on the guest state");
+
+      for (void *Block : Compiled)
+        Backend->FreeCode(Block);
+
+      double CompileUS = std::chrono::duration<double, std::micro>(CompileEnd - CompileStart).count() / NumBlocks;
+      double RunNS = std::chrono::duration<double, std::nano>(End - Start).count() / Iterations;
+      printf("%-14s %-14u %12.1f %12.1f\n", Pipeline.Name, NumInstructions, CompileUS, RunNS);
+    }
+  }
+
+  return 0;
+}
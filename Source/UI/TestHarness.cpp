@@ -16,6 +16,7 @@
 #include <llvm/IR/Module.h>
 #include <llvm/IR/Type.h>
 #include <llvm/IR/Verifier.h>
+#include <llvm/Support/Host.h>
 #include <llvm/Support/raw_ostream.h>
 #include <llvm/Support/TargetSelect.h>
 #include <llvm/Transforms/Scalar.h>
@@ -92,7 +93,12 @@ void *LLVMIRVisitor::Visit(Emu::IR::IntrusiveIRList const *ir) {
 
 	SmallVector<std::string, 0> attrs;
 	std::string arch = "";
-	std::string cpu = "haswell";
+	std::string cpu = sys::getHostCPUName().str();
+	StringMap<bool> hostfeatures;
+	if (sys::getHostCPUFeatures(hostfeatures)) {
+		for (auto &feature : hostfeatures)
+			attrs.emplace_back((feature.second ? "+" : "-") + feature.first().str());
+	}
 
   auto engine_builder = EngineBuilder(std::unique_ptr<llvm::Module>(testmodule));
 	engine_builder.setEngineKind(EngineKind::JIT);
@@ -253,7 +259,12 @@ void *LLVMIRVisitor::Visit(Emu::IR::IntrusiveIRList const *ir) {
         // LLVM splits the block at all branches
         auto FalsePath = BasicBlock::Create(*con, "false", func);
 
-        auto Comp = builder->CreateICmpNE(Values[Op->Cond], builder->getInt64(0));
+        constexpr CmpInst::Predicate Predicates[] = {
+          CmpInst::ICMP_EQ, CmpInst::ICMP_NE,
+          CmpInst::ICMP_SLT, CmpInst::ICMP_SLE, CmpInst::ICMP_SGT, CmpInst::ICMP_SGE,
+          CmpInst::ICMP_ULT, CmpInst::ICMP_ULE, CmpInst::ICMP_UGT, CmpInst::ICMP_UGE,
+        };
+        auto Comp = builder->CreateICmp(Predicates[Op->Cond], Values[Op->Args[0]], Values[Op->Args[1]]);
         builder->CreateCondBr(Comp, block_locations[Op->Target], FalsePath);
         builder->SetInsertPoint(FalsePath);
         curblock = FalsePath;
@@ -375,6 +386,7 @@ int main(int argc, char **argv) {
 
         auto loadmem = ir.AllocateOp<IROp_LoadMem, OP_LOAD_MEM>();
         loadmem.first->Size = 8;
+        loadmem.first->SignExtend = false;
         loadmem.first->Arg[0] = mem_offset.second;
         loadmem.first->Arg[1] = ~0;
 
@@ -407,12 +419,10 @@ int main(int argc, char **argv) {
       auto loop_count = ir.AllocateOp<IROp_Constant, OP_CONSTANT>();
       loop_count.first->Constant = 10000;
 
-      auto loop_remaining = ir.AllocateOp<IROp_Sub, OP_SUB>();
-      loop_remaining.first->Args[0] = loop_count.second;
-      loop_remaining.first->Args[1] = loop_index.second;
-
       auto cond_jump = ir.AllocateOp<IROp_CondJump, OP_COND_JUMP>();
-      cond_jump.first->Cond = loop_remaining.second;
+      cond_jump.first->Cond = IROp_Select::COMP_NEQ;
+      cond_jump.first->Args[0] = loop_count.second;
+      cond_jump.first->Args[1] = loop_index.second;
       cond_jump.first->Target = loop_body.second;
 
       body_jump = ir.AllocateOp<IROp_Jump, OP_JUMP>();